@@ -20,7 +20,13 @@
 #include "mex-aggregate-model.h"
 #include "mex-model-manager.h"
 
-G_DEFINE_TYPE (MexAggregateModel, mex_aggregate_model, MEX_TYPE_GENERIC_MODEL)
+static void mex_model_iface_init (MexModelIface *iface);
+
+G_DEFINE_TYPE_WITH_CODE (MexAggregateModel,
+                         mex_aggregate_model,
+                         MEX_TYPE_GENERIC_MODEL,
+                         G_IMPLEMENT_INTERFACE (MEX_TYPE_MODEL,
+                                                mex_model_iface_init))
 
 #define AGGREGATE_MODEL_PRIVATE(o) \
   (G_TYPE_INSTANCE_GET_PRIVATE ((o), MEX_TYPE_AGGREGATE_MODEL, MexAggregateModelPrivate))
@@ -107,6 +113,53 @@ mex_aggregate_model_init (MexAggregateModel *self)
   priv->content_to_model = g_hash_table_new (NULL, NULL);
 }
 
+/* Pass on to each model the part of the range that holds its items, so
+ * that feeds loading their content on demand keep paging when they are
+ * aggregated */
+static void
+mex_aggregate_model_set_visible_range (MexModel *model,
+                                       guint     first,
+                                       guint     last)
+{
+  MexAggregateModelPrivate *priv = MEX_AGGREGATE_MODEL (model)->priv;
+  GList *l;
+
+  for (l = priv->models; l; l = l->next)
+    {
+      MexModel *child = l->data;
+      gint child_first = -1, child_last = -1;
+      MexContent *content;
+      guint i;
+
+      for (i = first;
+           (i <= last) && (content = mex_model_get_content (model, i));
+           i++)
+        {
+          gint index;
+
+          if (g_hash_table_lookup (priv->content_to_model, content) != child)
+            continue;
+
+          index = mex_model_index (child, content);
+          if (index < 0)
+            continue;
+
+          if ((child_first < 0) || (index < child_first))
+            child_first = index;
+          child_last = MAX (child_last, index);
+        }
+
+      if (child_first >= 0)
+        mex_model_set_visible_range (child, child_first, child_last);
+    }
+}
+
+static void
+mex_model_iface_init (MexModelIface *iface)
+{
+  iface->set_visible_range = mex_aggregate_model_set_visible_range;
+}
+
 MexModel *
 mex_aggregate_model_new (void)
 {
@@ -614,6 +614,7 @@ mex_column_view_init (MexColumnView *self)
   clutter_actor_set_parent (priv->scroll, CLUTTER_ACTOR (self));
 
   priv->column = mex_column_new ();
+  mex_column_set_virtualized (MEX_COLUMN (priv->column), TRUE);
   clutter_actor_add_child (CLUTTER_ACTOR (priv->scroll), priv->column);
 
   g_signal_connect (priv->column, "notify::opened",
@@ -24,9 +24,13 @@
 #include "mex-scroll-view.h"
 #include "mex-tile.h"
 #include "mex-scrollable-container.h"
+#include "mex-realized-range-private.h"
 
 #define SPACING 6
 
+/* Number of boxes kept aside for reuse when virtualized */
+#define MAX_RECYCLED_BOXES 16
+
 
 enum
 {
@@ -34,18 +38,31 @@ enum
   PROP_EMPTY,
   PROP_HADJUST,
   PROP_VADJUST,
-  PROP_OPENED
+  PROP_OPENED,
+  PROP_VIRTUALIZED
 };
 
 struct _MexColumnPrivate
 {
   guint         has_focus_changed : 1;
+  guint         virtualized : 1;
 
   ClutterActor *current_focus;
 
-  GList        *children;
-  guint         n_items;
-  gint          open_boxes;
+  /* One slot per item of the model, NULL for the items that don't have a
+   * box, see MexRealizedRange */
+  GArray       *children;
+  GPtrArray    *realized;
+  MexRealizedRange range;
+  GQueue        recycled;
+  GList        *open_children;
+  guchar        child_opacity;
+
+  /* Layout of the rows, from the last allocation */
+  gfloat        width;
+  gfloat        row_height;
+  gint          first_visible;
+  gint          last_visible;
 
   MxAdjustment *adjustment;
   gdouble       adjustment_value;
@@ -69,27 +86,87 @@ G_DEFINE_TYPE_WITH_CODE (MexColumn, mex_column, MX_TYPE_WIDGET,
                          G_IMPLEMENT_INTERFACE (MEX_TYPE_SCROLLABLE_CONTAINER,
                                                 mex_scrollable_iface_init))
 
+static void mex_column_queue_realize (MexColumn *column);
+static ClutterActor *mex_column_realize (MexColumn *column, gint index);
+
+static gint
+mex_column_get_child_index (MexColumn    *column,
+                            ClutterActor *child)
+{
+  return mex_realized_range_get_index (&column->priv->range, child);
+}
+
+/* Closed boxes all have the same height, so any of them will do to measure
+ * the rows */
+static ClutterActor *
+mex_column_get_template_child (MexColumn *column)
+{
+  MexColumnPrivate *priv = column->priv;
+  gint i;
+
+  for (i = 0; i < priv->realized->len; i++)
+    {
+      ClutterActor *child = g_ptr_array_index (priv->realized, i);
+
+      if (!g_list_find (priv->open_children, child))
+        return child;
+    }
+
+  return priv->realized->len ? g_ptr_array_index (priv->realized, 0) : NULL;
+}
+
+static gfloat
+mex_column_get_child_height (MexColumn    *column,
+                             ClutterActor *child)
+{
+  gfloat min_height, nat_height;
+
+  clutter_actor_get_preferred_height (child, column->priv->width,
+                                      &min_height, &nat_height);
+
+  return MAX (min_height, nat_height);
+}
+
+/* Top of the row at @index when scrolling. Only the open boxes have a
+ * different height, and there's rarely more than one of them. */
+static gfloat
+mex_column_get_row_y (MexColumn *column,
+                      gint       index)
+{
+  MexColumnPrivate *priv = column->priv;
+  gfloat y;
+  GList *l;
+
+  y = index * (priv->row_height + SPACING);
+
+  for (l = priv->open_children; l; l = l->next)
+    {
+      gint i = mex_column_get_child_index (column, l->data);
+
+      if ((i >= 0) && (i < index))
+        y += mex_column_get_child_height (column, l->data) - priv->row_height;
+    }
+
+  return y;
+}
+
 /* MexScrollableContainerInterface */
 static void
 mex_column_get_allocation (MexScrollableContainer *self,
                            ClutterActor           *child,
                            ClutterActorBox        *box)
 {
-  MexColumnPrivate *priv = MEX_COLUMN (self)->priv;
+  MexColumn *column = MEX_COLUMN (self);
   gfloat width, height;
-  gfloat child_height;
   gint i;
 
   box->y1 = 0;
 
-  if (!priv->children)
+  i = mex_column_get_child_index (column, child);
+  if (i < 0)
     return;
 
-  child_height = clutter_actor_get_height (priv->children->data);
-  i = g_list_index (priv->children, child);
-
-  if (i >= 0)
-    box->y1 += child_height * i;
+  box->y1 = mex_column_get_row_y (column, i);
 
   clutter_actor_get_size (child, &width, &height);
 
@@ -111,14 +188,16 @@ content_box_open_notify (MexContentBox *box,
                          MexColumn     *column)
 {
   MexColumnPrivate *priv = MEX_COLUMN (column)->priv;
-  GList *l;
+  gint i;
 
   if (mex_content_box_get_open (box))
     {
-      for (l = priv->children; l; l = l->next)
+      for (i = 0; i < priv->realized->len; i++)
         {
-          if (l->data != box)
-            clutter_actor_animate (l->data, CLUTTER_EASE_IN_OUT_QUAD, 200,
+          ClutterActor *child = g_ptr_array_index (priv->realized, i);
+
+          if (child != (ClutterActor *) box)
+            clutter_actor_animate (child, CLUTTER_EASE_IN_OUT_QUAD, 200,
                                    "opacity", 56, NULL);
         }
 
@@ -126,49 +205,45 @@ content_box_open_notify (MexContentBox *box,
       clutter_actor_animate (CLUTTER_ACTOR (box), CLUTTER_EASE_IN_OUT_QUAD, 200,
                              "opacity", 255, NULL);
 
-      priv->open_boxes ++;
+      if (!g_list_find (priv->open_children, box))
+        priv->open_children = g_list_prepend (priv->open_children, box);
     }
   else
     {
-      priv->open_boxes --;
+      priv->open_children = g_list_remove (priv->open_children, box);
     }
 
-  if (priv->open_boxes == 0)
+  if (!priv->open_children)
     {
       /* restore all children to full opacity */
-      for (l = priv->children; l; l = l->next)
+      for (i = 0; i < priv->realized->len; i++)
         {
-          clutter_actor_animate (l->data, CLUTTER_EASE_IN_OUT_QUAD, 200,
+          clutter_actor_animate (g_ptr_array_index (priv->realized, i),
+                                 CLUTTER_EASE_IN_OUT_QUAD, 200,
                                  "opacity", 255, NULL);
         }
+
+      /* Closed boxes may now be released */
+      mex_column_queue_realize (column);
     }
 
   g_object_notify (G_OBJECT (column), "opened");
 }
 
 /**
- * mex_column_add_content:
+ * mex_column_create_box:
  *
- * Add an item to the column for the specified content at the specified
- * position.
+ * Create an item for the column, without any content.
  */
-static void
-mex_column_add_content (MexColumn  *column,
-                        MexContent *content,
-                        guint       position)
+static ClutterActor *
+mex_column_create_box (MexColumn *column)
 {
   MexColumnPrivate *priv = column->priv;
   ClutterActor *box;
-  GList *sibling;
 
   box = mex_content_box_new ();
-  mex_content_view_set_content (MEX_CONTENT_VIEW (box), content);
   mex_content_view_set_context (MEX_CONTENT_VIEW (box), priv->model);
 
-  sibling = g_list_nth (priv->children, position);
-  priv->children = g_list_insert_before (priv->children, sibling, box);
-  priv->n_items ++;
-
   g_signal_connect (box, "notify::open",
                     G_CALLBACK (content_box_open_notify), column);
 
@@ -176,6 +251,217 @@ mex_column_add_content (MexColumn  *column,
   mex_content_box_set_important (MEX_CONTENT_BOX (box), TRUE);
 
   clutter_actor_set_parent (box, CLUTTER_ACTOR (column));
+
+  return box;
+}
+
+/**
+ * mex_column_realize:
+ *
+ * Make sure the item at the specified position has a box, reusing one that
+ * scrolled out of view if possible.
+ */
+static ClutterActor *
+mex_column_realize (MexColumn *column,
+                    gint       index)
+{
+  MexColumnPrivate *priv = column->priv;
+  ClutterActor *box;
+
+  box = g_array_index (priv->children, ClutterActor *, index);
+  if (box)
+    return box;
+
+  box = g_queue_pop_head (&priv->recycled);
+  if (!box)
+    box = mex_column_create_box (column);
+
+  mex_content_view_set_content (MEX_CONTENT_VIEW (box),
+                                mex_model_get_content (priv->model, index));
+  clutter_actor_set_opacity (box,
+                             priv->open_children ? 56 : priv->child_opacity);
+  clutter_actor_show (box);
+
+  mex_realized_range_add (&priv->range, index, box);
+
+  return box;
+}
+
+/**
+ * mex_column_unrealize:
+ *
+ * Take the box away from the item at the specified position.
+ */
+static void
+mex_column_unrealize (MexColumn *column,
+                      gint       index)
+{
+  MexColumnPrivate *priv = column->priv;
+  ClutterActor *box;
+
+  box = g_array_index (priv->children, ClutterActor *, index);
+  mex_realized_range_remove (&priv->range, index);
+
+  if (priv->virtualized &&
+      (box != priv->current_focus) &&
+      !g_list_find (priv->open_children, box) &&
+      (priv->recycled.length < MAX_RECYCLED_BOXES))
+    {
+      clutter_actor_hide (box);
+      g_queue_push_head (&priv->recycled, box);
+      return;
+    }
+
+  if (box == priv->current_focus)
+    priv->current_focus = NULL;
+
+  if (g_list_find (priv->open_children, box))
+    {
+      priv->open_children = g_list_remove (priv->open_children, box);
+      if (!priv->open_children)
+        g_object_notify (G_OBJECT (column), "opened");
+    }
+
+  clutter_actor_destroy (box);
+}
+
+/* Rows that need a box, the ones laid out in mex_column_allocate() */
+static void
+mex_column_get_visible_range (MexColumn *column,
+                              gfloat     page_size,
+                              gint      *first,
+                              gint      *last)
+{
+  MexColumnPrivate *priv = column->priv;
+  gfloat row, extra;
+  GList *l;
+
+  /* Everything is laid out when not scrolling */
+  if (!priv->adjustment || (priv->row_height <= 0))
+    {
+      *first = 0;
+      *last = priv->children->len - 1;
+      return;
+    }
+
+  /* Open boxes above the visible rows push them down */
+  extra = 0;
+  for (l = priv->open_children; l; l = l->next)
+    extra += mex_column_get_child_height (column, l->data) - priv->row_height;
+
+  row = priv->row_height + SPACING;
+  *first = MAX (0, (gint) ((priv->adjustment_value - extra) / row) -
+                MEX_REALIZED_BUFFER_ROWS);
+  *last = MIN ((gint) priv->children->len - 1,
+               (gint) ((priv->adjustment_value + page_size) / row) +
+               MEX_REALIZED_BUFFER_ROWS);
+}
+
+/**
+ * mex_column_update_realized:
+ *
+ * When virtualized, create the boxes for the rows around the visible ones
+ * and release the others.
+ */
+static void
+mex_column_update_realized (MexColumn *column)
+{
+  MexColumnPrivate *priv = column->priv;
+  gint first, last;
+
+  if (!priv->model || !priv->children->len)
+    return;
+
+  /* Every row is laid out when not scrolling, so every row needs a box */
+  if (!priv->virtualized || !priv->adjustment)
+    {
+      first = 0;
+      last = priv->children->len - 1;
+    }
+  else if (priv->row_height <= 0)
+    mex_realized_range_get_initial (&priv->range, 1, &first, &last);
+  else
+    {
+      ClutterActorBox box;
+      MxPadding padding;
+
+      clutter_actor_get_allocation_box (CLUTTER_ACTOR (column), &box);
+      mx_widget_get_padding (MX_WIDGET (column), &padding);
+      mex_column_get_visible_range (column,
+                                    box.y2 - box.y1 -
+                                    padding.top - padding.bottom,
+                                    &first, &last);
+    }
+
+  if (mex_realized_range_set (&priv->range, first, last) && priv->virtualized)
+    mex_model_set_visible_range (priv->model, first, last);
+}
+
+static ClutterActor *
+mex_column_range_realize (ClutterActor *owner,
+                          gint          index)
+{
+  return mex_column_realize (MEX_COLUMN (owner), index);
+}
+
+static void
+mex_column_range_unrealize (ClutterActor *owner,
+                            gint          index)
+{
+  mex_column_unrealize (MEX_COLUMN (owner), index);
+}
+
+/* The focused and open boxes stay even when scrolled out of view */
+static gboolean
+mex_column_range_keep (ClutterActor *owner,
+                       ClutterActor *child)
+{
+  MexColumnPrivate *priv = MEX_COLUMN (owner)->priv;
+
+  return (child == priv->current_focus) ||
+    (g_list_find (priv->open_children, child) != NULL);
+}
+
+static void
+mex_column_range_update (ClutterActor *owner)
+{
+  mex_column_update_realized (MEX_COLUMN (owner));
+}
+
+static const MexRealizedRangeFuncs mex_column_range_funcs =
+{
+  mex_column_range_realize,
+  mex_column_range_unrealize,
+  mex_column_range_keep,
+  mex_column_range_update
+};
+
+static void
+mex_column_queue_realize (MexColumn *column)
+{
+  if (column->priv->virtualized)
+    mex_realized_range_queue (&column->priv->range);
+}
+
+/**
+ * mex_column_add_content:
+ *
+ * Add an item to the column at the specified position.
+ */
+static void
+mex_column_add_content (MexColumn *column,
+                        guint      position)
+{
+  MexColumnPrivate *priv = column->priv;
+  ClutterActor *box = NULL;
+
+  mex_realized_range_shift (&priv->range, position, 1);
+  g_array_insert_val (priv->children, position, box);
+
+  if (priv->virtualized)
+    mex_column_queue_realize (column);
+  else
+    mex_column_realize (column, position);
 }
 
 
@@ -187,7 +473,10 @@ mex_column_adjustment_changed_cb (MexColumn *self)
   MexColumnPrivate *priv = self->priv;
 
   priv->adjustment_value = mx_adjustment_get_value (priv->adjustment);
-  clutter_actor_queue_redraw (CLUTTER_ACTOR (self));
+
+  /* Only the visible rows are laid out */
+  mex_column_queue_realize (self);
+  clutter_actor_queue_relayout (CLUTTER_ACTOR (self));
 }
 
 static void
@@ -220,6 +509,7 @@ mex_column_set_adjustments (MxScrollable *scrollable,
       priv->adjustment_value = mx_adjustment_get_value (priv->adjustment);
     }
 
+  mex_column_queue_realize (MEX_COLUMN (scrollable));
   clutter_actor_queue_relayout (CLUTTER_ACTOR (scrollable));
 }
 
@@ -261,15 +551,15 @@ mex_column_move_focus (MxFocusable      *focusable,
                        MxFocusable      *from)
 {
   MxFocusHint hint;
+  gint index;
 
-  GList *link_ = NULL;
   MexColumn *self = MEX_COLUMN (focusable);
   MexColumnPrivate *priv = self->priv;
 
   focusable = NULL;
 
-  link_ = g_list_find (priv->children, from);
-  if (!link_)
+  index = mex_column_get_child_index (self, CLUTTER_ACTOR (from));
+  if (index < 0)
     return NULL;
 
   switch (direction)
@@ -278,21 +568,21 @@ mex_column_move_focus (MxFocusable      *focusable,
     case MX_FOCUS_DIRECTION_UP:
       hint = (direction == MX_FOCUS_DIRECTION_PREVIOUS) ?
         MX_FOCUS_HINT_LAST : MX_FOCUS_HINT_FROM_BELOW;
-      link_ = g_list_previous (link_);
-      if (link_)
+      if (index > 0)
         focusable = mx_focusable_accept_focus (
-                       MX_FOCUSABLE (link_->data), hint);
+                       MX_FOCUSABLE (mex_column_realize (self, index - 1)),
+                       hint);
       break;
 
     case MX_FOCUS_DIRECTION_NEXT:
     case MX_FOCUS_DIRECTION_DOWN:
       hint = (direction == MX_FOCUS_DIRECTION_NEXT) ?
         MX_FOCUS_HINT_FIRST : MX_FOCUS_HINT_FROM_ABOVE;
-      link_ = g_list_next (link_);
 
-      if (link_)
+      if (index + 1 < priv->children->len)
         focusable = mx_focusable_accept_focus (
-                       MX_FOCUSABLE (link_->data), hint);
+                       MX_FOCUSABLE (mex_column_realize (self, index + 1)),
+                       hint);
       break;
 
     case MX_FOCUS_DIRECTION_OUT:
@@ -313,8 +603,6 @@ static MxFocusable *
 mex_column_accept_focus (MxFocusable *focusable,
                          MxFocusHint  hint)
 {
-  GList *link_;
-
   MexColumn *self = MEX_COLUMN (focusable);
   MexColumnPrivate *priv = self->priv;
 
@@ -335,20 +623,25 @@ mex_column_accept_focus (MxFocusable *focusable,
 
     case MX_FOCUS_HINT_FIRST:
     case MX_FOCUS_HINT_FROM_ABOVE:
-      if (priv->n_items)
+      if (priv->children->len)
         focusable = mx_focusable_accept_focus (
-                       MX_FOCUSABLE (priv->children->data), hint);
+                       MX_FOCUSABLE (mex_column_realize (self, 0)), hint);
       break;
 
     case MX_FOCUS_HINT_LAST:
     case MX_FOCUS_HINT_FROM_BELOW:
-      link_ = g_list_last (priv->children);
-      if (link_)
+      if (priv->children->len)
         focusable = mx_focusable_accept_focus (
-                       MX_FOCUSABLE (link_->data), hint);
+                       MX_FOCUSABLE (mex_column_realize (self,
+                                                         priv->children->len -
+                                                         1)),
+                       hint);
       break;
     }
 
+  /* Let go of the boxes that aren't needed anymore */
+  mex_column_queue_realize (self);
+
   return focusable;
 }
 
@@ -404,6 +697,10 @@ mex_column_set_property (GObject      *object,
                                   self->priv->adjustment);
       break;
 
+    case PROP_VIRTUALIZED:
+      mex_column_set_virtualized (self, g_value_get_boolean (value));
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -437,6 +734,11 @@ mex_column_get_property (GObject    *object,
 
     case PROP_OPENED:
       g_value_set_boolean (value, mex_column_get_opened (self));
+      break;
+
+    case PROP_VIRTUALIZED:
+      g_value_set_boolean (value, mex_column_get_virtualized (self));
+      break;
 
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
@@ -447,6 +749,11 @@ mex_column_get_property (GObject    *object,
 static void
 mex_column_finalize (GObject *object)
 {
+  MexColumnPrivate *priv = MEX_COLUMN (object)->priv;
+
+  g_array_unref (priv->children);
+  g_ptr_array_unref (priv->realized);
+
   G_OBJECT_CLASS (mex_column_parent_class)->finalize (object);
 }
 
@@ -456,10 +763,12 @@ mex_column_dispose (GObject *object)
   MexColumn *self = MEX_COLUMN (object);
   MexColumnPrivate *priv = self->priv;
 
+  mex_realized_range_dispose (&priv->range);
+
   if (priv->adjustment)
     {
       g_signal_handlers_disconnect_by_func (priv->adjustment,
-                                            clutter_actor_queue_redraw,
+                                            mex_column_adjustment_changed_cb,
                                             object);
       g_object_unref (priv->adjustment);
       priv->adjustment = NULL;
@@ -477,7 +786,7 @@ mex_column_get_preferred_width (ClutterActor *actor,
                                 gfloat       *min_width_p,
                                 gfloat       *nat_width_p)
 {
-  GList *c;
+  gint i;
   MxPadding padding;
   gfloat min_width = 0, nat_width = 0;
 
@@ -486,15 +795,17 @@ mex_column_get_preferred_width (ClutterActor *actor,
 
   for_height = -1;
 
-  if (priv->n_items > 0)
+  if (priv->children->len > 0)
     {
       min_width = nat_width = 0;
-      for_height /= (gfloat)priv->n_items;
+      for_height /= (gfloat)priv->children->len;
 
-      for (c = priv->children; c; c = c->next)
+      /* Only the boxes that exist, there's a box for every item unless
+       * virtualized */
+      for (i = 0; i < priv->realized->len; i++)
         {
           gfloat child_min_width, child_nat_width;
-          ClutterActor *child = c->data;
+          ClutterActor *child = g_ptr_array_index (priv->realized, i);
 
           clutter_actor_get_preferred_width (child, for_height,
                                              &child_min_width,
@@ -521,7 +832,7 @@ mex_column_get_preferred_height (ClutterActor *actor,
                                  gfloat       *min_height_p,
                                  gfloat       *nat_height_p)
 {
-  GList *c;
+  gint i;
   gfloat min_height = 0, nat_height = 0;
   MxPadding padding;
 
@@ -533,13 +844,21 @@ mex_column_get_preferred_height (ClutterActor *actor,
   if (for_width >= 0)
     for_width = MAX (0, for_width - padding.left - padding.right);
 
-  if (priv->n_items > 0)
+  if (priv->adjustment)
+    {
+      ClutterActor *child = mex_column_get_template_child (self);
+
+      if (child)
+        clutter_actor_get_preferred_height (child, for_width,
+                                            &min_height, &nat_height);
+    }
+  else
     {
       gfloat child_min_height, child_nat_height;
 
-      for (c = priv->children; c; c = c->next)
+      for (i = 0; i < priv->realized->len; i++)
         {
-          ClutterActor *child = c->data;
+          ClutterActor *child = g_ptr_array_index (priv->realized, i);
 
           clutter_actor_get_preferred_height (child, for_width,
                                               &child_min_height,
@@ -547,18 +866,27 @@ mex_column_get_preferred_height (ClutterActor *actor,
 
           min_height += child_min_height;
           nat_height += child_nat_height;
-
-          if (priv->adjustment)
-            break;
         }
     }
 
   if (min_height_p)
     *min_height_p = min_height + padding.top + padding.bottom
-      + (priv->n_items > 0) ? (SPACING * priv->n_items - 1) : 0;
+      + (priv->children->len > 0) ? (SPACING * priv->children->len - 1) : 0;
   if (nat_height_p)
     *nat_height_p += nat_height + padding.top + padding.bottom
-      + (priv->n_items > 0) ? (SPACING * priv->n_items - 1) : 0;
+      + (priv->children->len > 0) ? (SPACING * priv->children->len - 1) : 0;
+}
+
+static void
+mex_column_allocate_child (ClutterActor          *child,
+                           gfloat                 y,
+                           gfloat                 height,
+                           ClutterActorBox       *child_box,
+                           ClutterAllocationFlags flags)
+{
+  child_box->y1 = y;
+  child_box->y2 = y + height;
+  clutter_actor_allocate (child, child_box, flags);
 }
 
 static void
@@ -568,7 +896,8 @@ mex_column_allocate (ClutterActor          *actor,
 {
   ClutterActorBox child_box;
   MxPadding padding;
-  GList *c;
+  gfloat page_size;
+  gint i;
 
   MexColumn *column = MEX_COLUMN (actor);
   MexColumnPrivate *priv = column->priv;
@@ -582,37 +911,37 @@ mex_column_allocate (ClutterActor          *actor,
   child_box.y1 = padding.top;
   child_box.y2 = box->y2 - box->y1 - padding.bottom;
 
-  if (priv->n_items)
+  page_size = child_box.y2 - child_box.y1;
+  priv->width = child_box.x2 - child_box.x1;
+  priv->first_visible = priv->last_visible = -1;
+
+  if (priv->children->len && !priv->adjustment)
     {
       /* Calculate child height multiplier */
-      gfloat width, pref_height, avail_height, ratio, remainder;
+      gfloat pref_height, ratio, remainder;
 
-      if (!priv->adjustment)
-        {
-          /* Find out the height available for each actor as a ratio of
-           * their preferred height.
-           */
-          clutter_actor_get_preferred_height (actor, box->x2 - box->x1,
-                                              NULL, &pref_height);
-          pref_height -= padding.top + padding.bottom;
+      /* Find out the height available for each actor as a ratio of
+       * their preferred height.
+       */
+      clutter_actor_get_preferred_height (actor, box->x2 - box->x1,
+                                          NULL, &pref_height);
+      pref_height -= padding.top + padding.bottom;
 
-          avail_height = child_box.y2 - child_box.y1;
-
-          ratio = avail_height / pref_height;
-        }
-      else
-        ratio = 1;
+      ratio = page_size / pref_height;
 
       /* Allocate children */
       remainder = 0;
-      width = child_box.x2 - child_box.x1;
 
-      for (c = priv->children; c; c = c->next)
+      for (i = 0; i < priv->children->len; i++)
         {
           gfloat min_height, nat_height, height;
-          ClutterActor *child = c->data;
+          ClutterActor *child =
+            g_array_index (priv->children, ClutterActor *, i);
+
+          if (!child)
+            continue;
 
-          clutter_actor_get_preferred_height (child, width,
+          clutter_actor_get_preferred_height (child, priv->width,
                                               &min_height, &nat_height);
 
           /* Calculate the allocatable height and keep an accumulator so
@@ -630,18 +959,71 @@ mex_column_allocate (ClutterActor          *actor,
             }
 
           /* Allocate the child */
-          child_box.y2 = child_box.y1 + height;
-          clutter_actor_allocate (child, &child_box, flags);
+          mex_column_allocate_child (child, child_box.y1, height,
+                                     &child_box, flags);
 
           /* Set the top position of the next child box */
           child_box.y1 = child_box.y2 + SPACING;
         }
+
+      priv->first_visible = 0;
+      priv->last_visible = priv->children->len - 1;
+    }
+  else if (priv->children->len)
+    {
+      ClutterActor *sample = mex_column_get_template_child (column);
+      GList *l;
+
+      /* When scrolling, all the rows but the open ones have the height of
+       * a closed box, only the rows in view need to be laid out
+       */
+      if (sample)
+        priv->row_height = mex_column_get_child_height (column, sample);
+
+      mex_column_get_visible_range (column, page_size,
+                                    &priv->first_visible,
+                                    &priv->last_visible);
+
+      for (i = priv->first_visible; i <= priv->last_visible; i++)
+        {
+          ClutterActor *child =
+            g_array_index (priv->children, ClutterActor *, i);
+
+          /* Not created yet, see mex_column_update_realized() */
+          if (!child || g_list_find (priv->open_children, child))
+            continue;
+
+          mex_column_allocate_child (child,
+                                     padding.top +
+                                     mex_column_get_row_y (column, i),
+                                     priv->row_height, &child_box, flags);
+        }
+
+      /* Open boxes are the only ones with a height of their own */
+      for (l = priv->open_children; l; l = l->next)
+        {
+          i = mex_column_get_child_index (column, l->data);
+          mex_column_allocate_child (l->data,
+                                     padding.top +
+                                     mex_column_get_row_y (column, i),
+                                     mex_column_get_child_height (column,
+                                                                  l->data),
+                                     &child_box, flags);
+        }
+
+      child_box.y2 = padding.top +
+        mex_column_get_row_y (column, priv->children->len) - SPACING;
+
+      /* Scrolled or resized, update the boxes before the next layout */
+      if (priv->virtualized &&
+          ((priv->first_visible != priv->range.first) ||
+           (priv->last_visible != priv->range.last)))
+        mex_column_queue_realize (column);
     }
 
   /* Make sure the adjustment reflects the column's allocation */
   if (priv->adjustment)
     {
-      gdouble page_size = box->y2 - box->y1 - padding.top - padding.bottom;
       mx_adjustment_set_values (priv->adjustment,
                                 mx_adjustment_get_value (priv->adjustment),
                                 0.0,
@@ -669,6 +1051,7 @@ mex_column_apply_transform (ClutterActor *actor,
 static void
 mex_column_paint (ClutterActor *actor)
 {
+  gint i;
   GList *c;
   MxPadding padding;
   ClutterActorBox box;
@@ -687,9 +1070,19 @@ mex_column_paint (ClutterActor *actor)
                             box.y2 - box.y1 - padding.bottom +
                             priv->adjustment_value);
 
-  for (c = priv->children; c; c = c->next)
+  for (i = priv->first_visible; i <= priv->last_visible; i++)
     {
+      ClutterActor *child = g_array_index (priv->children, ClutterActor *, i);
+
       /* skip the current focus and paint it last*/
+      if (child && (priv->current_focus != child) &&
+          !g_list_find (priv->open_children, child))
+        clutter_actor_paint (child);
+    }
+
+  /* Open boxes may reach into the visible rows from above */
+  for (c = priv->open_children; c; c = c->next)
+    {
       if (priv->current_focus != c->data)
         clutter_actor_paint (c->data);
     }
@@ -705,6 +1098,7 @@ mex_column_paint (ClutterActor *actor)
 static void
 mex_column_pick (ClutterActor *actor, const ClutterColor *color)
 {
+  gint i;
   GList *c;
   gdouble value;
   MxPadding padding;
@@ -727,7 +1121,15 @@ mex_column_pick (ClutterActor *actor, const ClutterColor *color)
                             box.x2 - box.x1 - padding.right,
                             box.y2 - box.y1 - padding.bottom + value);
 
-  for (c = priv->children; c; c = c->next)
+  for (i = priv->first_visible; i <= priv->last_visible; i++)
+    {
+      ClutterActor *child = g_array_index (priv->children, ClutterActor *, i);
+
+      if (child && !g_list_find (priv->open_children, child))
+        clutter_actor_paint (child);
+    }
+
+  for (c = priv->open_children; c; c = c->next)
     clutter_actor_paint (c->data);
 
   cogl_clip_pop ();
@@ -764,6 +1166,9 @@ mex_column_notify_focused_cb (MxFocusManager *manager,
                   !priv->has_focus_changed)
                 return;
               priv->current_focus = focused_cell;
+
+              /* The previously focused box may not be needed anymore */
+              mex_column_queue_realize (self);
               break;
             }
 
@@ -868,6 +1273,14 @@ mex_column_class_init (MexColumnClass *klass)
                                 G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
   g_object_class_install_property (o_class, PROP_OPENED, pspec);
 
+  pspec = g_param_spec_boolean ("virtualized",
+                                "Virtualized",
+                                "Only create boxes for the visible rows and "
+                                "reuse them while scrolling.",
+                                FALSE,
+                                G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+  g_object_class_install_property (o_class, PROP_VIRTUALIZED, pspec);
+
   /* MxScrollable properties */
   g_object_class_override_property (o_class,
                                     PROP_HADJUST,
@@ -880,7 +1293,16 @@ mex_column_class_init (MexColumnClass *klass)
 static void
 mex_column_init (MexColumn *self)
 {
-  self->priv = GET_PRIVATE (self);
+  MexColumnPrivate *priv = self->priv = GET_PRIVATE (self);
+
+  priv->children = g_array_new (FALSE, TRUE, sizeof (ClutterActor *));
+  priv->realized = g_ptr_array_new ();
+  mex_realized_range_init (&priv->range, CLUTTER_ACTOR (self),
+                           priv->children, priv->realized,
+                           &mex_column_range_funcs);
+  g_queue_init (&priv->recycled);
+  priv->first_visible = priv->last_visible = -1;
+  priv->child_opacity = 255;
 
   clutter_actor_set_reactive (CLUTTER_ACTOR (self), TRUE);
 }
@@ -893,13 +1315,12 @@ mex_column_init (MexColumn *self)
 static void
 mex_column_populate (MexColumn *column)
 {
-  MexContent *content;
-  gint i = 0;
+  MexColumnPrivate *priv = column->priv;
 
-  g_return_if_fail (column->priv->model != NULL);
+  g_return_if_fail (priv->model != NULL);
 
-  while ((content = mex_model_get_content (column->priv->model, i)))
-    mex_column_add_content (column, content, i++);
+  g_array_set_size (priv->children, mex_model_get_length (priv->model));
+  mex_column_update_realized (column);
 }
 
 /**
@@ -911,11 +1332,19 @@ static void
 mex_column_clear (MexColumn *column)
 {
   MexColumnPrivate *priv = column->priv;
+  ClutterActor *box;
+
+  mex_realized_range_clear (&priv->range);
+  while ((box = g_queue_pop_head (&priv->recycled)))
+    clutter_actor_destroy (box);
 
-  while (priv->children)
+  priv->first_visible = priv->last_visible = -1;
+
+  if (priv->open_children)
     {
-      clutter_actor_destroy (CLUTTER_ACTOR (priv->children->data));
-      priv->children = g_list_delete_link (priv->children, priv->children);
+      g_list_free (priv->open_children);
+      priv->open_children = NULL;
+      g_object_notify (G_OBJECT (column), "opened");
     }
 
   priv->current_focus = NULL;
@@ -934,7 +1363,6 @@ mex_column_controller_changed (GController          *controller,
 {
   MexColumnPrivate *priv = column->priv;
   gint i, n_indices;
-  MexContent *content;
   gboolean was_empty, is_empty;
 
   was_empty = mex_column_is_empty (column);
@@ -948,9 +1376,8 @@ mex_column_controller_changed (GController          *controller,
       for (i = 0; i < n_indices; i++)
         {
           gint content_index = g_controller_reference_get_index_uint (ref, i);
-          content = mex_model_get_content (priv->model, content_index);
 
-          mex_column_add_content (column, content, content_index);
+          mex_column_add_content (column, content_index);
         }
       is_empty = mex_column_is_empty (column);
       break;
@@ -958,18 +1385,15 @@ mex_column_controller_changed (GController          *controller,
     case G_CONTROLLER_REMOVE:
       for (i = 0; i < n_indices; i++)
         {
-          GList *lnk;
-
           gint content_index = g_controller_reference_get_index_uint (ref, i);
 
-          lnk = g_list_nth (priv->children, content_index);
+          if (g_array_index (priv->children, ClutterActor *, content_index))
+            mex_column_unrealize (column, content_index);
 
-          if (lnk->data == priv->current_focus)
-            priv->current_focus = NULL;
-
-          clutter_actor_destroy (lnk->data);
-          priv->children = g_list_delete_link (priv->children, lnk);
+          mex_realized_range_shift (&priv->range, content_index + 1, -1);
+          g_array_remove_index (priv->children, content_index);
         }
+      mex_column_queue_realize (column);
       is_empty = mex_column_is_empty (column);
       break;
 
@@ -1014,7 +1438,7 @@ gboolean
 mex_column_is_empty (MexColumn *column)
 {
   g_return_val_if_fail (MEX_IS_COLUMN (column), TRUE);
-  return (column->priv->children == NULL);
+  return (column->priv->children->len == 0);
 }
 
 gboolean
@@ -1022,7 +1446,49 @@ mex_column_get_opened (MexColumn *column)
 {
   g_return_val_if_fail (MEX_IS_COLUMN (column), FALSE);
 
-  return column->priv->open_boxes != 0;
+  return column->priv->open_children != NULL;
+}
+
+/**
+ * mex_column_set_virtualized:
+ * @column: a #MexColumn
+ * @virtualized: whether to virtualize @column
+ *
+ * A virtualized column only creates boxes for the rows around the visible
+ * ones when scrolling, and reuses them for other items, like a list view
+ * would. A column without a vertical adjustment lays out all of its rows,
+ * so it still creates a box for every item.
+ */
+void
+mex_column_set_virtualized (MexColumn *column,
+                            gboolean   virtualized)
+{
+  MexColumnPrivate *priv;
+
+  g_return_if_fail (MEX_IS_COLUMN (column));
+
+  priv = column->priv;
+  if (priv->virtualized == !!virtualized)
+    return;
+
+  priv->virtualized = !!virtualized;
+
+  if (priv->model)
+    {
+      mex_column_clear (column);
+      mex_column_populate (column);
+      clutter_actor_queue_relayout (CLUTTER_ACTOR (column));
+    }
+
+  g_object_notify (G_OBJECT (column), "virtualized");
+}
+
+gboolean
+mex_column_get_virtualized (MexColumn *column)
+{
+  g_return_val_if_fail (MEX_IS_COLUMN (column), FALSE);
+
+  return column->priv->virtualized;
 }
 
 /**
@@ -1103,8 +1569,12 @@ void
 mex_column_set_child_opacity (MexColumn *column,
                               guchar     opacity)
 {
-  GList *l;
+  MexColumnPrivate *priv = column->priv;
+  gint i;
+
+  /* Boxes created later on pick it up in mex_column_realize() */
+  priv->child_opacity = opacity;
 
-  for (l = column->priv->children; l; l = g_list_next (l))
-    clutter_actor_set_opacity (l->data, opacity);
+  for (i = 0; i < priv->realized->len; i++)
+    clutter_actor_set_opacity (g_ptr_array_index (priv->realized, i), opacity);
 }
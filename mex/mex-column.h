@@ -72,6 +72,9 @@ gboolean mex_column_is_empty (MexColumn *column);
 
 gboolean mex_column_get_opened (MexColumn *column);
 
+void     mex_column_set_virtualized (MexColumn *column, gboolean virtualized);
+gboolean mex_column_get_virtualized (MexColumn *column);
+
 void      mex_column_set_model (MexColumn *column, MexModel *model);
 MexModel* mex_column_get_model (MexColumn *column);
 
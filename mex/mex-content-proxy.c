@@ -58,6 +58,14 @@ static void mex_content_proxy_object_created (MexProxy   *proxy,
                                               MexContent *content,
                                               GObject    *object);
 
+static void
+mex_content_proxy_view_mapped_cb (ClutterActor    *view,
+                                  GParamSpec      *pspec,
+                                  MexContentProxy *proxy)
+{
+  mex_proxy_set_on_screen (MEX_PROXY (proxy), CLUTTER_ACTOR_IS_MAPPED (view));
+}
+
 static void
 mex_content_proxy_finalize (GObject *object)
 {
@@ -79,6 +87,9 @@ mex_content_proxy_dispose (GObject *object)
 
   if (priv->view)
     {
+      g_signal_handlers_disconnect_by_func (priv->view,
+                                            mex_content_proxy_view_mapped_cb,
+                                            self);
       g_object_remove_weak_pointer (G_OBJECT (priv->view),
                                     (gpointer *)&priv->view);
       priv->view = NULL;
@@ -100,14 +111,24 @@ mex_content_proxy_set_property (GObject      *object,
     {
     case PROP_VIEW:
       if (priv->view)
-        g_object_remove_weak_pointer (G_OBJECT (priv->view),
-                                      (gpointer *)&priv->view);
+        {
+          g_signal_handlers_disconnect_by_func (
+            priv->view, mex_content_proxy_view_mapped_cb, self);
+          g_object_remove_weak_pointer (G_OBJECT (priv->view),
+                                        (gpointer *)&priv->view);
+        }
 
       priv->view = g_value_get_object (value);
 
       if (priv->view)
-        g_object_add_weak_pointer (G_OBJECT (priv->view),
-                                   (gpointer *)&priv->view);
+        {
+          g_object_add_weak_pointer (G_OBJECT (priv->view),
+                                     (gpointer *)&priv->view);
+          g_signal_connect (priv->view, "notify::mapped",
+                            G_CALLBACK (mex_content_proxy_view_mapped_cb),
+                            self);
+          mex_content_proxy_view_mapped_cb (priv->view, NULL, self);
+        }
       break;
 
     default:
@@ -20,7 +20,9 @@
 #include "mex-content-tile.h"
 
 #include "mex-download-queue.h"
+#include "mex-image-loader.h"
 #include "mex-program.h"
+#include "mex-texture-cache.h"
 
 #include "mex-utils.h"
 #include "mex-player.h"
@@ -35,6 +37,8 @@ G_DEFINE_TYPE_WITH_CODE (MexContentTile, mex_content_tile, MEX_TYPE_TILE,
                          G_IMPLEMENT_INTERFACE (MEX_TYPE_CONTENT_VIEW, mex_content_view_iface_init)
                          G_IMPLEMENT_INTERFACE (MX_TYPE_FOCUSABLE, mx_focusable_iface_init))
 
+#define LOGO_SIZE 26
+
 #define CONTENT_TILE_PRIVATE(o) \
   (G_TYPE_INSTANCE_GET_PRIVATE ((o), MEX_TYPE_CONTENT_TILE, MexContentTilePrivate))
 
@@ -48,6 +52,8 @@ struct _MexContentTilePrivate
 {
   MexContent *content;
   guint changed_id;
+  GBinding *label_binding;
+  GBinding *secondary_label_binding;
 
   MexModel *model;
 
@@ -63,9 +69,13 @@ struct _MexContentTilePrivate
   guint stop_video_preview;
 
   gpointer download_id;
+  MexImageRequest *image_request;
+  MexImageRequest *placeholder_request;
+  MexImageRequest *logo_request;
 
   guint thumbnail_loaded : 1;
   guint image_set        : 1;
+  guint program_visible  : 1;
 };
 
 enum
@@ -241,88 +251,154 @@ mx_focusable_iface_init (MxFocusableIface *iface)
   iface->move_focus = mex_content_tile_move_focus;
 }
 
+static void
+_cancel_image_request (MexImageRequest **request)
+{
+  if (*request)
+    {
+      mex_image_loader_cancel (*request);
+      *request = NULL;
+    }
+}
+
+static void
+_set_thumbnail_texture (MexContentTile *tile,
+                        CoglHandle      texture)
+{
+  MexContentTilePrivate *priv = tile->priv;
+
+  /* Don't let a placeholder still being loaded replace the thumbnail */
+  _cancel_image_request (&priv->placeholder_request);
+
+  mx_image_set_from_cogl_texture (MX_IMAGE (priv->image), texture);
+
+  priv->thumbnail_loaded = TRUE;
+  priv->image_set = TRUE;
+  clutter_actor_set_size (priv->image,
+                          priv->thumb_width, priv->thumb_height);
+}
+
+static void
+image_loaded (CoglHandle    texture,
+              const GError *error,
+              gpointer      user_data)
+{
+  MexContentTile *tile = MEX_CONTENT_TILE (user_data);
+  MexContentTilePrivate *priv = tile->priv;
+
+  priv->image_request = NULL;
+  priv->thumbnail_loaded = TRUE;
+
+  if (error)
+    {
+      g_warning ("Error loading thumbnail: %s", error->message);
+
+      /* TODO: Maybe set a broken-image tile? */
+
+      return;
+    }
+
+  /* The placeholder stays until the thumbnail is ready */
+  _set_thumbnail_texture (tile, texture);
+}
+
 static void
 download_queue_completed (MexDownloadQueue *queue,
                           const gchar      *uri,
-                          const gchar      *buffer,
-                          gsize             count,
+                          GBytes           *bytes,
                           const GError     *error,
                           gpointer          user_data)
 {
   MexContentTile *tile = MEX_CONTENT_TILE (user_data);
   MexContentTilePrivate *priv = tile->priv;
-  GError *suberror = NULL;
 
   priv->download_id = NULL;
-  priv->thumbnail_loaded = TRUE;
 
-  if (error)
+  if (error || !bytes)
     {
-      g_warning ("Error loading %s: %s", uri, error->message);
+      if (error)
+        g_warning ("Error loading %s: %s", uri, error->message);
+      priv->thumbnail_loaded = TRUE;
       return;
     }
 
-  /* TODO: Find a way of not having to do a g_memdup here */
-  if (!mx_image_set_from_buffer_at_size (MX_IMAGE (priv->image),
-                                         g_memdup (buffer, count), count,
-                                         (GDestroyNotify)g_free,
-                                         priv->thumb_width,
-                                         priv->thumb_height,
-                                         &suberror))
-    {
-      g_warning ("Error loading %s: %s", uri, suberror->message);
-      g_error_free (suberror);
+  priv->image_request = mex_image_loader_load_bytes (uri, bytes,
+                                                     priv->thumb_width,
+                                                     priv->thumb_height,
+                                                     image_loaded,
+                                                     tile);
+}
 
-      /* TODO: Maybe set a broken-image tile? */
+static void
+placeholder_loaded (CoglHandle    texture,
+                    const GError *error,
+                    gpointer      user_data)
+{
+  MexContentTile *tile = MEX_CONTENT_TILE (user_data);
+  MexContentTilePrivate *priv = tile->priv;
 
+  priv->placeholder_request = NULL;
+
+  if (error)
+    {
+      g_warning ("Error loading placeholder: %s", error->message);
       return;
     }
 
+  mx_image_set_from_cogl_texture (MX_IMAGE (priv->image), texture);
   priv->image_set = TRUE;
-  clutter_actor_set_size (priv->image,
-                          priv->thumb_width, priv->thumb_height);
 }
 
 static void
 _update_thumbnail_from_image (MexContentTile *tile,
                               const gchar    *file)
 {
-  GError *error = NULL;
-
   MexContentTilePrivate *priv = tile->priv;
+  CoglHandle texture;
 
-  if (!mx_image_set_from_file_at_size (MX_IMAGE (priv->image),
-                                       file,
-                                       -1,
-                                       -1,
-                                       &error))
+  /* There's only a handful of placeholders, they're nearly always cached */
+  texture = mex_texture_cache_lookup (file, -1, -1);
+  if (texture != COGL_INVALID_HANDLE)
     {
-      g_warning ("Error loading %s: %s", file, error->message);
-      g_error_free (error);
+      mx_image_set_from_cogl_texture (MX_IMAGE (priv->image), texture);
+      cogl_handle_unref (texture);
+      priv->image_set = TRUE;
 
       return;
     }
 
-  priv->image_set = TRUE;
+  /* Don't leave the previous content's thumbnail up in the meantime */
+  mx_image_clear (MX_IMAGE (priv->image));
+  priv->placeholder_request =
+    mex_image_loader_load_file (file, -1, -1, placeholder_loaded, tile);
 }
 
 static void
-_reset_thumbnail (MexContentTile *tile)
+_cancel_thumbnail (MexContentTile *tile)
 {
   MexContentTilePrivate *priv = tile->priv;
-  MexDownloadQueue *queue = mex_download_queue_get_default ();
-  const gchar *mime = NULL;
-  gchar *placeholder_filename = NULL;
 
-  queue = mex_download_queue_get_default ();
-
-  /* cancel any download already in progress */
+  /* cancel any download or decoding already in progress */
   if (priv->download_id)
     {
-      mex_download_queue_cancel (queue, priv->download_id);
+      mex_download_queue_cancel (mex_download_queue_get_default (),
+                                 priv->download_id);
       priv->download_id = NULL;
     }
 
+  _cancel_image_request (&priv->image_request);
+}
+
+static void
+_reset_thumbnail (MexContentTile *tile)
+{
+  MexContentTilePrivate *priv = tile->priv;
+  const gchar *mime = NULL;
+  gchar *placeholder_filename = NULL;
+
+  _cancel_thumbnail (tile);
+  _cancel_image_request (&priv->placeholder_request);
+
   priv->thumbnail_loaded = FALSE;
 
   /* Load placeholder image */
@@ -395,65 +471,106 @@ _update_thumbnail (MexContentTile *tile)
 {
   MexContentTilePrivate *priv = tile->priv;
   MexDownloadQueue *queue;
+  CoglHandle texture;
   const gchar *uri;
-  GFile *file;
+  gchar *path;
 
-  queue = mex_download_queue_get_default ();
-
-  /* cancel any download already in progress */
-  if (priv->download_id)
-    {
-      mex_download_queue_cancel (queue, priv->download_id);
-      priv->download_id = NULL;
-    }
+  _cancel_thumbnail (tile);
 
   /* update thumbnail */
   uri = mex_content_get_metadata (priv->content,
                                   MEX_CONTENT_METADATA_STILL);
-  if (uri)
-    {
-      file = g_file_new_for_uri (uri);
-
-      /* TODO: Display a spinner? */
-      if (file)
-        {
-          gchar *path = g_file_get_path (file);
-
-          if (path)
-            {
-              mx_image_set_from_file_at_size (MX_IMAGE (priv->image), path,
-                                              priv->thumb_width,
-                                              priv->thumb_height,
-                                              NULL);
-              priv->thumbnail_loaded = TRUE;
-              priv->image_set = TRUE;
-              clutter_actor_set_size (priv->image,
+  if (!uri)
+    {
+      priv->thumbnail_loaded = TRUE;
+      return;
+    }
+
+  /* Local files are cached under their path, see
+   * mex_image_loader_load_file() */
+  path = g_filename_from_uri (uri, NULL, NULL);
+
+  texture = mex_texture_cache_lookup (path ? path : uri,
                                       priv->thumb_width, priv->thumb_height);
-              g_free (path);
-            }
-          else
-            {
-              priv->download_id =
-                mex_download_queue_enqueue (queue, uri,
-                                            download_queue_completed,
-                                            tile);
-            }
-
-          g_object_unref (file);
-        }
+  if (texture != COGL_INVALID_HANDLE)
+    {
+      _set_thumbnail_texture (tile, texture);
+      cogl_handle_unref (texture);
+    }
+  /* TODO: Display a spinner? */
+  else if (path)
+    {
+      priv->image_request = mex_image_loader_load_file (path,
+                                                        priv->thumb_width,
+                                                        priv->thumb_height,
+                                                        image_loaded,
+                                                        tile);
     }
   else
-    priv->thumbnail_loaded = TRUE;
+    {
+      queue = mex_download_queue_get_default ();
+      priv->download_id =
+        mex_download_queue_enqueue_bytes (queue, uri,
+                                          download_queue_completed,
+                                          tile);
+    }
+
+  g_free (path);
 }
 
+/* Lets the program know whether it's on screen, so that it can prioritise
+ * or postpone work such as thumbnailing */
 static void
-_update_logo (MexContentTile *tile)
+_set_program_visible (MexContentTile *tile,
+                      gboolean        visible)
 {
+  MexContentTilePrivate *priv = tile->priv;
+
+  if (priv->program_visible == visible)
+    return;
+
+  if (!priv->content || !MEX_IS_PROGRAM (priv->content))
+    return;
+
+  priv->program_visible = visible;
+  _mex_program_set_visible (MEX_PROGRAM (priv->content), visible);
+}
+
+static void
+logo_loaded (CoglHandle    texture,
+             const GError *error,
+             gpointer      user_data)
+{
+  MexContentTile *tile = MEX_CONTENT_TILE (user_data);
   ClutterActor *image;
-  GError *err = NULL;
+
+  tile->priv->logo_request = NULL;
+
+  if (error)
+    {
+      g_warning ("Could not load station logo: %s", error->message);
+      return;
+    }
+
+  /* The logo is decoded to cover the icon's box, fit it back in */
+  image = mx_image_new ();
+  mx_image_set_scale_mode (MX_IMAGE (image), MX_IMAGE_SCALE_FIT);
+  clutter_actor_set_size (image, LOGO_SIZE, LOGO_SIZE);
+  mx_image_set_from_cogl_texture (MX_IMAGE (image), texture);
+
+  mex_tile_set_primary_icon (MEX_TILE (tile), image);
+}
+
+static void
+_update_logo (MexContentTile *tile)
+{
+  MexContentTilePrivate *priv = tile->priv;
   const gchar *logo_url;
+  CoglHandle texture;
+
+  _cancel_image_request (&priv->logo_request);
 
-  logo_url = mex_content_get_metadata (tile->priv->content,
+  logo_url = mex_content_get_metadata (priv->content,
                                        MEX_CONTENT_METADATA_STATION_LOGO);
   if (!logo_url)
     {
@@ -461,21 +578,21 @@ _update_logo (MexContentTile *tile)
       return;
     }
 
-  image = mx_image_new ();
-
   if (g_str_has_prefix (logo_url, "file://"))
     logo_url = logo_url + 7;
 
-  mx_image_set_from_file_at_size (MX_IMAGE (image), logo_url, 26, 26, &err);
-
-  if (err)
+  /* Many channels share the same logo */
+  texture = mex_texture_cache_lookup (logo_url, LOGO_SIZE, LOGO_SIZE);
+  if (texture != COGL_INVALID_HANDLE)
     {
-      g_warning ("Could not load station logo: %s", err->message);
-      g_clear_error (&err);
+      logo_loaded (texture, NULL, tile);
+      cogl_handle_unref (texture);
       return;
     }
 
-  mex_tile_set_primary_icon (MEX_TILE (tile), image);
+  priv->logo_request = mex_image_loader_load_file (logo_url,
+                                                   LOGO_SIZE, LOGO_SIZE,
+                                                   logo_loaded, tile);
 }
 
 static void
@@ -519,8 +636,25 @@ mex_content_tile_set_content (MexContentView *view,
       priv->changed_id = 0;
     }
 
+  /* Tiles get rebound to other content when recycled by a grid */
+  if (priv->label_binding)
+    {
+      g_object_unref (priv->label_binding);
+      priv->label_binding = NULL;
+    }
+
+  if (priv->secondary_label_binding)
+    {
+      g_object_unref (priv->secondary_label_binding);
+      priv->secondary_label_binding = NULL;
+    }
+
   if (priv->content)
     {
+      _cancel_thumbnail (tile);
+      _cancel_image_request (&priv->placeholder_request);
+      _cancel_image_request (&priv->logo_request);
+      _set_program_visible (tile, FALSE);
       g_object_unref (priv->content);
       priv->content = NULL;
     }
@@ -538,15 +672,19 @@ mex_content_tile_set_content (MexContentView *view,
     mex_content_get_property_name (priv->content,
                                    MEX_CONTENT_METADATA_ARTIST);
 
-  g_object_bind_property (content, label_prop_name,
-                          tile, "label",
-                          G_BINDING_SYNC_CREATE);
+  priv->label_binding =
+    g_object_bind_property (content, label_prop_name,
+                            tile, "label",
+                            G_BINDING_SYNC_CREATE);
   if (secondary_label_prop_name)
     {
-      g_object_bind_property (content, secondary_label_prop_name,
-                              tile, "secondary-label",
-                              G_BINDING_SYNC_CREATE);
+      priv->secondary_label_binding =
+        g_object_bind_property (content, secondary_label_prop_name,
+                                tile, "secondary-label",
+                                G_BINDING_SYNC_CREATE);
     }
+  else
+    mex_tile_set_secondary_label (MEX_TILE (tile), NULL);
 
 
 
@@ -675,12 +813,9 @@ mex_content_tile_dispose (GObject *object)
       priv->model = NULL;
     }
 
-  if (priv->download_id)
-    {
-      MexDownloadQueue *dl_queue = mex_download_queue_get_default ();
-      mex_download_queue_cancel (dl_queue, priv->download_id);
-      priv->download_id = NULL;
-    }
+  _cancel_thumbnail (MEX_CONTENT_TILE (object));
+  _cancel_image_request (&priv->placeholder_request);
+  _cancel_image_request (&priv->logo_request);
 
   if (priv->start_video_preview > 0)
     g_source_remove (priv->start_video_preview);
@@ -710,14 +845,25 @@ mex_content_tile_paint (ClutterActor *actor)
   MexContentTilePrivate *priv = MEX_CONTENT_TILE (actor)->priv;
 
   if (priv->content && MEX_IS_PROGRAM (priv->content))
-    _mex_program_complete (MEX_PROGRAM (priv->content));
+    {
+      _set_program_visible (MEX_CONTENT_TILE (actor), TRUE);
+      _mex_program_complete (MEX_PROGRAM (priv->content));
+    }
 
-  if (!priv->thumbnail_loaded && !priv->download_id)
+  if (!priv->thumbnail_loaded && !priv->download_id && !priv->image_request)
     _update_thumbnail (MEX_CONTENT_TILE (actor));
 
   CLUTTER_ACTOR_CLASS (mex_content_tile_parent_class)->paint (actor);
 }
 
+static void
+mex_content_tile_unmap (ClutterActor *actor)
+{
+  _set_program_visible (MEX_CONTENT_TILE (actor), FALSE);
+
+  CLUTTER_ACTOR_CLASS (mex_content_tile_parent_class)->unmap (actor);
+}
+
 static void
 mex_content_tile_class_init (MexContentTileClass *klass)
 {
@@ -733,6 +879,7 @@ mex_content_tile_class_init (MexContentTileClass *klass)
   object_class->finalize = mex_content_tile_finalize;
 
   actor_class->paint = mex_content_tile_paint;
+  actor_class->unmap = mex_content_tile_unmap;
 
   pspec = g_param_spec_int ("thumb-width",
                             "Thumbnail width",
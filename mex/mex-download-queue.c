@@ -20,6 +20,8 @@
 #include "config.h"
 #endif
 
+#include <string.h>
+#include <glib/gstdio.h>
 #include <gio/gio.h>
 #include <gdk-pixbuf/gdk-pixbuf.h>
 
@@ -40,7 +42,9 @@ enum
   PROP_0,
 
   PROP_THROTTLE,
-  PROP_QUEUE_LENGTH
+  PROP_QUEUE_LENGTH,
+  PROP_CACHE_SIZE,
+  PROP_DISK_CACHE_SIZE
 };
 
 enum
@@ -61,9 +65,20 @@ struct _MexDownloadQueuePrivate
   GTimeVal last_process;
   guint    process_timeout;
 
+  /* memory tier, the most recently used items are at the head of
+   * cache_lru */
   GHashTable *cache;
-  gsize cache_size;
-  guint current_age;
+  GQueue     *cache_lru;
+  gsize       cache_size;
+  gsize       max_cache_size;
+
+  /* disk tier, only used for HTTP downloads */
+  gchar      *disk_dir;
+  GHashTable *disk_entries;
+  GQueue     *disk_lru;
+  gboolean    disk_ready;
+  gsize       disk_size;
+  gsize       max_disk_size;
 };
 
 typedef enum
@@ -71,7 +86,8 @@ typedef enum
   MEX_DQ_TYPE_NONE,
   MEX_DQ_TYPE_GIO,
   MEX_DQ_TYPE_SOUP,
-  MEX_DQ_TYPE_CACHED
+  MEX_DQ_TYPE_CACHED,
+  MEX_DQ_TYPE_MAPPED
 } MexDownloadQueueTaskType;
 
 struct _DQTaskAny
@@ -81,17 +97,43 @@ struct _DQTaskAny
   char                     *uri;
 
   MexDownloadQueueCompletedReply callback;
+  MexDownloadQueueBytesReply     bytes_callback;
   gpointer                       userdata;
 };
 
 #define MAX_CACHE_SIZE (6 * 1024 * 1024)
 typedef struct
 {
-  gchar *data;
-  gsize  length;
-  gint   age;
+  gchar  *uri;
+  GBytes *bytes;
+  GList  *link;
 } DQCacheItem;
 
+/* Downloads from HTTP servers are also kept on disk, each in a file named
+ * after the MD5 of the URI, next to a "<md5>.meta" key file holding the
+ * URI and what is needed to revalidate it.
+ */
+#define MAX_DISK_CACHE_SIZE (64 * 1024 * 1024)
+#define DISK_META_GROUP     "Download"
+
+typedef struct
+{
+  gchar  *etag;
+  gchar  *last_modified;
+  gint64  expires;
+} DQDiskMeta;
+
+/* The index keeps what is in the meta files, lookups are answered from
+ * memory */
+typedef struct
+{
+  gchar      *key;
+  gchar      *uri;
+  gsize       size;
+  DQDiskMeta  meta;
+  GList      *link;
+} DQDiskEntry;
+
 #define BUFFER_SIZE 4096
 struct _DQTaskGIO
 {
@@ -100,6 +142,7 @@ struct _DQTaskGIO
   char                     *uri;
 
   MexDownloadQueueCompletedReply callback;
+  MexDownloadQueueBytesReply     bytes_callback;
   gpointer                       userdata;
 
   GCancellable *cancellable;
@@ -113,6 +156,7 @@ struct _DQTaskSoup
   char                     *uri;
 
   MexDownloadQueueCompletedReply callback;
+  MexDownloadQueueBytesReply     bytes_callback;
   gpointer                       userdata;
 
   SoupMessage *message;
@@ -125,11 +169,27 @@ struct _DQTaskCached
   char                     *uri;
 
   MexDownloadQueueCompletedReply callback;
+  MexDownloadQueueBytesReply     bytes_callback;
   gpointer                       userdata;
 
   guint source_id;
 };
 
+/* Local files are mapped rather than read */
+struct _DQTaskMapped
+{
+  MexDownloadQueueTaskType  type;
+  MexDownloadQueue         *queue;
+  char                     *uri;
+
+  MexDownloadQueueCompletedReply callback;
+  MexDownloadQueueBytesReply     bytes_callback;
+  gpointer                       userdata;
+
+  guint  source_id;
+  gchar *path;
+};
+
 typedef union _DQTask
 {
   MexDownloadQueueTaskType type;
@@ -138,6 +198,7 @@ typedef union _DQTask
   struct _DQTaskGIO  gio;
   struct _DQTaskSoup soup;
   struct _DQTaskCached cached;
+  struct _DQTaskMapped mapped;
 } DQTask;
 
 #define GET_PRIVATE(obj) (G_TYPE_INSTANCE_GET_PRIVATE ((obj), \
@@ -147,86 +208,734 @@ G_DEFINE_TYPE (MexDownloadQueue, mex_download_queue, G_TYPE_OBJECT);
 
 static void process_queue (MexDownloadQueue *self);
 
+/* Hands the result of a task to whichever kind of callback it has */
+static void
+mex_download_queue_task_reply (DQTask       *task,
+                               GBytes       *bytes,
+                               const GError *error)
+{
+  if (task->any.bytes_callback)
+    {
+      task->any.bytes_callback (task->any.queue, task->any.uri,
+                                bytes, error, task->any.userdata);
+    }
+  else
+    {
+      gsize count = 0;
+      const gchar *buffer = bytes ? g_bytes_get_data (bytes, &count) : NULL;
+
+      task->any.callback (task->any.queue, task->any.uri,
+                          buffer, count, error, task->any.userdata);
+    }
+}
+
 static void
 mex_download_queue_cache_item_free (DQCacheItem *item)
 {
-  g_free (item->data);
+  g_free (item->uri);
+  g_bytes_unref (item->bytes);
   g_slice_free (DQCacheItem, item);
 }
 
+static void
+mex_download_queue_cache_remove (MexDownloadQueue *queue,
+                                 DQCacheItem      *item)
+{
+  MexDownloadQueuePrivate *priv = queue->priv;
+
+  priv->cache_size -= g_bytes_get_size (item->bytes);
+  g_queue_delete_link (priv->cache_lru, item->link);
+
+  MEX_DEBUG ("cache (%" G_GSIZE_FORMAT "): removed: %s",
+             priv->cache_size, item->uri);
+
+  /* frees the item */
+  g_hash_table_remove (priv->cache, item->uri);
+}
+
+static void
+mex_download_queue_cache_trim (MexDownloadQueue *queue)
+{
+  MexDownloadQueuePrivate *priv = queue->priv;
+
+  while (priv->cache_size > priv->max_cache_size)
+    mex_download_queue_cache_remove (queue,
+                                     g_queue_peek_tail (priv->cache_lru));
+}
+
+/* The cache shares bytes with the callers, it never copies data */
 static void
 mex_download_queue_cache_insert (MexDownloadQueue *queue,
                                  const gchar      *uri,
-                                 gchar            *data,
-                                 gsize             length)
+                                 GBytes           *bytes)
 {
+  MexDownloadQueuePrivate *priv = queue->priv;
   DQCacheItem *item;
-  guint iterations = 0;
+
+  if (g_bytes_get_size (bytes) > priv->max_cache_size)
+    return;
+
+  item = g_hash_table_lookup (priv->cache, uri);
+  if (item)
+    mex_download_queue_cache_remove (queue, item);
 
   item = g_slice_new (DQCacheItem);
-  item->length = length;
-  item->data = data;
-  item->age = queue->priv->current_age++;
+  item->uri = g_strdup (uri);
+  item->bytes = g_bytes_ref (bytes);
+
+  g_queue_push_head (priv->cache_lru, item);
+  item->link = priv->cache_lru->head;
+  g_hash_table_insert (priv->cache, item->uri, item);
+
+  priv->cache_size += g_bytes_get_size (bytes);
+
+  MEX_DEBUG ("cache (%" G_GSIZE_FORMAT "): added: %s",
+             priv->cache_size, uri);
+
+  mex_download_queue_cache_trim (queue);
+}
 
-  g_hash_table_insert (queue->priv->cache, g_strdup (uri), item);
+static const DQCacheItem*
+mex_download_queue_cache_lookup (MexDownloadQueue *queue,
+                                 const gchar      *uri)
+{
+  MexDownloadQueuePrivate *priv = queue->priv;
+  DQCacheItem *item;
+
+  item = g_hash_table_lookup (priv->cache, uri);
 
-  queue->priv->cache_size += item->length;
+  if (item && item->link != priv->cache_lru->head)
+    {
+      g_queue_unlink (priv->cache_lru, item->link);
+      g_queue_push_head_link (priv->cache_lru, item->link);
+    }
+
+  return item;
+}
+
+static gchar *
+mex_download_queue_disk_path (MexDownloadQueue *queue,
+                              const gchar      *key,
+                              const gchar      *suffix)
+{
+  gchar *path, *name = g_strconcat (key, suffix, NULL);
 
-  MEX_DEBUG ("cache (%" G_GSSIZE_FORMAT "): added: %s",
-             queue->priv->cache_size, uri);
+  path = g_build_filename (queue->priv->disk_dir, name, NULL);
+  g_free (name);
 
-  /* keep cache size under MAX_CACHE_SIZE */
-  while (queue->priv->cache_size > MAX_CACHE_SIZE && iterations < 3)
+  return path;
+}
+
+static void
+mex_download_queue_disk_meta_clear (DQDiskMeta *meta)
+{
+  g_free (meta->etag);
+  g_free (meta->last_modified);
+}
+
+static void
+mex_download_queue_disk_entry_free (DQDiskEntry *entry)
+{
+  g_free (entry->key);
+  g_free (entry->uri);
+  mex_download_queue_disk_meta_clear (&entry->meta);
+  g_slice_free (DQDiskEntry, entry);
+}
+
+/* Drops entry from the index, its files are left alone */
+static void
+mex_download_queue_disk_forget (MexDownloadQueue *queue,
+                                DQDiskEntry      *entry)
+{
+  MexDownloadQueuePrivate *priv = queue->priv;
+
+  priv->disk_size -= entry->size;
+  g_queue_delete_link (priv->disk_lru, entry->link);
+
+  /* frees the entry */
+  g_hash_table_remove (priv->disk_entries, entry->key);
+}
+
+static void
+mex_download_queue_disk_remove (MexDownloadQueue *queue,
+                                DQDiskEntry      *entry)
+{
+  gchar *path;
+
+  path = mex_download_queue_disk_path (queue, entry->key, NULL);
+  g_unlink (path);
+  g_free (path);
+
+  path = mex_download_queue_disk_path (queue, entry->key, ".meta");
+  g_unlink (path);
+  g_free (path);
+
+  mex_download_queue_disk_forget (queue, entry);
+}
+
+static void
+mex_download_queue_disk_trim (MexDownloadQueue *queue)
+{
+  MexDownloadQueuePrivate *priv = queue->priv;
+
+  while (priv->disk_size > priv->max_disk_size)
+    mex_download_queue_disk_remove (queue, g_queue_peek_tail (priv->disk_lru));
+}
+
+/* Adds or updates the entry for key as the most recently used one, the
+ * strings of meta are taken over */
+static DQDiskEntry *
+mex_download_queue_disk_add (MexDownloadQueue *queue,
+                             const gchar      *key,
+                             const gchar      *uri,
+                             gsize             size,
+                             DQDiskMeta       *meta)
+{
+  MexDownloadQueuePrivate *priv = queue->priv;
+  DQDiskEntry *entry;
+
+  /* The same URI can be written twice, e.g. when two downloads of it
+   * finish around the same time, update the entry in place then */
+  entry = g_hash_table_lookup (priv->disk_entries, key);
+  if (entry)
     {
-      DQCacheItem *value, *value_to_remove = NULL;
-      gchar *key_to_remove = NULL, *key;
-      guint lowest = G_MAXINT;
-      GHashTableIter iter;
+      priv->disk_size -= entry->size;
+      entry->size = size;
 
-      g_hash_table_iter_init (&iter, queue->priv->cache);
-      while (g_hash_table_iter_next (&iter, (gpointer*) &key,
-                                     (gpointer*) &value))
+      g_free (entry->uri);
+      mex_download_queue_disk_meta_clear (&entry->meta);
+
+      if (entry->link != priv->disk_lru->head)
         {
-          /* find the item with the lowest age to evict from the cache */
-          if (value->age < lowest)
-            {
-              lowest = value->age;
-              key_to_remove = key;
-              value_to_remove = value;
-            }
+          g_queue_unlink (priv->disk_lru, entry->link);
+          g_queue_push_head_link (priv->disk_lru, entry->link);
         }
+    }
+  else
+    {
+      entry = g_slice_new (DQDiskEntry);
+      entry->key = g_strdup (key);
+      entry->size = size;
+
+      g_queue_push_head (priv->disk_lru, entry);
+      entry->link = priv->disk_lru->head;
+      g_hash_table_insert (priv->disk_entries, entry->key, entry);
+    }
 
-      if (value_to_remove)
+  entry->uri = g_strdup (uri);
+  entry->meta = *meta;
+  memset (meta, 0, sizeof (DQDiskMeta));
+
+  priv->disk_size += size;
+
+  return entry;
+}
+
+/* The index of the disk tier is built in a thread from what previous runs
+ * left in the cache directory, HTTP downloads wait for it in
+ * process_queue() */
+static GThreadPool *disk_scan_thread_pool = NULL;
+
+typedef struct
+{
+  gchar      *key;
+  gchar      *uri;
+  gsize       size;
+  time_t      mtime;
+  DQDiskMeta  meta;
+} DQDiskScanItem;
+
+typedef struct
+{
+  MexDownloadQueue *queue;
+  gchar            *dir;
+  gsize             max_size;
+  GArray           *items;
+} DQDiskScan;
+
+static gint
+disk_scan_item_compare (gconstpointer a,
+                        gconstpointer b)
+{
+  const DQDiskScanItem *item_a = a, *item_b = b;
+
+  /* newest first */
+  return (item_a->mtime < item_b->mtime) - (item_a->mtime > item_b->mtime);
+}
+
+static void
+disk_scan_unlink (DQDiskScan  *scan,
+                  const gchar *key)
+{
+  gchar *path, *name = g_strconcat (key, ".meta", NULL);
+
+  path = g_build_filename (scan->dir, key, NULL);
+  g_unlink (path);
+  g_free (path);
+
+  path = g_build_filename (scan->dir, name, NULL);
+  g_unlink (path);
+  g_free (path);
+  g_free (name);
+}
+
+static gboolean
+mex_download_queue_disk_scanned_cb (gpointer user_data)
+{
+  DQDiskScan *scan = user_data;
+  MexDownloadQueue *queue = scan->queue;
+  MexDownloadQueuePrivate *priv = queue->priv;
+  guint i;
+
+  /* Nothing is stored before the index is ready, so the items go in as
+   * they are, newest first */
+  for (i = 0; i < scan->items->len; i++)
+    {
+      DQDiskScanItem *item = &g_array_index (scan->items, DQDiskScanItem, i);
+      DQDiskEntry *entry = g_slice_new (DQDiskEntry);
+
+      entry->key = item->key;
+      entry->uri = item->uri;
+      entry->size = item->size;
+      entry->meta = item->meta;
+
+      g_queue_push_tail (priv->disk_lru, entry);
+      entry->link = priv->disk_lru->tail;
+      g_hash_table_insert (priv->disk_entries, entry->key, entry);
+
+      priv->disk_size += entry->size;
+    }
+  g_array_free (scan->items, TRUE);
+
+  priv->disk_ready = TRUE;
+
+  MEX_DEBUG ("disk cache (%" G_GSIZE_FORMAT "): %u entries",
+             priv->disk_size, g_hash_table_size (priv->disk_entries));
+
+  /* The size may have been lowered in the meantime */
+  mex_download_queue_disk_trim (queue);
+  process_queue (queue);
+
+  g_free (scan->dir);
+  g_slice_free (DQDiskScan, scan);
+  g_object_unref (queue);
+
+  return FALSE;
+}
+
+/* Files are touched when used, so their modification time gives the LRU
+ * order. Their expiry and validators are read from the meta files, so
+ * that lookups never go to the disk. */
+static void
+mex_download_queue_disk_scan (gpointer data,
+                              gpointer user_data)
+{
+  DQDiskScan *scan = data;
+  const gchar *name;
+  gint64 start;
+  gsize size;
+  GDir *dir;
+  guint i;
+
+  start = g_get_real_time () / G_USEC_PER_SEC;
+  scan->items = g_array_new (FALSE, FALSE, sizeof (DQDiskScanItem));
+
+  g_mkdir_with_parents (scan->dir, 0700);
+
+  dir = g_dir_open (scan->dir, 0, NULL);
+  while (dir && (name = g_dir_read_name (dir)))
+    {
+      DQDiskScanItem item;
+      GKeyFile *key_file;
+      gchar *path, *meta_path;
+      GStatBuf buf;
+
+      if (g_str_has_suffix (name, ".meta"))
+        continue;
+
+      path = g_build_filename (scan->dir, name, NULL);
+      if (g_stat (path, &buf) != 0)
         {
-          queue->priv->cache_size -= value_to_remove->length;
+          g_free (path);
+          continue;
+        }
 
-          MEX_DEBUG ("cache (%" G_GSSIZE_FORMAT "): removed: %s",
-                     queue->priv->cache_size, key_to_remove);
+      meta_path = g_strconcat (path, ".meta", NULL);
+      key_file = g_key_file_new ();
 
-          g_hash_table_remove (queue->priv->cache, key_to_remove);
+      item.uri = NULL;
+      if (g_key_file_load_from_file (key_file, meta_path, G_KEY_FILE_NONE,
+                                     NULL))
+        item.uri = g_key_file_get_string (key_file, DISK_META_GROUP, "URI",
+                                          NULL);
+
+      if (item.uri)
+        {
+          item.key = g_strdup (name);
+          item.size = buf.st_size;
+          item.mtime = buf.st_mtime;
+          item.meta.etag = g_key_file_get_string (key_file, DISK_META_GROUP,
+                                                  "ETag", NULL);
+          item.meta.last_modified =
+            g_key_file_get_string (key_file, DISK_META_GROUP,
+                                   "LastModified", NULL);
+          item.meta.expires = g_key_file_get_int64 (key_file,
+                                                    DISK_META_GROUP,
+                                                    "Expires", NULL);
+          g_array_append_val (scan->items, item);
         }
-      else
+      else if (buf.st_mtime < start)
+        {
+          /* A file without its meta can't be revalidated, it was left by
+           * a write that didn't finish */
+          disk_scan_unlink (scan, name);
+        }
+
+      g_key_file_free (key_file);
+      g_free (meta_path);
+      g_free (path);
+    }
+  if (dir)
+    g_dir_close (dir);
+
+  /* Only keep the most recently used entries that fit */
+  g_array_sort (scan->items, disk_scan_item_compare);
+  for (i = 0, size = 0; i < scan->items->len; i++)
+    {
+      size += g_array_index (scan->items, DQDiskScanItem, i).size;
+      if (size > scan->max_size)
+        break;
+    }
+  if (i < scan->items->len)
+    {
+      guint n_kept = i;
+
+      for (; i < scan->items->len; i++)
         {
-          /* nothing to remove, hash table must be empty */
-          break;
+          DQDiskScanItem *item =
+            &g_array_index (scan->items, DQDiskScanItem, i);
+
+          disk_scan_unlink (scan, item->key);
+          g_free (item->key);
+          g_free (item->uri);
+          mex_download_queue_disk_meta_clear (&item->meta);
         }
+      g_array_set_size (scan->items, n_kept);
+    }
+
+  g_idle_add (mex_download_queue_disk_scanned_cb, scan);
+}
 
-      iterations++;
+/* Starts building the index on first use, returns whether it is ready */
+static gboolean
+mex_download_queue_disk_ready (MexDownloadQueue *queue)
+{
+  MexDownloadQueuePrivate *priv = queue->priv;
+  GError *error = NULL;
+  DQDiskScan *scan;
+
+  if (priv->disk_entries)
+    return priv->disk_ready;
+
+  priv->disk_entries =
+    g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+                           (GDestroyNotify) mex_download_queue_disk_entry_free);
+  priv->disk_lru = g_queue_new ();
+
+  priv->disk_dir = g_build_filename (g_get_user_cache_dir (), "mex",
+                                     "downloads", NULL);
+
+  if (G_UNLIKELY (disk_scan_thread_pool == NULL))
+    {
+      disk_scan_thread_pool = g_thread_pool_new (mex_download_queue_disk_scan,
+                                                 NULL, 1, FALSE, &error);
+      if (error)
+        {
+          g_warning (G_STRLOC ": %s", error->message);
+          g_clear_error (&error);
+        }
     }
+
+  scan = g_slice_new0 (DQDiskScan);
+  scan->queue = g_object_ref (queue);
+  scan->dir = g_strdup (priv->disk_dir);
+  scan->max_size = priv->max_disk_size;
+
+  if (disk_scan_thread_pool)
+    g_thread_pool_push (disk_scan_thread_pool, scan, NULL);
+  else
+    mex_download_queue_disk_scan (scan, NULL);
+
+  return FALSE;
 }
 
-static const DQCacheItem*
-mex_download_queue_cache_lookup (MexDownloadQueue *queue,
-                                 const gchar      *uri)
+/* Looks up uri in the index of the disk tier, which must be ready */
+static DQDiskEntry *
+mex_download_queue_disk_lookup (MexDownloadQueue *queue,
+                                const gchar      *uri)
 {
-  DQCacheItem *item;
+  MexDownloadQueuePrivate *priv = queue->priv;
+  DQDiskEntry *entry;
+  gchar *key;
 
-  item = g_hash_table_lookup (queue->priv->cache, uri);
+  key = g_compute_checksum_for_string (G_CHECKSUM_MD5, uri, -1);
+  entry = g_hash_table_lookup (priv->disk_entries, key);
+  g_free (key);
 
-  if (item)
-    item->age = queue->priv->current_age++;
+  /* Guard against another URI with the same MD5 */
+  if (entry && g_strcmp0 (entry->uri, uri) != 0)
+    return NULL;
 
-  return item;
+  return entry;
+}
+
+static void
+disk_touch_cb (GObject      *source_object,
+               GAsyncResult *res,
+               gpointer      user_data)
+{
+  GFileInfo *info = NULL;
+
+  g_file_set_attributes_finish (G_FILE (source_object), res, &info, NULL);
+  if (info)
+    g_object_unref (info);
+}
+
+static void
+mex_download_queue_disk_touch (MexDownloadQueue *queue,
+                               DQDiskEntry      *entry)
+{
+  MexDownloadQueuePrivate *priv = queue->priv;
+  GFileInfo *info;
+  GFile *file;
+  gchar *path;
+
+  if (entry->link != priv->disk_lru->head)
+    {
+      g_queue_unlink (priv->disk_lru, entry->link);
+      g_queue_push_head_link (priv->disk_lru, entry->link);
+    }
+
+  /* Only the next run looks at the modification time */
+  info = g_file_info_new ();
+  g_file_info_set_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED,
+                                    g_get_real_time () / G_USEC_PER_SEC);
+
+  path = mex_download_queue_disk_path (queue, entry->key, NULL);
+  file = g_file_new_for_path (path);
+  g_file_set_attributes_async (file, info, G_FILE_QUERY_INFO_NONE,
+                               G_PRIORITY_DEFAULT, NULL, disk_touch_cb, NULL);
+  g_object_unref (file);
+  g_object_unref (info);
+  g_free (path);
+}
+
+static void
+disk_write_meta_cb (GObject      *source_object,
+                    GAsyncResult *res,
+                    gpointer      user_data)
+{
+  gchar *data = user_data;
+  GError *error = NULL;
+
+  if (!g_file_replace_contents_finish (G_FILE (source_object), res,
+                                       NULL, &error))
+    {
+      MEX_WARNING ("disk cache: could not store metadata: %s",
+                   error->message);
+      g_error_free (error);
+    }
+
+  g_free (data);
+}
+
+/* Lookups are answered from the index, the meta file is only read back by
+ * the next run */
+static void
+mex_download_queue_disk_write_meta (MexDownloadQueue *queue,
+                                    DQDiskEntry      *entry)
+{
+  GKeyFile *key_file;
+  gchar *path, *data;
+  gsize length;
+  GFile *file;
+
+  key_file = g_key_file_new ();
+  g_key_file_set_string (key_file, DISK_META_GROUP, "URI", entry->uri);
+  if (entry->meta.etag)
+    g_key_file_set_string (key_file, DISK_META_GROUP, "ETag",
+                           entry->meta.etag);
+  if (entry->meta.last_modified)
+    g_key_file_set_string (key_file, DISK_META_GROUP, "LastModified",
+                           entry->meta.last_modified);
+  g_key_file_set_int64 (key_file, DISK_META_GROUP, "Expires",
+                        entry->meta.expires);
+
+  data = g_key_file_to_data (key_file, &length, NULL);
+  g_key_file_free (key_file);
+
+  path = mex_download_queue_disk_path (queue, entry->key, ".meta");
+  file = g_file_new_for_path (path);
+  g_file_replace_contents_async (file, data, length, NULL, FALSE,
+                                 G_FILE_CREATE_REPLACE_DESTINATION,
+                                 NULL, disk_write_meta_cb, data);
+  g_object_unref (file);
+  g_free (path);
+}
+
+/* Works out until when a response can be used without revalidation, in
+ * seconds since the epoch, from its Cache-Control or Expires headers */
+static gint64
+mex_download_queue_get_expiry (SoupMessageHeaders *headers,
+                               gboolean           *no_store)
+{
+  gint64 now = g_get_real_time () / G_USEC_PER_SEC;
+  const gchar *header;
+
+  *no_store = FALSE;
+
+  header = soup_message_headers_get_list (headers, "Cache-Control");
+  if (header)
+    {
+      GHashTable *params = soup_header_parse_param_list (header);
+      const gchar *max_age = g_hash_table_lookup (params, "max-age");
+      gint64 expires = 0;
+
+      *no_store = g_hash_table_lookup_extended (params, "no-store",
+                                                NULL, NULL);
+
+      if (!g_hash_table_lookup_extended (params, "no-cache", NULL, NULL) &&
+          max_age)
+        expires = now + g_ascii_strtoll (max_age, NULL, 10);
+
+      soup_header_free_param_list (params);
+
+      if (expires || max_age)
+        return expires;
+    }
+
+  header = soup_message_headers_get_one (headers, "Expires");
+  if (header)
+    {
+      SoupDate *date = soup_date_new_from_string (header);
+
+      if (date)
+        {
+          gint64 expires = soup_date_to_time_t (date);
+
+          soup_date_free (date);
+          return expires;
+        }
+    }
+
+  return 0;
+}
+
+typedef struct
+{
+  MexDownloadQueue *queue;
+  gchar            *key;
+  gchar            *uri;
+  GBytes           *bytes;
+  DQDiskMeta        meta;
+} DQDiskWrite;
+
+static void
+disk_write_cb (GObject      *source_object,
+               GAsyncResult *res,
+               gpointer      user_data)
+{
+  DQDiskWrite *write = user_data;
+  GError *error = NULL;
+
+  if (!g_file_replace_contents_finish (G_FILE (source_object), res,
+                                       NULL, &error))
+    {
+      MEX_WARNING ("disk cache: could not store %s: %s",
+                   write->uri, error->message);
+      g_error_free (error);
+    }
+  else
+    {
+      DQDiskEntry *entry;
+
+      entry = mex_download_queue_disk_add (write->queue, write->key,
+                                           write->uri,
+                                           g_bytes_get_size (write->bytes),
+                                           &write->meta);
+      mex_download_queue_disk_write_meta (write->queue, entry);
+      mex_download_queue_disk_trim (write->queue);
+
+      MEX_DEBUG ("disk cache (%" G_GSIZE_FORMAT "): added: %s",
+                 write->queue->priv->disk_size, write->uri);
+    }
+
+  g_object_unref (write->queue);
+  g_free (write->key);
+  g_free (write->uri);
+  g_bytes_unref (write->bytes);
+  mex_download_queue_disk_meta_clear (&write->meta);
+  g_slice_free (DQDiskWrite, write);
+}
+
+/* Stores a successful HTTP response in the disk tier, if it can be
+ * revalidated or is fresh for a while */
+static void
+mex_download_queue_disk_store (MexDownloadQueue *queue,
+                               const gchar      *uri,
+                               SoupMessage      *msg,
+                               GBytes           *bytes)
+{
+  MexDownloadQueuePrivate *priv = queue->priv;
+  DQDiskEntry *entry;
+  DQDiskWrite *write;
+  gboolean no_store;
+  GFile *file;
+  gchar *path;
+
+  /* HTTP downloads only start once the index is ready, see
+   * process_queue() */
+  if (!priv->disk_ready || g_bytes_get_size (bytes) > priv->max_disk_size)
+    return;
+
+  write = g_slice_new0 (DQDiskWrite);
+  write->meta.expires = mex_download_queue_get_expiry (msg->response_headers,
+                                                       &no_store);
+  write->meta.etag =
+    g_strdup (soup_message_headers_get_one (msg->response_headers, "ETag"));
+  write->meta.last_modified =
+    g_strdup (soup_message_headers_get_one (msg->response_headers,
+                                            "Last-Modified"));
+
+  if (no_store ||
+      (!write->meta.etag && !write->meta.last_modified &&
+       write->meta.expires <= g_get_real_time () / G_USEC_PER_SEC))
+    {
+      mex_download_queue_disk_meta_clear (&write->meta);
+      g_slice_free (DQDiskWrite, write);
+      return;
+    }
+
+  write->queue = g_object_ref (queue);
+  write->key = g_compute_checksum_for_string (G_CHECKSUM_MD5, uri, -1);
+  write->uri = g_strdup (uri);
+  write->bytes = g_bytes_ref (bytes);
+
+  /* Drop any previous version, the new one is added once written over
+   * it */
+  entry = g_hash_table_lookup (priv->disk_entries, write->key);
+  if (entry)
+    mex_download_queue_disk_forget (queue, entry);
+
+  path = mex_download_queue_disk_path (queue, write->key, NULL);
+  file = g_file_new_for_path (path);
+  g_file_replace_contents_async (file,
+                                 g_bytes_get_data (write->bytes, NULL),
+                                 g_bytes_get_size (write->bytes), NULL,
+                                 FALSE, G_FILE_CREATE_REPLACE_DESTINATION,
+                                 NULL, disk_write_cb, write);
+  g_object_unref (file);
+  g_free (path);
 }
 
 static void
@@ -269,6 +978,10 @@ mex_download_queue_free (DQTask *task)
 
       break;
 
+    case MEX_DQ_TYPE_MAPPED:
+      g_free (task->mapped.path);
+      break;
+
     default:
       break;
     }
@@ -294,6 +1007,27 @@ mex_download_queue_finalize (GObject *object)
       priv->cache = NULL;
     }
 
+  if (priv->cache_lru)
+    {
+      g_queue_free (priv->cache_lru);
+      priv->cache_lru = NULL;
+    }
+
+  if (priv->disk_entries)
+    {
+      g_hash_table_destroy (priv->disk_entries);
+      priv->disk_entries = NULL;
+    }
+
+  if (priv->disk_lru)
+    {
+      g_queue_free (priv->disk_lru);
+      priv->disk_lru = NULL;
+    }
+
+  g_free (priv->disk_dir);
+  priv->disk_dir = NULL;
+
   G_OBJECT_CLASS (mex_download_queue_parent_class)->finalize (object);
 }
 
@@ -333,6 +1067,14 @@ mex_download_queue_set_property (GObject      *object,
       mex_download_queue_set_throttle (self, g_value_get_uint (value));
       break;
 
+    case PROP_CACHE_SIZE:
+      mex_download_queue_set_cache_size (self, g_value_get_uint (value));
+      break;
+
+    case PROP_DISK_CACHE_SIZE:
+      mex_download_queue_set_disk_cache_size (self, g_value_get_uint (value));
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -357,6 +1099,14 @@ mex_download_queue_get_property (GObject    *object,
       g_value_set_uint (value, mex_download_queue_get_queue_length (self));
       break;
 
+    case PROP_CACHE_SIZE:
+      g_value_set_uint (value, mex_download_queue_get_cache_size (self));
+      break;
+
+    case PROP_DISK_CACHE_SIZE:
+      g_value_set_uint (value, mex_download_queue_get_disk_cache_size (self));
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -390,6 +1140,22 @@ mex_download_queue_class_init (MexDownloadQueueClass *klass)
                              0, G_MAXUINT, 3,
                              G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
   g_object_class_install_property (o_class, PROP_QUEUE_LENGTH, pspec);
+
+  pspec = g_param_spec_uint ("cache-size",
+                             "Cache size",
+                             "Maximum size in bytes of the downloads kept "
+                             "in memory",
+                             0, G_MAXUINT, MAX_CACHE_SIZE,
+                             G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+  g_object_class_install_property (o_class, PROP_CACHE_SIZE, pspec);
+
+  pspec = g_param_spec_uint ("disk-cache-size",
+                             "Disk cache size",
+                             "Maximum size in bytes of the HTTP downloads "
+                             "kept on disk",
+                             0, G_MAXUINT, MAX_DISK_CACHE_SIZE,
+                             G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+  g_object_class_install_property (o_class, PROP_DISK_CACHE_SIZE, pspec);
 }
 
 static void
@@ -413,22 +1179,20 @@ file_load_cb (GObject      *source_object,
     {
       if (error)
         {
-          task->any.callback (task->any.queue, task->any.uri,
-                              NULL, 0,
-                              error,
-                              task->any.userdata);
+          mex_download_queue_task_reply (task, NULL, error);
         }
       else
         {
-          task->any.callback (task->any.queue, task->any.uri,
-                              contents, length,
-                              NULL,
-                              task->any.userdata);
+          GBytes *bytes = g_bytes_new_take (contents, length);
 
+          mex_download_queue_task_reply (task, bytes, NULL);
           mex_download_queue_cache_insert (task->any.queue, task->any.uri,
-                                           contents, length);
+                                           bytes);
+          g_bytes_unref (bytes);
         }
     }
+  else
+    g_free (contents);
 
   if (error)
     g_error_free (error);
@@ -452,6 +1216,53 @@ process_gio (MexDownloadQueue *queue,
                               task);
 }
 
+static gboolean
+run_mapped_callback (DQTask *task)
+{
+  GMappedFile *mapped;
+  GError *error = NULL;
+
+  task->mapped.source_id = 0;
+
+  mapped = g_mapped_file_new (task->mapped.path, FALSE, &error);
+  if (mapped)
+    {
+      GBytes *bytes;
+
+      /* The mapping lives as long as someone holds on to the data */
+      bytes =
+        g_bytes_new_with_free_func (g_mapped_file_get_contents (mapped),
+                                    g_mapped_file_get_length (mapped),
+                                    (GDestroyNotify) g_mapped_file_unref,
+                                    mapped);
+
+      mex_download_queue_task_reply (task, bytes, NULL);
+      mex_download_queue_cache_insert (task->any.queue, task->any.uri, bytes);
+      g_bytes_unref (bytes);
+    }
+  else
+    {
+      mex_download_queue_task_reply (task, NULL, error);
+      g_error_free (error);
+    }
+
+  mex_download_queue_free (task);
+
+  return FALSE;
+}
+
+/* Local files are mmap'ed rather than read, the pages are then shared
+ * between the cache and whoever keeps a reference on the data */
+static void
+process_mapped (MexDownloadQueue *self,
+                DQTask           *task,
+                gchar            *path)
+{
+  task->mapped.path = path;
+  task->mapped.source_id = g_idle_add ((GSourceFunc) run_mapped_callback,
+                                       task);
+}
+
 static void
 soup_session_cb (SoupSession *session,
                  SoupMessage *msg,
@@ -477,28 +1288,59 @@ soup_session_cb (SoupSession *session,
           return;
         }
     }
+  else if (msg->status_code == SOUP_STATUS_NOT_MODIFIED)
+    {
+      MexDownloadQueue *queue = task->any.queue;
+      DQDiskEntry *entry;
+      gboolean no_store;
+
+      entry = mex_download_queue_disk_lookup (queue, task->any.uri);
+      if (entry)
+        {
+          gchar *path;
+
+          MEX_DEBUG ("disk cache: revalidated: %s", task->any.uri);
+
+          entry->meta.expires =
+            mex_download_queue_get_expiry (msg->response_headers, &no_store);
+          mex_download_queue_disk_write_meta (queue, entry);
+          mex_download_queue_disk_touch (queue, entry);
+
+          /* Carry on with reading the data from the disk cache, the
+           * message is unref'd by the session */
+          path = mex_download_queue_disk_path (queue, entry->key, NULL);
+          task->soup.message = NULL;
+          task->type = MEX_DQ_TYPE_MAPPED;
+          process_mapped (queue, task, path);
+
+          return;
+        }
+
+      /* The entry went away in the meantime */
+      mex_download_queue_task_reply (task, NULL, NULL);
+    }
   else if (SOUP_STATUS_IS_SUCCESSFUL (msg->status_code))
     {
-      void *cache;
+      SoupBuffer *buffer;
+      GBytes *bytes;
 
-      task->any.callback (task->any.queue, task->any.uri,
-                          msg->response_body->data,
-                          msg->response_body->length,
-                          NULL,
-                          task->any.userdata);
+      /* Share the response body with the cache rather than copying it */
+      buffer = soup_message_body_flatten (msg->response_body);
+      bytes = g_bytes_new_with_free_func (buffer->data, buffer->length,
+                                          (GDestroyNotify) soup_buffer_free,
+                                          buffer);
 
-      /* add the contents to the cache */
-      cache = g_memdup (msg->response_body->data, msg->response_body->length);
-      mex_download_queue_cache_insert (task->any.queue, task->any.uri, cache,
-                                       msg->response_body->length);
+      mex_download_queue_task_reply (task, bytes, NULL);
 
+      mex_download_queue_cache_insert (task->any.queue, task->any.uri, bytes);
+      mex_download_queue_disk_store (task->any.queue, task->any.uri, msg,
+                                     bytes);
+      g_bytes_unref (bytes);
     }
   else if (msg->status_code != SOUP_STATUS_CANCELLED)
     {
       /* FIXME: Also create an error on failure */
-      task->any.callback (task->any.queue, task->any.uri,
-                          NULL, 0, NULL,
-                          task->any.userdata);
+      mex_download_queue_task_reply (task, NULL, NULL);
     }
 
   /* The message is unref'd by the session */
@@ -507,9 +1349,12 @@ soup_session_cb (SoupSession *session,
   mex_download_queue_free (task);
 }
 
+/* meta holds the validators of a stale copy in the disk cache, if any, to
+ * make the request conditional */
 static void
 process_soup (MexDownloadQueue *queue,
-              DQTask           *task)
+              DQTask           *task,
+              DQDiskMeta       *meta)
 {
   MexDownloadQueuePrivate *priv = queue->priv;
 
@@ -518,14 +1363,19 @@ process_soup (MexDownloadQueue *queue,
   if (!task->soup.message)
     {
       /* FIXME: Another situation in which to create a GError */
-      task->any.callback (task->any.queue, task->any.uri,
-                          NULL, 0, NULL,
-                          task->any.userdata);
+      mex_download_queue_task_reply (task, NULL, NULL);
       mex_download_queue_free (task);
 
       return;
     }
 
+  if (meta && meta->etag)
+    soup_message_headers_append (task->soup.message->request_headers,
+                                 "If-None-Match", meta->etag);
+  if (meta && meta->last_modified)
+    soup_message_headers_append (task->soup.message->request_headers,
+                                 "If-Modified-Since", meta->last_modified);
+
   soup_session_queue_message (priv->session,
                               task->soup.message,
                               soup_session_cb,
@@ -550,15 +1400,7 @@ run_cached_callback (DQTask *task)
 
   cached = mex_download_queue_cache_lookup (task->any.queue, task->any.uri);
 
-  if (cached)
-    task->any.callback (task->any.queue, task->any.uri,
-                        cached->data, cached->length,
-                        NULL, task->any.userdata);
-  else
-    task->any.callback (task->any.queue, task->any.uri,
-                        NULL, 0, NULL,
-                        task->any.userdata);
-
+  mex_download_queue_task_reply (task, cached ? cached->bytes : NULL, NULL);
 
   mex_download_queue_free (task);
 
@@ -617,9 +1459,24 @@ process_queue (MexDownloadQueue *self)
       gboolean is_http = g_str_has_prefix (task->any.uri, "http://");
       const DQCacheItem *cached =
         mex_download_queue_cache_lookup (self, task->any.uri);
+      DQDiskEntry *disk_entry = NULL;
+      gboolean fresh = FALSE;
+      gchar *path;
+
+      if (!cached && is_http)
+        {
+          /* Wait for the index of the disk tier, it is built in a
+           * thread and lets the disk be skipped here */
+          if (!mex_download_queue_disk_ready (self))
+            break;
+
+          disk_entry = mex_download_queue_disk_lookup (self, task->any.uri);
+          fresh = disk_entry &&
+            disk_entry->meta.expires > g_get_real_time () / G_USEC_PER_SEC;
+        }
 
       /* Make sure to reserve one slot for local/cached content */
-      if (!cached && is_http &&
+      if (!cached && is_http && !fresh &&
           (priv->in_progress >= priv->max_transfers - 1))
         break;
       else
@@ -640,12 +1497,30 @@ process_queue (MexDownloadQueue *self)
           task->type = MEX_DQ_TYPE_CACHED;
           process_cached (self, task);
         }
+      else if (fresh)
+        {
+          MEX_DEBUG ("disk cache: hit: %s", task->any.uri);
+
+          mex_download_queue_disk_touch (self, disk_entry);
+          path = mex_download_queue_disk_path (self, disk_entry->key, NULL);
+
+          task->type = MEX_DQ_TYPE_MAPPED;
+          process_mapped (self, task, path);
+        }
       else if (is_http)
         {
-          MEX_DEBUG ("cache miss, using soup: %s", task->any.uri);
+          MEX_DEBUG ("cache miss, using soup%s: %s",
+                     disk_entry ? " to revalidate" : "", task->any.uri);
 
           task->type = MEX_DQ_TYPE_SOUP;
-          process_soup (self, task);
+          process_soup (self, task, disk_entry ? &disk_entry->meta : NULL);
+        }
+      else if ((path = g_filename_from_uri (task->any.uri, NULL, NULL)))
+        {
+          MEX_DEBUG ("cache miss, mapping: %s", task->any.uri);
+
+          task->type = MEX_DQ_TYPE_MAPPED;
+          process_mapped (self, task, path);
         }
       else
         {
@@ -691,8 +1566,11 @@ mex_download_queue_init (MexDownloadQueue *self)
     NULL);
 
   priv->cache = g_hash_table_new_full (g_str_hash, g_str_equal,
-                                       g_free,
+                                       NULL,
                                        (GDestroyNotify) mex_download_queue_cache_item_free);
+  priv->cache_lru = g_queue_new ();
+  priv->max_cache_size = MAX_CACHE_SIZE;
+  priv->max_disk_size = MAX_DISK_CACHE_SIZE;
 }
 
 MexDownloadQueue *
@@ -706,25 +1584,15 @@ mex_download_queue_get_default (void)
   return queue;
 }
 
-gpointer
-mex_download_queue_enqueue (MexDownloadQueue               *queue,
-                            const char                     *uri,
-                            MexDownloadQueueCompletedReply  reply,
-                            gpointer                        userdata)
+static DQTask *
+mex_download_queue_push (MexDownloadQueue *queue,
+                         const char       *uri,
+                         DQTask           *task)
 {
-  MexDownloadQueuePrivate *priv;
-  DQTask *task;
-
-  g_return_val_if_fail (MEX_IS_DOWNLOAD_QUEUE (queue), NULL);
-  g_return_val_if_fail (uri, NULL);
-
-  priv = queue->priv;
+  MexDownloadQueuePrivate *priv = queue->priv;
 
-  task = g_slice_new0 (DQTask);
   task->any.uri = g_strdup (uri);
   task->any.queue = queue;
-  task->any.callback = reply;
-  task->any.userdata = userdata;
 
   MEX_DEBUG ("queueing download: %s", uri);
 
@@ -752,6 +1620,49 @@ mex_download_queue_enqueue (MexDownloadQueue               *queue,
   return task;
 }
 
+gpointer
+mex_download_queue_enqueue (MexDownloadQueue               *queue,
+                            const char                     *uri,
+                            MexDownloadQueueCompletedReply  reply,
+                            gpointer                        userdata)
+{
+  DQTask *task;
+
+  g_return_val_if_fail (MEX_IS_DOWNLOAD_QUEUE (queue), NULL);
+  g_return_val_if_fail (uri, NULL);
+
+  task = g_slice_new0 (DQTask);
+  task->any.callback = reply;
+  task->any.userdata = userdata;
+
+  return mex_download_queue_push (queue, uri, task);
+}
+
+/**
+ * mex_download_queue_enqueue_bytes:
+ *
+ * Like mex_download_queue_enqueue() but @reply is given a #GBytes it can
+ * hold on to instead of a buffer only valid for the duration of the call.
+ * Local files are mapped rather than read.
+ */
+gpointer
+mex_download_queue_enqueue_bytes (MexDownloadQueue           *queue,
+                                  const char                 *uri,
+                                  MexDownloadQueueBytesReply  reply,
+                                  gpointer                    userdata)
+{
+  DQTask *task;
+
+  g_return_val_if_fail (MEX_IS_DOWNLOAD_QUEUE (queue), NULL);
+  g_return_val_if_fail (uri, NULL);
+
+  task = g_slice_new0 (DQTask);
+  task->any.bytes_callback = reply;
+  task->any.userdata = userdata;
+
+  return mex_download_queue_push (queue, uri, task);
+}
+
 void
 mex_download_queue_cancel (MexDownloadQueue *queue,
                            gpointer          id)
@@ -802,6 +1713,14 @@ mex_download_queue_cancel (MexDownloadQueue *queue,
       mex_download_queue_free (task);
       break;
 
+    case MEX_DQ_TYPE_MAPPED:
+      if (task->mapped.source_id)
+        g_source_remove (task->mapped.source_id);
+      task->mapped.source_id = 0;
+
+      mex_download_queue_free (task);
+      break;
+
     default:
       g_warning ("Unknown download type cancelled! %d", task->type);
       break;
@@ -837,3 +1756,52 @@ mex_download_queue_get_queue_length (MexDownloadQueue *queue)
   g_return_val_if_fail (MEX_IS_DOWNLOAD_QUEUE (queue), 0);
   return g_queue_get_length (queue->priv->queue) + queue->priv->in_progress;
 }
+
+void
+mex_download_queue_set_cache_size (MexDownloadQueue *queue,
+                                   guint             size)
+{
+  MexDownloadQueuePrivate *priv;
+
+  g_return_if_fail (MEX_IS_DOWNLOAD_QUEUE (queue));
+
+  priv = queue->priv;
+  if (priv->max_cache_size != size)
+    {
+      priv->max_cache_size = size;
+      mex_download_queue_cache_trim (queue);
+      g_object_notify (G_OBJECT (queue), "cache-size");
+    }
+}
+
+guint
+mex_download_queue_get_cache_size (MexDownloadQueue *queue)
+{
+  g_return_val_if_fail (MEX_IS_DOWNLOAD_QUEUE (queue), 0);
+  return queue->priv->max_cache_size;
+}
+
+void
+mex_download_queue_set_disk_cache_size (MexDownloadQueue *queue,
+                                        guint             size)
+{
+  MexDownloadQueuePrivate *priv;
+
+  g_return_if_fail (MEX_IS_DOWNLOAD_QUEUE (queue));
+
+  priv = queue->priv;
+  if (priv->max_disk_size != size)
+    {
+      priv->max_disk_size = size;
+      if (priv->disk_entries)
+        mex_download_queue_disk_trim (queue);
+      g_object_notify (G_OBJECT (queue), "disk-cache-size");
+    }
+}
+
+guint
+mex_download_queue_get_disk_cache_size (MexDownloadQueue *queue)
+{
+  g_return_val_if_fail (MEX_IS_DOWNLOAD_QUEUE (queue), 0);
+  return queue->priv->max_disk_size;
+}
@@ -54,6 +54,16 @@ typedef void (*MexDownloadQueueCompletedReply) (MexDownloadQueue *queue,
                                                 gsize             count,
                                                 const GError     *error,
                                                 gpointer          userdata);
+
+/* Same as above but the data is handed over as a GBytes that the callee can
+ * keep a reference on; it's shared with the download cache, so no copy is
+ * needed */
+typedef void (*MexDownloadQueueBytesReply) (MexDownloadQueue *queue,
+                                            const char       *uri,
+                                            GBytes           *bytes,
+                                            const GError     *error,
+                                            gpointer          userdata);
+
 struct _MexDownloadQueue
 {
     GObject parent;
@@ -73,6 +83,10 @@ gpointer mex_download_queue_enqueue (MexDownloadQueue               *queue,
                                      const char                     *uri,
                                      MexDownloadQueueCompletedReply  reply,
                                      gpointer                        userdata);
+gpointer mex_download_queue_enqueue_bytes (MexDownloadQueue           *queue,
+                                           const char                 *uri,
+                                           MexDownloadQueueBytesReply  reply,
+                                           gpointer                    userdata);
 
 void mex_download_queue_cancel (MexDownloadQueue *queue,
                                 gpointer          id);
@@ -83,6 +97,14 @@ guint mex_download_queue_get_throttle (MexDownloadQueue *queue);
 
 guint mex_download_queue_get_queue_length (MexDownloadQueue *queue);
 
+void  mex_download_queue_set_cache_size (MexDownloadQueue *queue,
+                                         guint             size);
+guint mex_download_queue_get_cache_size (MexDownloadQueue *queue);
+
+void  mex_download_queue_set_disk_cache_size (MexDownloadQueue *queue,
+                                              guint             size);
+guint mex_download_queue_get_disk_cache_size (MexDownloadQueue *queue);
+
 G_END_DECLS
 
 #endif /* __MEX_DOWNLOAD_QUEUE_H__ */
@@ -243,29 +243,98 @@ parse_channels_dat_line (MexEpgRadiotimes *provider,
   return TRUE;
 }
 
+/*
+ * Walks over the lines of a downloaded buffer without copying it, each
+ * line is made available, nul terminated, in the scratch string which is
+ * reused from one line to the next. If crlf is TRUE, lines are only
+ * terminated by "\r\n".
+ */
+typedef struct
+{
+  const gchar *p;
+  const gchar *end;
+  gboolean     crlf;
+  GString     *line;
+} LineReader;
+
+static void
+line_reader_init (LineReader *reader,
+                  GBytes     *bytes,
+                  gboolean    crlf)
+{
+  gsize size = 0;
+
+  reader->p = bytes ? g_bytes_get_data (bytes, &size) : NULL;
+  reader->end = reader->p + size;
+  reader->crlf = crlf;
+  reader->line = g_string_sized_new (256);
+}
+
+static gchar *
+line_reader_next (LineReader *reader)
+{
+  const gchar *start = reader->p, *eol = start;
+  gsize length;
+
+  if (start == NULL || start >= reader->end)
+    return NULL;
+
+  for (;;)
+    {
+      eol = memchr (eol, '\n', reader->end - eol);
+
+      if (eol == NULL || !reader->crlf || (eol > start && eol[-1] == '\r'))
+        break;
+
+      eol++;
+    }
+
+  if (eol)
+    {
+      reader->p = eol + 1;
+      length = eol - start;
+      if (reader->crlf)
+        length--;
+    }
+  else
+    {
+      reader->p = reader->end;
+      length = reader->end - start;
+    }
+
+  g_string_truncate (reader->line, 0);
+  g_string_append_len (reader->line, start, length);
+
+  return reader->line->str;
+}
+
+static void
+line_reader_clear (LineReader *reader)
+{
+  g_string_free (reader->line, TRUE);
+}
+
 static void
 on_channel_dat_received (MexDownloadQueue *queue,
                          const char       *uri,
-                         const char       *buffer,
-                         gsize             count,
+                         GBytes           *bytes,
                          const GError     *dq_error,
                          gpointer          userdata)
 {
   MexEpgRadiotimes *provider = MEX_EPG_RADIOTIMES (userdata);
   MexEpgRadiotimesPrivate *priv = provider->priv;
-  GInputStream *input;
-  GDataInputStream *data;
-  GError *error = NULL;
+  LineReader reader;
   gchar *line;
 
-  MEX_DEBUG ("received %s, size %"G_GSIZE_FORMAT, uri, count);
-
   if (dq_error)
     {
       g_warning ("Could not download %s: %s", uri, dq_error->message);
       return;
     }
 
+  MEX_DEBUG ("received %s, size %"G_GSIZE_FORMAT, uri,
+             bytes ? g_bytes_get_size (bytes) : 0);
+
   /* prepare channel2id hash table */
   if (priv->channel2id)
     g_hash_table_unref (priv->channel2id);
@@ -274,32 +343,16 @@ on_channel_dat_received (MexDownloadQueue *queue,
                                            g_free, g_free);
 
   /* parse the date line by line */
-  input = g_memory_input_stream_new_from_data (buffer, count, NULL);
-  data = g_data_input_stream_new (input);
+  line_reader_init (&reader, bytes, FALSE);
 
-  /* The first line is empty */
-  line = g_data_input_stream_read_line (data, NULL, NULL, &error);
-  g_free (line);
+  /* The first line is empty and the second one is the disclamer */
+  line_reader_next (&reader);
+  line_reader_next (&reader);
 
-  /* The second line is the disclamer*/
-  line = g_data_input_stream_read_line (data, NULL, NULL, &error);
-  g_free (line);
+  while ((line = line_reader_next (&reader)))
+    parse_channels_dat_line (provider, line);
 
-  line = g_data_input_stream_read_line (data, NULL, NULL, &error);
-  while (line)
-    {
-      parse_channels_dat_line (provider, line);
-      g_free (line);
-      line = g_data_input_stream_read_line (data, NULL, NULL, &error);
-    }
-  if (G_UNLIKELY (error))
-    {
-      g_warning ("Could not read line: %s", error->message);
-      g_clear_error (&error);
-    }
-
-  g_object_unref (data);
-  g_object_unref (input);
+  line_reader_clear (&reader);
 
   g_signal_emit_by_name (provider, "epg-provider-ready", 0);
 }
@@ -313,8 +366,8 @@ mex_epg_radiotimes_grab_channel_list (MexEpgRadiotimes *provider)
 
   dq = mex_download_queue_get_default ();
   channels_dat_url = g_strconcat (priv->base_url, "/channels.dat", NULL);
-  mex_download_queue_enqueue (dq, channels_dat_url,
-                              on_channel_dat_received, provider);
+  mex_download_queue_enqueue_bytes (dq, channels_dat_url,
+                                    on_channel_dat_received, provider);
   g_free (channels_dat_url);
 }
 
@@ -502,15 +555,12 @@ no_duration:
 static void
 on_epg_dat_received (MexDownloadQueue *queue,
                      const char       *uri,
-                     const char       *buffer,
-                     gsize             count,
+                     GBytes           *bytes,
                      const GError     *dq_error,
                      gpointer          user_data)
 {
   Request *req = user_data;
-  GInputStream *input;
-  GDataInputStream *data;
-  GError *error = NULL;
+  LineReader reader;
   GPtrArray *events;
   gchar *line;
 
@@ -520,38 +570,23 @@ on_epg_dat_received (MexDownloadQueue *queue,
       return;
     }
 
-  MEX_DEBUG ("received %s, size %"G_GSIZE_FORMAT, uri, count);
+  MEX_DEBUG ("received %s, size %"G_GSIZE_FORMAT, uri,
+             bytes ? g_bytes_get_size (bytes) : 0);
 
   events = g_ptr_array_new_with_free_func (g_object_unref);
 
-  /* parse the date line by line */
-  input = g_memory_input_stream_new_from_data (buffer, count, NULL);
-  data = g_data_input_stream_new (input);
-  g_data_input_stream_set_newline_type (data, G_DATA_STREAM_NEWLINE_TYPE_CR_LF);
+  /* parse the date line by line, parse_epg_dat_line() cuts the fields
+   * out of the line in place, which the scratch string allows */
+  line_reader_init (&reader, bytes, TRUE);
 
-  /* The first line is empty */
-  line = g_data_input_stream_read_line (data, NULL, NULL, &error);
-  g_free (line);
+  /* The first line is empty and the second one is the disclamer */
+  line_reader_next (&reader);
+  line_reader_next (&reader);
 
-  /* The second line is the disclamer*/
-  line = g_data_input_stream_read_line (data, NULL, NULL, &error);
-  g_free (line);
-
-  line = g_data_input_stream_read_line (data, NULL, NULL, &error);
-  while (line)
-    {
-      parse_epg_dat_line (req, line, events);
-      g_free (line);
-      line = g_data_input_stream_read_line (data, NULL, NULL, &error);
-    }
-  if (G_UNLIKELY (error))
-    {
-      g_warning ("Could not read line: %s", error->message);
-      g_clear_error (&error);
-    }
+  while ((line = line_reader_next (&reader)))
+    parse_epg_dat_line (req, line, events);
 
-  g_object_unref (data);
-  g_object_unref (input);
+  line_reader_clear (&reader);
 
   req->callback (req->provider, req->channel, events, req->user_data);
 
@@ -592,7 +627,7 @@ mex_epg_radiotimes_get_events (MexEpgProvider      *provider,
   dq = mex_download_queue_get_default ();
 
   data_url = g_strconcat (priv->base_url, "/", id, ".dat", NULL);
-  mex_download_queue_enqueue (dq, data_url, on_epg_dat_received, req);
+  mex_download_queue_enqueue_bytes (dq, data_url, on_epg_dat_received, req);
   g_free (data_url);
 }
 
@@ -19,6 +19,7 @@
 #include "mex-feed.h"
 #include "mex-program.h"
 #include "mex-model.h"
+#include "mex-search-index-private.h"
 
 #include <string.h>
 #include <stdlib.h>
@@ -40,10 +41,15 @@ struct _MexFeedPrivate {
 
   GController *controller;
 
-  GPtrArray *index_terms;
-  GHashTable *index_to_programs; /* Maps index term to a GHashTable of
-                                    MexPrograms that have that term */
+  MexSearchIndex *index;
   GHashTable *id_to_programs; /* Maps program ids to MexPrograms */
+
+  GHashTable *indexed; /* Maps the MexPrograms of the feed to the
+                          generation they were indexed with */
+  guint generation;
+  struct _IndexBatch *batch; /* Changes waiting to be sent to the pool */
+  guint batch_id;
+  guint n_pending_batches;
 };
 
 #define GET_PRIVATE(obj)                                                \
@@ -51,58 +57,199 @@ struct _MexFeedPrivate {
 
 G_DEFINE_TYPE (MexFeed, mex_feed, MEX_TYPE_GENERIC_MODEL);
 
+/* Programs are indexed in a thread. Their metadata is copied when they're
+   added or when it changes, tokenised by the pool, and the tokens of a
+   whole batch are merged into the index at once from the main loop, so
+   that searches never see half of a batch. Each metadata field is indexed
+   on its own, a change only tokenises the field that changed. */
+
+typedef struct {
+  MexContent  *program;
+  guint        generation;
+  guint        field;
+  gchar       *text;
+  gchar      **tokens;
+} IndexEntry;
+
+typedef struct _IndexBatch {
+  MexFeed   *feed;
+  GPtrArray *entries;
+} IndexBatch;
+
+static GThreadPool *index_thread_pool = NULL;
+
 static void
-index_content (MexFeed    *feed,
-               MexContent *content)
+index_entry_free (IndexEntry *entry)
 {
-  MexFeedPrivate *priv = feed->priv;
-  char *index_str = mex_program_get_index_str (MEX_PROGRAM (content));
-  char **idx_strs;
+  g_free (entry->text);
+  g_strfreev (entry->tokens);
+  g_slice_free (IndexEntry, entry);
+}
+
+static void
+index_batch_free (IndexBatch *batch)
+{
+  g_ptr_array_free (batch->entries, TRUE);
+  if (batch->feed)
+    g_object_unref (batch->feed);
+  g_slice_free (IndexBatch, batch);
+}
+
+static gboolean
+index_batch_apply (gpointer data)
+{
+  IndexBatch *batch = data;
+  MexFeedPrivate *priv = batch->feed->priv;
   int i;
 
-  if (index_str == NULL) {
-    return;
+  for (i = 0; i < batch->entries->len; i++) {
+    IndexEntry *entry = g_ptr_array_index (batch->entries, i);
+    gpointer generation;
+
+    /* Skip programs that have been removed since, or removed and added
+       again */
+    if (!g_hash_table_lookup_extended (priv->indexed, entry->program,
+                                       NULL, &generation) ||
+        GPOINTER_TO_UINT (generation) != entry->generation)
+      continue;
+
+    mex_search_index_set_field (priv->index, entry->program, entry->field,
+                                entry->tokens);
   }
 
-  idx_strs = g_strsplit (index_str, " ", -1);
+  priv->n_pending_batches--;
+  index_batch_free (batch);
 
-  /* Put each index item into the hashtable, and add its program to the
-     bucket */
-  for (i = 0; idx_strs[i]; i++) {
-    GHashTable *bucket = NULL;
+  return FALSE;
+}
 
-    bucket = g_hash_table_lookup (priv->index_to_programs, idx_strs[i]);
-    if (bucket == NULL) {
-      char *term;
+static void
+index_batch_tokenize (gpointer data,
+                      gpointer user_data)
+{
+  IndexBatch *batch = data;
+  int i;
 
-      /* We use a hashtable so that we can eliminate duplicates easily. */
-      bucket = g_hash_table_new (NULL, NULL);
-      g_hash_table_insert (bucket, content, content);
+  for (i = 0; i < batch->entries->len; i++) {
+    IndexEntry *entry = g_ptr_array_index (batch->entries, i);
 
-      term = g_strdup (idx_strs[i]);
-      g_hash_table_insert (priv->index_to_programs, term, bucket);
+    if (entry->text)
+      entry->tokens = mex_search_index_tokenize (entry->text);
+  }
 
-      /* Put the term into an array for searching later */
-      g_ptr_array_add (priv->index_terms, term);
-    } else {
-      /* Check if the program is already in the bucket */
-      if (g_hash_table_lookup (bucket, content) == NULL) {
-        g_hash_table_insert (bucket, content, content);
-      }
+  g_idle_add (index_batch_apply, batch);
+}
 
-      /* The bucket is already in the hashtable so don't need to
-         do anything else */
+static gboolean
+mex_feed_push_batch (MexFeed *feed)
+{
+  MexFeedPrivate *priv = feed->priv;
+  IndexBatch *batch = priv->batch;
+  GError *error = NULL;
+
+  priv->batch = NULL;
+  priv->batch_id = 0;
+
+  if (G_UNLIKELY (index_thread_pool == NULL)) {
+    /* A single thread, so that the batches are applied in order */
+    index_thread_pool = g_thread_pool_new (index_batch_tokenize, NULL,
+                                           1, FALSE, &error);
+    if (error) {
+      g_warning (G_STRLOC ": %s", error->message);
+      g_clear_error (&error);
     }
   }
 
-  g_free (index_str);
-  g_strfreev (idx_strs);
+  batch->feed = g_object_ref (feed);
+  priv->n_pending_batches++;
+
+  if (index_thread_pool)
+    g_thread_pool_push (index_thread_pool, batch, NULL);
+  else
+    index_batch_tokenize (batch, NULL);
+
+  return FALSE;
+}
+
+static void
+queue_field (MexFeed     *feed,
+             MexContent  *content,
+             guint        field,
+             const gchar *value)
+{
+  MexFeedPrivate *priv = feed->priv;
+  IndexEntry *entry;
+
+  if (!priv->batch) {
+    priv->batch = g_slice_new0 (IndexBatch);
+    priv->batch->entries =
+      g_ptr_array_new_with_free_func ((GDestroyNotify) index_entry_free);
+  }
+
+  entry = g_slice_new0 (IndexEntry);
+  entry->program = content;
+  entry->generation =
+    GPOINTER_TO_UINT (g_hash_table_lookup (priv->indexed, content));
+  entry->field = field;
+  entry->text = g_strdup (value);
+  g_ptr_array_add (priv->batch->entries, entry);
+
+  /* Collect everything that changes during this main loop iteration */
+  if (!priv->batch_id)
+    priv->batch_id = g_idle_add ((GSourceFunc) mex_feed_push_batch, feed);
+}
+
+struct _QueueClosure {
+  MexFeed    *feed;
+  MexContent *content;
+};
+
+static void
+queue_metadata_cb (MexContentMetadata  key,
+                   const gchar        *value,
+                   gpointer            data)
+{
+  struct _QueueClosure *closure = data;
+
+  queue_field (closure->feed, closure->content, key, value);
+}
+
+static void
+program_notify_cb (MexContent *content,
+                   GParamSpec *pspec,
+                   MexFeed    *feed)
+{
+  /* MexGenericContent has a property per metadata key, with the key as
+     property id */
+  if (pspec->owner_type != MEX_TYPE_GENERIC_CONTENT ||
+      pspec->param_id >= MEX_CONTENT_METADATA_LAST_ID)
+    return;
+
+  queue_field (feed, content, pspec->param_id,
+               mex_content_get_metadata (content, pspec->param_id));
+}
+
+static void
+index_content (MexFeed    *feed,
+               MexContent *content)
+{
+  MexFeedPrivate *priv = feed->priv;
+  struct _QueueClosure closure = { feed, content };
+  char *id;
+
+  if (g_hash_table_lookup (priv->indexed, content) == NULL)
+    g_signal_connect (content, "notify",
+                      G_CALLBACK (program_notify_cb), feed);
+
+  g_hash_table_insert (priv->indexed, content,
+                       GUINT_TO_POINTER (++priv->generation));
+  mex_content_foreach_metadata (content, queue_metadata_cb, &closure);
 
   /* Add to id table */
-  index_str = mex_program_get_id (MEX_PROGRAM (content));
+  id = mex_program_get_id (MEX_PROGRAM (content));
 
-  if (index_str)
-    g_hash_table_insert (priv->id_to_programs, index_str, content);
+  if (id)
+    g_hash_table_insert (priv->id_to_programs, id, content);
 }
 
 static void
@@ -110,44 +257,19 @@ unindex_content (MexFeed    *feed,
                  MexContent *content)
 {
   MexFeedPrivate *priv = feed->priv;
-  char *index_str = mex_program_get_index_str (MEX_PROGRAM (content));
-  char **idx_strs;
-  int i;
-
-  if (index_str == NULL) {
-    return;
-  }
+  char *id;
 
-  idx_strs = g_strsplit (index_str, " ", -1);
-  g_free (index_str);
-
-  /* Look for each index term in the index, and remove the program from
-     its bucket */
-  for (i = 0; idx_strs[i]; i++) {
-    GHashTable *bucket = NULL;
-
-    bucket = g_hash_table_lookup (priv->index_to_programs, idx_strs[i]);
-    if (bucket) {
-      /* Check if the program is already in the bucket and remove */
-      if (g_hash_table_lookup (bucket, content)) {
-        g_hash_table_remove (bucket, content);
-      }
-
-      if (g_hash_table_size (bucket) == 0) {
-        /* Empty bucket, remove from the index */
-        g_hash_table_remove (priv->index_to_programs, idx_strs[i]);
-      }
-    }
-  }
+  if (g_hash_table_remove (priv->indexed, content))
+    g_signal_handlers_disconnect_by_func (content, program_notify_cb, feed);
 
-  g_strfreev (idx_strs);
+  mex_search_index_remove (priv->index, content);
 
   /* Remove from id table */
-  index_str = mex_program_get_id (MEX_PROGRAM (content));
+  id = mex_program_get_id (MEX_PROGRAM (content));
 
-  if (index_str) {
-    g_hash_table_remove (priv->id_to_programs, index_str);
-    g_free (index_str);
+  if (id) {
+    g_hash_table_remove (priv->id_to_programs, id);
+    g_free (id);
   }
 }
 
@@ -155,9 +277,16 @@ static void
 index_clear (MexFeed *feed)
 {
   MexFeedPrivate *priv = feed->priv;
+  GHashTableIter iter;
+  gpointer content;
 
-  g_hash_table_remove_all (priv->index_to_programs);
-  g_ptr_array_set_size (priv->index_terms, 0);
+  g_hash_table_iter_init (&iter, priv->indexed);
+  while (g_hash_table_iter_next (&iter, &content, NULL))
+    g_signal_handlers_disconnect_by_func (content, program_notify_cb, feed);
+  g_hash_table_remove_all (priv->indexed);
+
+  mex_search_index_clear (priv->index);
+  g_hash_table_remove_all (priv->id_to_programs);
 }
 
 static void
@@ -278,6 +407,10 @@ mex_feed_finalize (GObject *object)
   g_free (priv->source);
   priv->source = NULL;
 
+  mex_search_index_free (priv->index);
+  g_hash_table_destroy (priv->id_to_programs);
+  g_hash_table_destroy (priv->indexed);
+
   G_OBJECT_CLASS (mex_feed_parent_class)->finalize (object);
 }
 
@@ -300,6 +433,20 @@ mex_feed_dispose (GObject *object)
       priv->timeout = 0;
     }
 
+  if (priv->batch_id)
+    {
+      g_source_remove (priv->batch_id);
+      priv->batch_id = 0;
+    }
+
+  if (priv->batch)
+    {
+      index_batch_free (priv->batch);
+      priv->batch = NULL;
+    }
+
+  index_clear (MEX_FEED (object));
+
   G_OBJECT_CLASS (mex_feed_parent_class)->dispose (object);
 }
 
@@ -422,10 +569,8 @@ mex_feed_init (MexFeed *self)
 
   self->priv = priv;
 
-  priv->index_terms = g_ptr_array_new ();
-  priv->index_to_programs = g_hash_table_new_full
-    (g_str_hash, g_str_equal, g_free,
-     (GDestroyNotify) g_hash_table_destroy);
+  priv->index = mex_search_index_new ();
+  priv->indexed = g_hash_table_new (NULL, NULL);
   priv->id_to_programs = g_hash_table_new_full (g_str_hash,
                                                 g_str_equal,
                                                 g_free,
@@ -451,100 +596,6 @@ mex_feed_new (const char *title,
                        NULL);
 }
 
-static void
-or_add_to_feed (gpointer key,
-                gpointer value,
-                gpointer userdata)
-{
-  MexModel *model = (MexModel *) userdata;
-
-  /* The key and value are the same, doesn't matter which we add */
-  mex_model_add_content (model, (MexContent *) key);
-}
-
-struct _SearchPayload {
-  MexModel *model;
-  int term_count;
-};
-
-static void
-and_add_to_feed (gpointer key,
-                 gpointer value,
-                 gpointer userdata)
-{
-  struct _SearchPayload *payload = (struct _SearchPayload *) userdata;
-
-  /* @value is the number of terms that the program in @key was found
-     related to. For AND operations the program needs to have been found
-     related to all of the terms */
-  if (GPOINTER_TO_INT (value) == payload->term_count) {
-    mex_model_add_content (payload->model, (MexContent *) key);
-  }
-}
-
-static GPtrArray *
-get_full_search_terms (MexFeed     *feed,
-                       const char **terms)
-{
-  MexFeedPrivate *priv = feed->priv;
-  GPtrArray *results;
-  int i;
-
-  results = g_ptr_array_new ();
-
-  for (i = 0; terms[i]; i++) {
-    GPtrArray *t;
-    int j;
-
-    /* For each term in terms, we want to find all the search terms
-       that it might match in the index */
-
-    t = g_ptr_array_new ();
-    g_ptr_array_add (results, t);
-
-    for (j = 0; j < priv->index_terms->len; j++) {
-      if (strstr (priv->index_terms->pdata[j], terms[i])) {
-        g_ptr_array_add (t, priv->index_terms->pdata[j]);
-      }
-    }
-  }
-
-  return results;
-}
-
-static void
-insert_into_hash (gpointer key,
-                  gpointer value,
-                  gpointer userdata)
-{
-  g_hash_table_insert ((GHashTable *) userdata, key, value);
-}
-
-static GHashTable *
-get_programs_for_term (MexFeed   *feed,
-                       GPtrArray *possible_terms)
-{
-  MexFeedPrivate *priv = feed->priv;
-  GHashTable *results;
-  int i;
-
-  results = g_hash_table_new (NULL, NULL);
-
-  for (i = 0; i < possible_terms->len; i++) {
-    GHashTable *programs;
-
-    programs = g_hash_table_lookup (priv->index_to_programs,
-                                    possible_terms->pdata[i]);
-    if (programs) {
-      /* Just put all the items in programs into results, this
-         will make them unique too */
-      g_hash_table_foreach (programs, insert_into_hash, results);
-    }
-  }
-
-  return results;
-}
-
 /**
  * mex_feed_search:
  * @feed: A #MexFeed
@@ -561,68 +612,36 @@ mex_feed_search (MexFeed            *feed,
                  MexFeedSearchMode   mode,
                  MexModel           *results_model)
 {
-  int i;
-  GHashTable *count_hash = NULL;
-  GPtrArray *terms;
+  GPtrArray *programs;
+  guint i;
 
   g_return_if_fail (MEX_IS_FEED (feed));
   g_return_if_fail (MEX_IS_MODEL (results_model));
 
-  terms = get_full_search_terms (feed, search);
-
-  for (i = 0; i < terms->len; i++) {
-    GPtrArray *possible_terms = terms->pdata[i];
-    GHashTable *term_programs;
-
-    term_programs = get_programs_for_term (feed, possible_terms);
+  programs = mex_search_index_query (feed->priv->index, search,
+                                     mode == MEX_FEED_SEARCH_MODE_AND);
 
-    /* term_programs now contains all the programs that match
-       the term in search[i] */
+  for (i = 0; i < programs->len; i++)
+    mex_model_add_content (results_model, g_ptr_array_index (programs, i));
 
-    if (mode == MEX_FEED_SEARCH_MODE_OR) {
-      /* For OR mode we just need to add the programs to the feed */
-      g_hash_table_foreach (term_programs, or_add_to_feed,
-                            results_model);
-    } else {
-      GList *programs, *p;
-      gpointer count_as_ptr;
-      int count;
-
-      /* For AND mode we need to count how many terms each program is
-         found in */
-      if (G_UNLIKELY (count_hash == NULL)) {
-        count_hash = g_hash_table_new (NULL, NULL);
-      }
-
-      programs = g_hash_table_get_keys (term_programs);
-      for (p = programs; p; p = p->next) {
-        MexProgram *program = (MexProgram *) p->data;
-
-        count_as_ptr = g_hash_table_lookup (count_hash, program);
-        count = GPOINTER_TO_INT (count_as_ptr);
-        count++;
-
-        g_hash_table_insert (count_hash, program,
-                             GINT_TO_POINTER (count));
-      }
-      g_list_free (programs);
-    }
-
-    g_ptr_array_free (possible_terms, TRUE);
-    g_hash_table_destroy (term_programs);
-  }
-
-  if (count_hash) {
-    struct _SearchPayload payload;
-
-    payload.model = results_model;
-    payload.term_count = i;
+  g_ptr_array_free (programs, TRUE);
+}
 
-    g_hash_table_foreach (count_hash, and_add_to_feed, &payload);
-    g_hash_table_destroy (count_hash);
-  }
+/**
+ * mex_feed_is_indexing:
+ * @feed: A #MexFeed
+ *
+ * Programs are indexed in the background when they're added to @feed or
+ * when their metadata changes; until then searches don't find them.
+ *
+ * Return value: %TRUE if some changes haven't made it to the index yet
+ */
+gboolean
+mex_feed_is_indexing (MexFeed *feed)
+{
+  g_return_val_if_fail (MEX_IS_FEED (feed), FALSE);
 
-  g_ptr_array_free (terms, TRUE);
+  return feed->priv->batch != NULL || feed->priv->n_pending_batches > 0;
 }
 
 MexProgram *
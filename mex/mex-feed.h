@@ -83,6 +83,8 @@ void mex_feed_search (MexFeed            *feed,
                       MexFeedSearchMode   mode,
                       MexModel           *results_model);
 
+gboolean mex_feed_is_indexing (MexFeed *feed);
+
 MexProgram *mex_feed_lookup (MexFeed    *feed,
                              const char *id);
 
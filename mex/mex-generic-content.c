@@ -16,9 +16,19 @@
  * along with this program; if not, see <http://www.gnu.org/licenses>
  */
 
+/*
+ * Metadata is kept in a small array sorted by key, with the values shared
+ * through mex_intern_string(): the same mime types, artists, albums and
+ * thumbnail directories come back across thousands of contents, and a
+ * hash table per content costs more than the handful of values it holds.
+ */
+
+#include <string.h>
+
 #include "mex-generic-content.h"
 #include "mex-content.h"
 #include "mex-enum-types.h"
+#include "mex-intern-private.h"
 
 enum {
   PROP_0 = MEX_CONTENT_METADATA_LAST_ID,
@@ -29,10 +39,17 @@ enum {
   LAST_SIGNAL,
 };
 
+typedef struct
+{
+  guint        key;
+  const gchar *value;
+} MetadataItem;
+
 struct _MexGenericContentPrivate {
   int dummy;
 
-  GHashTable *metadata;
+  MetadataItem *metadata;
+  guint         n_metadata;
 
   gboolean last_position_start;
 };
@@ -43,6 +60,61 @@ G_DEFINE_TYPE_WITH_CODE (MexGenericContent, mex_generic_content, G_TYPE_INITIALL
                          G_IMPLEMENT_INTERFACE (MEX_TYPE_CONTENT,
                                                 mex_content_iface_init));
 
+/* Used to work out what the metadata would take with the previous
+ * storage, a GHashTable of copied strings per content */
+#define HASH_TABLE_SIZE (12 * sizeof (gpointer))
+#define HASH_TABLE_SLOT_SIZE (2 * sizeof (gpointer) + sizeof (guint))
+
+static guint content_n_contents = 0;
+static guint content_n_values = 0;
+static gsize content_hash_tables_size = 0;
+
+static gsize
+hash_table_size_for (guint n_values)
+{
+  guint size = 8;
+
+  while (size <= n_values + n_values / 16)
+    size *= 2;
+
+  return HASH_TABLE_SIZE + size * HASH_TABLE_SLOT_SIZE;
+}
+
+/* Index of @key in the metadata array, or of where it should be inserted */
+static guint
+metadata_find (MexGenericContentPrivate *priv,
+               guint                     key,
+               gboolean                 *found)
+{
+  guint low = 0, high = priv->n_metadata;
+
+  while (low < high)
+    {
+      guint middle = (low + high) / 2;
+
+      if (priv->metadata[middle].key < key)
+        low = middle + 1;
+      else
+        high = middle;
+    }
+
+  *found = (low < priv->n_metadata && priv->metadata[low].key == key);
+
+  return low;
+}
+
+static void
+metadata_resize (MexGenericContentPrivate *priv,
+                 guint                     n_metadata)
+{
+  content_n_values += n_metadata - priv->n_metadata;
+  content_hash_tables_size += hash_table_size_for (n_metadata) -
+    hash_table_size_for (priv->n_metadata);
+
+  priv->n_metadata = n_metadata;
+  priv->metadata = g_renew (MetadataItem, priv->metadata, n_metadata);
+}
+
 /*
  * MexContent implementation
  */
@@ -62,8 +134,12 @@ content_get_metadata (MexContent         *content,
   MexGenericContent *gc = (MexGenericContent *) content;
   MexGenericContentPrivate *priv = gc->priv;
 
-  return (const gchar *) g_hash_table_lookup (priv->metadata,
-                                              GUINT_TO_POINTER (key));
+  gboolean found;
+  guint i;
+
+  i = metadata_find (priv, key, &found);
+
+  return found ? priv->metadata[i].value : NULL;
 }
 
 static void
@@ -74,12 +150,36 @@ content_set_metadata (MexContent         *content,
   const char *property;
   MexGenericContent *gc = (MexGenericContent *) content;
   MexGenericContentPrivate *priv = gc->priv;
+  gboolean found;
+  guint i;
 
-  if (value)
-    g_hash_table_insert (priv->metadata, GUINT_TO_POINTER (key),
-                         g_strdup (value));
-  else
-    g_hash_table_remove (priv->metadata, GUINT_TO_POINTER (key));
+  i = metadata_find (priv, key, &found);
+
+  if (found)
+    {
+      const gchar *old_value = priv->metadata[i].value;
+
+      if (value)
+        {
+          priv->metadata[i].value = mex_intern_string (value);
+        }
+      else
+        {
+          memmove (priv->metadata + i, priv->metadata + i + 1,
+                   (priv->n_metadata - i - 1) * sizeof (MetadataItem));
+          metadata_resize (priv, priv->n_metadata - 1);
+        }
+
+      mex_intern_release (old_value);
+    }
+  else if (value)
+    {
+      metadata_resize (priv, priv->n_metadata + 1);
+      memmove (priv->metadata + i + 1, priv->metadata + i,
+               (priv->n_metadata - i - 1) * sizeof (MetadataItem));
+      priv->metadata[i].key = key;
+      priv->metadata[i].value = mex_intern_string (value);
+    }
 
   property = mex_content_get_property_name (content, key);
   g_object_notify (G_OBJECT (content), property);
@@ -105,23 +205,6 @@ content_save_metadata (MexContent *content)
   /* No implementation possible here */
 }
 
-struct MetadataCbStuff {
-  MexContentMetadataCb callback;
-  gpointer             data;
-};
-
-static void
-content_foreach_metadata_cb (gpointer key,
-                             gpointer value,
-                             gpointer data)
-{
-  struct MetadataCbStuff *stuff = (struct MetadataCbStuff *) data;
-
-  stuff->callback ((MexContentMetadata) key,
-                   (const gchar *) value,
-                   stuff->data);
-}
-
 static void
 content_foreach_metadata (MexContent           *content,
                           MexContentMetadataCb  callback,
@@ -129,14 +212,11 @@ content_foreach_metadata (MexContent           *content,
 {
   MexGenericContent *gc = (MexGenericContent *) content;
   MexGenericContentPrivate *priv = gc->priv;
-  struct MetadataCbStuff stuff;
-
-  stuff.callback = callback;
-  stuff.data     = data;
+  guint i;
 
-  g_hash_table_foreach (priv->metadata,
-                        content_foreach_metadata_cb,
-                        &stuff);
+  for (i = 0; i < priv->n_metadata; i++)
+    callback ((MexContentMetadata) priv->metadata[i].key,
+              priv->metadata[i].value, data);
 }
 
 static void
@@ -157,23 +237,19 @@ mex_content_iface_init (MexContentIface *iface)
 
 static void
 mex_generic_content_finalize (GObject *object)
-{
-  G_OBJECT_CLASS (mex_generic_content_parent_class)->finalize (object);
-}
-
-static void
-mex_generic_content_dispose (GObject *object)
 {
   MexGenericContent *content = (MexGenericContent *) object;
   MexGenericContentPrivate *priv = content->priv;
+  guint i;
 
-  if (priv->metadata)
-    {
-      g_hash_table_unref (priv->metadata);
-      priv->metadata = NULL;
-    }
+  for (i = 0; i < priv->n_metadata; i++)
+    mex_intern_release (priv->metadata[i].value);
+  metadata_resize (priv, 0);
 
-  G_OBJECT_CLASS (mex_generic_content_parent_class)->dispose (object);
+  content_n_contents--;
+  content_hash_tables_size -= hash_table_size_for (0);
+
+  G_OBJECT_CLASS (mex_generic_content_parent_class)->finalize (object);
 }
 
 static void
@@ -234,7 +310,6 @@ mex_generic_content_class_init (MexGenericContentClass *klass)
   GObjectClass *o_class = (GObjectClass *) klass;
   int i;
 
-  o_class->dispose = mex_generic_content_dispose;
   o_class->finalize = mex_generic_content_finalize;
   o_class->set_property = mex_generic_content_set_property;
   o_class->get_property = mex_generic_content_get_property;
@@ -270,7 +345,8 @@ mex_generic_content_init (MexGenericContent *self)
 
   self->priv = priv = GET_PRIVATE (self);
 
-  priv->metadata = g_hash_table_new_full (NULL, NULL, NULL, g_free);
+  content_n_contents++;
+  content_hash_tables_size += hash_table_size_for (0);
 
   priv->last_position_start = TRUE;
 }
@@ -284,3 +360,28 @@ mex_generic_content_get_last_position_start (MexGenericContent *self)
 
   return priv->last_position_start;
 }
+
+/**
+ * mex_generic_content_get_stats:
+ * @stats: (out): return location for the counters
+ *
+ * Fills @stats with how much memory the metadata of all the
+ * #MexGenericContent<!-- -->s currently alive takes, and what it would take
+ * if each of them kept its own copy of the values in a hash table.
+ * The sizes are estimates that leave out allocator overhead.
+ */
+void
+mex_generic_content_get_stats (MexGenericContentStats *stats)
+{
+  MexInternStats intern_stats;
+
+  g_return_if_fail (stats != NULL);
+
+  mex_intern_get_stats (&intern_stats);
+
+  stats->n_contents = content_n_contents;
+  stats->n_values = content_n_values;
+  stats->n_strings = intern_stats.n_strings;
+  stats->size = content_n_values * sizeof (MetadataItem) + intern_stats.size;
+  stats->unshared_size = content_hash_tables_size + intern_stats.refs_size;
+}
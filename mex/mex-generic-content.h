@@ -49,6 +49,7 @@ G_BEGIN_DECLS
 typedef struct _MexGenericContentPrivate MexGenericContentPrivate;
 typedef struct _MexGenericContent      MexGenericContent;
 typedef struct _MexGenericContentClass MexGenericContentClass;
+typedef struct _MexGenericContentStats MexGenericContentStats;
 
 struct _MexGenericContent
 {
@@ -62,10 +63,32 @@ struct _MexGenericContentClass
   GInitiallyUnownedClass parent_class;
 };
 
+/**
+ * MexGenericContentStats:
+ * @n_contents: number of contents alive
+ * @n_values: number of metadata values they hold
+ * @n_strings: number of distinct values
+ * @size: estimated size, in bytes, of the metadata
+ * @unshared_size: estimated size, in bytes, the metadata would take with a
+ *   hash table and a copy of each value per content
+ *
+ * Memory used by the metadata of #MexGenericContent<!-- -->s.
+ */
+struct _MexGenericContentStats
+{
+  guint n_contents;
+  guint n_values;
+  guint n_strings;
+  gsize size;
+  gsize unshared_size;
+};
+
 GType mex_generic_content_get_type (void) G_GNUC_CONST;
 
 gboolean mex_generic_content_get_last_position_start (MexGenericContent *self);
 
+void mex_generic_content_get_stats (MexGenericContentStats *stats);
+
 G_END_DECLS
 
 #endif /* __MEX_GENERIC_CONTENT_H__ */
@@ -165,6 +165,66 @@ mex_generic_model_add_content (MexModel   *model,
   g_object_notify (G_OBJECT (model), "length");
 }
 
+typedef struct
+{
+  MexModelSortFunc sort_func;
+  gpointer         userdata;
+} MexGenericModelSortData;
+
+static gint
+mex_generic_model_sort_func (gconstpointer a,
+                             gconstpointer b,
+                             gpointer      userdata)
+{
+  MexGenericModelSortData *data = userdata;
+  MexContent **ca = (MexContent **)a;
+  MexContent **cb = (MexContent **)b;
+
+  return data->sort_func (*ca, *cb, data->userdata);
+}
+
+/* Sorts @new_items and merges them into the (sorted) items array, working
+ * from the end of the array so that each existing item is moved at most
+ * once. The final index of each new item is added to @ref. */
+static void
+mex_generic_model_merge_sorted (MexGenericModel      *self,
+                                GPtrArray            *new_items,
+                                GControllerReference *ref)
+{
+  MexGenericModelPrivate *priv = self->priv;
+  MexGenericModelSortData data;
+  MexContent **items;
+  guint *positions;
+  gint i, j, k;
+
+  data.sort_func = priv->sort_func;
+  data.userdata = priv->sort_data;
+  g_ptr_array_sort_with_data (new_items, mex_generic_model_sort_func, &data);
+
+  i = priv->items->len - 1;
+  g_array_set_size (priv->items, priv->items->len + new_items->len);
+  items = (MexContent **) priv->items->data;
+
+  positions = g_new (guint, new_items->len);
+
+  k = priv->items->len - 1;
+  for (j = new_items->len - 1; j >= 0; j--)
+    {
+      MexContent *content = g_ptr_array_index (new_items, j);
+
+      while (i >= 0 && priv->sort_func (items[i], content, priv->sort_data) > 0)
+        items[k--] = items[i--];
+
+      items[k] = content;
+      positions[j] = k--;
+    }
+
+  for (j = 0; j < new_items->len; j++)
+    g_controller_reference_add_index (ref, positions[j]);
+
+  g_free (positions);
+}
+
 static void
 mex_generic_model_add (MexModel *model,
                        GList    *content_list)
@@ -173,26 +233,37 @@ mex_generic_model_add (MexModel *model,
   MexGenericModelPrivate *priv = gm->priv;
   GControllerReference *ref;
   MexContent *content;
+  GList *l;
   gint pos;
-  GList *list = g_list_copy (content_list);
 
   ref = g_controller_create_reference (priv->controller, G_CONTROLLER_ADD,
                                        G_TYPE_UINT, 0);
 
-  while (list)
+  if (priv->sort_func)
     {
-      content = list->data;
-      g_object_ref_sink (content);
+      GPtrArray *new_items = g_ptr_array_new ();
 
-      /* the items cannot be inserted sorted at this point because the
-       * references (i.e. position) of previously added items might be changed
-       */
-      pos = priv->items->len;
-      g_array_append_val (priv->items, content);
+      /* the items are merged in as a batch, so that all the references
+       * (i.e. positions) in the emitted signal are final */
+      for (l = content_list; l; l = l->next)
+        g_ptr_array_add (new_items, g_object_ref_sink (l->data));
 
-      g_controller_reference_add_index (ref, pos);
+      if (new_items->len)
+        mex_generic_model_merge_sorted (gm, new_items, ref);
 
-      list = g_list_delete_link (list, list);
+      g_ptr_array_free (new_items, TRUE);
+    }
+  else
+    {
+      for (l = content_list; l; l = l->next)
+        {
+          content = g_object_ref_sink (l->data);
+
+          pos = priv->items->len;
+          g_array_append_val (priv->items, content);
+
+          g_controller_reference_add_index (ref, pos);
+        }
     }
 
   g_controller_emit_changed (priv->controller, ref);
@@ -200,8 +271,6 @@ mex_generic_model_add (MexModel *model,
   g_object_unref (ref);
 
   g_object_notify (G_OBJECT (model), "length");
-
-  g_list_free (list);
 }
 
 
@@ -285,24 +354,6 @@ mex_generic_model_get_content (MexModel *model,
   return get_content_internal (gm, index_);
 }
 
-typedef struct
-{
-  MexModelSortFunc sort_func;
-  gpointer         userdata;
-} MexGenericModelSortData;
-
-static gint
-mex_generic_model_sort_func (gconstpointer a,
-                             gconstpointer b,
-                             gpointer      userdata)
-{
-  MexGenericModelSortData *data = userdata;
-  MexContent **ca = (MexContent **)a;
-  MexContent **cb = (MexContent **)b;
-
-  return data->sort_func (*ca, *cb, data->userdata);
-}
-
 static void
 mex_generic_model_set_sort_func (MexModel         *model,
                                  MexModelSortFunc  sort_func,
@@ -22,11 +22,15 @@
 #include "mex-content-view.h"
 #include "mex-scrollable-container.h"
 #include "mex-content-tile.h"
+#include "mex-realized-range-private.h"
 #include <math.h>
 
 #define DEFAULT_TILE_RATIO (9.0 / 16.0)
 #define SPACING 6.0
 
+/* Number of tiles kept aside for reuse in virtualized mode */
+#define MAX_RECYCLED_TILES 32
+
 static void mx_scrollable_iface_init (MxScrollableIface *iface);
 static void mx_focusable_iface_init (MxFocusableIface *iface);
 static void mx_stylable_iface_init (MxStylableIface *iface);
@@ -51,9 +55,16 @@ struct _MexGridPrivate
   guint            next_foreach_is_style_changed : 1;
   guint            tile_width_changed : 1;
   guint            tile_height_changed : 1;
+  guint            virtualized : 1;
   guint            focus_waiting;
 
+  /* One slot per item of the model, NULL for the items that don't have a
+   * tile, see MexRealizedRange */
   GArray          *children;
+  GPtrArray       *realized;
+  MexRealizedRange range;
+  GQueue           recycled;
+
   ClutterActor    *current_focus;
   gint             focused_row;
   MexActorSortFunc sort_func;
@@ -71,6 +82,7 @@ struct _MexGridPrivate
 
   gint             first_visible;
   gint             last_visible;
+  gfloat           avail_height;
   gfloat           tile_width;
   gfloat           tile_height;
   gfloat           tile_ratio;
@@ -91,10 +103,80 @@ enum
   PROP_VADJUST,
   PROP_TILE_WIDTH,
   PROP_TILE_HEIGHT,
-  PROP_TILE_RATIO
+  PROP_TILE_RATIO,
+  PROP_VIRTUALIZED
 };
 
 static void mex_grid_start_animation (MexGrid *self);
+static void mex_grid_queue_realize (MexGrid *grid);
+static ClutterActor *mex_grid_realize (MexGrid *grid, gint index);
+static void mex_grid_clear (MexGrid *grid);
+static void mex_grid_populate (MexGrid *grid);
+
+static const MexRealizedRangeFuncs mex_grid_range_funcs;
+
+static gint
+mex_grid_get_child_index (MexGrid      *grid,
+                          ClutterActor *child)
+{
+  return mex_realized_range_get_index (&grid->priv->range, child);
+}
+
+/* Any tile will do to measure the rows, but the focused one may be open */
+static ClutterActor *
+mex_grid_get_template_child (MexGrid *grid)
+{
+  MexGridPrivate *priv = grid->priv;
+  ClutterActor *child;
+  gint i;
+
+  if (!priv->children->len)
+    return NULL;
+
+  child = g_array_index (priv->children, ClutterActor *, 0);
+  if (child)
+    return child;
+
+  for (i = 0; i < priv->realized->len; i++)
+    {
+      child = g_ptr_array_index (priv->realized, i);
+      if (child != priv->current_focus)
+        return child;
+    }
+
+  return priv->current_focus;
+}
+
+static void
+mex_grid_get_visible_rows (MexGrid *grid,
+                           gfloat   avail_height,
+                           gfloat   basic_height,
+                           gint    *first_row,
+                           gint    *last_row)
+{
+  gdouble value;
+  MexGridPrivate *priv = grid->priv;
+
+  if (priv->vadjust)
+    value = (gint)mx_adjustment_get_value (priv->vadjust);
+  else
+    value = 0;
+
+  /* Calculate our visible range - we buffer it by a few rows, for lingering
+   * animations/rounding errors.
+   */
+  *first_row = MAX (0, (value / (gint)(basic_height)) - 3);
+  *last_row = ((value + avail_height) / (gint)(basic_height)) + 3;
+}
+
+static void
+mex_grid_vadjust_value_cb (MxAdjustment *adjustment,
+                           GParamSpec   *pspec,
+                           MexGrid      *grid)
+{
+  mex_grid_queue_realize (grid);
+  clutter_actor_queue_relayout (CLUTTER_ACTOR (grid));
+}
 
 
 /* MxScrollableIface */
@@ -112,7 +194,7 @@ mex_grid_set_adjustments (MxScrollable *scrollable,
       if (priv->vadjust)
         {
           g_signal_handlers_disconnect_by_func (priv->vadjust,
-                                                clutter_actor_queue_relayout,
+                                                mex_grid_vadjust_value_cb,
                                                 self);
           g_object_unref (priv->vadjust);
         }
@@ -120,10 +202,10 @@ mex_grid_set_adjustments (MxScrollable *scrollable,
       if (vadjust)
         {
           g_object_ref (vadjust);
-          g_signal_connect_swapped (vadjust,
-                                    "notify::value",
-                                    G_CALLBACK (clutter_actor_queue_relayout),
-                                    self);
+          g_signal_connect (vadjust,
+                            "notify::value",
+                            G_CALLBACK (mex_grid_vadjust_value_cb),
+                            self);
         }
 
       priv->vadjust = vadjust;
@@ -206,94 +288,87 @@ mex_grid_move_focus (MxFocusable      *focusable,
       break;
     }
 
+  /* Tiles are created on demand, so this works from the index of @from
+   * rather than from the tiles that happen to exist */
+  index = mex_grid_get_child_index (self, (ClutterActor *) from);
+  if (index < 0)
+    return NULL;
+
   child = NULL;
   focusable = NULL;
-  for (index = 0; index < priv->children->len; index++)
-    {
-      child = g_array_index (priv->children, ClutterActor *, index);
-
-      if (child != (ClutterActor *)from)
-        continue;
 
-      switch (direction)
+  switch (direction)
+    {
+    case MX_FOCUS_DIRECTION_UP:
+    case MX_FOCUS_DIRECTION_DOWN:
+      for (i = index + dx; (i >= 0) && (i < priv->children->len); i += dx)
         {
-        case MX_FOCUS_DIRECTION_UP:
-        case MX_FOCUS_DIRECTION_DOWN:
-          for (i = index + dx; (i >= 0) && (i < priv->children->len); i += dx)
-            {
-              child = g_array_index (priv->children, ClutterActor *, i);
-              if (MX_IS_FOCUSABLE (child) &&
-                  (focusable = mx_focusable_accept_focus (MX_FOCUSABLE (child),
-                                                          hint)))
-                break;
-            }
-
-          /* If we're on the row before last, we possibly want to focus
-           * the last item
-           */
-          if (!focusable &&
-              (direction == MX_FOCUS_DIRECTION_DOWN) &&
-              ((index / priv->stride) ==
-               ((priv->children->len - 1) / priv->stride) - 1))
-            {
-              child = g_array_index (priv->children, ClutterActor *,
-                                     priv->children->len - 1);
-              if (MX_IS_FOCUSABLE (child) &&
-                  (focusable = mx_focusable_accept_focus (MX_FOCUSABLE (child),
-                                                          hint)))
-                break;
-            }
+          child = mex_grid_realize (self, i);
+          if (MX_IS_FOCUSABLE (child) &&
+              (focusable = mx_focusable_accept_focus (MX_FOCUSABLE (child),
+                                                      hint)))
+            break;
+        }
 
-          break;
+      /* If we're on the row before last, we possibly want to focus
+       * the last item
+       */
+      if (!focusable &&
+          (direction == MX_FOCUS_DIRECTION_DOWN) &&
+          ((index / priv->stride) ==
+           ((priv->children->len - 1) / priv->stride) - 1))
+        {
+          i = priv->children->len - 1;
+          child = mex_grid_realize (self, i);
+          if (MX_IS_FOCUSABLE (child))
+            focusable = mx_focusable_accept_focus (MX_FOCUSABLE (child), hint);
+        }
 
-        case MX_FOCUS_DIRECTION_NEXT:
-        case MX_FOCUS_DIRECTION_RIGHT:
-        case MX_FOCUS_DIRECTION_PREVIOUS:
-        case MX_FOCUS_DIRECTION_LEFT:
-          for (i = index + dx; (i >= 0) && (i < priv->children->len); i += dx)
-            {
-              if ((direction == MX_FOCUS_DIRECTION_LEFT) &&
-                  ((i + 1) % priv->stride == 0))
-                break;
-              if ((direction == MX_FOCUS_DIRECTION_RIGHT) &&
-                  (i % priv->stride == 0))
-                break;
-              child = g_array_index (priv->children, ClutterActor *, i);
-              if (MX_IS_FOCUSABLE (child) &&
-                  (focusable = mx_focusable_accept_focus (MX_FOCUSABLE (child),
-                                                          hint)))
-                break;
-            }
+      break;
 
-          /* If we're on the last row, we possibly want to focus the
-           * right hand side item on the previous row.
-           */
-          if (!focusable &&
-              (direction == MX_FOCUS_DIRECTION_RIGHT) &&
-              (priv->children->len > priv->stride) &&
-              ((index % priv->stride) != (priv->stride - 1)) &&
-              ((index / priv->stride) ==
-               ((priv->children->len - 1) / priv->stride)))
-            {
-              child = g_array_index (priv->children, ClutterActor *,
-                                     priv->children->len - priv->stride);
-              if (MX_IS_FOCUSABLE (child) &&
-                  (focusable = mx_focusable_accept_focus (MX_FOCUSABLE (child),
-                                                          hint)))
-                {
-                  i = priv->children->len - priv->stride;
-                  break;
-                }
-            }
-          break;
+    case MX_FOCUS_DIRECTION_NEXT:
+    case MX_FOCUS_DIRECTION_RIGHT:
+    case MX_FOCUS_DIRECTION_PREVIOUS:
+    case MX_FOCUS_DIRECTION_LEFT:
+      for (i = index + dx; (i >= 0) && (i < priv->children->len); i += dx)
+        {
+          if ((direction == MX_FOCUS_DIRECTION_LEFT) &&
+              ((i + 1) % priv->stride == 0))
+            break;
+          if ((direction == MX_FOCUS_DIRECTION_RIGHT) &&
+              (i % priv->stride == 0))
+            break;
+          child = mex_grid_realize (self, i);
+          if (MX_IS_FOCUSABLE (child) &&
+              (focusable = mx_focusable_accept_focus (MX_FOCUSABLE (child),
+                                                      hint)))
+            break;
+        }
 
-        default:
-          break;
+      /* If we're on the last row, we possibly want to focus the
+       * right hand side item on the previous row.
+       */
+      if (!focusable &&
+          (direction == MX_FOCUS_DIRECTION_RIGHT) &&
+          (priv->children->len > priv->stride) &&
+          ((index % priv->stride) != (priv->stride - 1)) &&
+          ((index / priv->stride) ==
+           ((priv->children->len - 1) / priv->stride)))
+        {
+          i = priv->children->len - priv->stride;
+          child = mex_grid_realize (self, i);
+          if (MX_IS_FOCUSABLE (child))
+            focusable = mx_focusable_accept_focus (MX_FOCUSABLE (child), hint);
         }
+      break;
 
+    default:
       break;
     }
 
+  /* Let go of the tiles we went through */
+  mex_grid_queue_realize (self);
+
   if (focusable)
     {
       /* Update the focused child/row. We do this here to avoid
@@ -345,8 +420,7 @@ mex_grid_accept_focus (MxFocusable *focusable, MxFocusHint hint)
       for (i = reverse ? priv->children->len - 1 : 0;
            (i >= 0) && (i < priv->children->len); i += reverse ? -1 : 1)
         {
-          ClutterActor *child =
-            g_array_index (priv->children, ClutterActor *, i);
+          ClutterActor *child = mex_grid_realize (self, i);
 
           if (!MX_IS_FOCUSABLE (child))
             continue;
@@ -360,6 +434,8 @@ mex_grid_accept_focus (MxFocusable *focusable, MxFocusHint hint)
               break;
             }
         }
+
+      mex_grid_queue_realize (self);
     }
 
   /* keep focus so that children added later can be focused */
@@ -421,7 +497,7 @@ mex_grid_get_tile_size (MexGrid               *grid,
   *basic_width = floorf ((box->x2 - box->x1 - padding.right - padding.left) /
                          (gfloat) priv->stride);
 
-  first_child = g_array_index (priv->children, ClutterActor *, 0);
+  first_child = mex_grid_get_template_child (grid);
 
   clutter_actor_get_preferred_height (first_child, *basic_width, NULL,
                                       basic_height);
@@ -435,7 +511,6 @@ mex_grid_get_allocation (MexScrollableContainer *self,
                          ClutterActor           *child,
                          ClutterActorBox        *box)
 {
-  gboolean found;
   MxPadding padding;
   gint i, row, column;
   ClutterActorBox grid_box;
@@ -445,15 +520,8 @@ mex_grid_get_allocation (MexScrollableContainer *self,
   MexGridPrivate *priv = grid->priv;
 
   /* Figure out what row the child is on */
-  found = FALSE;
-  for (i = 0; i < priv->children->len; i++)
-    if (g_array_index (priv->children, ClutterActor *, i) == child)
-      {
-        found = TRUE;
-        break;
-      }
-
-  if (!found)
+  i = mex_grid_get_child_index (grid, child);
+  if (i < 0)
     {
       g_warning (G_STRLOC ": Can't give allocation for child not in grid");
       return;
@@ -539,6 +607,10 @@ mex_grid_get_property (GObject    *object,
       g_value_set_float (value, self->priv->tile_ratio);
       break;
 
+    case PROP_VIRTUALIZED:
+      g_value_set_boolean (value, self->priv->virtualized);
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
     }
@@ -575,6 +647,10 @@ mex_grid_set_property (GObject      *object,
       g_object_notify (object, "tile-ratio");
       break;
 
+    case PROP_VIRTUALIZED:
+      mex_grid_set_virtualized (self, g_value_get_boolean (value));
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
     }
@@ -585,8 +661,13 @@ mex_grid_dispose (GObject *object)
 {
   MexGridPrivate *priv = MEX_GRID (object)->priv;
 
+  mex_realized_range_dispose (&priv->range);
+
   if (priv->vadjust)
     {
+      g_signal_handlers_disconnect_by_func (priv->vadjust,
+                                            mex_grid_vadjust_value_cb,
+                                            object);
       g_object_unref (priv->vadjust);
       priv->vadjust = NULL;
     }
@@ -631,6 +712,12 @@ mex_grid_finalize (GObject *object)
       priv->children = NULL;
     }
 
+  if (priv->realized)
+    {
+      g_ptr_array_unref (priv->realized);
+      priv->realized = NULL;
+    }
+
   if (priv->highlight_image)
     {
       g_boxed_free (MX_TYPE_BORDER_IMAGE, priv->highlight_image);
@@ -672,11 +759,11 @@ mex_grid_get_preferred_width (ClutterActor *actor,
 
   MexGridPrivate *priv = MEX_GRID (actor)->priv;
 
-  if (!priv->children->len)
+  if (!priv->realized->len)
     min_width = width = 0;
   else
     {
-      ClutterActor *child = g_array_index (priv->children, ClutterActor *, 0);
+      ClutterActor *child = mex_grid_get_template_child (MEX_GRID (actor));
       clutter_actor_get_preferred_width (child, -1, NULL, &min_width);
       width = min_width * priv->stride;
     }
@@ -700,13 +787,13 @@ mex_grid_get_preferred_height (ClutterActor *actor,
 
   MexGridPrivate *priv = MEX_GRID (actor)->priv;
 
-  if (!priv->children->len)
+  if (!priv->realized->len)
     height = 0;
   else
     {
       ClutterActor *child = priv->current_focus ?
         priv->current_focus :
-        g_array_index (priv->children, ClutterActor *, 0);
+        mex_grid_get_template_child (MEX_GRID (actor));
 
       clutter_actor_get_preferred_height (child, -1, NULL, &height);
     }
@@ -725,7 +812,6 @@ mex_grid_allocate (ClutterActor           *actor,
                    const ClutterActorBox  *box,
                    ClutterAllocationFlags  flags)
 {
-  gdouble value;
   MxPadding padding;
   ClutterActorBox child_box;
   gint i, first_row, last_row;
@@ -736,14 +822,22 @@ mex_grid_allocate (ClutterActor           *actor,
 
   CLUTTER_ACTOR_CLASS (mex_grid_parent_class)->allocate (actor, box, flags);
 
+  mx_widget_get_padding (MX_WIDGET (actor), &padding);
+  avail_width = box->x2 - box->x1 - padding.left - padding.right;
+  avail_height = box->y2 - box->y1 - padding.top - padding.bottom;
+  priv->avail_height = avail_height;
+
   /* Bail out if we have no children */
   priv->first_visible = priv->last_visible = -1;
   if (!priv->children->len)
     return;
 
-  mx_widget_get_padding (MX_WIDGET (actor), &padding);
-  avail_width = box->x2 - box->x1 - padding.left - padding.right;
-  avail_height = box->y2 - box->y1 - padding.top - padding.bottom;
+  /* Tiles can't be created from here, do it before the next layout */
+  if (!priv->realized->len)
+    {
+      mex_grid_queue_realize (self);
+      return;
+    }
 
   /* Allocate all actors in the visible range their preferred size. The
    * visible range is based on the preferred height of the first actor.
@@ -766,19 +860,22 @@ mex_grid_allocate (ClutterActor           *actor,
       priv->tile_height_changed = TRUE;
     }
 
-  if (priv->vadjust)
-    value = (gint)mx_adjustment_get_value (priv->vadjust);
-  else
-    value = 0;
-
-  /* Calculate our visible range - we buffer it by a few rows, for lingering
-   * animations/rounding errors.
-   */
-  first_row = MAX (0, (value / (gint)(basic_height)) - 3);
+  mex_grid_get_visible_rows (self, avail_height, basic_height,
+                             &first_row, &last_row);
   priv->first_visible = first_row * priv->stride;
-  last_row = ((value + avail_height) / (gint)(basic_height)) + 3;
   priv->last_visible = MIN (priv->children->len - 1, last_row * priv->stride);
 
+  /* Scrolled or resized, update the tiles before the next layout */
+  if (priv->virtualized)
+    {
+      gint last = priv->children->len - 1;
+
+      if ((MIN (last, priv->first_visible) != priv->range.first) ||
+          (MIN (last, (last_row + 1) * priv->stride - 1) !=
+           priv->range.last))
+        mex_grid_queue_realize (self);
+    }
+
   bottom = 0;
 
   child_box.y1 = first_row * (basic_height + SPACING);
@@ -794,6 +891,10 @@ mex_grid_allocate (ClutterActor           *actor,
           ClutterActor *child =
             g_array_index (priv->children, ClutterActor *, j);
 
+          /* Not created yet, see mex_grid_update_realized() */
+          if (!child)
+            continue;
+
           child_box.x1 = ((basic_width + SPACING) * (j % priv->stride)) + padding.left;
 
           /* Get the preferred size of the child */
@@ -893,6 +994,9 @@ mex_grid_paint (ClutterActor *actor)
     {
       ClutterActor *child = g_array_index (priv->children, ClutterActor *, i);
 
+      if (!child)
+        continue;
+
       /* Paint child */
       if (priv->has_focus && (child == priv->current_focus))
         draw_focus = TRUE;
@@ -963,6 +1067,10 @@ mex_grid_pick (ClutterActor *actor, const ClutterColor *color)
   for (i = priv->first_visible; i <= priv->last_visible; i++)
     {
       ClutterActor *child = g_array_index (priv->children, ClutterActor *, i);
+
+      if (!child)
+        continue;
+
       if (priv->has_focus && (child == priv->current_focus))
         draw_focus = TRUE;
       else
@@ -991,15 +1099,15 @@ mex_grid_set_focused_actor (MexGrid      *self,
   /* Find what row this actor is on */
   if (actor)
     {
-      gint i;
-
-      for (i = 0; i < priv->children->len; i++)
-        if (g_array_index (priv->children, ClutterActor *, i) == actor)
-          break;
+      gint i = mex_grid_get_child_index (self, actor);
 
-      priv->focused_row = i / priv->stride;
+      if (i >= 0)
+        priv->focused_row = i / priv->stride;
     }
 
+  /* The previously focused tile may not be needed anymore */
+  mex_grid_queue_realize (self);
+
   /* Animate to possibly newly focused row (or reset) */
   if (priv->has_focus)
     mex_grid_start_animation (self);
@@ -1151,6 +1259,14 @@ mex_grid_class_init (MexGridClass *klass)
                               G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
   g_object_class_install_property (object_class, PROP_TILE_RATIO, pspec);
 
+  pspec = g_param_spec_boolean ("virtualized",
+                                "Virtualized",
+                                "Only create tiles for the visible rows and "
+                                "reuse them while scrolling.",
+                                FALSE,
+                                G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+  g_object_class_install_property (object_class, PROP_VIRTUALIZED, pspec);
+
   /* MxScrollable properties */
   g_object_class_override_property (object_class,
                                     PROP_HADJUST,
@@ -1231,7 +1347,12 @@ mex_grid_init (MexGrid *self)
 {
   MexGridPrivate *priv = self->priv = GRID_PRIVATE (self);
 
-  priv->children = g_array_new (FALSE, FALSE, sizeof (ClutterActor *));
+  priv->children = g_array_new (FALSE, TRUE, sizeof (ClutterActor *));
+  priv->realized = g_ptr_array_new ();
+  mex_realized_range_init (&priv->range, CLUTTER_ACTOR (self),
+                           priv->children, priv->realized,
+                           &mex_grid_range_funcs);
+  g_queue_init (&priv->recycled);
   priv->first_visible = priv->last_visible = -1;
   priv->stride = 3;
 
@@ -1287,14 +1408,53 @@ mex_grid_set_stride (MexGrid *grid, gint stride)
 }
 
 /**
- * mex_grid_add_content:
+ * mex_grid_set_virtualized:
+ * @grid: a #MexGrid
+ * @virtualized: whether to virtualize @grid
  *
- * Add an item to the grid for the given content and position
+ * A virtualized grid only creates tiles for the rows around the visible
+ * ones, and reuses them for other items while scrolling, instead of having
+ * a tile for each item of the model. Useful for very large models.
  */
-static void
-mex_grid_add_content (MexGrid    *grid,
-                      MexContent *content,
-                      gint        position)
+void
+mex_grid_set_virtualized (MexGrid  *grid,
+                          gboolean  virtualized)
+{
+  MexGridPrivate *priv;
+
+  g_return_if_fail (MEX_IS_GRID (grid));
+
+  priv = grid->priv;
+  if (priv->virtualized == !!virtualized)
+    return;
+
+  priv->virtualized = !!virtualized;
+
+  if (priv->model)
+    {
+      mex_grid_clear (grid);
+      mex_grid_populate (grid);
+      clutter_actor_queue_relayout (CLUTTER_ACTOR (grid));
+    }
+
+  g_object_notify (G_OBJECT (grid), "virtualized");
+}
+
+gboolean
+mex_grid_get_virtualized (MexGrid *grid)
+{
+  g_return_val_if_fail (MEX_IS_GRID (grid), FALSE);
+
+  return grid->priv->virtualized;
+}
+
+/**
+ * mex_grid_create_box:
+ *
+ * Create an item for the grid, without any content
+ */
+static ClutterActor *
+mex_grid_create_box (MexGrid *grid)
 {
   MexGridPrivate *priv = grid->priv;
   ClutterActor *box;
@@ -1317,12 +1477,170 @@ mex_grid_add_content (MexGrid    *grid,
                           box, "thumb-ratio",
                           G_BINDING_SYNC_CREATE);
 
-  mex_content_view_set_content (MEX_CONTENT_VIEW (box), content);
   mex_content_view_set_context (MEX_CONTENT_VIEW (box), priv->model);
 
   clutter_actor_set_parent (box, CLUTTER_ACTOR (grid));
 
+  return box;
+}
+
+/**
+ * mex_grid_realize:
+ *
+ * Make sure the item at the given position has a tile, reusing one that
+ * scrolled out of view if possible
+ */
+static ClutterActor *
+mex_grid_realize (MexGrid *grid,
+                  gint     index)
+{
+  MexGridPrivate *priv = grid->priv;
+  ClutterActor *box;
+
+  box = g_array_index (priv->children, ClutterActor *, index);
+  if (box)
+    return box;
+
+  box = g_queue_pop_head (&priv->recycled);
+  if (!box)
+    box = mex_grid_create_box (grid);
+
+  mex_content_view_set_content (MEX_CONTENT_VIEW (box),
+                                mex_model_get_content (priv->model, index));
+  clutter_actor_show (box);
+
+  mex_realized_range_add (&priv->range, index, box);
+
+  return box;
+}
+
+/**
+ * mex_grid_unrealize:
+ *
+ * Take the tile away from the item at the given position
+ */
+static void
+mex_grid_unrealize (MexGrid *grid,
+                    gint     index)
+{
+  MexGridPrivate *priv = grid->priv;
+  ClutterActor *box;
+
+  box = g_array_index (priv->children, ClutterActor *, index);
+  mex_realized_range_remove (&priv->range, index);
+
+  /* Open and focused tiles aren't worth resetting */
+  if (priv->virtualized &&
+      (box != priv->current_focus) &&
+      !mex_content_box_get_open (MEX_CONTENT_BOX (box)) &&
+      (priv->recycled.length < MAX_RECYCLED_TILES))
+    {
+      clutter_actor_hide (box);
+      g_queue_push_head (&priv->recycled, box);
+    }
+  else
+    {
+      if (box == priv->current_focus)
+        priv->current_focus = NULL;
+
+      clutter_actor_destroy (box);
+    }
+}
+
+/**
+ * mex_grid_update_realized:
+ *
+ * In virtualized mode, create the tiles for the rows around the visible
+ * ones and release the others
+ */
+static void
+mex_grid_update_realized (MexGrid *grid)
+{
+  MexGridPrivate *priv = grid->priv;
+  gint first, last;
+
+  if (!priv->virtualized || !priv->model || !priv->children->len)
+    return;
+
+  if ((gint) priv->tile_height <= 0)
+    mex_realized_range_get_initial (&priv->range, priv->stride,
+                                    &first, &last);
+  else
+    {
+      gint first_row, last_row;
+
+      mex_grid_get_visible_rows (grid, priv->avail_height, priv->tile_height,
+                                 &first_row, &last_row);
+      first = MIN (priv->children->len - 1, first_row * priv->stride);
+      last = MIN (priv->children->len - 1, (last_row + 1) * priv->stride - 1);
+    }
+
+  if (mex_realized_range_set (&priv->range, first, last))
+    mex_model_set_visible_range (priv->model, first, last);
+}
+
+static ClutterActor *
+mex_grid_range_realize (ClutterActor *owner,
+                        gint          index)
+{
+  return mex_grid_realize (MEX_GRID (owner), index);
+}
+
+static void
+mex_grid_range_unrealize (ClutterActor *owner,
+                          gint          index)
+{
+  mex_grid_unrealize (MEX_GRID (owner), index);
+}
+
+/* The focused tile stays even when scrolled out of view */
+static gboolean
+mex_grid_range_keep (ClutterActor *owner,
+                     ClutterActor *child)
+{
+  return child == MEX_GRID (owner)->priv->current_focus;
+}
+
+static void
+mex_grid_range_update (ClutterActor *owner)
+{
+  mex_grid_update_realized (MEX_GRID (owner));
+}
+
+static const MexRealizedRangeFuncs mex_grid_range_funcs =
+{
+  mex_grid_range_realize,
+  mex_grid_range_unrealize,
+  mex_grid_range_keep,
+  mex_grid_range_update
+};
+
+static void
+mex_grid_queue_realize (MexGrid *grid)
+{
+  if (grid->priv->virtualized)
+    mex_realized_range_queue (&grid->priv->range);
+}
+
+/**
+ * mex_grid_add_content:
+ *
+ * Add an item to the grid for the given content and position
+ */
+static void
+mex_grid_add_content (MexGrid *grid,
+                      gint     position)
+{
+  MexGridPrivate *priv = grid->priv;
+  ClutterActor *box = NULL;
+
+  mex_realized_range_shift (&priv->range, position, 1);
   g_array_insert_val (priv->children, position, box);
+
+  if (priv->virtualized)
+    mex_grid_queue_realize (grid);
+  else
+    mex_grid_realize (grid, position);
 }
 
 /**
@@ -1334,14 +1652,13 @@ static void
 mex_grid_clear (MexGrid *grid)
 {
   MexGridPrivate *priv = grid->priv;
+  ClutterActor *box;
 
   /* remove all children */
-  while (priv->children->len > 0)
-    {
-      clutter_actor_destroy (g_array_index (priv->children, ClutterActor*,
-                                            0));
-      g_array_remove_index_fast (priv->children, 0);
-    }
+  mex_realized_range_clear (&priv->range);
+  while ((box = g_queue_pop_head (&priv->recycled)))
+    clutter_actor_destroy (box);
+
   priv->current_focus = NULL;
 }
 
@@ -1353,11 +1670,16 @@ mex_grid_clear (MexGrid *grid)
 static void
 mex_grid_populate (MexGrid *grid)
 {
-  MexContent *content;
-  gint i = 0;
+  MexGridPrivate *priv = grid->priv;
+  gint i;
 
-  while ((content = mex_model_get_content (grid->priv->model, i)))
-    mex_grid_add_content (grid, content, i++);
+  g_array_set_size (priv->children, mex_model_get_length (priv->model));
+
+  if (priv->virtualized)
+    mex_grid_update_realized (grid);
+  else
+    for (i = 0; i < priv->children->len; i++)
+      mex_grid_realize (grid, i);
 }
 
 static void
@@ -1368,8 +1690,6 @@ mex_grid_controller_changed (GController          *controller,
 {
   MexGridPrivate *priv = grid->priv;
   gint i, n_indices;
-  MexContent *content;
-  ClutterActor *box;
 
   n_indices = g_controller_reference_get_n_indices (ref);
 
@@ -1379,9 +1699,8 @@ mex_grid_controller_changed (GController          *controller,
       for (i = 0; i < n_indices; i++)
         {
           gint content_index = g_controller_reference_get_index_uint (ref, i);
-          content = mex_model_get_content (priv->model, content_index);
 
-          mex_grid_add_content (grid, content, content_index);
+          mex_grid_add_content (grid, content_index);
         }
       break;
 
@@ -1390,15 +1709,13 @@ mex_grid_controller_changed (GController          *controller,
         {
           gint content_index = g_controller_reference_get_index_uint (ref, i);
 
-          box = g_array_index (priv->children, ClutterActor*, content_index);
-
-
-          if (box == priv->current_focus)
-            priv->current_focus = NULL;
+          if (g_array_index (priv->children, ClutterActor *, content_index))
+            mex_grid_unrealize (grid, content_index);
 
-          clutter_actor_destroy (box);
+          mex_realized_range_shift (&priv->range, content_index + 1, -1);
           g_array_remove_index (priv->children, content_index);
         }
+      mex_grid_queue_realize (grid);
       break;
 
     case G_CONTROLLER_UPDATE:
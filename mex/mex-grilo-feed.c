@@ -23,6 +23,7 @@
 #include "mex-content-view.h"
 #include "mex-grilo-feed.h"
 #include "mex-player.h"
+#include "mex-trace.h"
 
 enum {
   PROP_0,
@@ -30,7 +31,9 @@ enum {
   PROP_ROOT,
   PROP_QUERY_KEYS,
   PROP_METADATA_KEYS,
-  PROP_COMPLETED
+  PROP_COMPLETED,
+  PROP_PAGE_SIZE,
+  PROP_ESTIMATED_LENGTH
 };
 
 struct _MexGriloFeedPrivate {
@@ -46,6 +49,20 @@ struct _MexGriloFeedPrivate {
   MexGriloFeedOpenCb open_callback;
 
   GList *items_to_add;
+
+  /* Paging: the current operation is fetched page_size items at a time,
+   * the next page being requested when a view gets close to the end */
+  guint page_size;
+  guint fetched;
+  guint page_requested;
+  guint page_received;
+  guint estimated_length;
+  guint visible_last;
+  guint more : 1;
+
+  /* When the current operation was started, for the trace */
+  gint64 op_start;
+  guint  got_result : 1;
 };
 
 #define BROWSE_LIMIT 100
@@ -55,7 +72,10 @@ struct _MexGriloFeedPrivate {
                                                        MEX_TYPE_GRILO_FEED, \
                                                        MexGriloFeedPrivate))
 
-G_DEFINE_TYPE (MexGriloFeed, mex_grilo_feed, MEX_TYPE_FEED)
+static void mex_model_iface_init (MexModelIface *iface);
+G_DEFINE_TYPE_WITH_CODE (MexGriloFeed, mex_grilo_feed, MEX_TYPE_FEED,
+                         G_IMPLEMENT_INTERFACE (MEX_TYPE_MODEL,
+                                                mex_model_iface_init))
 
 static void update_source (MexGriloFeed *feed, GrlSource *new_source);
 
@@ -63,6 +83,7 @@ static void mex_grilo_feed_stop_op (MexGriloFeed *feed);
 static void mex_grilo_feed_start_op (MexGriloFeed *feed);
 static void mex_grilo_feed_free_op (MexGriloFeed *feed);
 static void mex_grilo_feed_init_op (MexGriloFeed *feed);
+static void mex_grilo_feed_fetch_page (MexGriloFeed *feed);
 
 static guint _mex_grilo_feed_browse (MexGriloFeed      *feed,
                                      int                offset,
@@ -158,6 +179,10 @@ mex_grilo_feed_set_property (GObject      *object,
     priv->root = g_value_dup_object (value);
     break;
 
+  case PROP_PAGE_SIZE:
+    mex_grilo_feed_set_page_size (self, g_value_get_uint (value));
+    break;
+
   default:
     break;
   }
@@ -193,6 +218,14 @@ mex_grilo_feed_get_property (GObject    *object,
     g_value_set_boolean (value, priv->completed);
     break;
 
+  case PROP_PAGE_SIZE:
+    g_value_set_uint (value, priv->page_size);
+    break;
+
+  case PROP_ESTIMATED_LENGTH:
+    g_value_set_uint (value, priv->estimated_length);
+    break;
+
   default:
     break;
   }
@@ -294,6 +327,20 @@ mex_grilo_feed_class_init (MexGriloFeedClass *klass)
                                 FALSE,
                                 G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
   g_object_class_install_property (o_class, PROP_COMPLETED, pspec);
+
+  pspec = g_param_spec_uint ("page-size", "Page size",
+                             "Number of items fetched at a time, or 0 to "
+                             "fetch them all at once.",
+                             0, G_MAXUINT, 0,
+                             G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+  g_object_class_install_property (o_class, PROP_PAGE_SIZE, pspec);
+
+  pspec = g_param_spec_uint ("estimated-length", "Estimated length",
+                             "Estimated number of items of the current "
+                             "operation, including those not fetched yet.",
+                             0, G_MAXUINT, 0,
+                             G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
+  g_object_class_install_property (o_class, PROP_ESTIMATED_LENGTH, pspec);
 }
 
 static void
@@ -348,6 +395,33 @@ emit_media_added (MexGriloFeed *feed, GrlMedia *media)
   feed->priv->items_to_add = g_list_prepend (feed->priv->items_to_add, program);
 }
 
+static void
+mex_grilo_feed_set_estimated_length (MexGriloFeed *feed,
+                                     guint         length)
+{
+  MexGriloFeedPrivate *priv = feed->priv;
+
+  if (priv->estimated_length == length)
+    return;
+
+  priv->estimated_length = length;
+  g_object_notify (G_OBJECT (feed), "estimated-length");
+}
+
+/* Fetch the next page once the views get within half a page of the end of
+ * what's been fetched */
+static void
+mex_grilo_feed_maybe_fetch_page (MexGriloFeed *feed)
+{
+  MexGriloFeedPrivate *priv = feed->priv;
+
+  if (!priv->more || !priv->op || priv->op->op_id)
+    return;
+
+  if (priv->visible_last + priv->page_size / 2 >= priv->fetched)
+    mex_grilo_feed_fetch_page (feed);
+}
+
 static void
 browse_cb (GrlSource    *source,
            guint         browse_id,
@@ -373,42 +447,64 @@ browse_cb (GrlSource    *source,
   if (priv->op->op_id != browse_id)
     return;
 
-  if (media) {
-    /*
-     * FIXME: talk to thomas/lionel/grilo guys about that crasher. We are
-     * being called with what seems to be an invalid media when cancelled.
-     * this is obviously temporary to enable people to work in the meantime
-     */
-    gconstpointer foo = grl_media_get_id (media);
-    if (!foo) {
-      const gchar *source_name;
-
-      source_name =
-        grl_source_get_name (GRL_SOURCE (priv->source));
-      g_warning ("FIXME: oh no, a grilo bug! (on the '%s' source)",
-                 source_name);
-      return;
+  /*
+   * FIXME: talk to thomas/lionel/grilo guys about that crasher. We are
+   * being called with what seems to be an invalid media when cancelled.
+   * this is obviously temporary to enable people to work in the meantime
+   */
+  if (media && !grl_media_get_id (media)) {
+    const gchar *source_name;
+
+    source_name =
+      grl_source_get_name (GRL_SOURCE (priv->source));
+    g_warning ("FIXME: oh no, a grilo bug! (on the '%s' source)",
+               source_name);
+
+    /* It still takes up a slot of the page, and the page still needs to
+     * be finished below when it's the last one */
+    priv->page_received++;
+  } else if (media) {
+    if (!priv->got_result) {
+      const gchar *title;
+
+      title = mex_generic_model_get_title (MEX_GENERIC_MODEL (feed));
+      mex_trace_end (priv->op_start, "grilo %s: first result",
+                     title ? title : grl_source_get_name (priv->source));
+      priv->got_result = TRUE;
     }
 
+    priv->page_received++;
+
     program = MEX_GRILO_PROGRAM (mex_feed_lookup (MEX_FEED (feed),
                                                   grl_media_get_id (media)));
     if (program != NULL) {
       mex_grilo_program_set_grilo_media (program, media);
-      return;
     } else {
       emit_media_added (feed, media);
-      g_object_unref (media);
+      priv->op->count++;
     }
+    g_object_unref (media);
   }
 
-  priv->op->count++;
-
   if (remaining == 0) {
     priv->op->op_id = 0;
 
-    /* Emit completed signal */
-    priv->completed = TRUE;
-    g_object_notify (G_OBJECT (feed), "completed");
+    /* A full page means there probably are more items to fetch */
+    priv->fetched += priv->page_received;
+    priv->more = (priv->page_size &&
+                  priv->page_received >= priv->page_requested &&
+                  priv->fetched < priv->op->limit);
+    mex_grilo_feed_set_estimated_length (feed, priv->more ?
+                                         priv->fetched + priv->page_size :
+                                         priv->fetched);
+
+    /* Emit completed signal, once the last page is in */
+    if (!priv->more && !priv->completed) {
+      priv->completed = TRUE;
+      g_object_notify (G_OBJECT (feed), "completed");
+    }
+
+    mex_grilo_feed_maybe_fetch_page (feed);
   }
 }
 
@@ -433,17 +529,19 @@ mex_grilo_feed_stop_op (MexGriloFeed *feed)
 }
 
 static void
-mex_grilo_feed_start_op (MexGriloFeed *feed)
+mex_grilo_feed_fetch_page (MexGriloFeed *feed)
 {
   MexGriloFeedPrivate *priv = feed->priv;
   MexGriloFeedClass *klass = MEX_GRILO_FEED_GET_CLASS (feed);
+  guint offset, limit;
 
-  if (!priv->op)
-    return;
+  offset = priv->op->offset + priv->fetched;
+  limit = priv->op->limit - priv->fetched;
+  if (priv->page_size)
+    limit = MIN (limit, priv->page_size);
 
-  if (priv->op->op_id) {
-    mex_grilo_feed_stop_op (feed);
-  }
+  priv->page_requested = limit;
+  priv->page_received = 0;
 
   switch (priv->op->type) {
   case MEX_GRILO_FEED_OPERATION_NONE:
@@ -451,30 +549,43 @@ mex_grilo_feed_start_op (MexGriloFeed *feed)
     break;
 
   case MEX_GRILO_FEED_OPERATION_BROWSE:
-    priv->op->op_id = klass->browse (feed,
-                                     priv->op->offset,
-                                     priv->op->limit,
-                                     browse_cb);
+    priv->op->op_id = klass->browse (feed, offset, limit, browse_cb);
     break;
 
   case MEX_GRILO_FEED_OPERATION_QUERY:
-    priv->op->op_id = klass->query (feed,
-                                    priv->op->text,
-                                    priv->op->offset,
-                                    priv->op->limit,
+    priv->op->op_id = klass->query (feed, priv->op->text, offset, limit,
                                     browse_cb);
     break;
 
   case MEX_GRILO_FEED_OPERATION_SEARCH:
-    priv->op->op_id = klass->search (feed,
-                                     priv->op->text,
-                                     priv->op->offset,
-                                     priv->op->limit,
+    priv->op->op_id = klass->search (feed, priv->op->text, offset, limit,
                                      browse_cb);
     break;
   }
 }
 
+static void
+mex_grilo_feed_start_op (MexGriloFeed *feed)
+{
+  MexGriloFeedPrivate *priv = feed->priv;
+
+  if (!priv->op)
+    return;
+
+  if (priv->op->op_id) {
+    mex_grilo_feed_stop_op (feed);
+  }
+
+  priv->fetched = 0;
+  priv->more = FALSE;
+  mex_grilo_feed_set_estimated_length (feed, 0);
+
+  priv->op_start = mex_trace_begin ();
+  priv->got_result = FALSE;
+
+  mex_grilo_feed_fetch_page (feed);
+}
+
 static void
 mex_grilo_feed_free_op (MexGriloFeed *feed)
 {
@@ -526,8 +637,8 @@ _mex_grilo_feed_browse (MexGriloFeed      *feed,
 
   options = grl_operation_options_new (NULL);
   grl_operation_options_set_flags (options, BROWSE_FLAGS);
-  grl_operation_options_set_skip (options, priv->op->offset);
-  grl_operation_options_set_count (options, priv->op->limit);
+  grl_operation_options_set_skip (options, offset);
+  grl_operation_options_set_count (options, limit);
 
 
   op_id = grl_source_browse (priv->source, priv->root,
@@ -553,10 +664,10 @@ _mex_grilo_feed_query (MexGriloFeed      *feed,
 
   options = grl_operation_options_new (NULL);
   grl_operation_options_set_flags (options, BROWSE_FLAGS);
-  grl_operation_options_set_skip (options, priv->op->offset);
-  grl_operation_options_set_count (options, priv->op->limit);
+  grl_operation_options_set_skip (options, offset);
+  grl_operation_options_set_count (options, limit);
 
-  op_id = grl_source_query (priv->source, priv->op->text,
+  op_id = grl_source_query (priv->source, query,
                             priv->query_keys,
                             options,
                             callback, feed);
@@ -579,10 +690,10 @@ _mex_grilo_feed_search (MexGriloFeed      *feed,
 
   options = grl_operation_options_new (NULL);
   grl_operation_options_set_flags (options, BROWSE_FLAGS);
-  grl_operation_options_set_skip (options, priv->op->offset);
-  grl_operation_options_set_count (options, priv->op->limit);
+  grl_operation_options_set_skip (options, offset);
+  grl_operation_options_set_count (options, limit);
 
-  op_id = grl_source_search (priv->source, priv->op->text,
+  op_id = grl_source_search (priv->source, search_text,
                              priv->query_keys,
                              options,
                              callback, feed);
@@ -681,6 +792,80 @@ mex_grilo_feed_get_completed (MexGriloFeed *feed)
   return feed->priv->completed;
 }
 
+/**
+ * mex_grilo_feed_set_page_size:
+ * @feed: a #MexGriloFeed
+ * @page_size: number of items to fetch at a time, or 0
+ *
+ * Makes the next operations fetch @page_size items first, and the
+ * following pages only once a view showing the feed scrolls close to the
+ * end of what's been fetched (see mex_model_set_visible_range()). The
+ * limit passed to mex_grilo_feed_browse() and friends is still honoured.
+ * With a @page_size of 0, the default, everything is fetched at once.
+ */
+void
+mex_grilo_feed_set_page_size (MexGriloFeed *feed,
+                              guint         page_size)
+{
+  MexGriloFeedPrivate *priv;
+
+  g_return_if_fail (MEX_IS_GRILO_FEED (feed));
+
+  priv = feed->priv;
+
+  if (priv->page_size == page_size)
+    return;
+
+  priv->page_size = page_size;
+  g_object_notify (G_OBJECT (feed), "page-size");
+}
+
+guint
+mex_grilo_feed_get_page_size (MexGriloFeed *feed)
+{
+  g_return_val_if_fail (MEX_IS_GRILO_FEED (feed), 0);
+  return feed->priv->page_size;
+}
+
+/**
+ * mex_grilo_feed_get_estimated_length:
+ * @feed: a #MexGriloFeed
+ *
+ * Grilo doesn't tell how many items an operation will return, so while
+ * pages are left to fetch this is the number of items fetched plus one
+ * more page. It's exact once the last page is in.
+ *
+ * Return value: the estimated number of items of the current operation
+ */
+guint
+mex_grilo_feed_get_estimated_length (MexGriloFeed *feed)
+{
+  g_return_val_if_fail (MEX_IS_GRILO_FEED (feed), 0);
+  return feed->priv->estimated_length;
+}
+
+/*
+ * MexModel implementation
+ */
+
+static void
+mex_grilo_feed_set_visible_range (MexModel *model,
+                                  guint     first,
+                                  guint     last)
+{
+  MexGriloFeed *feed = MEX_GRILO_FEED (model);
+
+  feed->priv->visible_last = last;
+  mex_grilo_feed_maybe_fetch_page (feed);
+}
+
+static void
+mex_model_iface_init (MexModelIface *iface)
+{
+  /* Everything else is inherited from MexGenericModel */
+  iface->set_visible_range = mex_grilo_feed_set_visible_range;
+}
+
 static void
 _mex_grilo_feed_content_updated (GrlSource *source,
                                  GPtrArray *changed_medias,
@@ -134,6 +134,11 @@ const MexGriloOperation *mex_grilo_feed_get_operation (MexGriloFeed *feed);
 
 gboolean mex_grilo_feed_get_completed (MexGriloFeed *feed);
 
+void  mex_grilo_feed_set_page_size        (MexGriloFeed *feed,
+                                           guint         page_size);
+guint mex_grilo_feed_get_page_size        (MexGriloFeed *feed);
+guint mex_grilo_feed_get_estimated_length (MexGriloFeed *feed);
+
 void mex_grilo_feed_set_open_callback (MexGriloFeed       *feed,
                                        MexGriloFeedOpenCb  callback);
 
@@ -23,6 +23,7 @@
 
 #include "mex-grilo.h"
 #include "mex-grilo-program.h"
+#include "mex-private.h"
 #include "mex-thumbnailer.h"
 #include "mex-utils.h"
 
@@ -50,7 +51,13 @@ struct _MexGriloProgramPrivate
   GrlMedia *media;
   guint     completed : 1;
   guint     in_update : 1;
+  guint     visible   : 1;
   GPid      pid;
+
+  MexThumbnailRequest *thumbnail_request;
+
+  /* Keys changed since the metadata was last saved */
+  GList    *dirty_keys;
 };
 
 /**/
@@ -106,6 +113,14 @@ mex_grilo_program_dispose (GObject *object)
     priv->pid = 0;
   }
 
+  if (priv->thumbnail_request) {
+    mex_thumbnailer_cancel (priv->thumbnail_request);
+    priv->thumbnail_request = NULL;
+  }
+
+  g_list_free (priv->dirty_keys);
+  priv->dirty_keys = NULL;
+
   G_OBJECT_CLASS (mex_grilo_program_parent_class)->dispose (object);
 }
 
@@ -230,6 +245,8 @@ thumbnail_cb (const char *uri, gpointer user_data)
   content = MEX_CONTENT (user_data);
   priv = GRILO_PROGRAM_PRIVATE (user_data);
 
+  priv->thumbnail_request = NULL;
+
   thumb_path = mex_get_thumbnail_path_for_uri (uri);
 
   if (g_file_test (thumb_path, G_FILE_TEST_EXISTS))
@@ -259,10 +276,17 @@ thumbnail_cb (const char *uri, gpointer user_data)
 static void
 mex_grilo_program_thumbnail (MexContent *content, GrlMedia *media)
 {
+  MexGriloProgramPrivate *priv = MEX_GRILO_PROGRAM (content)->priv;
   const char *url, *old_thumb_url;
   char *thumb_path;
   static gchar *folder_thumb_uri = NULL;
 
+  if (priv->thumbnail_request)
+    {
+      mex_thumbnailer_cancel (priv->thumbnail_request);
+      priv->thumbnail_request = NULL;
+    }
+
   /* If the media isn't local, then we'll ignore it for now */
   url = grl_media_get_url (media);
   if (url == NULL || !g_str_has_prefix (url, "file:///"))
@@ -299,8 +323,12 @@ mex_grilo_program_thumbnail (MexContent *content, GrlMedia *media)
     }
   else
     {
-      mex_thumbnailer_generate (url, grl_media_get_mime (media),
-                                thumbnail_cb, content);
+      priv->thumbnail_request =
+        mex_thumbnailer_request (url, grl_media_get_mime (media),
+                                 priv->visible ?
+                                 MEX_THUMBNAIL_PRIORITY_HIGH :
+                                 MEX_THUMBNAIL_PRIORITY_NORMAL,
+                                 thumbnail_cb, content);
     }
   g_free (thumb_path);
 }
@@ -344,6 +372,27 @@ mex_grilo_program_complete (MexProgram *program)
   g_object_unref (source);
 }
 
+/*
+ * Thumbnails of programs that are on screen are generated first, and
+ * those of programs that are no longer shown are pushed back behind
+ * everything else until they are shown again.
+ */
+static void
+mex_grilo_program_set_visible (MexProgram *program,
+                               gboolean    visible)
+{
+  MexGriloProgram *self = MEX_GRILO_PROGRAM (program);
+  MexGriloProgramPrivate *priv = self->priv;
+
+  priv->visible = visible;
+
+  if (priv->thumbnail_request)
+    mex_thumbnailer_request_set_priority (priv->thumbnail_request,
+                                          visible ?
+                                          MEX_THUMBNAIL_PRIORITY_HIGH :
+                                          MEX_THUMBNAIL_PRIORITY_LOW);
+}
+
 static void
 mex_grilo_program_set_metadata (MexContent         *content,
                                  MexContentMetadata  key,
@@ -354,7 +403,16 @@ mex_grilo_program_set_metadata (MexContent         *content,
   MexContentIface        *iface, *parent_iface;
 
   if (!priv->in_update && key != MEX_CONTENT_METADATA_QUEUED)
-    mex_grilo_set_media_content_metadata (priv->media, key, value);
+    {
+      GrlKeyID grl_key = mex_grilo_get_grl_key (key);
+
+      mex_grilo_set_media_content_metadata (priv->media, key, value);
+
+      if (grl_key &&
+          !g_list_find (priv->dirty_keys, GRLKEYID_TO_POINTER (grl_key)))
+        priv->dirty_keys = g_list_prepend (priv->dirty_keys,
+                                           GRLKEYID_TO_POINTER (grl_key));
+    }
 
 
   iface = MEX_CONTENT_GET_IFACE (content);
@@ -363,6 +421,19 @@ mex_grilo_program_set_metadata (MexContent         *content,
   /* mex_grilo_program_set_metadata (content, key, value); */
 }
 
+static void
+mex_grilo_program_store_cb (GrlSource    *source,
+                            GrlMedia     *media,
+                            GList        *failed_keys,
+                            gpointer      user_data,
+                            const GError *error)
+{
+  if (error)
+    g_warning ("Could not store metadata: %s", error->message);
+
+  _mex_metadata_journal_write_finished ();
+}
+
 static void
 mex_grilo_program_save_metadata (MexContent *content)
 {
@@ -370,7 +441,11 @@ mex_grilo_program_save_metadata (MexContent *content)
   MexGriloProgramPrivate *priv    = program->priv;
   GrlSource              *source;
   const GList *ckeys;
-  GList *keys;
+  GList *keys = NULL, *l;
+
+  /* Nothing changed since the last save */
+  if (!priv->dirty_keys)
+    return;
 
   g_object_get (G_OBJECT (mex_program_get_feed (MEX_PROGRAM (program))),
                 "grilo-source", &source,
@@ -380,18 +455,28 @@ mex_grilo_program_save_metadata (MexContent *content)
         & GRL_OP_STORE_METADATA))
     goto goout;
 
+  /* Only store the keys that changed, all in one update */
   ckeys = grl_source_writable_keys (GRL_SOURCE (source));
-  keys = g_list_copy ((GList *) ckeys);
+  for (l = priv->dirty_keys; l; l = l->next)
+    if (g_list_find ((GList *) ckeys, l->data))
+      keys = g_list_prepend (keys, l->data);
 
-  grl_source_store_metadata (GRL_SOURCE (source),
-                             priv->media,
-                             keys,
-                             GRL_WRITE_NORMAL,
-                             NULL, NULL);
+  if (keys)
+    {
+      _mex_metadata_journal_write_started ();
+      grl_source_store_metadata (GRL_SOURCE (source),
+                                 priv->media,
+                                 keys,
+                                 GRL_WRITE_NORMAL,
+                                 mex_grilo_program_store_cb, NULL);
+    }
 
   g_list_free (keys);
 
  goout:
+  g_list_free (priv->dirty_keys);
+  priv->dirty_keys = NULL;
+
   g_object_unref (source);
 }
 
@@ -422,6 +507,7 @@ mex_grilo_program_class_init (MexGriloProgramClass *klass)
   program_class->get_stream = mex_grilo_program_get_stream;
   program_class->complete = mex_grilo_program_complete;
   program_class->get_id = mex_grilo_program_get_id;
+  program_class->set_visible = mex_grilo_program_set_visible;
 
   pspec = g_param_spec_object ("grilo-media", "Grilo media",
                                "GrlMedia object for this program",
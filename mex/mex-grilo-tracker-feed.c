@@ -29,10 +29,24 @@ struct _MexGriloTrackerFeedPrivate {
   GrlSource *source;
   gchar     *filter;
   GList     *keys;
+
+  /* Ids of the medias Tracker reported as added, waiting to be filtered */
+  GHashTable *added_ids;
+  guint       added_source;
 };
 
+typedef struct
+{
+  MexGriloTrackerFeed *feed;
+  GList               *programs;
+} FilterBatch;
+
 #define BROWSE_FLAGS (GRL_RESOLVE_IDLE_RELAY | GRL_RESOLVE_FULL)
 
+/* Tracker reports changes as they are indexed, a folder copied over sends
+ * them one by one: wait that long for more before querying them at once */
+#define ADDED_DELAY 250
+
 #define GET_PRIVATE(obj)                                                \
   (G_TYPE_INSTANCE_GET_PRIVATE ((obj),                                  \
                                 MEX_TYPE_GRILO_TRACKER_FEED,            \
@@ -77,6 +91,8 @@ mex_grilo_tracker_feed_finalize (GObject *object)
       priv->keys = NULL;
     }
 
+  g_hash_table_unref (priv->added_ids);
+
   G_OBJECT_CLASS (mex_grilo_tracker_feed_parent_class)->finalize (object);
 }
 
@@ -176,6 +192,9 @@ mex_grilo_tracker_feed_init (MexGriloTrackerFeed *self)
   MexGriloTrackerFeedPrivate *priv;
 
   self->priv = priv = GET_PRIVATE (self);
+
+  priv->added_ids = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                           g_free, NULL);
 }
 
 MexFeed *
@@ -202,16 +221,16 @@ item_cb (GrlSource    *source,
          gpointer      userdata,
          const GError *error)
 {
-  MexGriloTrackerFeed *feed = (MexGriloTrackerFeed *) userdata;
+  FilterBatch *batch = (FilterBatch *) userdata;
+  MexGriloTrackerFeed *feed = batch->feed;
   MexGriloTrackerFeedPrivate *priv = feed->priv;
   MexProgram *program;
 
   if (error) {
-    g_warning ("Error browsing: %s", error->message);
-    return;
-  }
-
-  if (media) {
+    if (!g_error_matches (error, GRL_CORE_ERROR,
+                          GRL_CORE_ERROR_OPERATION_CANCELLED))
+      g_warning ("Error browsing: %s", error->message);
+  } else if (media) {
     /*
      * FIXME: talk to thomas/lionel/grilo guys about that crasher. We are
      * being called with what seems to be an invalid media when cancelled.
@@ -225,18 +244,32 @@ item_cb (GrlSource    *source,
         grl_source_get_name (GRL_SOURCE (priv->source));
       g_warning ("FIXME: oh no, a grilo bug! (on the '%s' source)",
                  source_name);
-      return;
-    }
-
-    program = mex_feed_lookup (MEX_FEED (feed), grl_media_get_id (media));
-    if (program != NULL) {
-      mex_grilo_program_set_grilo_media (MEX_GRILO_PROGRAM (program), media);
     } else {
-      program = mex_grilo_program_new (MEX_GRILO_FEED (feed), media);
-      mex_model_add_content (MEX_MODEL (feed), (MexContent *) program);
+      program = mex_feed_lookup (MEX_FEED (feed), grl_media_get_id (media));
+      if (program != NULL) {
+        mex_grilo_program_set_grilo_media (MEX_GRILO_PROGRAM (program),
+                                           media);
+      } else {
+        program = mex_grilo_program_new (MEX_GRILO_FEED (feed), media);
+        batch->programs = g_list_prepend (batch->programs, program);
+      }
+      g_object_unref (media);
     }
-    g_object_unref (media);
   }
+
+  if (remaining > 0)
+    return;
+
+  /* All the medias of the batch are in, add them in one go */
+  if (batch->programs)
+    {
+      batch->programs = g_list_reverse (batch->programs);
+      mex_model_add (MEX_MODEL (feed), batch->programs);
+      g_list_free (batch->programs);
+    }
+
+  g_object_unref (feed);
+  g_slice_free (FilterBatch, batch);
 }
 
 static gchar *
@@ -306,42 +339,86 @@ get_filter_from_operation (MexGriloTrackerFeed *feed,
   return text;
 }
 
-static void
-filter_media (MexGriloTrackerFeed *feed, GrlMedia *media)
+static gboolean
+filter_added_medias (MexGriloTrackerFeed *feed)
 {
   MexGriloTrackerFeedPrivate *priv = feed->priv;
   const MexGriloOperation *op;
   gchar *query_text = NULL, *query_final = NULL;
-  const gchar *str_id = grl_media_get_id (media);
   GrlOperationOptions *options;
+  GHashTableIter iter;
+  FilterBatch *batch;
+  gpointer str_id;
+  GString *ids;
+  guint n_ids;
 
-  if (!str_id) {
-    g_warning ("Cannot filter media without id");
-    return;
-  }
+  priv->added_source = 0;
 
+  n_ids = g_hash_table_size (priv->added_ids);
   op = mex_grilo_feed_get_operation (MEX_GRILO_FEED (feed));
 
-  if (op->type == MEX_GRILO_FEED_OPERATION_NONE)
-    return;
+  if (n_ids == 0 || op->type == MEX_GRILO_FEED_OPERATION_NONE)
+    {
+      g_hash_table_remove_all (priv->added_ids);
+      g_object_unref (feed);
+      return FALSE;
+    }
+
+  ids = g_string_new (NULL);
+  g_hash_table_iter_init (&iter, priv->added_ids);
+  while (g_hash_table_iter_next (&iter, &str_id, NULL))
+    {
+      if (ids->len)
+        g_string_append (ids, ", ");
+      g_string_append (ids, str_id);
+    }
+  g_hash_table_remove_all (priv->added_ids);
 
+  /* Only keep the medias that belong to the feed */
   query_text = get_filter_from_operation (feed, op->text, op->type);
-  query_final = g_strdup_printf ("%s . FILTER(tracker:id(?urn) = %s)",
-                                 query_text, str_id);
+  query_final = g_strdup_printf ("%s . FILTER(tracker:id(?urn) IN (%s))",
+                                 query_text, ids->str);
 
   options = grl_operation_options_new (NULL);
   grl_operation_options_set_flags (options, BROWSE_FLAGS);
   grl_operation_options_set_skip (options, 0);
-  grl_operation_options_set_count (options, 1);
+  grl_operation_options_set_count (options, n_ids);
+
+  /* The reference on the feed taken with the timeout is kept until the
+   * query is done */
+  batch = g_slice_new0 (FilterBatch);
+  batch->feed = feed;
 
   grl_source_query (priv->source, query_final,
-                          priv->keys,
-                          options,
-                          item_cb, feed);
+                    priv->keys,
+                    options,
+                    item_cb, batch);
 
-	g_object_unref (options);
+  g_object_unref (options);
+  g_string_free (ids, TRUE);
   g_free (query_final);
   g_free (query_text);
+
+  return FALSE;
+}
+
+static void
+filter_media (MexGriloTrackerFeed *feed, GrlMedia *media)
+{
+  MexGriloTrackerFeedPrivate *priv = feed->priv;
+  const gchar *str_id = grl_media_get_id (media);
+
+  if (!str_id) {
+    g_warning ("Cannot filter media without id");
+    return;
+  }
+
+  if (!priv->added_source)
+    priv->added_source =
+      g_timeout_add (ADDED_DELAY, (GSourceFunc) filter_added_medias,
+                     g_object_ref (feed));
+
+  g_hash_table_insert (priv->added_ids, g_strdup (str_id), NULL);
 }
 
 static guint
@@ -478,6 +555,8 @@ _mex_grilo_tracker_feed_content_updated (GrlSource           *source,
           break;
 
         case GRL_CONTENT_REMOVED:
+          g_hash_table_remove (MEX_GRILO_TRACKER_FEED (feed)->priv->added_ids,
+                               id);
           program = mex_feed_lookup (MEX_FEED (feed), id);
           if (program != NULL) {
             mex_model_remove_content (MEX_MODEL (feed), MEX_CONTENT (program));
@@ -227,6 +227,14 @@ mex_grilo_set_media_content_metadata (GrlMedia           *media,
   }
 }
 
+GrlKeyID
+mex_grilo_get_grl_key (MexContentMetadata mex_key)
+{
+  g_return_val_if_fail (mex_key < MEX_CONTENT_METADATA_LAST_ID, 0);
+
+  return _get_grl_key_from_mex (mex_key);
+}
+
 void
 mex_grilo_update_content_from_media (MexContent *content,
                                      GrlMedia   *media)
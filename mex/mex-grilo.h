@@ -13,6 +13,8 @@ void mex_grilo_set_media_content_metadata (GrlMedia           *media,
                                            MexContentMetadata  mex_key,
                                            const gchar        *value);
 
+GrlKeyID mex_grilo_get_grl_key (MexContentMetadata mex_key);
+
 void mex_grilo_update_content_from_media (MexContent *content,
                                           GrlMedia   *media);
 
@@ -0,0 +1,326 @@
+/*
+ * Mex - a media explorer
+ *
+ * Copyright © 2010, 2011 Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses>
+ */
+
+/*
+ * Decodes and scales images on a pool of threads, so that a column of tiles
+ * showing up doesn't stall the main loop. Images are decoded at the size
+ * they're going to be displayed at, and the main thread is only left with
+ * uploading them into the texture cache.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <clutter/clutter.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+#include "mex-image-loader.h"
+#include "mex-os.h"
+#include "mex-texture-cache.h"
+
+struct _MexImageRequest
+{
+  gchar  *uri;
+  gchar  *path;
+  GBytes *bytes;
+  gint    width;
+  gint    height;
+  guint   serial;
+
+  MexImageLoaderCallback callback;
+  gpointer               user_data;
+
+  /* Set from the main thread, read from the pool */
+  volatile gint cancelled;
+
+  /* Set from the pool, read from the main thread once it's done */
+  GdkPixbuf *pixbuf;
+  GError    *error;
+};
+
+static GThreadPool *image_thread_pool = NULL;
+static guint image_serial = 0;
+
+static void
+mex_image_request_free (MexImageRequest *request)
+{
+  g_free (request->uri);
+  g_free (request->path);
+  if (request->bytes)
+    g_bytes_unref (request->bytes);
+  if (request->pixbuf)
+    g_object_unref (request->pixbuf);
+  if (request->error)
+    g_error_free (request->error);
+  g_slice_free (MexImageRequest, request);
+}
+
+static gboolean
+mex_image_loader_finished (gpointer data)
+{
+  MexImageRequest *request = data;
+  CoglHandle texture = COGL_INVALID_HANDLE;
+
+  if (g_atomic_int_get (&request->cancelled))
+    {
+      mex_image_request_free (request);
+      return FALSE;
+    }
+
+  if (request->pixbuf)
+    {
+      texture = mex_texture_cache_add (request->uri,
+                                       request->width, request->height,
+                                       request->pixbuf);
+      if (texture == COGL_INVALID_HANDLE)
+        g_set_error (&request->error, GDK_PIXBUF_ERROR,
+                     GDK_PIXBUF_ERROR_FAILED,
+                     "Could not create a texture for %s", request->uri);
+    }
+
+  request->callback (texture, request->error, request->user_data);
+
+  if (texture != COGL_INVALID_HANDLE)
+    cogl_handle_unref (texture);
+  mex_image_request_free (request);
+
+  return FALSE;
+}
+
+/* Decode to the smallest size that still covers the requested box, the
+ * MxImage then crops or fits it without having to scale much. Images are
+ * never scaled up. */
+static void
+size_prepared_cb (GdkPixbufLoader *loader,
+                  gint             width,
+                  gint             height,
+                  MexImageRequest *request)
+{
+  gdouble scale = 0;
+
+  if (request->width > 0)
+    scale = request->width / (gdouble) width;
+  if (request->height > 0)
+    scale = MAX (scale, request->height / (gdouble) height);
+
+  if (scale <= 0 || scale >= 1.0)
+    return;
+
+  gdk_pixbuf_loader_set_size (loader,
+                              MAX (1, (gint) (width * scale + 0.5)),
+                              MAX (1, (gint) (height * scale + 0.5)));
+}
+
+static void
+mex_image_loader_decode (gpointer data,
+                         gpointer user_data)
+{
+  MexImageRequest *request = data;
+  GdkPixbufLoader *loader;
+  const guchar *buffer;
+  gsize size;
+
+  /* The requester went away while this was waiting in the pool */
+  if (g_atomic_int_get (&request->cancelled))
+    goto finished;
+
+  if (request->path)
+    {
+      GMappedFile *mapped;
+
+      mapped = g_mapped_file_new (request->path, FALSE, &request->error);
+      if (!mapped)
+        goto finished;
+
+      request->bytes =
+        g_bytes_new_with_free_func (g_mapped_file_get_contents (mapped),
+                                    g_mapped_file_get_length (mapped),
+                                    (GDestroyNotify) g_mapped_file_unref,
+                                    mapped);
+    }
+
+  loader = gdk_pixbuf_loader_new ();
+  g_signal_connect (loader, "size-prepared",
+                    G_CALLBACK (size_prepared_cb), request);
+
+  buffer = g_bytes_get_data (request->bytes, &size);
+  if (size > 0 &&
+      !gdk_pixbuf_loader_write (loader, buffer, size, &request->error))
+    {
+      gdk_pixbuf_loader_close (loader, NULL);
+    }
+  else if (gdk_pixbuf_loader_close (loader, &request->error))
+    {
+      request->pixbuf = gdk_pixbuf_loader_get_pixbuf (loader);
+      if (request->pixbuf)
+        g_object_ref (request->pixbuf);
+    }
+
+  g_object_unref (loader);
+
+  /* Release the data as soon as possible, it's not needed anymore */
+  g_bytes_unref (request->bytes);
+  request->bytes = NULL;
+
+  if (!request->pixbuf && !request->error)
+    g_set_error_literal (&request->error, GDK_PIXBUF_ERROR,
+                         GDK_PIXBUF_ERROR_CORRUPT_IMAGE,
+                         "Could not decode image");
+
+finished:
+  clutter_threads_add_timeout (0, mex_image_loader_finished, request);
+}
+
+/* The most recent requests are served first: when scrolling through a long
+ * column, those are the tiles that have just come on screen */
+static gint
+mex_image_loader_compare (gconstpointer a,
+                          gconstpointer b,
+                          gpointer      user_data)
+{
+  const MexImageRequest *request_a = a, *request_b = b;
+
+  return (gint) (request_b->serial - request_a->serial);
+}
+
+static MexImageRequest *
+mex_image_loader_push (MexImageRequest *request)
+{
+  GError *error = NULL;
+
+  if (G_UNLIKELY (image_thread_pool == NULL))
+    {
+      image_thread_pool = g_thread_pool_new (mex_image_loader_decode,
+                                             NULL,
+                                             mex_os_get_n_cores (),
+                                             FALSE, &error);
+      if (error)
+        {
+          g_warning (G_STRLOC ": %s", error->message);
+          g_clear_error (&error);
+        }
+      else
+        g_thread_pool_set_sort_function (image_thread_pool,
+                                         mex_image_loader_compare, NULL);
+    }
+
+  request->serial = image_serial++;
+
+  if (image_thread_pool)
+    g_thread_pool_push (image_thread_pool, request, NULL);
+  else
+    mex_image_loader_decode (request, NULL);
+
+  return request;
+}
+
+/**
+ * mex_image_loader_load_file:
+ * @path: the file to load
+ * @width: width the image is displayed at, or -1
+ * @height: height the image is displayed at, or -1
+ * @callback: called from the main loop once the image is decoded
+ * @user_data: data to pass to @callback
+ *
+ * Decodes the image at @path in a thread, scaling it down to the smallest
+ * size covering @width x @height, and adds it to the texture cache under
+ * @path. Unless the request is cancelled, @callback is called exactly once,
+ * with either the texture or an error.
+ *
+ * Return value: a request that can be passed to mex_image_loader_cancel()
+ *   until @callback is called
+ */
+MexImageRequest *
+mex_image_loader_load_file (const gchar            *path,
+                            gint                    width,
+                            gint                    height,
+                            MexImageLoaderCallback  callback,
+                            gpointer                user_data)
+{
+  MexImageRequest *request;
+
+  g_return_val_if_fail (path != NULL, NULL);
+  g_return_val_if_fail (callback != NULL, NULL);
+
+  request = g_slice_new0 (MexImageRequest);
+  request->uri = g_strdup (path);
+  request->path = g_strdup (path);
+  request->width = width;
+  request->height = height;
+  request->callback = callback;
+  request->user_data = user_data;
+
+  return mex_image_loader_push (request);
+}
+
+/**
+ * mex_image_loader_load_bytes:
+ * @uri: where @bytes come from, used as key in the texture cache
+ * @bytes: the encoded image
+ * @width: width the image is displayed at, or -1
+ * @height: height the image is displayed at, or -1
+ * @callback: called from the main loop once the image is decoded
+ * @user_data: data to pass to @callback
+ *
+ * Same as mex_image_loader_load_file() for an image already in memory,
+ * typically handed out by the #MexDownloadQueue. A reference is kept on
+ * @bytes until it's decoded.
+ *
+ * Return value: a request that can be passed to mex_image_loader_cancel()
+ *   until @callback is called
+ */
+MexImageRequest *
+mex_image_loader_load_bytes (const gchar            *uri,
+                             GBytes                 *bytes,
+                             gint                    width,
+                             gint                    height,
+                             MexImageLoaderCallback  callback,
+                             gpointer                user_data)
+{
+  MexImageRequest *request;
+
+  g_return_val_if_fail (uri != NULL, NULL);
+  g_return_val_if_fail (bytes != NULL, NULL);
+  g_return_val_if_fail (callback != NULL, NULL);
+
+  request = g_slice_new0 (MexImageRequest);
+  request->uri = g_strdup (uri);
+  request->bytes = g_bytes_ref (bytes);
+  request->width = width;
+  request->height = height;
+  request->callback = callback;
+  request->user_data = user_data;
+
+  return mex_image_loader_push (request);
+}
+
+/**
+ * mex_image_loader_cancel:
+ * @request: a pending request
+ *
+ * Makes sure the callback of @request isn't called. If it hasn't been
+ * picked up by a thread yet, the image won't be decoded at all.
+ */
+void
+mex_image_loader_cancel (MexImageRequest *request)
+{
+  g_return_if_fail (request != NULL);
+
+  g_atomic_int_set (&request->cancelled, TRUE);
+}
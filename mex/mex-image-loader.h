@@ -0,0 +1,47 @@
+/*
+ * Mex - a media explorer
+ *
+ * Copyright © 2010, 2011 Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses>
+ */
+
+#ifndef __MEX_IMAGE_LOADER_H__
+#define __MEX_IMAGE_LOADER_H__
+
+#include <clutter/clutter.h>
+
+G_BEGIN_DECLS
+
+typedef struct _MexImageRequest MexImageRequest;
+
+typedef void (*MexImageLoaderCallback) (CoglHandle    texture,
+                                        const GError *error,
+                                        gpointer      user_data);
+
+MexImageRequest *mex_image_loader_load_file  (const gchar            *path,
+                                              gint                    width,
+                                              gint                    height,
+                                              MexImageLoaderCallback  callback,
+                                              gpointer                user_data);
+MexImageRequest *mex_image_loader_load_bytes (const gchar            *uri,
+                                              GBytes                 *bytes,
+                                              gint                    width,
+                                              gint                    height,
+                                              MexImageLoaderCallback  callback,
+                                              gpointer                user_data);
+void mex_image_loader_cancel (MexImageRequest *request);
+
+G_END_DECLS
+
+#endif /* __MEX_IMAGE_LOADER_H__ */
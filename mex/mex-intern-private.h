@@ -0,0 +1,43 @@
+/*
+ * Mex - a media explorer
+ *
+ * Copyright © 2010, 2011 Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses>
+ */
+
+#ifndef __MEX_INTERN_PRIVATE_H__
+#define __MEX_INTERN_PRIVATE_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _MexInternStats MexInternStats;
+
+struct _MexInternStats
+{
+  guint n_strings;
+  guint n_refs;
+  gsize size;
+  gsize refs_size;
+};
+
+const gchar *mex_intern_string    (const gchar    *string);
+void         mex_intern_release   (const gchar    *string);
+
+void         mex_intern_get_stats (MexInternStats *stats);
+
+G_END_DECLS
+
+#endif /* __MEX_INTERN_PRIVATE_H__ */
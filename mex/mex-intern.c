@@ -0,0 +1,155 @@
+/*
+ * Mex - a media explorer
+ *
+ * Copyright © 2010, 2011 Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses>
+ */
+
+
+/*
+ * Refcounted string interner. Metadata values like mime types, artists,
+ * albums or the directory part of thumbnail URIs are the same across
+ * thousands of contents, so they are only stored once and shared.
+ *
+ * Unlike g_intern_string(), strings are released once the last user goes
+ * away, as most values (titles, URLs) are unique and would otherwise stay
+ * around forever.
+ */
+
+#include <string.h>
+
+#include "mex-intern-private.h"
+
+typedef struct
+{
+  guint ref_count;
+  guint length;
+  gchar string[1];
+} InternedString;
+
+#define INTERNED_STRING(s) \
+  ((InternedString *) ((s) - G_STRUCT_OFFSET (InternedString, string)))
+
+G_LOCK_DEFINE_STATIC (intern);
+static GHashTable *intern_table = NULL;
+static guint intern_n_refs = 0;
+static gsize intern_size = 0;
+static gsize intern_refs_size = 0;
+
+/**
+ * mex_intern_string:
+ * @string: (allow-none): a string
+ *
+ * Returns the canonical copy of @string, adding a reference to it.
+ *
+ * Return value: a string that is valid until released with
+ *   mex_intern_release()
+ */
+const gchar *
+mex_intern_string (const gchar *string)
+{
+  InternedString *interned;
+  guint length;
+
+  if (string == NULL)
+    return NULL;
+
+  G_LOCK (intern);
+
+  if (G_UNLIKELY (intern_table == NULL))
+    intern_table = g_hash_table_new (g_str_hash, g_str_equal);
+
+  interned = g_hash_table_lookup (intern_table, string);
+  if (interned)
+    {
+      interned->ref_count++;
+    }
+  else
+    {
+      length = strlen (string);
+
+      interned = g_malloc (G_STRUCT_OFFSET (InternedString, string) +
+                           length + 1);
+      interned->ref_count = 1;
+      interned->length = length;
+      memcpy (interned->string, string, length + 1);
+
+      g_hash_table_insert (intern_table, interned->string, interned);
+      intern_size += length + 1;
+    }
+
+  intern_n_refs++;
+  intern_refs_size += interned->length + 1;
+
+  G_UNLOCK (intern);
+
+  return interned->string;
+}
+
+/**
+ * mex_intern_release:
+ * @string: (allow-none): a string returned by mex_intern_string()
+ *
+ * Drops a reference on @string, freeing it once unused.
+ */
+void
+mex_intern_release (const gchar *string)
+{
+  InternedString *interned;
+
+  if (string == NULL)
+    return;
+
+  interned = INTERNED_STRING (string);
+
+  G_LOCK (intern);
+
+  intern_n_refs--;
+  intern_refs_size -= interned->length + 1;
+
+  if (--interned->ref_count == 0)
+    {
+      g_hash_table_remove (intern_table, interned->string);
+      intern_size -= interned->length + 1;
+      g_free (interned);
+    }
+
+  G_UNLOCK (intern);
+}
+
+/**
+ * mex_intern_get_stats:
+ * @stats: (out): return location for the counters
+ *
+ * Fills @stats with the number of distinct strings, the number of
+ * references on them, the bytes they take and the bytes they would take if
+ * each reference had its own copy.
+ */
+void
+mex_intern_get_stats (MexInternStats *stats)
+{
+  g_return_if_fail (stats != NULL);
+
+  G_LOCK (intern);
+
+  stats->n_strings = intern_table ? g_hash_table_size (intern_table) : 0;
+  stats->n_refs = intern_n_refs;
+  /* Count the header of each string and its slot in the table */
+  stats->size = intern_size + stats->n_strings *
+    (G_STRUCT_OFFSET (InternedString, string) +
+     2 * sizeof (gpointer) + sizeof (guint));
+  stats->refs_size = intern_refs_size;
+
+  G_UNLOCK (intern);
+}
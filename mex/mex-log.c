@@ -330,6 +330,7 @@ _mex_log_init_core_domains (void)
   DOMAIN_INIT (download_queue_log_domain, "download-queue");
   DOMAIN_INIT (surface_player_log_domain, "surface-player");
   DOMAIN_INIT (player_log_domain, "player");
+  DOMAIN_INIT (plugin_manager_log_domain, "plugin-manager");
 
   /* Retrieve the MEX_DEBUG environment variable, initialize core domains from
    * it if applicable and keep it for mex_log_domain_new(). Plugins are using
@@ -361,6 +362,7 @@ _mex_log_free_core_domains (void)
   DOMAIN_FREE (applet_manager_log_domain);
   DOMAIN_FREE (channel_log_domain);
   DOMAIN_FREE (download_queue_log_domain);
+  DOMAIN_FREE (plugin_manager_log_domain);
 
   g_strfreev (mex_log_env);
 }
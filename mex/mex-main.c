@@ -34,6 +34,7 @@
 #include "mex-log-private.h"
 #include "mex-model-manager.h"
 #include "mex-grilo.h"
+#include "mex-metadata-journal.h"
 #include "mex-vt-manager.h"
 
 /* Default Categories */
@@ -316,6 +317,7 @@ mex_init (int    *argc,
 void
 mex_deinit (void)
 {
+  mex_metadata_journal_flush ();
   mex_set_main_window (NULL);
   mex_vt_manager_deinit ();
 }
@@ -0,0 +1,203 @@
+/*
+ * Mex - a media explorer
+ *
+ * Copyright © 2010, 2011 Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses>
+ */
+
+
+/*
+ * Write-behind journal for content metadata. Saving metadata can be an
+ * expensive operation (a Tracker update for Grilo content), and it happens
+ * every time the slide show moves to another photo or the player switches
+ * media. Contents are collected here and saved together a little later,
+ * a few at a time from idle, so that flicking through a whole album doesn't
+ * queue one store operation per photo in the middle of the animations.
+ *
+ * Implementations of save_metadata() are expected to only write the keys
+ * that changed since the last save. The ones saving asynchronously tell
+ * the journal about their writes, so that flushing it on shutdown can wait
+ * for them. Only used from the main thread.
+ */
+
+#include "mex-metadata-journal.h"
+#include "mex-log.h"
+#include "mex-private.h"
+
+/* How long contents stay in the journal before being saved, and how many of
+ * them are saved per main loop iteration */
+#define FLUSH_DELAY 2
+#define FLUSH_BATCH 8
+
+/* How long a flush waits for the outstanding writes, in seconds */
+#define FLUSH_TIMEOUT 5
+
+static GQueue journal = G_QUEUE_INIT;
+static GHashTable *journal_contents = NULL;
+static guint journal_timeout_id = 0;
+static guint journal_idle_id = 0;
+static guint journal_n_writes = 0;
+
+static void
+mex_metadata_journal_save_one (void)
+{
+  MexContent *content = g_queue_pop_head (&journal);
+
+  g_hash_table_remove (journal_contents, content);
+
+  mex_content_save_metadata (content);
+  g_object_unref (content);
+}
+
+static gboolean
+mex_metadata_journal_idle_cb (gpointer data)
+{
+  gint i;
+
+  for (i = 0; i < FLUSH_BATCH && !g_queue_is_empty (&journal); i++)
+    mex_metadata_journal_save_one ();
+
+  if (!g_queue_is_empty (&journal))
+    return TRUE;
+
+  journal_idle_id = 0;
+
+  return FALSE;
+}
+
+static gboolean
+mex_metadata_journal_timeout_cb (gpointer data)
+{
+  journal_timeout_id = 0;
+
+  MEX_DEBUG ("metadata journal: saving %u contents",
+             g_queue_get_length (&journal));
+
+  if (!journal_idle_id)
+    journal_idle_id = g_idle_add_full (G_PRIORITY_LOW,
+                                       mex_metadata_journal_idle_cb,
+                                       NULL, NULL);
+
+  return FALSE;
+}
+
+/**
+ * mex_metadata_journal_add:
+ * @content: a #MexContent whose metadata changed
+ *
+ * Schedules saving the metadata of @content, as mex_content_save_metadata()
+ * would. Adding a content that's already waiting to be saved only saves it
+ * once, with all the changes made in the meantime. A reference is kept on
+ * @content until it's saved.
+ */
+void
+mex_metadata_journal_add (MexContent *content)
+{
+  g_return_if_fail (MEX_IS_CONTENT (content));
+
+  if (G_UNLIKELY (journal_contents == NULL))
+    journal_contents = g_hash_table_new (NULL, NULL);
+
+  if (g_hash_table_lookup (journal_contents, content))
+    return;
+
+  g_hash_table_insert (journal_contents, content, content);
+  g_queue_push_tail (&journal, g_object_ref (content));
+
+  if (!journal_timeout_id && !journal_idle_id)
+    journal_timeout_id = g_timeout_add_seconds (FLUSH_DELAY,
+                                                mex_metadata_journal_timeout_cb,
+                                                NULL);
+}
+
+void
+_mex_metadata_journal_write_started (void)
+{
+  journal_n_writes++;
+}
+
+void
+_mex_metadata_journal_write_finished (void)
+{
+  g_return_if_fail (journal_n_writes > 0);
+
+  journal_n_writes--;
+}
+
+static gboolean
+mex_metadata_journal_flush_timeout_cb (gpointer data)
+{
+  gboolean *timed_out = data;
+
+  *timed_out = TRUE;
+
+  return FALSE;
+}
+
+/**
+ * mex_metadata_journal_flush:
+ *
+ * Saves the metadata of all the contents in the journal straight away, and
+ * iterates the default main context until the asynchronous writes are
+ * done, or for a few seconds at most. Call it before quitting, so that
+ * nothing is lost on shutdown.
+ */
+void
+mex_metadata_journal_flush (void)
+{
+  gboolean timed_out = FALSE;
+  guint timeout_id;
+
+  if (journal_timeout_id)
+    {
+      g_source_remove (journal_timeout_id);
+      journal_timeout_id = 0;
+    }
+
+  if (journal_idle_id)
+    {
+      g_source_remove (journal_idle_id);
+      journal_idle_id = 0;
+    }
+
+  while (!g_queue_is_empty (&journal))
+    mex_metadata_journal_save_one ();
+
+  if (journal_n_writes == 0)
+    return;
+
+  timeout_id = g_timeout_add_seconds (FLUSH_TIMEOUT,
+                                      mex_metadata_journal_flush_timeout_cb,
+                                      &timed_out);
+
+  while (journal_n_writes > 0 && !timed_out)
+    g_main_context_iteration (NULL, TRUE);
+
+  if (timed_out)
+    MEX_WARNING ("metadata journal: gave up waiting for %u writes",
+                 journal_n_writes);
+  else
+    g_source_remove (timeout_id);
+}
+
+/**
+ * mex_metadata_journal_get_n_pending:
+ *
+ * Return value: the number of contents waiting to be saved
+ */
+guint
+mex_metadata_journal_get_n_pending (void)
+{
+  return g_queue_get_length (&journal);
+}
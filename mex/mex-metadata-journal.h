@@ -0,0 +1,34 @@
+/*
+ * Mex - a media explorer
+ *
+ * Copyright © 2010, 2011 Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses>
+ */
+
+
+#ifndef __MEX_METADATA_JOURNAL_H__
+#define __MEX_METADATA_JOURNAL_H__
+
+#include <mex/mex-content.h>
+
+G_BEGIN_DECLS
+
+void  mex_metadata_journal_add   (MexContent *content);
+void  mex_metadata_journal_flush (void);
+
+guint mex_metadata_journal_get_n_pending (void);
+
+G_END_DECLS
+
+#endif /* __MEX_METADATA_JOURNAL_H__ */
@@ -34,6 +34,7 @@
 enum
 {
   PRESENT_MODEL,
+  MODEL_ADDED,
 
   LAST_SIGNAL
 };
@@ -60,6 +61,16 @@ mex_model_provider_default_init (MexModelProviderInterface *klass)
                       NULL, NULL,
                       g_cclosure_marshal_VOID__POINTER,
                       G_TYPE_NONE, 1, G_TYPE_POINTER);
+
+      signals[MODEL_ADDED] =
+        g_signal_new ("model-added",
+                      G_TYPE_FROM_INTERFACE (klass),
+                      G_SIGNAL_RUN_LAST,
+                      G_STRUCT_OFFSET (MexModelProviderInterface,
+                                       model_added),
+                      NULL, NULL,
+                      g_cclosure_marshal_VOID__POINTER,
+                      G_TYPE_NONE, 1, G_TYPE_POINTER);
     }
 }
 
@@ -114,3 +125,23 @@ mex_model_provider_present_model (MexModelProvider *provider,
 
   g_signal_emit (provider, signals[PRESENT_MODEL], 0, model);
 }
+
+/**
+ * mex_model_provider_model_added:
+ * @provider: a #MexModelProvider
+ * @model: a model that has just been added to the models of @provider
+ *
+ * Providers that can't build all their models up front, typically because
+ * that requires asynchronous I/O, add the others to the list returned by
+ * mex_model_provider_get_models() as they become available and let the
+ * application know with this function.
+ */
+void
+mex_model_provider_model_added (MexModelProvider *provider,
+                                MexModel         *model)
+{
+  g_return_if_fail (MEX_IS_MODEL_PROVIDER (provider));
+  g_return_if_fail (MEX_IS_MODEL (model));
+
+  g_signal_emit (provider, signals[MODEL_ADDED], 0, model);
+}
@@ -64,6 +64,8 @@ struct _MexModelProviderInterface
   /* signals */
   void (* present_model)        (MexModelProvider *provider,
                                  MexModel         *model);
+  void (* model_added)          (MexModelProvider *provider,
+                                 MexModel         *model);
 };
 
 GType   mex_model_provider_get_type       (void) G_GNUC_CONST;
@@ -76,6 +78,9 @@ gboolean mex_model_provider_model_activated (MexModelProvider *provider,
 void mex_model_provider_present_model (MexModelProvider *provider,
                                        MexModel         *model);
 
+void mex_model_provider_model_added (MexModelProvider *provider,
+                                     MexModel         *model);
+
 G_END_DECLS
 
 #endif /* __MEX_MODEL_PROVIDER_H__ */
@@ -405,6 +405,31 @@ mex_model_get_model (MexModel *model)
   return NULL;
 }
 
+/**
+ * mex_model_set_visible_range:
+ * @model: the model
+ * @first: index of the first item shown
+ * @last: index of the last item shown
+ *
+ * Lets @model know which of its items a view is showing, so that models
+ * loading their content on demand can fetch more of it as the view gets
+ * close to the end. This is only a hint, models are free to ignore it.
+ */
+void
+mex_model_set_visible_range (MexModel *model,
+                             guint     first,
+                             guint     last)
+{
+  MexModelIface *iface;
+
+  g_return_if_fail (MEX_IS_MODEL (model));
+
+  iface = MEX_MODEL_GET_IFACE (model);
+
+  if (iface->set_visible_range)
+    iface->set_visible_range (model, first, last);
+}
+
 /**
  * mex_model_to_string :
  * @model: the model
@@ -65,6 +65,10 @@ struct _MexModelIface
   gint  (*index)      (MexModel *model, MexContent *content);
 
   MexModel *(*get_model) (MexModel *model);
+
+  void (*set_visible_range) (MexModel *model,
+                             guint     first,
+                             guint     last);
 };
 
 GType         mex_model_get_type         (void) G_GNUC_CONST;
@@ -88,6 +92,10 @@ gint  mex_model_index      (MexModel   *model,
                             MexContent *content);
 
 MexModel *mex_model_get_model (MexModel *model);
+
+void mex_model_set_visible_range (MexModel *model,
+                                  guint     first,
+                                  guint     last);
 gchar * mex_model_to_string (MexModel          *model,
                              MexDebugVerbosity  verbosity);
 
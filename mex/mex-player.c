@@ -49,6 +49,7 @@
 #include "mex-media-controls.h"
 #include "mex-screensaver.h"
 #include "mex-log.h"
+#include "mex-metadata-journal.h"
 #include "mex-utils.h"
 
 #define MEX_LOG_DOMAIN_DEFAULT  player_log_domain
@@ -667,7 +668,7 @@ save_old_content (MexPlayer *player)
   }
 
   mex_content_set_last_used_metadatas (priv->content);
-  mex_content_save_metadata (priv->content);
+  mex_metadata_journal_add (priv->content);
 }
 
 static void
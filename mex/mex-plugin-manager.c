@@ -19,11 +19,33 @@
 #include <string.h>
 #include <stdlib.h>
 
+#include <glib/gstdio.h>
 #include <gmodule.h>
 
+#include "mex-log.h"
 #include "mex-marshal.h"
+#include "mex-model-provider.h"
+#include "mex-os.h"
 #include "mex-plugin.h"
 #include "mex-plugin-manager.h"
+#include "mex-trace.h"
+
+#define MEX_LOG_DOMAIN_DEFAULT  plugin_manager_log_domain
+MEX_LOG_DOMAIN(plugin_manager_log_domain);
+
+/*
+ * Plugins are described in a manifest kept in the user's cache directory:
+ * one group per plugin file with its mtime, name, priority and the
+ * interfaces its type implements. Plugins that are in the manifest and
+ * aren't part of the base UI (priority MEX_PLUGIN_PRIORITY_NORMAL and
+ * above, except for the model providers whose content the home screen
+ * shows) aren't opened by mex_plugin_manager_refresh(). Their modules are
+ * opened on a pool of threads instead and the plugins are instantiated
+ * from the main loop, one at a time and in priority order, unless someone
+ * asks for one of their interfaces with mex_plugin_manager_require() first.
+ */
+
+#define MANIFEST_VERSION 1
 
 G_DEFINE_TYPE (MexPluginManager, mex_plugin_manager, G_TYPE_OBJECT)
 
@@ -46,11 +68,60 @@ enum
   LAST_SIGNAL
 };
 
+typedef enum
+{
+  ENTRY_DEFERRED,
+  ENTRY_OPENED,
+  ENTRY_LOADED,
+  ENTRY_FAILED
+} MexPluginEntryState;
+
+typedef struct
+{
+  MexPluginManager     *manager;
+  MexPluginEntryState   state;
+
+  gchar                *filename;
+  gchar                *name;
+  gint64                mtime;
+  gint                  priority;
+  gchar               **capabilities;
+  gboolean              cached;
+  gboolean              deferred;
+
+  GModule              *module;
+  MexPluginDescription *desc;
+
+  /* Written by the pool, read from the main thread once preloaded is set */
+  GModule              *preload_module;
+  gint64                preload_time;
+  gboolean              preloading;
+  gboolean              preloaded;
+
+  /* Timeline, in microseconds */
+  gint64                open_time;
+  gint64                type_time;
+  gint64                init_time;
+  gint64                ready_time;
+} MexPluginEntry;
+
 struct _MexPluginManagerPrivate
 {
   gchar      **search_paths;
-  GList       *descriptions;
+  GList       *entries;
+  GHashTable  *files;
+  GHashTable  *opened;
   GHashTable  *plugins;
+
+  GKeyFile    *manifest;
+  gchar       *manifest_path;
+  guint        manifest_dirty : 1;
+  guint        reported       : 1;
+
+  GList       *deferred;
+  GThreadPool *pool;
+  guint        load_source;
+  gint64       refresh_time;
 };
 
 static guint signals[LAST_SIGNAL] = { 0, };
@@ -141,6 +212,12 @@ mex_plugin_manager_dispose (GObject *object)
 {
   MexPluginManagerPrivate *priv = MEX_PLUGIN_MANAGER (object)->priv;
 
+  if (priv->load_source)
+    {
+      g_source_remove (priv->load_source);
+      priv->load_source = 0;
+    }
+
   if (priv->plugins)
     {
       g_hash_table_unref (priv->plugins);
@@ -150,11 +227,33 @@ mex_plugin_manager_dispose (GObject *object)
   G_OBJECT_CLASS (mex_plugin_manager_parent_class)->dispose (object);
 }
 
+static void
+mex_plugin_entry_free (MexPluginEntry *entry)
+{
+  g_free (entry->filename);
+  g_free (entry->name);
+  g_strfreev (entry->capabilities);
+  g_slice_free (MexPluginEntry, entry);
+}
+
 static void
 mex_plugin_manager_finalize (GObject *object)
 {
   MexPluginManagerPrivate *priv = MEX_PLUGIN_MANAGER (object)->priv;
 
+  /* Each preload holds a reference on the manager, the pool is idle */
+  if (priv->pool)
+    g_thread_pool_free (priv->pool, TRUE, FALSE);
+
+  g_list_free (priv->deferred);
+  g_hash_table_unref (priv->opened);
+  g_hash_table_unref (priv->files);
+  g_list_free_full (priv->entries, (GDestroyNotify) mex_plugin_entry_free);
+
+  if (priv->manifest)
+    g_key_file_free (priv->manifest);
+  g_free (priv->manifest_path);
+
   g_strfreev (priv->search_paths);
 
   G_OBJECT_CLASS (mex_plugin_manager_parent_class)->finalize (object);
@@ -164,73 +263,485 @@ static gint
 sort_by_prority (gconstpointer ap,
                  gconstpointer bp)
 {
-  const MexPluginDescription *a = ap;
-  const MexPluginDescription *b = bp;
+  const MexPluginEntry *a = ap;
+  const MexPluginEntry *b = bp;
 
   return a->priority - b->priority;
 }
 
+static gboolean
+mex_plugin_entry_has_capability (MexPluginEntry *entry,
+                                 GType           capability)
+{
+  const gchar *name = g_type_name (capability);
+  gint i;
+
+  for (i = 0; entry->capabilities[i]; i++)
+    if (g_str_equal (entry->capabilities[i], name))
+      return TRUE;
+
+  return FALSE;
+}
+
+/*
+ * Manifest
+ */
+
 static void
-mex_plugin_manager_open_plugin (MexPluginManager *manager,
-                                const gchar      *filename)
+mex_plugin_manager_load_manifest (MexPluginManager *manager)
 {
-  GModule *module;
-  gpointer symbol;
-  MexPluginDescription *plugin_info;
-  GType plugin_type;
-  gchar *plugin_name;
-  gchar *plugin_suffix;
+  MexPluginManagerPrivate *priv = manager->priv;
+
+  priv->manifest = g_key_file_new ();
+  priv->manifest_path = g_build_filename (g_get_user_cache_dir (), "mex",
+                                          "plugins.manifest", NULL);
+
+  if (g_key_file_load_from_file (priv->manifest, priv->manifest_path,
+                                 G_KEY_FILE_NONE, NULL) &&
+      g_key_file_get_integer (priv->manifest, "manifest", "version",
+                              NULL) == MANIFEST_VERSION)
+    return;
+
+  g_key_file_free (priv->manifest);
+  priv->manifest = g_key_file_new ();
+  g_key_file_set_integer (priv->manifest, "manifest", "version",
+                          MANIFEST_VERSION);
+  priv->manifest_dirty = TRUE;
+}
+
+static gboolean
+mex_plugin_manager_read_manifest (MexPluginManager *manager,
+                                  MexPluginEntry   *entry)
+{
+  GKeyFile *manifest = manager->priv->manifest;
+  const gchar *group = entry->filename;
+  GError *error = NULL;
+  gint64 mtime;
+  gint priority;
+
+  if (!g_key_file_has_group (manifest, group))
+    return FALSE;
+
+  /* The plugin has been rebuilt or reinstalled since */
+  mtime = g_key_file_get_int64 (manifest, group, "mtime", &error);
+  if (error || mtime != entry->mtime)
+    {
+      g_clear_error (&error);
+      return FALSE;
+    }
+
+  priority = g_key_file_get_integer (manifest, group, "priority", &error);
+  if (error)
+    {
+      g_clear_error (&error);
+      return FALSE;
+    }
 
+  entry->priority = priority;
+  entry->capabilities = g_key_file_get_string_list (manifest, group,
+                                                    "capabilities",
+                                                    NULL, NULL);
+  if (!entry->capabilities)
+    entry->capabilities = g_new0 (gchar *, 1);
+
+  return TRUE;
+}
+
+static void
+mex_plugin_manager_update_manifest (MexPluginManager *manager,
+                                    MexPluginEntry   *entry,
+                                    GType             plugin_type)
+{
   MexPluginManagerPrivate *priv = manager->priv;
+  const gchar *group = entry->filename;
+  GType *interfaces;
+  guint i, n_interfaces;
+
+  /* What the plugin can provide, so that it can be found by
+   * mex_plugin_manager_require() without opening it */
+  interfaces = g_type_interfaces (plugin_type, &n_interfaces);
+  g_strfreev (entry->capabilities);
+  entry->capabilities = g_new0 (gchar *, n_interfaces + 1);
+  for (i = 0; i < n_interfaces; i++)
+    entry->capabilities[i] = g_strdup (g_type_name (interfaces[i]));
+  g_free (interfaces);
+
+  entry->priority = entry->desc->priority;
+
+  if (entry->cached)
+    return;
+
+  g_key_file_set_int64 (priv->manifest, group, "mtime", entry->mtime);
+  g_key_file_set_string (priv->manifest, group, "name", entry->name);
+  g_key_file_set_integer (priv->manifest, group, "priority", entry->priority);
+  g_key_file_set_string_list (priv->manifest, group, "capabilities",
+                              (const gchar * const *) entry->capabilities,
+                              n_interfaces);
+
+  priv->manifest_dirty = TRUE;
+}
 
-  /* Extract the plugin name */
-  plugin_name = g_path_get_basename (filename);
-  if ((plugin_suffix = g_strrstr (plugin_name, ".")))
-    *plugin_suffix = '\0';
+static void
+mex_plugin_manager_save_manifest (MexPluginManager *manager)
+{
+  MexPluginManagerPrivate *priv = manager->priv;
+  gchar **groups, *data, *dirname;
+  GError *error = NULL;
+  gsize length;
+  gint i, j;
+
+  /* Forget about the plugins that went away from our search paths */
+  groups = g_key_file_get_groups (priv->manifest, NULL);
+  for (i = 0; groups[i]; i++)
+    {
+      if (g_hash_table_lookup (priv->files, groups[i]))
+        continue;
+
+      dirname = g_path_get_dirname (groups[i]);
+      for (j = 0; priv->search_paths[j]; j++)
+        if (g_str_equal (dirname, priv->search_paths[j]))
+          {
+            g_key_file_remove_group (priv->manifest, groups[i], NULL);
+            priv->manifest_dirty = TRUE;
+            break;
+          }
+      g_free (dirname);
+    }
+  g_strfreev (groups);
+
+  if (!priv->manifest_dirty)
+    return;
 
-  module = g_module_open (filename, G_MODULE_BIND_LOCAL);
-  if (!module)
+  dirname = g_path_get_dirname (priv->manifest_path);
+  g_mkdir_with_parents (dirname, 0755);
+  g_free (dirname);
+
+  data = g_key_file_to_data (priv->manifest, &length, NULL);
+  if (g_file_set_contents (priv->manifest_path, data, length, &error))
+    priv->manifest_dirty = FALSE;
+  else
     {
-      g_warning (G_STRLOC ": Error opening module: %s",
-                 g_module_error ());
-      g_free (plugin_name);
-      return;
+      MEX_WARNING ("Couldn't write the plugin manifest: %s", error->message);
+      g_clear_error (&error);
+    }
+  g_free (data);
+}
+
+/*
+ * Loading
+ */
+
+static gboolean
+mex_plugin_manager_open_entry (MexPluginManager *manager,
+                               MexPluginEntry   *entry)
+{
+  MexPluginManagerPrivate *priv = manager->priv;
+  MexPluginDescription *plugin_info;
+  GType plugin_type;
+  gpointer symbol;
+  gint64 start;
+
+  if (!entry->module)
+    {
+      start = g_get_monotonic_time ();
+      entry->module = g_module_open (entry->filename, G_MODULE_BIND_LOCAL);
+      entry->open_time = g_get_monotonic_time () - start;
+      mex_trace_end (start, "plugin %s: open", entry->name);
+
+      if (!entry->module)
+        {
+          g_warning (G_STRLOC ": Error opening module: %s",
+                     g_module_error ());
+          return FALSE;
+        }
     }
 
-  if (!g_module_symbol (module, "mex_plugin_info", &symbol))
+  if (!g_module_symbol (entry->module, "mex_plugin_info", &symbol))
     {
       g_warning (G_STRLOC ": Unable to get symbol 'mex_plugin_info': %s",
                  g_module_error ());
-      g_module_close (module);
-      g_free (plugin_name);
-      return;
+      goto fail;
     }
 
   plugin_info = (MexPluginDescription *) symbol;
   /* Check if plugin is already loaded */
-  if (g_hash_table_lookup (priv->plugins, plugin_info))
-    {
-      g_module_close (module);
-      g_free (plugin_name);
-      return;
-    }
+  if (g_hash_table_lookup (priv->opened, plugin_info))
+    goto fail;
 
+  start = g_get_monotonic_time ();
   plugin_type = plugin_info->get_type ();
+  entry->type_time = g_get_monotonic_time () - start;
+  mex_trace_end (start, "plugin %s: get_type", entry->name);
+
   if (!plugin_type)
     {
-      g_warning (G_STRLOC ": Plugin '%s' didn't return a type", plugin_name);
-      g_module_close (module);
-      g_free (plugin_name);
-      return;
+      g_warning (G_STRLOC ": Plugin '%s' didn't return a type", entry->name);
+      goto fail;
     }
 
-  g_free (plugin_name);
-
   /* Unloading modules usually has bad effects - don't allow it */
-  g_module_make_resident (module);
+  g_module_make_resident (entry->module);
+
+  entry->desc = plugin_info;
+  entry->state = ENTRY_OPENED;
+  g_hash_table_insert (priv->opened, plugin_info, entry);
+
+  mex_plugin_manager_update_manifest (manager, entry, plugin_type);
+
+  return TRUE;
+
+fail:
+  g_module_close (entry->module);
+  entry->module = NULL;
+
+  return FALSE;
+}
+
+static void
+mex_plugin_manager_load_entry (MexPluginManager *manager,
+                               MexPluginEntry   *entry)
+{
+  MexPluginManagerPrivate *priv = manager->priv;
+  GObject *plugin;
+  gint64 start;
+
+  start = g_get_monotonic_time ();
+  plugin = g_object_new (entry->desc->get_type (), NULL);
+  entry->init_time = g_get_monotonic_time () - start;
+  mex_trace_end (start, "plugin %s: constructor", entry->name);
+
+  entry->state = ENTRY_LOADED;
+  g_hash_table_insert (priv->plugins, entry->desc, plugin);
+
+  start = g_get_monotonic_time ();
+  g_signal_emit (manager, signals[PLUGIN_LOADED], 0, plugin);
+  mex_trace_end (start, "plugin %s: plugin-loaded", entry->name);
+
+  entry->ready_time = g_get_monotonic_time () - priv->refresh_time;
+}
+
+#define MS(t) ((t) / 1000.0)
+
+static void
+mex_plugin_manager_maybe_report (MexPluginManager *manager)
+{
+  MexPluginManagerPrivate *priv = manager->priv;
+  GList *l;
+
+  if (priv->reported || priv->deferred)
+    return;
+
+  priv->reported = TRUE;
+
+  if (!MEX_INFO_ENABLED)
+    return;
+
+  MEX_INFO ("plugins ready after %.1f ms",
+            MS (g_get_monotonic_time () - priv->refresh_time));
+
+  for (l = priv->entries; l; l = l->next)
+    {
+      MexPluginEntry *entry = l->data;
+
+      if (entry->state != ENTRY_LOADED)
+        {
+          MEX_INFO ("  %-20s not loaded", entry->name);
+          continue;
+        }
+
+      MEX_INFO ("  %-20s open %6.1f ms, type %5.1f ms, init %6.1f ms, "
+                "ready at %7.1f ms%s",
+                entry->name, MS (entry->open_time), MS (entry->type_time),
+                MS (entry->init_time), MS (entry->ready_time),
+                entry->deferred ? " (deferred)" : "");
+    }
+}
+
+#undef MS
+
+static void
+mex_plugin_manager_realize_entry (MexPluginManager *manager,
+                                  MexPluginEntry   *entry)
+{
+  MexPluginManagerPrivate *priv = manager->priv;
+
+  priv->deferred = g_list_remove (priv->deferred, entry);
+
+  /* Take over the handle opened by the pool, if it's done with it */
+  if (entry->preloaded && entry->preload_module)
+    {
+      entry->module = entry->preload_module;
+      entry->open_time = entry->preload_time;
+      entry->preload_module = NULL;
+    }
+
+  if (mex_plugin_manager_open_entry (manager, entry))
+    mex_plugin_manager_load_entry (manager, entry);
+  else
+    entry->state = ENTRY_FAILED;
+
+  mex_plugin_manager_maybe_report (manager);
+}
+
+/* Instantiates the deferred plugins one per main loop iteration, in
+ * priority order, as soon as their modules have been opened */
+static gboolean
+mex_plugin_manager_load_deferred_cb (MexPluginManager *manager)
+{
+  MexPluginManagerPrivate *priv = manager->priv;
+  MexPluginEntry *entry;
+
+  entry = priv->deferred ? priv->deferred->data : NULL;
+  if (!entry || !entry->preloaded)
+    {
+      priv->load_source = 0;
+      return FALSE;
+    }
+
+  mex_plugin_manager_realize_entry (manager, entry);
+
+  if (priv->deferred)
+    return TRUE;
+
+  priv->load_source = 0;
+  return FALSE;
+}
+
+static void
+mex_plugin_manager_schedule_load (MexPluginManager *manager)
+{
+  MexPluginManagerPrivate *priv = manager->priv;
+
+  if (priv->load_source || !priv->deferred)
+    return;
+
+  priv->load_source =
+    g_idle_add_full (G_PRIORITY_LOW,
+                     (GSourceFunc) mex_plugin_manager_load_deferred_cb,
+                     manager, NULL);
+}
+
+static gboolean
+mex_plugin_manager_preloaded_cb (gpointer data)
+{
+  MexPluginEntry *entry = data;
+  MexPluginManager *manager = entry->manager;
+
+  entry->preloading = FALSE;
+  entry->preloaded = TRUE;
+
+  /* The plugin was required in the meantime and opened its own handle */
+  if (entry->state != ENTRY_DEFERRED && entry->preload_module)
+    {
+      g_module_close (entry->preload_module);
+      entry->preload_module = NULL;
+    }
+
+  mex_plugin_manager_schedule_load (manager);
+  g_object_unref (manager);
+
+  return FALSE;
+}
+
+/* Opening a module means reading it, relocating it and pulling its own
+ * dependencies, which can be done away from the main thread */
+static void
+mex_plugin_manager_preload (gpointer data,
+                            gpointer user_data)
+{
+  MexPluginEntry *entry = data;
+  gint64 start;
+
+  start = g_get_monotonic_time ();
+  entry->preload_module = g_module_open (entry->filename, G_MODULE_BIND_LOCAL);
+  entry->preload_time = g_get_monotonic_time () - start;
+  mex_trace_end (start, "plugin %s: open", entry->name);
+
+  g_idle_add (mex_plugin_manager_preloaded_cb, entry);
+}
 
-  priv->descriptions = g_list_insert_sorted (priv->descriptions, plugin_info,
+static void
+mex_plugin_manager_preload_deferred (MexPluginManager *manager)
+{
+  MexPluginManagerPrivate *priv = manager->priv;
+  GError *error = NULL;
+  GList *l;
+
+  if (priv->deferred && G_UNLIKELY (priv->pool == NULL))
+    {
+      priv->pool = g_thread_pool_new (mex_plugin_manager_preload, NULL,
+                                      mex_os_get_n_cores (), FALSE, &error);
+      if (error)
+        {
+          g_warning (G_STRLOC ": %s", error->message);
+          g_clear_error (&error);
+        }
+    }
+
+  for (l = priv->deferred; l; l = l->next)
+    {
+      MexPluginEntry *entry = l->data;
+
+      if (entry->preloading || entry->preloaded)
+        continue;
+
+      /* Without threads, the modules are opened when instantiating */
+      if (!priv->pool)
+        {
+          entry->preloaded = TRUE;
+          continue;
+        }
+
+      entry->preloading = TRUE;
+      g_object_ref (manager);
+      g_thread_pool_push (priv->pool, entry, NULL);
+    }
+
+  mex_plugin_manager_schedule_load (manager);
+}
+
+static void
+mex_plugin_manager_add_file (MexPluginManager *manager,
+                             const gchar      *filename)
+{
+  MexPluginManagerPrivate *priv = manager->priv;
+  MexPluginEntry *entry;
+  gchar *plugin_suffix;
+  GStatBuf buf;
+
+  /* Already known */
+  if (g_hash_table_lookup (priv->files, filename))
+    return;
+
+  entry = g_slice_new0 (MexPluginEntry);
+  entry->manager = manager;
+  entry->filename = g_strdup (filename);
+
+  /* Extract the plugin name */
+  entry->name = g_path_get_basename (filename);
+  if ((plugin_suffix = g_strrstr (entry->name, ".")))
+    *plugin_suffix = '\0';
+
+  if (g_stat (filename, &buf) == 0)
+    entry->mtime = buf.st_mtime;
+
+  entry->cached = mex_plugin_manager_read_manifest (manager, entry);
+  g_hash_table_insert (priv->files, entry->filename, entry);
+
+  /* Model providers fill the home screen, so they are never deferred */
+  if (entry->cached && entry->priority >= MEX_PLUGIN_PRIORITY_NORMAL &&
+      !mex_plugin_entry_has_capability (entry, MEX_TYPE_MODEL_PROVIDER))
+    {
+      entry->deferred = TRUE;
+      entry->state = ENTRY_DEFERRED;
+      priv->deferred = g_list_insert_sorted (priv->deferred, entry,
                                              sort_by_prority);
+    }
+  else if (!mex_plugin_manager_open_entry (manager, entry))
+    entry->state = ENTRY_FAILED;
+
+  priv->entries = g_list_insert_sorted (priv->entries, entry,
+                                        sort_by_prority);
 }
 
 static void
@@ -270,6 +781,8 @@ mex_plugin_manager_init (MexPluginManager *self)
 
   priv->search_paths = build_plugin_search_paths ();
 
+  priv->files = g_hash_table_new (g_str_hash, g_str_equal);
+  priv->opened = g_hash_table_new (g_direct_hash, g_direct_equal);
   priv->plugins = g_hash_table_new (g_direct_hash, g_direct_equal);
 }
 
@@ -284,15 +797,32 @@ mex_plugin_manager_get_default (void)
   return manager;
 }
 
+/**
+ * mex_plugin_manager_refresh:
+ * @manager: a #MexPluginManager
+ *
+ * Looks for new plugins in the search paths. The plugins needed by the
+ * base UI or providing models, and the ones that aren't in the manifest
+ * yet, are loaded before this returns, the others are loaded from the main
+ * loop afterwards.
+ * #MexPluginManager::plugin-loaded is emitted for each of them.
+ */
 void
 mex_plugin_manager_refresh (MexPluginManager *manager)
 {
-  MexPluginManagerPrivate *priv = manager->priv;
+  MexPluginManagerPrivate *priv;
   GList *l;
   gint i;
 
   g_return_if_fail (MEX_IS_PLUGIN_MANAGER (manager));
 
+  priv = manager->priv;
+  priv->refresh_time = g_get_monotonic_time ();
+  priv->reported = FALSE;
+
+  if (!priv->manifest)
+    mex_plugin_manager_load_manifest (manager);
+
   for (i = 0; priv->search_paths[i]; i++)
     {
       GDir *dir;
@@ -330,29 +860,65 @@ mex_plugin_manager_refresh (MexPluginManager *manager)
         {
           gchar *full_file = files->data;
 
-          mex_plugin_manager_open_plugin (manager, full_file);
+          mex_plugin_manager_add_file (manager, full_file);
           g_free (full_file);
 
           files = g_list_delete_link (files, files);
         }
     }
 
-  /* in open_plugins() we inserted PluginDescriptions in prioriy order in
-   * priv->descriptions, time to load the plugins */
-  for (l = priv->descriptions; l; l = g_list_next (l))
+  /* in add_file() we inserted the entries in priority order in
+   * priv->entries, time to load the plugins that have been opened */
+  for (l = priv->entries; l; l = g_list_next (l))
     {
-      MexPluginDescription *desc = l->data;
-      GType plugin_type;
-      GObject *plugin;
+      MexPluginEntry *entry = l->data;
 
-      /* already loaded */
-      if (g_hash_table_lookup (priv->plugins, desc))
-        continue;
+      if (entry->state == ENTRY_OPENED)
+        mex_plugin_manager_load_entry (manager, entry);
+    }
+
+  mex_plugin_manager_save_manifest (manager);
+
+  mex_plugin_manager_preload_deferred (manager);
+  mex_plugin_manager_maybe_report (manager);
+}
+
+/**
+ * mex_plugin_manager_require:
+ * @manager: a #MexPluginManager
+ * @capability: an interface type, e.g. %MEX_TYPE_ACTION_PROVIDER
+ *
+ * Loads right away the plugins implementing @capability whose loading
+ * was deferred by mex_plugin_manager_refresh(), for code that needs all
+ * of them to be there.
+ */
+void
+mex_plugin_manager_require (MexPluginManager *manager,
+                            GType             capability)
+{
+  MexPluginManagerPrivate *priv;
+  GList *l;
+
+  g_return_if_fail (MEX_IS_PLUGIN_MANAGER (manager));
+  g_return_if_fail (G_TYPE_IS_INTERFACE (capability));
+
+  priv = manager->priv;
+
+  for (l = priv->deferred; l;)
+    {
+      MexPluginEntry *entry = l->data;
+
+      if (!mex_plugin_entry_has_capability (entry, capability))
+        {
+          l = l->next;
+          continue;
+        }
 
-      plugin_type = desc->get_type ();
-      plugin = g_object_new (plugin_type, NULL);
-      g_hash_table_insert (priv->plugins, desc, plugin);
+      MEX_DEBUG ("loading %s, required for %s", entry->name,
+                 g_type_name (capability));
 
-      g_signal_emit (manager, signals[PLUGIN_LOADED], 0, plugin);
+      /* Loading a plugin can change the list, start over */
+      mex_plugin_manager_realize_entry (manager, entry);
+      l = priv->deferred;
     }
 }
@@ -72,6 +72,8 @@ GType mex_plugin_manager_get_type (void) G_GNUC_CONST;
 MexPluginManager *mex_plugin_manager_get_default (void);
 
 void mex_plugin_manager_refresh (MexPluginManager *manager);
+void mex_plugin_manager_require (MexPluginManager *manager,
+                                 GType             capability);
 
 G_END_DECLS
 
@@ -43,6 +43,9 @@ gboolean mex_content_title_fallback_cb (GBinding     *binding,
                                         gpointer      user_data);
 void _mex_print_date (GDateTime *date);
 
+void _mex_metadata_journal_write_started  (void);
+void _mex_metadata_journal_write_finished (void);
+
 G_END_DECLS
 
 #endif /* __MEX_PRIVATE_H__ */
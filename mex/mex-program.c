@@ -32,6 +32,7 @@ enum {
 struct _MexProgramPrivate {
   GPtrArray *actors;
   MexFeed *feed;
+  guint visible_count;
 };
 
 #define GET_PRIVATE(obj) (G_TYPE_INSTANCE_GET_PRIVATE ((obj),           \
@@ -362,6 +363,33 @@ _mex_program_complete (MexProgram *program)
   }
 }
 
+/* Private function for views to tell the program whether they are showing
+   it. Calls must be balanced, the set_visible method is only called when
+   the first view appears and when the last one goes away */
+void
+_mex_program_set_visible (MexProgram *program,
+                          gboolean    visible)
+{
+  MexProgramClass *klass = MEX_PROGRAM_GET_CLASS (program);
+  MexProgramPrivate *priv = program->priv;
+
+  if (visible)
+    {
+      if (priv->visible_count++ > 0)
+        return;
+    }
+  else
+    {
+      g_return_if_fail (priv->visible_count > 0);
+
+      if (--priv->visible_count > 0)
+        return;
+    }
+
+  if (klass->set_visible)
+    klass->set_visible (program, visible);
+}
+
 gchar *
 mex_program_get_index_str (MexProgram *program)
 {
@@ -80,6 +80,8 @@ struct _MexProgramClass
   void (*get_stream) (MexProgram       *program,
                       MexGetStreamReply reply,
                       gpointer          userdata);
+  void (*set_visible) (MexProgram *program,
+                       gboolean    visible);
 };
 
 GType mex_program_get_type (void) G_GNUC_CONST;
@@ -99,6 +101,8 @@ gchar *mex_program_get_id (MexProgram *program);
 
 /* Private functions for internal Mex Classes to use */
 void _mex_program_complete (MexProgram *program);
+void _mex_program_set_visible (MexProgram *program,
+                               gboolean    visible);
 
 G_END_DECLS
 
@@ -25,6 +25,12 @@
  * in the model which are translated to GObjects (see mex_proxy_set_limit()),
  * and reorder the content in a model (by changing the start point from
  * which items are added: see mex_proxy_start_at()).
+ *
+ * Objects are not necessarily created as soon as content is added to the
+ * model. All proxies share a single scheduler that spreads object creation
+ * over several frames, fitting as much work as the measured frame time
+ * allows and serving proxies that are on screen (see
+ * mex_proxy_set_on_screen()) first.
  */
 
 #include "mex-proxy.h"
@@ -61,10 +67,41 @@ struct _MexProxyPrivate
 
   GQueue     *to_add;
   GHashTable *to_add_hash;
-  GTimer     *timer;
-  guint       timer_timeout;
+  GList      *scheduler_link;
+
+  gdouble     creation_cost;
+  guint       on_screen : 1;
 };
 
+/* Object creation is throttled globally: proxies with queued content sit
+ * in a single queue and one idle source creates objects for all of them,
+ * within a per-frame budget that adapts to the stage's frame time.
+ */
+typedef struct
+{
+  GQueue  *proxies;
+  guint    idle_id;
+  guint    repaint_id;
+
+  gint64   last_repaint;
+  gint64   frame_start;
+  gdouble  frame_interval;
+  gdouble  frame_used;
+  gdouble  budget;
+  gdouble  average_cost;
+
+  guint    queue_depth;
+  guint    created_this_frame;
+  guint    created_last_frame;
+} MexProxyScheduler;
+
+#define SCHEDULER_INITIAL_BUDGET  5.0
+#define SCHEDULER_MIN_BUDGET      1.0
+#define SCHEDULER_BUDGET_STEP     0.25
+#define SCHEDULER_COST_WEIGHT     0.2
+
+static MexProxyScheduler scheduler = { NULL, };
+
 static guint signals[LAST_SIGNAL] = { 0, };
 
 static void mex_proxy_object_gone_cb (MexProxy *proxy, GObject *object);
@@ -149,12 +186,6 @@ mex_proxy_dispose (GObject *object)
       priv->to_add_hash = NULL;
     }
 
-  if (priv->timer)
-    {
-      g_timer_destroy (priv->timer);
-      priv->timer = NULL;
-    }
-
   G_OBJECT_CLASS (mex_proxy_parent_class)->dispose (object);
 }
 
@@ -225,9 +256,9 @@ mex_proxy_init (MexProxy *self)
                            (GDestroyNotify)g_object_unref,
                            NULL);
 
-  priv->timer = g_timer_new ();
   priv->to_add = g_queue_new ();
   priv->to_add_hash = g_hash_table_new (NULL, NULL);
+  priv->on_screen = TRUE;
 }
 
 MexModel *
@@ -244,6 +275,51 @@ mex_proxy_get_object_type (MexProxy *proxy)
   return proxy->priv->object_type;
 }
 
+/**
+ * mex_proxy_set_on_screen:
+ * @proxy: a #MexProxy
+ * @on_screen: whether the objects created by @proxy are visible
+ *
+ * Hints the object creation scheduler that @proxy feeds a visible part of
+ * the user interface. Queued content of on-screen proxies is turned into
+ * objects before that of off-screen ones. Proxies are on screen by default.
+ */
+void
+mex_proxy_set_on_screen (MexProxy *proxy,
+                         gboolean  on_screen)
+{
+  g_return_if_fail (MEX_IS_PROXY (proxy));
+  proxy->priv->on_screen = !!on_screen;
+}
+
+gboolean
+mex_proxy_get_on_screen (MexProxy *proxy)
+{
+  g_return_val_if_fail (MEX_IS_PROXY (proxy), FALSE);
+  return proxy->priv->on_screen;
+}
+
+/**
+ * mex_proxy_get_stats:
+ * @stats: (out caller-allocates): a #MexProxyStats to fill
+ *
+ * Retrieves profiling counters of the object creation scheduler shared by
+ * all proxies.
+ */
+void
+mex_proxy_get_stats (MexProxyStats *stats)
+{
+  g_return_if_fail (stats != NULL);
+
+  stats->queue_depth = scheduler.queue_depth;
+  stats->created_this_frame = scheduler.created_this_frame;
+  stats->created_last_frame = scheduler.created_last_frame;
+  stats->budget = scheduler.proxies ?
+    scheduler.budget : SCHEDULER_INITIAL_BUDGET;
+  stats->average_cost = scheduler.average_cost;
+  stats->frame_interval = scheduler.frame_interval;
+}
+
 static void
 mex_proxy_object_gone_cb (MexProxy *proxy,
                           GObject  *object)
@@ -263,6 +339,92 @@ mex_proxy_object_gone_cb (MexProxy *proxy,
     }
 }
 
+static gdouble
+mex_proxy_scheduler_target_interval (void)
+{
+  guint rate = clutter_get_default_frame_rate ();
+
+  return 1000.0 / (rate ? rate : 60);
+}
+
+static void
+mex_proxy_scheduler_start_frame (gint64 now)
+{
+  scheduler.frame_start = now;
+  scheduler.frame_used = 0;
+  scheduler.created_last_frame = scheduler.created_this_frame;
+  scheduler.created_this_frame = 0;
+}
+
+static gboolean
+mex_proxy_scheduler_repaint_cb (gpointer data)
+{
+  gint64 now = g_get_monotonic_time ();
+  gdouble target = mex_proxy_scheduler_target_interval ();
+
+  if (scheduler.last_repaint)
+    {
+      gdouble interval = (now - scheduler.last_repaint) / 1000.0;
+
+      /* Long gaps just mean nothing needed painting, they don't tell us
+       * anything about how expensive our frames are. */
+      if (interval < target * 4)
+        {
+          scheduler.frame_interval = interval;
+
+          if (scheduler.created_this_frame && interval > target * 1.5)
+            scheduler.budget = MAX (scheduler.budget * 0.75,
+                                    SCHEDULER_MIN_BUDGET);
+          else if (interval <= target * 1.2)
+            scheduler.budget = MIN (scheduler.budget + SCHEDULER_BUDGET_STEP,
+                                    target / 2);
+        }
+    }
+
+  scheduler.last_repaint = now;
+  mex_proxy_scheduler_start_frame (now);
+
+  return TRUE;
+}
+
+static void
+mex_proxy_scheduler_ensure (void)
+{
+  if (scheduler.proxies)
+    return;
+
+  scheduler.proxies = g_queue_new ();
+  scheduler.budget = SCHEDULER_INITIAL_BUDGET;
+  scheduler.frame_interval = mex_proxy_scheduler_target_interval ();
+  scheduler.repaint_id =
+    clutter_threads_add_repaint_func (mex_proxy_scheduler_repaint_cb,
+                                      NULL, NULL);
+}
+
+/* Returns the time already spent in the current frame, starting a new
+ * frame if the stage hasn't repainted for a whole frame interval. */
+static gdouble
+mex_proxy_scheduler_get_used (gint64 now)
+{
+  if ((now - scheduler.frame_start) / 1000.0 >=
+      mex_proxy_scheduler_target_interval ())
+    mex_proxy_scheduler_start_frame (now);
+
+  return scheduler.frame_used;
+}
+
+static void
+mex_proxy_scheduler_remove (MexProxy *proxy)
+{
+  MexProxyPrivate *priv = proxy->priv;
+
+  if (!priv->scheduler_link)
+    return;
+
+  g_queue_delete_link (scheduler.proxies, priv->scheduler_link);
+  priv->scheduler_link = NULL;
+}
+
 static void
 mex_proxy_add_content_no_defer (MexProxy   *proxy,
                                 MexContent *content)
@@ -282,32 +444,101 @@ mex_proxy_add_content_no_defer (MexProxy   *proxy,
   g_object_unref (object);
 }
 
-static gboolean
-mex_proxy_stop_timer_cb (MexProxy *proxy)
+/* Creates the object for @content and feeds the time it took back into
+ * the scheduler. Returns the time spent, in milliseconds. */
+static gdouble
+mex_proxy_create_object (MexProxy   *proxy,
+                         MexContent *content)
 {
   MexProxyPrivate *priv = proxy->priv;
+  gint64 start;
+  gdouble cost;
+
+  start = g_get_monotonic_time ();
+  mex_proxy_add_content_no_defer (proxy, content);
+  cost = (g_get_monotonic_time () - start) / 1000.0;
+
+  priv->creation_cost = priv->creation_cost ?
+    priv->creation_cost + (cost - priv->creation_cost) * SCHEDULER_COST_WEIGHT :
+    cost;
+  scheduler.average_cost = scheduler.average_cost ?
+    scheduler.average_cost +
+    (cost - scheduler.average_cost) * SCHEDULER_COST_WEIGHT :
+    cost;
 
-  g_timer_start (priv->timer);
+  scheduler.frame_used += cost;
+  scheduler.created_this_frame++;
 
-  while (g_timer_elapsed (priv->timer, NULL) * 1000 < 5 &&
-         !g_queue_is_empty (priv->to_add))
+  return cost;
+}
+
+/* On-screen proxies are served before off-screen ones; within each group
+ * proxies take turns, one object at a time. */
+static GList *
+mex_proxy_scheduler_pick (void)
+{
+  GList *l;
+
+  for (l = scheduler.proxies->head; l; l = l->next)
     {
-      MexContent *content = g_queue_pop_head (priv->to_add);
+      MexProxy *proxy = l->data;
+
+      if (proxy->priv->on_screen)
+        return l;
+    }
+
+  return scheduler.proxies->head;
+}
+
+static gboolean
+mex_proxy_scheduler_dispatch_cb (gpointer data)
+{
+  gboolean created = FALSE;
+
+  while (!g_queue_is_empty (scheduler.proxies))
+    {
+      GList *link = mex_proxy_scheduler_pick ();
+      MexProxy *proxy = link->data;
+      MexProxyPrivate *priv = proxy->priv;
+      MexContent *content;
+      gdouble used;
+
+      /* Always make some progress, even if a single object costs more
+       * than the whole budget */
+      used = mex_proxy_scheduler_get_used (g_get_monotonic_time ());
+      if (created && used + priv->creation_cost > scheduler.budget)
+        break;
+
+      content = g_queue_pop_head (priv->to_add);
       g_hash_table_remove (priv->to_add_hash, content);
+      scheduler.queue_depth--;
+
+      /* Rotate before creating, object-created handlers may dispose the
+       * proxy or change its model */
+      g_queue_unlink (scheduler.proxies, link);
+      if (g_queue_is_empty (priv->to_add))
+        {
+          g_list_free (link);
+          priv->scheduler_link = NULL;
+        }
+      else
+        g_queue_push_tail_link (scheduler.proxies, link);
 
-      mex_proxy_add_content_no_defer (proxy, content);
+      g_object_ref (proxy);
+      mex_proxy_create_object (proxy, content);
       g_object_unref (content);
-    }
+      g_object_unref (proxy);
 
-  g_timer_stop (priv->timer);
+      created = TRUE;
+    }
 
-  if (g_queue_is_empty (priv->to_add))
+  if (g_queue_is_empty (scheduler.proxies))
     {
-      priv->timer_timeout = 0;
+      scheduler.idle_id = 0;
       return FALSE;
     }
-  else
-    return TRUE;
+
+  return TRUE;
 }
 
 static void
@@ -316,30 +547,36 @@ mex_proxy_add_content (MexProxy   *proxy,
 {
   MexProxyPrivate *priv = proxy->priv;
 
-  /* Start the timer or re-start its time-out */
-  if (!priv->timer_timeout)
-    {
-      g_timer_start (priv->timer);
-      priv->timer_timeout =
-        g_idle_add_full (CLUTTER_PRIORITY_REDRAW,
-                         (GSourceFunc)mex_proxy_stop_timer_cb,
-                         proxy,
-                         NULL);
-    }
+  mex_proxy_scheduler_ensure ();
 
-  /* Don't spend more than 5ms before hitting the main-loop again
-   * creating/adding objects, and make sure to maintain order.
+  /* Create straight away if nothing is waiting and the object is likely
+   * to fit in what is left of this frame's budget. Otherwise queue it,
+   * making sure to maintain order.
    */
-  if (!g_queue_is_empty (priv->to_add) ||
-      g_timer_elapsed (priv->timer, NULL) * 1000 >= 5)
+  if (g_queue_is_empty (priv->to_add) &&
+      mex_proxy_scheduler_get_used (g_get_monotonic_time ()) +
+      priv->creation_cost <= scheduler.budget)
     {
-      g_queue_push_tail (priv->to_add, g_object_ref_sink (content));
-      g_hash_table_insert (priv->to_add_hash, content,
-                           g_queue_peek_tail_link (priv->to_add));
+      mex_proxy_create_object (proxy, content);
       return;
     }
 
-  mex_proxy_add_content_no_defer (proxy, content);
+  g_queue_push_tail (priv->to_add, g_object_ref_sink (content));
+  g_hash_table_insert (priv->to_add_hash, content,
+                       g_queue_peek_tail_link (priv->to_add));
+  scheduler.queue_depth++;
+
+  if (!priv->scheduler_link)
+    {
+      g_queue_push_tail (scheduler.proxies, proxy);
+      priv->scheduler_link = g_queue_peek_tail_link (scheduler.proxies);
+    }
+
+  if (!scheduler.idle_id)
+    scheduler.idle_id =
+      g_idle_add_full (CLUTTER_PRIORITY_REDRAW,
+                       mex_proxy_scheduler_dispatch_cb,
+                       NULL, NULL);
 }
 
 static void
@@ -369,7 +606,11 @@ mex_proxy_remove_content (MexProxy   *proxy,
     {
       g_queue_delete_link (priv->to_add, to_add_link);
       g_hash_table_remove (priv->to_add_hash, content);
+      scheduler.queue_depth--;
       g_object_unref (content);
+
+      if (g_queue_is_empty (priv->to_add))
+        mex_proxy_scheduler_remove (proxy);
     }
 }
 
@@ -385,9 +626,11 @@ mex_proxy_clear (MexProxy *proxy)
       mex_proxy_remove_content (proxy, content);
     }
 
+  scheduler.queue_depth -= g_queue_get_length (priv->to_add);
   g_queue_foreach (priv->to_add, (GFunc)g_object_unref, NULL);
   g_queue_clear (priv->to_add);
   g_hash_table_remove_all (priv->to_add_hash);
+  mex_proxy_scheduler_remove (proxy);
 
   g_list_free (contents);
 }
@@ -404,12 +647,6 @@ mex_proxy_set_model (MexProxy *proxy, MexModel *model)
 
   if (priv->model)
     {
-      if (priv->timer_timeout)
-        {
-          g_source_remove (priv->timer_timeout);
-          priv->timer_timeout = 0;
-        }
-
       controller = mex_model_get_controller (priv->model);
 
       g_signal_handlers_disconnect_by_func (controller,
@@ -50,6 +50,7 @@ G_BEGIN_DECLS
 typedef struct _MexProxy MexProxy;
 typedef struct _MexProxyClass MexProxyClass;
 typedef struct _MexProxyPrivate MexProxyPrivate;
+typedef struct _MexProxyStats MexProxyStats;
 
 struct _MexProxy
 {
@@ -70,6 +71,28 @@ struct _MexProxyClass
                           GObject    *object);
 };
 
+/**
+ * MexProxyStats:
+ * @queue_depth: number of content items waiting for an object, across
+ *   all proxies
+ * @created_this_frame: objects created since the last stage repaint
+ * @created_last_frame: objects created during the previous frame
+ * @budget: time, in milliseconds, the scheduler may spend per frame
+ * @average_cost: running average cost of creating an object, in milliseconds
+ * @frame_interval: last measured interval between repaints, in milliseconds
+ *
+ * Snapshot of the object creation scheduler shared by all proxies.
+ */
+struct _MexProxyStats
+{
+  guint   queue_depth;
+  guint   created_this_frame;
+  guint   created_last_frame;
+  gdouble budget;
+  gdouble average_cost;
+  gdouble frame_interval;
+};
+
 GType mex_proxy_get_type (void) G_GNUC_CONST;
 
 MexModel *mex_proxy_get_model (MexProxy *proxy);
@@ -78,6 +101,11 @@ void mex_proxy_set_model (MexProxy *proxy, MexModel *model);
 
 GType     mex_proxy_get_object_type (MexProxy *proxy);
 
+void      mex_proxy_set_on_screen (MexProxy *proxy, gboolean on_screen);
+gboolean  mex_proxy_get_on_screen (MexProxy *proxy);
+
+void      mex_proxy_get_stats (MexProxyStats *stats);
+
 G_END_DECLS
 
 #endif /* __MEX_PROXY_H__ */
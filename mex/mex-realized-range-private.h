@@ -0,0 +1,94 @@
+/*
+ * Mex - a media explorer
+ *
+ * Copyright © 2010, 2011 Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses>
+ */
+
+
+#ifndef __MEX_REALIZED_RANGE_PRIVATE_H__
+#define __MEX_REALIZED_RANGE_PRIVATE_H__
+
+#include <clutter/clutter.h>
+
+G_BEGIN_DECLS
+
+/* Rows laid out above and below the visible ones, and the rows that get an
+ * actor before the container is first allocated */
+#define MEX_REALIZED_BUFFER_ROWS 2
+#define MEX_REALIZED_INITIAL_ROWS 8
+
+typedef struct _MexRealizedRange MexRealizedRange;
+
+/* Implemented by the container: give the item at @index an actor, take it
+ * away, tell whether @child stays even outside of the range (the focused
+ * one, say), and work out the range to pass to mex_realized_range_set() */
+typedef struct
+{
+  ClutterActor *(* realize)   (ClutterActor *owner,
+                               gint          index);
+  void          (* unrealize) (ClutterActor *owner,
+                               gint          index);
+  gboolean      (* keep)      (ClutterActor *owner,
+                               ClutterActor *child);
+  void          (* update)    (ClutterActor *owner);
+} MexRealizedRangeFuncs;
+
+/* Items of a virtualized container that have an actor. The container owns
+ * @children, with one slot per item of the model and NULL for the items
+ * without an actor, and @realized, which holds the actors in no particular
+ * order. */
+struct _MexRealizedRange
+{
+  ClutterActor                *owner;
+  const MexRealizedRangeFuncs *funcs;
+  GArray                      *children;
+  GPtrArray                   *realized;
+
+  gint                         first;
+  gint                         last;
+  guint                        repaint_id;
+};
+
+void     mex_realized_range_init        (MexRealizedRange            *range,
+                                         ClutterActor                *owner,
+                                         GArray                      *children,
+                                         GPtrArray                   *realized,
+                                         const MexRealizedRangeFuncs *funcs);
+void     mex_realized_range_dispose     (MexRealizedRange            *range);
+
+gint     mex_realized_range_get_index   (MexRealizedRange            *range,
+                                         ClutterActor                *child);
+void     mex_realized_range_add         (MexRealizedRange            *range,
+                                         gint                         index,
+                                         ClutterActor                *child);
+void     mex_realized_range_remove      (MexRealizedRange            *range,
+                                         gint                         index);
+void     mex_realized_range_shift       (MexRealizedRange            *range,
+                                         gint                         from,
+                                         gint                         delta);
+void     mex_realized_range_clear       (MexRealizedRange            *range);
+
+void     mex_realized_range_get_initial (MexRealizedRange            *range,
+                                         gint                         stride,
+                                         gint                        *first,
+                                         gint                        *last);
+gboolean mex_realized_range_set         (MexRealizedRange            *range,
+                                         gint                         first,
+                                         gint                         last);
+void     mex_realized_range_queue       (MexRealizedRange            *range);
+
+G_END_DECLS
+
+#endif /* __MEX_REALIZED_RANGE_PRIVATE_H__ */
@@ -0,0 +1,223 @@
+/*
+ * Mex - a media explorer
+ *
+ * Copyright © 2010, 2011 Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses>
+ */
+
+/*
+ * Bookkeeping shared by MexGrid and MexColumn: which items of the model
+ * have an actor, and keeping that in line with the rows in view when the
+ * container is virtualized.
+ */
+
+#include "mex-realized-range-private.h"
+
+static GQuark index_quark = 0;
+
+void
+mex_realized_range_init (MexRealizedRange            *range,
+                         ClutterActor                *owner,
+                         GArray                      *children,
+                         GPtrArray                   *realized,
+                         const MexRealizedRangeFuncs *funcs)
+{
+  if (G_UNLIKELY (!index_quark))
+    index_quark = g_quark_from_static_string ("mex-realized-range-index");
+
+  range->owner = owner;
+  range->funcs = funcs;
+  range->children = children;
+  range->realized = realized;
+  range->first = range->last = -1;
+  range->repaint_id = 0;
+}
+
+void
+mex_realized_range_dispose (MexRealizedRange *range)
+{
+  if (range->repaint_id)
+    {
+      clutter_threads_remove_repaint_func (range->repaint_id);
+      range->repaint_id = 0;
+    }
+}
+
+/* Actors know their index, so that looking it up doesn't mean walking the
+ * model. The slot is checked as the actor may belong to another container
+ * or have been recycled. */
+gint
+mex_realized_range_get_index (MexRealizedRange *range,
+                              ClutterActor     *child)
+{
+  gint index;
+
+  if (!child)
+    return -1;
+
+  index = GPOINTER_TO_INT (g_object_get_qdata (G_OBJECT (child),
+                                               index_quark)) - 1;
+
+  if ((index < 0) || (index >= range->children->len) ||
+      (g_array_index (range->children, ClutterActor *, index) != child))
+    return -1;
+
+  return index;
+}
+
+static void
+mex_realized_range_set_index (ClutterActor *child,
+                              gint          index)
+{
+  g_object_set_qdata (G_OBJECT (child), index_quark,
+                      GINT_TO_POINTER (index + 1));
+}
+
+void
+mex_realized_range_add (MexRealizedRange *range,
+                        gint              index,
+                        ClutterActor     *child)
+{
+  g_array_index (range->children, ClutterActor *, index) = child;
+  g_ptr_array_add (range->realized, child);
+  mex_realized_range_set_index (child, index);
+}
+
+void
+mex_realized_range_remove (MexRealizedRange *range,
+                           gint              index)
+{
+  ClutterActor *child;
+
+  child = g_array_index (range->children, ClutterActor *, index);
+  g_array_index (range->children, ClutterActor *, index) = NULL;
+  g_ptr_array_remove_fast (range->realized, child);
+  mex_realized_range_set_index (child, -1);
+}
+
+/**
+ * mex_realized_range_shift:
+ *
+ * Renumber the actors after the given position, before items are inserted
+ * or removed from the model
+ */
+void
+mex_realized_range_shift (MexRealizedRange *range,
+                          gint              from,
+                          gint              delta)
+{
+  gint i;
+
+  /* Nothing to do when appending */
+  if (from >= range->children->len)
+    return;
+
+  for (i = 0; i < range->realized->len; i++)
+    {
+      ClutterActor *child = g_ptr_array_index (range->realized, i);
+      gint index = mex_realized_range_get_index (range, child);
+
+      if (index >= from)
+        mex_realized_range_set_index (child, index + delta);
+    }
+}
+
+/* Destroys the actors; the container disposes of the ones it put aside */
+void
+mex_realized_range_clear (MexRealizedRange *range)
+{
+  gint i;
+
+  for (i = 0; i < range->realized->len; i++)
+    clutter_actor_destroy (g_ptr_array_index (range->realized, i));
+
+  g_ptr_array_set_size (range->realized, 0);
+  g_array_set_size (range->children, 0);
+  range->first = range->last = -1;
+}
+
+/* Until the container is laid out, the size of the rows isn't known */
+void
+mex_realized_range_get_initial (MexRealizedRange *range,
+                                gint              stride,
+                                gint             *first,
+                                gint             *last)
+{
+  *first = 0;
+  *last = MIN ((gint) range->children->len,
+               MEX_REALIZED_INITIAL_ROWS * stride) - 1;
+}
+
+/**
+ * mex_realized_range_set:
+ *
+ * Create the actors for the items between @first and @last, and release
+ * the others. Returns whether the range changed.
+ */
+gboolean
+mex_realized_range_set (MexRealizedRange *range,
+                        gint              first,
+                        gint              last)
+{
+  const MexRealizedRangeFuncs *funcs = range->funcs;
+  gboolean changed;
+  gint i;
+
+  /* Iterating backwards copes with the removals */
+  for (i = range->realized->len - 1; i >= 0; i--)
+    {
+      ClutterActor *child = g_ptr_array_index (range->realized, i);
+      gint index = mex_realized_range_get_index (range, child);
+
+      if (((index < first) || (index > last)) &&
+          !funcs->keep (range->owner, child))
+        funcs->unrealize (range->owner, index);
+    }
+
+  for (i = first; i <= last; i++)
+    funcs->realize (range->owner, i);
+
+  changed = (first != range->first) || (last != range->last);
+  range->first = first;
+  range->last = last;
+
+  return changed;
+}
+
+static gboolean
+mex_realized_range_repaint_cb (gpointer user_data)
+{
+  MexRealizedRange *range = user_data;
+
+  range->repaint_id = 0;
+
+  range->funcs->update (range->owner);
+  clutter_actor_queue_relayout (range->owner);
+
+  return FALSE;
+}
+
+/* Actors can't be added or removed while allocating, so that's done right
+ * before the next layout */
+void
+mex_realized_range_queue (MexRealizedRange *range)
+{
+  if (range->repaint_id)
+    return;
+
+  range->repaint_id =
+    clutter_threads_add_repaint_func_full (CLUTTER_REPAINT_FLAGS_PRE_PAINT,
+                                           mex_realized_range_repaint_cb,
+                                           range, NULL);
+}
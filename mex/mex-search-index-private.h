@@ -0,0 +1,48 @@
+/*
+ * Mex - a media explorer
+ *
+ * Copyright © 2010, 2011 Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses>
+ */
+
+
+#ifndef __MEX_SEARCH_INDEX_PRIVATE_H__
+#define __MEX_SEARCH_INDEX_PRIVATE_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _MexSearchIndex MexSearchIndex;
+
+MexSearchIndex *mex_search_index_new       (void);
+void            mex_search_index_free      (MexSearchIndex  *index);
+
+gchar         **mex_search_index_tokenize  (const gchar *text);
+
+void            mex_search_index_set_field (MexSearchIndex  *index,
+                                            gpointer         item,
+                                            guint            field,
+                                            gchar          **tokens);
+void            mex_search_index_remove    (MexSearchIndex  *index,
+                                            gpointer         item);
+void            mex_search_index_clear     (MexSearchIndex  *index);
+
+GPtrArray      *mex_search_index_query     (MexSearchIndex  *index,
+                                            const gchar    **terms,
+                                            gboolean         match_all);
+
+G_END_DECLS
+
+#endif /* __MEX_SEARCH_INDEX_PRIVATE_H__ */
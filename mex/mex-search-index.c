@@ -0,0 +1,686 @@
+/*
+ * Mex - a media explorer
+ *
+ * Copyright © 2010, 2011 Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses>
+ */
+
+
+/*
+ * Inverted index used to search feeds. Text is split into tokens that are
+ * case-folded and stripped of their accents, each token keeps the sorted
+ * list of the documents it appears in, and the tokens are themselves
+ * indexed by the 1, 2 and 3 character sequences they contain, so that
+ * looking for a substring only has to check a handful of tokens instead of
+ * the whole vocabulary.
+ *
+ * Documents are made of fields that are indexed separately, so that a
+ * change to one of them doesn't require tokenising the others again.
+ * Tokenising doesn't touch the index and can be done from any thread.
+ */
+
+#include <string.h>
+
+#include "mex-search-index-private.h"
+
+#define GRAM_LENGTH 3
+
+typedef struct
+{
+  gchar  *text;
+  GArray *postings; /* sorted document ids */
+} SearchTerm;
+
+typedef struct
+{
+  guint       id;
+  GHashTable *terms;  /* SearchTerm -> number of fields it appears in */
+  GHashTable *fields; /* field -> SearchTerms of the field */
+} SearchDocument;
+
+struct _MexSearchIndex
+{
+  GHashTable *terms;     /* token -> SearchTerm */
+  GHashTable *grams;     /* 1 to GRAM_LENGTH characters -> SearchTerms */
+  GHashTable *documents; /* item -> SearchDocument */
+  GPtrArray  *items;     /* document id -> item */
+  GArray     *free_ids;
+};
+
+/* Case-folds @text and removes its accents, so that "cafe" finds "Café".
+ * Anything that's not a letter or a digit becomes a separator. */
+static gchar *
+mex_search_index_normalise (const gchar *text)
+{
+  gchar *folded, *decomposed;
+  const gchar *p;
+  GString *str;
+
+  folded = g_utf8_casefold (text, -1);
+  decomposed = g_utf8_normalize (folded, -1, G_NORMALIZE_ALL);
+  g_free (folded);
+
+  if (!decomposed)
+    return NULL;
+
+  str = g_string_sized_new (strlen (decomposed));
+  for (p = decomposed; *p; p = g_utf8_next_char (p))
+    {
+      gunichar c = g_utf8_get_char (p);
+
+      if (g_unichar_type (c) == G_UNICODE_NON_SPACING_MARK)
+        continue;
+
+      if (g_unichar_isalnum (c))
+        g_string_append_unichar (str, c);
+      else
+        g_string_append_c (str, ' ');
+    }
+  g_free (decomposed);
+
+  return g_string_free (str, FALSE);
+}
+
+/**
+ * mex_search_index_tokenize:
+ * @text: some text
+ *
+ * Splits @text into normalised tokens, as they're indexed. Can be called
+ * from any thread.
+ *
+ * Return value: a %NULL terminated array of tokens, free with g_strfreev()
+ */
+gchar **
+mex_search_index_tokenize (const gchar *text)
+{
+  GPtrArray *tokens;
+  gchar *normalised, **split;
+  gint i;
+
+  tokens = g_ptr_array_new ();
+
+  normalised = mex_search_index_normalise (text);
+  if (normalised)
+    {
+      split = g_strsplit (normalised, " ", -1);
+      for (i = 0; split[i]; i++)
+        {
+          if (*split[i])
+            g_ptr_array_add (tokens, split[i]);
+          else
+            g_free (split[i]);
+        }
+      g_free (split);
+      g_free (normalised);
+    }
+
+  g_ptr_array_add (tokens, NULL);
+
+  return (gchar **) g_ptr_array_free (tokens, FALSE);
+}
+
+static gint
+compare_ids (gconstpointer a,
+             gconstpointer b)
+{
+  guint id_a = *(const guint *) a, id_b = *(const guint *) b;
+
+  return (id_a > id_b) - (id_a < id_b);
+}
+
+/* Position of @id in @postings, or of where it would be inserted */
+static guint
+postings_search (GArray *postings,
+                 guint   id)
+{
+  guint low = 0, high = postings->len;
+
+  while (low < high)
+    {
+      guint middle = (low + high) / 2;
+
+      if (g_array_index (postings, guint, middle) < id)
+        low = middle + 1;
+      else
+        high = middle;
+    }
+
+  return low;
+}
+
+static void
+postings_insert (GArray *postings,
+                 guint   id)
+{
+  guint position;
+
+  /* Documents are mostly added with increasing ids */
+  if (!postings->len || g_array_index (postings, guint, postings->len - 1) < id)
+    {
+      g_array_append_val (postings, id);
+      return;
+    }
+
+  position = postings_search (postings, id);
+  if (g_array_index (postings, guint, position) != id)
+    g_array_insert_val (postings, position, id);
+}
+
+static void
+postings_remove (GArray *postings,
+                 guint   id)
+{
+  guint position = postings_search (postings, id);
+
+  if (position < postings->len &&
+      g_array_index (postings, guint, position) == id)
+    g_array_remove_index (postings, position);
+}
+
+static void
+postings_sort_unique (GArray *postings)
+{
+  guint i, n;
+
+  if (postings->len < 2)
+    return;
+
+  g_array_sort (postings, compare_ids);
+
+  for (i = 1, n = 1; i < postings->len; i++)
+    if (g_array_index (postings, guint, i) !=
+        g_array_index (postings, guint, n - 1))
+      g_array_index (postings, guint, n++) = g_array_index (postings, guint, i);
+
+  g_array_set_size (postings, n);
+}
+
+/* Keeps in @a the ids that are also in @b */
+static void
+postings_intersect (GArray *a,
+                    GArray *b)
+{
+  guint i = 0, j = 0, n = 0;
+
+  while (i < a->len && j < b->len)
+    {
+      guint id_a = g_array_index (a, guint, i);
+      guint id_b = g_array_index (b, guint, j);
+
+      if (id_a < id_b)
+        i++;
+      else if (id_a > id_b)
+        j++;
+      else
+        {
+          g_array_index (a, guint, n++) = id_a;
+          i++;
+          j++;
+        }
+    }
+
+  g_array_set_size (a, n);
+}
+
+/* Calls @func for each distinct sequence of 1 to GRAM_LENGTH characters
+ * of @text (with duplicates when @text repeats itself) */
+static void
+foreach_gram (const gchar *text,
+              void       (*func) (MexSearchIndex *, gchar *, SearchTerm *),
+              MexSearchIndex *index,
+              SearchTerm     *term)
+{
+  const gchar *start, *end;
+  gint n;
+
+  for (start = text; *start; start = g_utf8_next_char (start))
+    {
+      end = start;
+      for (n = 0; n < GRAM_LENGTH && *end; n++)
+        {
+          end = g_utf8_next_char (end);
+          func (index, g_strndup (start, end - start), term);
+        }
+    }
+}
+
+static void
+gram_add_term (MexSearchIndex *index,
+               gchar          *gram,
+               SearchTerm     *term)
+{
+  GPtrArray *terms = g_hash_table_lookup (index->grams, gram);
+
+  if (!terms)
+    {
+      terms = g_ptr_array_new ();
+      g_hash_table_insert (index->grams, gram, terms);
+    }
+  else
+    g_free (gram);
+
+  /* A term is added to all its grams in one go, so a gram that's repeated
+   * within the term already has it last */
+  if (!terms->len || g_ptr_array_index (terms, terms->len - 1) != term)
+    g_ptr_array_add (terms, term);
+}
+
+static void
+gram_remove_term (MexSearchIndex *index,
+                  gchar          *gram,
+                  SearchTerm     *term)
+{
+  GPtrArray *terms = g_hash_table_lookup (index->grams, gram);
+
+  if (terms)
+    {
+      g_ptr_array_remove_fast (terms, term);
+      if (!terms->len)
+        g_hash_table_remove (index->grams, gram);
+    }
+
+  g_free (gram);
+}
+
+static void
+search_term_free (SearchTerm *term)
+{
+  g_free (term->text);
+  g_array_free (term->postings, TRUE);
+  g_slice_free (SearchTerm, term);
+}
+
+static SearchTerm *
+mex_search_index_get_term (MexSearchIndex *index,
+                           const gchar    *text)
+{
+  SearchTerm *term = g_hash_table_lookup (index->terms, text);
+
+  if (term)
+    return term;
+
+  term = g_slice_new (SearchTerm);
+  term->text = g_strdup (text);
+  term->postings = g_array_new (FALSE, FALSE, sizeof (guint));
+  g_hash_table_insert (index->terms, term->text, term);
+
+  foreach_gram (term->text, gram_add_term, index, term);
+
+  return term;
+}
+
+static void
+mex_search_index_release_term (MexSearchIndex *index,
+                               SearchTerm     *term)
+{
+  if (term->postings->len)
+    return;
+
+  foreach_gram (term->text, gram_remove_term, index, term);
+  g_hash_table_remove (index->terms, term->text);
+}
+
+static void
+search_document_free (SearchDocument *document)
+{
+  g_hash_table_destroy (document->terms);
+  g_hash_table_destroy (document->fields);
+  g_slice_free (SearchDocument, document);
+}
+
+MexSearchIndex *
+mex_search_index_new (void)
+{
+  MexSearchIndex *index = g_slice_new (MexSearchIndex);
+
+  index->terms = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+                                        (GDestroyNotify) search_term_free);
+  index->grams = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                        (GDestroyNotify) g_ptr_array_unref);
+  index->documents =
+    g_hash_table_new_full (NULL, NULL, NULL,
+                           (GDestroyNotify) search_document_free);
+  index->items = g_ptr_array_new ();
+  index->free_ids = g_array_new (FALSE, FALSE, sizeof (guint));
+
+  return index;
+}
+
+void
+mex_search_index_free (MexSearchIndex *index)
+{
+  g_hash_table_destroy (index->documents);
+  g_hash_table_destroy (index->grams);
+  g_hash_table_destroy (index->terms);
+  g_ptr_array_free (index->items, TRUE);
+  g_array_free (index->free_ids, TRUE);
+  g_slice_free (MexSearchIndex, index);
+}
+
+static SearchDocument *
+mex_search_index_get_document (MexSearchIndex *index,
+                               gpointer        item)
+{
+  SearchDocument *document = g_hash_table_lookup (index->documents, item);
+
+  if (document)
+    return document;
+
+  document = g_slice_new (SearchDocument);
+  document->terms = g_hash_table_new (NULL, NULL);
+  document->fields =
+    g_hash_table_new_full (NULL, NULL, NULL,
+                           (GDestroyNotify) g_ptr_array_unref);
+
+  if (index->free_ids->len)
+    {
+      document->id = g_array_index (index->free_ids, guint,
+                                    index->free_ids->len - 1);
+      g_array_set_size (index->free_ids, index->free_ids->len - 1);
+      g_ptr_array_index (index->items, document->id) = item;
+    }
+  else
+    {
+      document->id = index->items->len;
+      g_ptr_array_add (index->items, item);
+    }
+
+  g_hash_table_insert (index->documents, item, document);
+
+  return document;
+}
+
+static void
+document_add_term (SearchDocument *document,
+                   SearchTerm     *term)
+{
+  guint count = GPOINTER_TO_UINT (g_hash_table_lookup (document->terms,
+                                                       term));
+
+  if (count == 0)
+    postings_insert (term->postings, document->id);
+
+  g_hash_table_insert (document->terms, term, GUINT_TO_POINTER (count + 1));
+}
+
+static void
+document_remove_term (MexSearchIndex *index,
+                      SearchDocument *document,
+                      SearchTerm     *term)
+{
+  guint count = GPOINTER_TO_UINT (g_hash_table_lookup (document->terms,
+                                                       term));
+
+  if (count > 1)
+    {
+      g_hash_table_insert (document->terms, term,
+                           GUINT_TO_POINTER (count - 1));
+      return;
+    }
+
+  g_hash_table_remove (document->terms, term);
+  postings_remove (term->postings, document->id);
+  mex_search_index_release_term (index, term);
+}
+
+/**
+ * mex_search_index_set_field:
+ * @index: a #MexSearchIndex
+ * @item: the item to index
+ * @field: which part of @item @tokens come from
+ * @tokens: (allow-none): tokens returned by mex_search_index_tokenize()
+ *
+ * Indexes @item under @tokens, replacing what @field of @item was indexed
+ * under before. The other fields of @item are left alone.
+ */
+void
+mex_search_index_set_field (MexSearchIndex  *index,
+                            gpointer         item,
+                            guint            field,
+                            gchar          **tokens)
+{
+  SearchDocument *document;
+  GPtrArray *old_terms, *terms;
+  gint i;
+
+  document = mex_search_index_get_document (index, item);
+
+  old_terms = g_hash_table_lookup (document->fields, GUINT_TO_POINTER (field));
+  if (old_terms)
+    g_ptr_array_ref (old_terms);
+
+  /* Add the new terms before removing the old ones, so that the terms in
+   * both aren't released and created again */
+  terms = g_ptr_array_new ();
+  for (i = 0; tokens && tokens[i]; i++)
+    {
+      SearchTerm *term = mex_search_index_get_term (index, tokens[i]);
+      guint j;
+
+      for (j = 0; j < terms->len; j++)
+        if (g_ptr_array_index (terms, j) == term)
+          break;
+
+      if (j == terms->len)
+        {
+          g_ptr_array_add (terms, term);
+          document_add_term (document, term);
+        }
+    }
+
+  if (terms->len)
+    g_hash_table_insert (document->fields, GUINT_TO_POINTER (field), terms);
+  else
+    {
+      g_hash_table_remove (document->fields, GUINT_TO_POINTER (field));
+      g_ptr_array_unref (terms);
+    }
+
+  if (old_terms)
+    {
+      guint j;
+
+      for (j = 0; j < old_terms->len; j++)
+        document_remove_term (index, document,
+                              g_ptr_array_index (old_terms, j));
+      g_ptr_array_unref (old_terms);
+    }
+
+  if (!g_hash_table_size (document->fields))
+    mex_search_index_remove (index, item);
+}
+
+/**
+ * mex_search_index_remove:
+ * @index: a #MexSearchIndex
+ * @item: an item
+ *
+ * Removes @item from the index, if it was there.
+ */
+void
+mex_search_index_remove (MexSearchIndex *index,
+                         gpointer        item)
+{
+  SearchDocument *document;
+  GHashTableIter iter;
+  SearchTerm *term;
+
+  document = g_hash_table_lookup (index->documents, item);
+  if (!document)
+    return;
+
+  g_hash_table_iter_init (&iter, document->terms);
+  while (g_hash_table_iter_next (&iter, (gpointer *) &term, NULL))
+    {
+      g_hash_table_iter_remove (&iter);
+      postings_remove (term->postings, document->id);
+      mex_search_index_release_term (index, term);
+    }
+
+  g_ptr_array_index (index->items, document->id) = NULL;
+  g_array_append_val (index->free_ids, document->id);
+
+  g_hash_table_remove (index->documents, item);
+}
+
+void
+mex_search_index_clear (MexSearchIndex *index)
+{
+  g_hash_table_remove_all (index->documents);
+  g_hash_table_remove_all (index->grams);
+  g_hash_table_remove_all (index->terms);
+  g_ptr_array_set_size (index->items, 0);
+  g_array_set_size (index->free_ids, 0);
+}
+
+/* Documents containing @token anywhere within one of their tokens */
+static GArray *
+mex_search_index_match (MexSearchIndex *index,
+                        const gchar    *token)
+{
+  GPtrArray *candidates = NULL;
+  GArray *result;
+  gboolean exact;
+  guint i;
+
+  result = g_array_new (FALSE, FALSE, sizeof (guint));
+
+  /* Short tokens are grams themselves. Longer ones are looked for in the
+   * tokens containing their rarest trigram. */
+  exact = (g_utf8_strlen (token, -1) <= GRAM_LENGTH);
+  if (exact)
+    candidates = g_hash_table_lookup (index->grams, token);
+  else
+    {
+      const gchar *start, *end;
+      gint n;
+
+      for (start = token; *start; start = g_utf8_next_char (start))
+        {
+          GPtrArray *terms;
+          gchar *gram;
+
+          for (end = start, n = 0; n < GRAM_LENGTH && *end; n++)
+            end = g_utf8_next_char (end);
+          if (n < GRAM_LENGTH)
+            break;
+
+          gram = g_strndup (start, end - start);
+          terms = g_hash_table_lookup (index->grams, gram);
+          g_free (gram);
+
+          if (!terms)
+            return result;
+
+          if (!candidates || terms->len < candidates->len)
+            candidates = terms;
+        }
+    }
+
+  if (!candidates)
+    return result;
+
+  for (i = 0; i < candidates->len; i++)
+    {
+      SearchTerm *term = g_ptr_array_index (candidates, i);
+
+      if (exact || strstr (term->text, token))
+        g_array_append_vals (result, term->postings->data,
+                             term->postings->len);
+    }
+
+  postings_sort_unique (result);
+
+  return result;
+}
+
+static gint
+compare_postings_length (gconstpointer a,
+                         gconstpointer b)
+{
+  const GArray *postings_a = *(GArray * const *) a;
+  const GArray *postings_b = *(GArray * const *) b;
+
+  return (postings_a->len > postings_b->len) -
+    (postings_a->len < postings_b->len);
+}
+
+/**
+ * mex_search_index_query:
+ * @index: a #MexSearchIndex
+ * @terms: a %NULL terminated array of search terms
+ * @match_all: whether items must match all of @terms, or any of them
+ *
+ * Looks for the items that have the tokens of @terms as substrings of
+ * their own tokens.
+ *
+ * Return value: a new array of the items found
+ */
+GPtrArray *
+mex_search_index_query (MexSearchIndex  *index,
+                        const gchar    **terms,
+                        gboolean         match_all)
+{
+  GPtrArray *matches, *results;
+  GArray *ids;
+  gchar **tokens;
+  guint i, j;
+
+  matches = g_ptr_array_new ();
+  for (i = 0; terms[i]; i++)
+    {
+      tokens = mex_search_index_tokenize (terms[i]);
+      for (j = 0; tokens[j]; j++)
+        g_ptr_array_add (matches, mex_search_index_match (index, tokens[j]));
+      g_strfreev (tokens);
+    }
+
+  results = g_ptr_array_new ();
+  if (!matches->len)
+    {
+      g_ptr_array_free (matches, TRUE);
+      return results;
+    }
+
+  if (match_all)
+    {
+      /* Start from the shortest list, the intersection only shrinks */
+      g_ptr_array_sort (matches, compare_postings_length);
+
+      ids = g_ptr_array_index (matches, 0);
+      for (i = 1; i < matches->len && ids->len; i++)
+        postings_intersect (ids, g_ptr_array_index (matches, i));
+    }
+  else
+    {
+      ids = g_ptr_array_index (matches, 0);
+      for (i = 1; i < matches->len; i++)
+        {
+          GArray *other = g_ptr_array_index (matches, i);
+          g_array_append_vals (ids, other->data, other->len);
+        }
+      postings_sort_unique (ids);
+    }
+
+  for (i = 0; i < ids->len; i++)
+    g_ptr_array_add (results,
+                     g_ptr_array_index (index->items,
+                                        g_array_index (ids, guint, i)));
+
+  for (i = 0; i < matches->len; i++)
+    g_array_free (g_ptr_array_index (matches, i), TRUE);
+  g_ptr_array_free (matches, TRUE);
+
+  return results;
+}
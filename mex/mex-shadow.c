@@ -28,17 +28,35 @@ G_DEFINE_TYPE (MexShadow, mex_shadow, CLUTTER_TYPE_EFFECT)
 #define SHADOW_PRIVATE(o) \
   (G_TYPE_INSTANCE_GET_PRIVATE ((o), MEX_TYPE_SHADOW, MexShadowPrivate))
 
+/* Shadow textures are shared between all the shadows with the same radii.
+ * They're generated in a thread and packed into a single atlas texture. */
+typedef struct
+{
+  gint        key;
+  gint        radius_x;
+  gint        radius_y;
+
+  /* Set from the pool, read from the main thread once it's done */
+  guchar     *pixels;
+
+  CoglHandle  texture;
+  guint       pending  : 1;
+  guint       in_atlas : 1;
+  GList      *shadows;
+} MexShadowTexture;
+
 struct _MexShadowPrivate
 {
-  guint                     needs_regen  : 1;
+  guint                     needs_update : 1;
   MexPaintTextureFrameFlags paint_flags;
 
-  CoglHandle    material;
-  ClutterColor  color;
-  gint          radius_x;
-  gint          radius_y;
-  gint          offset_x;
-  gint          offset_y;
+  CoglHandle        material;
+  MexShadowTexture *texture;
+  ClutterColor      color;
+  gint              radius_x;
+  gint              radius_y;
+  gint              offset_x;
+  gint              offset_y;
 };
 
 enum
@@ -53,12 +71,29 @@ enum
   PROP_PAINT_FLAGS
 };
 
+#define ATLAS_SIZE    256
+#define ATLAS_PADDING 1
+
 static GHashTable *shadow_cache = NULL;
+static GThreadPool *shadow_thread_pool = NULL;
+
+static CoglHandle shadow_atlas = COGL_INVALID_HANDLE;
+static gint atlas_x = 0;
+static gint atlas_y = 0;
+static gint atlas_shelf_height = 0;
 
 static const ClutterColor mex_shadow_default_color = { 0x00, 0x00, 0x00, 0x80 };
 #define DEFAULT_RADIUS 12
 
-static void mex_shadow_regenerate (MexShadow *shadow);
+/* Radii that are generated up front, the default one and the one used by
+ * the slide show and the telepathy plugin */
+static const gint mex_shadow_common_radii[] = { DEFAULT_RADIUS, 15 };
+
+static MexShadowTexture *mex_shadow_texture_get (gint radius_x,
+                                                 gint radius_y);
+static void mex_shadow_texture_remove_shadow (MexShadowTexture *entry,
+                                              MexShadow        *shadow);
+static void mex_shadow_update_texture (MexShadow *shadow);
 
 static void
 mex_shadow_get_property (GObject    *object,
@@ -109,7 +144,12 @@ mex_shadow_paint_cb (ClutterEffect *shadow)
   MexShadowPrivate *priv = MEX_SHADOW (shadow)->priv;
   gfloat alpha_mult = clutter_actor_get_paint_opacity (actor) / 255.f;
 
-  mex_shadow_regenerate (MEX_SHADOW (shadow));
+  if (priv->needs_update)
+    mex_shadow_update_texture (MEX_SHADOW (shadow));
+
+  /* Nothing to paint until the texture has been generated */
+  if (cogl_material_get_n_layers (priv->material) == 0)
+    return TRUE;
 
   /* Get coordinates for texture frame */
   radius_x = MAX (1.f, priv->radius_x);
@@ -218,6 +258,12 @@ mex_shadow_dispose (GObject *object)
 {
   MexShadowPrivate *priv = MEX_SHADOW (object)->priv;
 
+  if (priv->texture)
+    {
+      mex_shadow_texture_remove_shadow (priv->texture, MEX_SHADOW (object));
+      priv->texture = NULL;
+    }
+
   if (priv->material)
     {
       cogl_handle_unref (priv->material);
@@ -237,6 +283,7 @@ static void
 mex_shadow_class_init (MexShadowClass *klass)
 {
   GParamSpec *pspec;
+  guint i;
 
   GObjectClass *object_class = G_OBJECT_CLASS (klass);
   ClutterEffectClass *effect_class = CLUTTER_EFFECT_CLASS (klass);
@@ -294,49 +341,11 @@ mex_shadow_class_init (MexShadowClass *klass)
                               MEX_PAINT_TEXTURE_FRAME_NOC,
                               G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
   g_object_class_install_property (object_class, PROP_PAINT_FLAGS, pspec);
-}
 
-static void
-mex_shadow_convolve_transpose_normalise (gfloat *kernel,
-                                         gint    radius,
-                                         guchar *buffer,
-                                         guchar *output,
-                                         gint    width,
-                                         gint    height)
-{
-  guchar normal;
-  gint x, y, col;
-
-  normal = 0;
-  for (y = 0; y < height; y++)
-    {
-      gint out_index = y;
-      gint in_index = y * width;
-
-      for (x = 0; x < width; x++, out_index += height)
-        {
-          gfloat a = 0.f;
-
-          for (col = -radius; col <= radius; col++)
-            {
-              gfloat f = kernel[col + radius];
-
-              if (f != 0.0)
-                {
-                  gint ix = CLAMP (x + col, 0, width - 1);
-                  guchar pixel = buffer[in_index + ix];
-                  a += f * (gfloat)pixel;
-                }
-            }
-
-          output[out_index] = (guchar)CLAMP (a + 0.5, 0, 0xff);
-          if (output[out_index] > normal)
-            normal = output[out_index];
-        }
-    }
-
-  for (x = 0; x < width * height; x++)
-    output[x] = (guchar)((gfloat)output[x] / (gfloat)normal * 255.f);
+  /* Have the common shadows ready by the time the first one is painted */
+  for (i = 0; i < G_N_ELEMENTS (mex_shadow_common_radii); i++)
+    mex_shadow_texture_get (mex_shadow_common_radii[i],
+                            mex_shadow_common_radii[i]);
 }
 
 static gfloat *
@@ -372,88 +381,245 @@ mex_shadow_gaussian_kernel_gen (gint radius, gsize *size)
   return kernel;
 }
 
-static void
-mex_shadow_regenerate (MexShadow *shadow)
+/* Blurring a single opaque pixel with a separable kernel gives the outer
+ * product of the horizontal and vertical kernels, so there's no need to
+ * run the convolution. The result is normalised so that the centre of the
+ * shadow is fully opaque. Runs in the thread pool. */
+static guchar *
+mex_shadow_generate_pixels (gint radius_x,
+                            gint radius_y)
 {
-  gpointer hash;
-  gsize image_size;
   gsize xsize, ysize;
-  CoglHandle texture;
-  gint radius_x, radius_y;
-  guchar *buffer1, *buffer2;
   gfloat *xkernel, *ykernel;
+  gfloat normal;
+  guchar *pixels, *pixel;
+  gint x, y;
 
-  MexShadowPrivate *priv = shadow->priv;
+  xkernel = mex_shadow_gaussian_kernel_gen (radius_x, &xsize);
+  ykernel = mex_shadow_gaussian_kernel_gen (radius_y, &ysize);
 
-  if (!priv->needs_regen)
-    return;
+  normal = xkernel[radius_x] * ykernel[radius_y];
+
+  pixels = pixel = g_malloc ((radius_x * 2) * (radius_y * 2));
+  for (y = 0; y < radius_y * 2; y++)
+    {
+      gfloat fy = ykernel[radius_y * 2 - y] * 255.f / normal;
+
+      for (x = 0; x < radius_x * 2; x++)
+        {
+          gfloat a = xkernel[radius_x * 2 - x] * fy;
+          *(pixel++) = (guchar) CLAMP (a + 0.5f, 0, 0xff);
+        }
+    }
+
+  g_slice_free1 (xsize, xkernel);
+  g_slice_free1 (ysize, ykernel);
+
+  return pixels;
+}
+
+/* Packs the texture on the current shelf of the atlas, or starts a new
+ * shelf below it. Space is never reclaimed, once the atlas is full the
+ * textures get their own Cogl texture. */
+static gboolean
+mex_shadow_atlas_add (MexShadowTexture *entry)
+{
+  gint x, y, shelf_height, width, height;
+
+  width = entry->radius_x * 2;
+  height = entry->radius_y * 2;
+
+  if (G_UNLIKELY (shadow_atlas == COGL_INVALID_HANDLE))
+    {
+      guchar *blank = g_malloc0 (ATLAS_SIZE * ATLAS_SIZE);
+
+      shadow_atlas = cogl_texture_new_from_data (ATLAS_SIZE, ATLAS_SIZE,
+                                                 COGL_TEXTURE_NO_SLICING |
+                                                 COGL_TEXTURE_NO_ATLAS,
+                                                 COGL_PIXEL_FORMAT_A_8,
+                                                 COGL_PIXEL_FORMAT_A_8,
+                                                 ATLAS_SIZE, blank);
+      g_free (blank);
+
+      if (shadow_atlas == COGL_INVALID_HANDLE)
+        return FALSE;
+    }
+
+  x = atlas_x;
+  y = atlas_y;
+  shelf_height = atlas_shelf_height;
+
+  if (x + width > ATLAS_SIZE)
+    {
+      x = 0;
+      y += shelf_height + ATLAS_PADDING;
+      shelf_height = 0;
+    }
+
+  if (width > ATLAS_SIZE || y + height > ATLAS_SIZE)
+    return FALSE;
+
+  if (!cogl_texture_set_region (shadow_atlas, 0, 0, x, y, width, height,
+                                width, height, COGL_PIXEL_FORMAT_A_8,
+                                width, entry->pixels))
+    return FALSE;
+
+  entry->texture = cogl_texture_new_from_sub_texture (shadow_atlas,
+                                                      x, y, width, height);
+  entry->in_atlas = TRUE;
+
+  /* Leave a transparent gutter so that filtering doesn't pick up the
+   * edges of the neighbouring shadows */
+  atlas_x = x + width + ATLAS_PADDING;
+  atlas_y = y;
+  atlas_shelf_height = MAX (shelf_height, height);
+
+  return TRUE;
+}
+
+static void
+mex_shadow_texture_free (MexShadowTexture *entry)
+{
+  g_hash_table_remove (shadow_cache, GINT_TO_POINTER (entry->key));
+
+  if (entry->texture != COGL_INVALID_HANDLE)
+    cogl_handle_unref (entry->texture);
+  g_slice_free (MexShadowTexture, entry);
+}
+
+/* Textures in the atlas stay there for good, the others are dropped as soon
+ * as no shadow uses them anymore */
+static void
+mex_shadow_texture_remove_shadow (MexShadowTexture *entry,
+                                  MexShadow        *shadow)
+{
+  entry->shadows = g_list_remove (entry->shadows, shadow);
+
+  if (!entry->shadows && !entry->pending && !entry->in_atlas)
+    mex_shadow_texture_free (entry);
+}
+
+static gboolean
+mex_shadow_texture_upload (gpointer data)
+{
+  MexShadowTexture *entry = data;
+  GList *l;
+
+  entry->pending = FALSE;
+
+  if (!mex_shadow_atlas_add (entry))
+    entry->texture = cogl_texture_new_from_data (entry->radius_x * 2,
+                                                 entry->radius_y * 2,
+                                                 COGL_TEXTURE_NONE,
+                                                 COGL_PIXEL_FORMAT_A_8,
+                                                 COGL_PIXEL_FORMAT_A_8,
+                                                 entry->radius_x * 2,
+                                                 entry->pixels);
 
-  priv->needs_regen = FALSE;
+  g_free (entry->pixels);
+  entry->pixels = NULL;
+
+  if (!entry->shadows && !entry->in_atlas)
+    {
+      mex_shadow_texture_free (entry);
+      return FALSE;
+    }
 
-  radius_x = MAX (1, priv->radius_x);
-  radius_y = MAX (1, priv->radius_y);
+  if (entry->texture == COGL_INVALID_HANDLE)
+    return FALSE;
+
+  for (l = entry->shadows; l; l = l->next)
+    {
+      MexShadow *shadow = l->data;
+
+      cogl_material_set_layer (shadow->priv->material, 0, entry->texture);
+      clutter_effect_queue_repaint (CLUTTER_EFFECT (shadow));
+    }
+
+  return FALSE;
+}
+
+static void
+mex_shadow_texture_generate (gpointer data,
+                             gpointer user_data)
+{
+  MexShadowTexture *entry = data;
+
+  entry->pixels = mex_shadow_generate_pixels (entry->radius_x,
+                                              entry->radius_y);
+
+  clutter_threads_add_timeout (0, mex_shadow_texture_upload, entry);
+}
+
+static MexShadowTexture *
+mex_shadow_texture_get (gint radius_x,
+                        gint radius_y)
+{
+  MexShadowTexture *entry;
+  GError *error = NULL;
+  gint key;
 
   /* Let's assume that no one's going to ask for a shadow with x or y radius
    * greater than 65535 pixels (16 bits)
    */
-  hash = GINT_TO_POINTER ((radius_x << 16) | radius_y);
+  key = (radius_x << 16) | radius_y;
 
-  if (shadow_cache)
-    texture = g_hash_table_lookup (shadow_cache, hash);
-  else
-    {
-      shadow_cache = g_hash_table_new (NULL, NULL);
-      texture = NULL;
-    }
+  if (G_UNLIKELY (shadow_cache == NULL))
+    shadow_cache = g_hash_table_new (NULL, NULL);
 
-  if (!texture)
+  entry = g_hash_table_lookup (shadow_cache, GINT_TO_POINTER (key));
+  if (entry)
+    return entry;
+
+  entry = g_slice_new0 (MexShadowTexture);
+  entry->key = key;
+  entry->radius_x = radius_x;
+  entry->radius_y = radius_y;
+  entry->pending = TRUE;
+  g_hash_table_insert (shadow_cache, GINT_TO_POINTER (key), entry);
+
+  if (G_UNLIKELY (shadow_thread_pool == NULL))
     {
-      xkernel = mex_shadow_gaussian_kernel_gen (radius_x, &xsize);
-      ykernel = mex_shadow_gaussian_kernel_gen (radius_y, &ysize);
-
-      /* Create surface to blur */
-      image_size = sizeof (guchar) * (radius_x * 2) * (radius_y * 2);
-      buffer1 = g_slice_alloc0 (image_size);
-      buffer2 = g_slice_alloc0 (image_size);
-      buffer1[radius_y * (radius_x * 2) + radius_x] = 0xff;
-
-      /* Blur */
-      mex_shadow_convolve_transpose_normalise (xkernel,
-                                               radius_x,
-                                               buffer1,
-                                               buffer2,
-                                               radius_x * 2,
-                                               radius_y * 2);
-      mex_shadow_convolve_transpose_normalise (ykernel,
-                                               radius_y,
-                                               buffer2,
-                                               buffer1,
-                                               radius_y * 2,
-                                               radius_x * 2);
-
-      /* We don't need the kernels anymore */
-      g_slice_free1 (xsize, xkernel);
-      g_slice_free1 (ysize, ykernel);
-
-      /* We don't need the 2nd buffer anymore */
-      g_slice_free1 (image_size, buffer2);
-
-      /* Create texture */
-      texture = cogl_texture_new_from_data (radius_x * 2,
-                                            radius_y * 2,
-                                            COGL_TEXTURE_NONE,
-                                            COGL_PIXEL_FORMAT_A_8,
-                                            COGL_PIXEL_FORMAT_RGBA_8888_PRE,
-                                            radius_x * 2,
-                                            (guint8 *)buffer1);
-      g_slice_free1 (image_size, buffer1);
-
-      /* Insert this shadow texture into the cache */
-      g_hash_table_insert (shadow_cache, hash, texture);
+      shadow_thread_pool = g_thread_pool_new (mex_shadow_texture_generate,
+                                              NULL, 1, FALSE, &error);
+      if (error)
+        {
+          g_warning (G_STRLOC ": %s", error->message);
+          g_clear_error (&error);
+        }
     }
 
-  /* Set texture on material */
-  cogl_material_set_layer (priv->material, 0, texture);
+  if (shadow_thread_pool)
+    g_thread_pool_push (shadow_thread_pool, entry, NULL);
+  else
+    mex_shadow_texture_generate (entry, NULL);
+
+  return entry;
+}
+
+/* Only looks the texture up, it's generated in the background the first
+ * time a radius is used. Until then, the shadow keeps painting with its
+ * previous texture, if it had one. */
+static void
+mex_shadow_update_texture (MexShadow *shadow)
+{
+  MexShadowPrivate *priv = shadow->priv;
+  MexShadowTexture *entry;
+
+  priv->needs_update = FALSE;
+
+  entry = mex_shadow_texture_get (MAX (1, priv->radius_x),
+                                  MAX (1, priv->radius_y));
+  if (entry == priv->texture)
+    return;
+
+  entry->shadows = g_list_prepend (entry->shadows, shadow);
+  if (priv->texture)
+    mex_shadow_texture_remove_shadow (priv->texture, shadow);
+  priv->texture = entry;
+
+  if (entry->texture != COGL_INVALID_HANDLE)
+    cogl_material_set_layer (priv->material, 0, entry->texture);
 }
 
 static void
@@ -471,6 +637,7 @@ mex_shadow_init (MexShadow *self)
   cogl_material_set_layer_combine (priv->material, 0,
                                    "RGBA = MODULATE (PREVIOUS, TEXTURE[A])",
                                    NULL);
+  priv->needs_update = TRUE;
 }
 
 MexShadow *
@@ -495,8 +662,6 @@ mex_shadow_set_color (MexShadow *shadow, const ClutterColor *color)
     {
       priv->color = *color;
       g_object_notify (G_OBJECT (shadow), "color");
-
-      priv->needs_regen = TRUE;
     }
 }
 
@@ -520,11 +685,9 @@ mex_shadow_set_radius_x (MexShadow *shadow, gint radius)
   if (priv->radius_x != radius)
     {
       priv->radius_x = radius;
-      mex_shadow_regenerate (shadow);
+      priv->needs_update = TRUE;
 
       g_object_notify (G_OBJECT (shadow), "radius-x");
-
-      priv->needs_regen = TRUE;
     }
 }
 
@@ -548,11 +711,9 @@ mex_shadow_set_radius_y (MexShadow *shadow, gint radius)
   if (priv->radius_y != radius)
     {
       priv->radius_y = radius;
-      mex_shadow_regenerate (shadow);
+      priv->needs_update = TRUE;
 
       g_object_notify (G_OBJECT (shadow), "radius-y");
-
-      priv->needs_regen = TRUE;
     }
 }
 
@@ -577,8 +738,6 @@ mex_shadow_set_offset_x (MexShadow *shadow, gint offset)
       priv->offset_x = offset;
 
       g_object_notify (G_OBJECT (shadow), "offset-x");
-
-      priv->needs_regen = TRUE;
     }
 }
 
@@ -603,8 +762,6 @@ mex_shadow_set_offset_y (MexShadow *shadow, gint offset)
       priv->offset_y = offset;
 
       g_object_notify (G_OBJECT (shadow), "offset-y");
-
-      priv->needs_regen = TRUE;
     }
 }
 
@@ -630,8 +787,6 @@ mex_shadow_set_paint_flags (MexShadow                 *shadow,
       priv->paint_flags = flags;
 
       g_object_notify (G_OBJECT (shadow), "paint-flags");
-
-      priv->needs_regen = TRUE;
     }
 }
 
@@ -33,6 +33,9 @@
 #include "mex-view-model.h"
 #include "mex-content-proxy.h"
 #include "mex-download-queue.h"
+#include "mex-image-loader.h"
+#include "mex-metadata-journal.h"
+#include "mex-texture-cache.h"
 
 #include <gdk-pixbuf/gdk-pixbuf.h>
 
@@ -58,6 +61,25 @@ enum
   PROP_0,
 };
 
+/* How many photos are prefetched after and before the current one, as long
+ * as their decoded size fits within PREFETCH_MAX_SIZE */
+#define PREFETCH_NEXT     2
+#define PREFETCH_PREVIOUS 1
+#define PREFETCH_MAX_SIZE (32 * 1024 * 1024)
+
+typedef struct
+{
+  MexSlideShow    *show;
+  MexContent      *content;
+  gchar           *url;
+  gint             width;
+  gint             height;
+
+  gpointer         download_id;
+  MexImageRequest *image_request;
+  CoglHandle       texture;
+} SlideImage;
+
 struct _MexSlideShowPrivate
 {
   ClutterScript *script;
@@ -81,7 +103,9 @@ struct _MexSlideShowPrivate
 
   guint playing : 1;
 
-  gpointer download_id;
+  /* The photo being shown, and the ones around it decoded ahead of time */
+  SlideImage *current;
+  GList      *prefetched;
 };
 
 enum
@@ -96,12 +120,7 @@ static guint signals[LAST_SIGNAL] = { 0, };
 
 static void reset_controls_timeout (MexSlideShow *show);
 
-static void download_queue_completed (MexDownloadQueue *queue,
-                                      const gchar      *uri,
-                                      const gchar      *buffer,
-                                      gsize             count,
-                                      const GError     *error,
-                                      gpointer          user_data);
+static gint get_content_rotation (MexContent *content, gboolean *is_unset);
 
 static void mex_slide_show_set_playing (MexSlideShow *slideshow,
                                         gboolean      playing);
@@ -200,6 +219,246 @@ image_fit_quark ()
   return result;
 }
 
+static gint
+get_image_angle (MexContent *content)
+{
+  const gchar *orientation;
+  gboolean rotation_unset;
+  gint angle;
+
+  angle = get_content_rotation (content, &rotation_unset);
+
+  if (rotation_unset)
+    {
+      orientation = mex_content_get_metadata (content,
+                                              MEX_CONTENT_METADATA_ORIENTATION);
+      if (orientation)
+        angle = atoi (orientation);
+    }
+
+  return angle;
+}
+
+/* Photos are decoded at the size they're shown at; a photo displayed
+ * sideways covers the image box with its width and height swapped */
+static void
+get_image_size (MexSlideShow *show,
+                MexContent   *content,
+                gint         *width,
+                gint         *height)
+{
+  gfloat box_width, box_height;
+
+  clutter_actor_get_size (show->priv->image, &box_width, &box_height);
+
+  if ((ABS (get_image_angle (content)) / 90) % 2)
+    {
+      *width = box_height;
+      *height = box_width;
+    }
+  else
+    {
+      *width = box_width;
+      *height = box_height;
+    }
+}
+
+static void
+slide_image_free (SlideImage *image)
+{
+  if (image->download_id)
+    mex_download_queue_cancel (mex_download_queue_get_default (),
+                               image->download_id);
+  if (image->image_request)
+    mex_image_loader_cancel (image->image_request);
+  if (image->texture != COGL_INVALID_HANDLE)
+    cogl_handle_unref (image->texture);
+
+  g_object_unref (image->content);
+  g_free (image->url);
+  g_slice_free (SlideImage, image);
+}
+
+static void mex_slide_show_prefetch (MexSlideShow *show);
+
+static void
+slide_image_decoded (CoglHandle    texture,
+                     const GError *error,
+                     gpointer      user_data)
+{
+  SlideImage *image = user_data;
+  MexSlideShowPrivate *priv = image->show->priv;
+
+  image->image_request = NULL;
+
+  if (error)
+    {
+      g_warning ("Error loading image: %s", error->message);
+      return;
+    }
+
+  image->texture = cogl_handle_ref (texture);
+
+  if (image == priv->current)
+    {
+      mx_image_set_from_cogl_texture (MX_IMAGE (priv->image), texture);
+      mex_slide_show_prefetch (image->show);
+    }
+}
+
+static void
+slide_image_downloaded (MexDownloadQueue *queue,
+                        const gchar      *uri,
+                        GBytes           *bytes,
+                        const GError     *error,
+                        gpointer          user_data)
+{
+  SlideImage *image = user_data;
+
+  image->download_id = NULL;
+
+  if (error)
+    {
+      g_warning ("Error loading %s: %s", uri, error->message);
+      return;
+    }
+
+  if (!bytes)
+    return;
+
+  image->image_request = mex_image_loader_load_bytes (uri, bytes,
+                                                      image->width,
+                                                      image->height,
+                                                      slide_image_decoded,
+                                                      image);
+}
+
+static SlideImage *
+slide_image_new (MexSlideShow *show,
+                 MexContent   *content)
+{
+  SlideImage *image;
+  const gchar *url;
+
+  url = mex_content_get_metadata (content, MEX_CONTENT_METADATA_STREAM);
+  if (!url)
+    return NULL;
+
+  image = g_slice_new0 (SlideImage);
+  image->show = show;
+  image->content = g_object_ref (content);
+  image->url = g_strdup (url);
+  get_image_size (show, content, &image->width, &image->height);
+
+  /* Going back to a photo that's been shown recently doesn't need to decode
+   * it again */
+  image->texture = mex_texture_cache_lookup (url, image->width, image->height);
+  if (image->texture == COGL_INVALID_HANDLE)
+    image->download_id =
+      mex_download_queue_enqueue_bytes (mex_download_queue_get_default (),
+                                        url, slide_image_downloaded, image);
+
+  return image;
+}
+
+/* Looks for a prefetched image of @content, still at the right size */
+static SlideImage *
+mex_slide_show_take_prefetched (MexSlideShow *show,
+                                MexContent   *content)
+{
+  MexSlideShowPrivate *priv = show->priv;
+  gint width, height;
+  GList *l;
+
+  get_image_size (show, content, &width, &height);
+
+  for (l = priv->prefetched; l; l = l->next)
+    {
+      SlideImage *image = l->data;
+
+      if (image->content == content &&
+          image->width == width && image->height == height)
+        {
+          priv->prefetched = g_list_delete_link (priv->prefetched, l);
+          return image;
+        }
+    }
+
+  return NULL;
+}
+
+static void
+mex_slide_show_prefetch_content (MexSlideShow  *show,
+                                 MexContent    *content,
+                                 gboolean       load,
+                                 GList        **prefetched)
+{
+  SlideImage *image;
+
+  image = mex_slide_show_take_prefetched (show, content);
+  if (!image && load)
+    image = slide_image_new (show, content);
+
+  if (image)
+    *prefetched = g_list_prepend (*prefetched, image);
+}
+
+/* Keeps the photos around the current one downloaded and decoded, so that
+ * moving through the slide show doesn't wait for them. New photos are only
+ * started once the current one is shown, so that they don't compete with
+ * it; photos out of the window are dropped straight away. */
+static void
+mex_slide_show_prefetch (MexSlideShow *show)
+{
+  MexSlideShowPrivate *priv = show->priv;
+  gint idx, i, length, width, height, n_next, n_previous, n_max;
+  GList *prefetched = NULL;
+  MexContent *content;
+  gboolean load;
+
+  if (!priv->model || !priv->current)
+    goto done;
+
+  idx = mex_model_index (priv->model, priv->current->content);
+  if (idx < 0)
+    goto done;
+
+  get_image_size (show, priv->current->content, &width, &height);
+  if (width <= 0 || height <= 0)
+    goto done;
+
+  n_max = PREFETCH_MAX_SIZE / (width * height * 4);
+  n_next = MIN (PREFETCH_NEXT, n_max);
+  n_previous = MIN (PREFETCH_PREVIOUS, n_max - n_next);
+
+  load = (priv->current->texture != COGL_INVALID_HANDLE);
+  length = mex_model_get_length (priv->model);
+
+  for (i = idx + 1; i < length && n_next > 0; i++)
+    {
+      content = mex_model_get_content (priv->model, i);
+      if (!allowed_content (content))
+        continue;
+
+      mex_slide_show_prefetch_content (show, content, load, &prefetched);
+      n_next--;
+    }
+
+  for (i = idx - 1; i >= 0 && n_previous > 0; i--)
+    {
+      content = mex_model_get_content (priv->model, i);
+      if (!allowed_content (content))
+        continue;
+
+      mex_slide_show_prefetch_content (show, content, load, &prefetched);
+      n_previous--;
+    }
+
+done:
+  g_list_free_full (priv->prefetched, (GDestroyNotify) slide_image_free);
+  priv->prefetched = prefetched;
+}
+
 static void
 mex_slide_show_real_set_content (MexSlideShow *show,
                                  MexContent   *content)
@@ -210,7 +469,7 @@ mex_slide_show_real_set_content (MexSlideShow *show,
   const gchar *url;
   GList *list, *l;
   ClutterContainer *container;
-  MexDownloadQueue *queue;
+  SlideImage *image;
   gchar *title_str, *info_str_1, *info_str_2;
   const gchar *camera, *date, *location;
 
@@ -227,21 +486,27 @@ mex_slide_show_real_set_content (MexSlideShow *show,
 
   if (priv->content) {
     mex_content_set_last_used_metadatas (priv->content);
-    mex_content_save_metadata (priv->content);
+    mex_metadata_journal_add (priv->content);
     g_object_unref (priv->content);
     priv->content = NULL;
   }
   priv->content = content;
   g_object_ref (priv->content);
 
-  queue = mex_download_queue_get_default ();
+  /* The photo that was shown is likely to be in the new prefetch window,
+   * mex_slide_show_prefetch() drops it otherwise */
+  if (priv->current)
+    priv->prefetched = g_list_prepend (priv->prefetched, priv->current);
+
+  image = mex_slide_show_take_prefetched (show, content);
+  if (!image)
+    image = slide_image_new (show, content);
+  priv->current = image;
 
-  if (priv->download_id)
-    mex_download_queue_cancel (queue, priv->download_id);
+  if (image->texture != COGL_INVALID_HANDLE)
+    mx_image_set_from_cogl_texture (MX_IMAGE (priv->image), image->texture);
 
-  priv->download_id = mex_download_queue_enqueue (queue, url,
-                                                  download_queue_completed,
-                                                  show);
+  mex_slide_show_prefetch (show);
 
   if (err)
     {
@@ -335,6 +600,15 @@ mex_slide_show_dispose (GObject *object)
       priv->content = NULL;
     }
 
+  if (priv->current)
+    {
+      slide_image_free (priv->current);
+      priv->current = NULL;
+    }
+
+  g_list_free_full (priv->prefetched, (GDestroyNotify) slide_image_free);
+  priv->prefetched = NULL;
+
   if (priv->model)
     {
       g_object_unref (priv->model);
@@ -705,19 +979,10 @@ image_loaded (MxImage      *image,
               MexSlideShow *show)
 {
   MexSlideShowPrivate *priv = show->priv;
-  const gchar *orientation;
   gint angle;
-  gboolean fit, rotation_unset;
+  gboolean fit;
 
-  angle = get_content_rotation (priv->content, &rotation_unset);
-
-  if (rotation_unset)
-    {
-      orientation = mex_content_get_metadata (priv->content,
-                                              MEX_CONTENT_METADATA_ORIENTATION);
-      if (orientation)
-        angle = atoi (orientation);
-    }
+  angle = get_image_angle (priv->content);
 
   mx_image_set_image_rotation (MX_IMAGE (priv->image), angle);
 
@@ -911,42 +1176,6 @@ mex_slide_show_new (void)
   return g_object_new (MEX_TYPE_SLIDE_SHOW, NULL);
 }
 
-static void
-download_queue_completed (MexDownloadQueue *queue,
-                          const gchar      *uri,
-                          const gchar      *buffer,
-                          gsize             count,
-                          const GError     *error,
-                          gpointer          user_data)
-{
-  MexSlideShowPrivate *priv = MEX_SLIDE_SHOW (user_data)->priv;
-  MxImage *image = MX_IMAGE (priv->image);
-  GError *suberror = NULL;
-  gfloat width, height;
-
-  priv->download_id = 0;
-
-  if (error)
-    {
-      g_warning ("Error loading %s: %s", uri, error->message);
-      return;
-    }
-
-  clutter_actor_get_size (CLUTTER_ACTOR (image), &width, &height);
-
-  /* TODO: Find a way of not having to do a g_memdup here */
-  if (!mx_image_set_from_buffer_at_size (image, g_memdup (buffer, count), count,
-                                         (GDestroyNotify)g_free, width, height,
-                                         &suberror))
-    {
-      g_warning ("Error loading %s: %s", uri, suberror->message);
-      g_error_free (suberror);
-
-      return;
-    }
-
-}
-
 static gboolean
 tile_focus_in_cb (ClutterActor *actor,
                   gpointer      user_data)
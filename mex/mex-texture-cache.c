@@ -0,0 +1,244 @@
+/*
+ * Mex - a media explorer
+ *
+ * Copyright © 2010, 2011 Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses>
+ */
+
+/*
+ * Process-wide cache of decoded images, uploaded as textures, so that the
+ * same cover art shown by several tiles, or shown again when navigating
+ * back into a column, is only decoded once. Textures are keyed by the URI
+ * of the image and the size it was decoded for.
+ *
+ * The cache holds a reference on each texture and drops the least recently
+ * used ones once over budget; textures still displayed stay alive through
+ * the references of the actors showing them. Only used from the main
+ * thread.
+ */
+
+#include "mex-texture-cache.h"
+#include "mex-log.h"
+
+#define DEFAULT_MAX_SIZE (48 * 1024 * 1024)
+
+typedef struct
+{
+  gchar      *key;
+  CoglHandle  texture;
+  gsize       size;
+  GList      *link;
+} TextureCacheItem;
+
+static GHashTable *texture_cache = NULL;
+static GQueue texture_cache_lru = G_QUEUE_INIT;
+static gsize texture_cache_size = 0;
+static gsize texture_cache_max_size = DEFAULT_MAX_SIZE;
+static guint texture_cache_hits = 0;
+static guint texture_cache_misses = 0;
+static guint texture_cache_evictions = 0;
+
+static void
+texture_cache_item_free (TextureCacheItem *item)
+{
+  g_free (item->key);
+  cogl_handle_unref (item->texture);
+  g_slice_free (TextureCacheItem, item);
+}
+
+static void
+texture_cache_remove (TextureCacheItem *item)
+{
+  texture_cache_size -= item->size;
+  g_queue_delete_link (&texture_cache_lru, item->link);
+  g_hash_table_remove (texture_cache, item->key);
+}
+
+static void
+texture_cache_trim (void)
+{
+  while (texture_cache_size > texture_cache_max_size)
+    {
+      TextureCacheItem *item = g_queue_peek_tail (&texture_cache_lru);
+
+      MEX_DEBUG ("texture cache: evicted: %s", item->key);
+
+      texture_cache_evictions++;
+      texture_cache_remove (item);
+    }
+}
+
+static gchar *
+texture_cache_key (const gchar *uri,
+                   gint         width,
+                   gint         height)
+{
+  return g_strdup_printf ("%dx%d:%s", width, height, uri);
+}
+
+/**
+ * mex_texture_cache_lookup:
+ * @uri: URI, or path, of the image
+ * @width: width the image was decoded for
+ * @height: height the image was decoded for
+ *
+ * Looks for a texture previously added with the same @uri and size.
+ *
+ * Return value: a new reference on the texture, to release with
+ *   cogl_handle_unref(), or %COGL_INVALID_HANDLE
+ */
+CoglHandle
+mex_texture_cache_lookup (const gchar *uri,
+                          gint         width,
+                          gint         height)
+{
+  TextureCacheItem *item = NULL;
+  gchar *key;
+
+  g_return_val_if_fail (uri != NULL, COGL_INVALID_HANDLE);
+
+  if (texture_cache)
+    {
+      key = texture_cache_key (uri, width, height);
+      item = g_hash_table_lookup (texture_cache, key);
+      g_free (key);
+    }
+
+  if (!item)
+    {
+      texture_cache_misses++;
+      return COGL_INVALID_HANDLE;
+    }
+
+  texture_cache_hits++;
+
+  /* Move the item to the head of the LRU list */
+  g_queue_unlink (&texture_cache_lru, item->link);
+  g_queue_push_head_link (&texture_cache_lru, item->link);
+
+  return cogl_handle_ref (item->texture);
+}
+
+/**
+ * mex_texture_cache_add:
+ * @uri: URI, or path, of the image
+ * @width: width @pixbuf was decoded for
+ * @height: height @pixbuf was decoded for
+ * @pixbuf: the decoded image
+ *
+ * Uploads @pixbuf into a texture and keeps it for later lookups of @uri at
+ * that size, replacing any previous texture for it.
+ *
+ * Return value: a new reference on the texture, to release with
+ *   cogl_handle_unref(), or %COGL_INVALID_HANDLE if it couldn't be created
+ */
+CoglHandle
+mex_texture_cache_add (const gchar *uri,
+                       gint         width,
+                       gint         height,
+                       GdkPixbuf   *pixbuf)
+{
+  TextureCacheItem *item;
+  CoglHandle texture;
+  gchar *key;
+  gsize size;
+
+  g_return_val_if_fail (uri != NULL, COGL_INVALID_HANDLE);
+  g_return_val_if_fail (GDK_IS_PIXBUF (pixbuf), COGL_INVALID_HANDLE);
+
+  texture = cogl_texture_new_from_data (gdk_pixbuf_get_width (pixbuf),
+                                        gdk_pixbuf_get_height (pixbuf),
+                                        COGL_TEXTURE_NONE,
+                                        gdk_pixbuf_get_has_alpha (pixbuf) ?
+                                        COGL_PIXEL_FORMAT_RGBA_8888 :
+                                        COGL_PIXEL_FORMAT_RGB_888,
+                                        COGL_PIXEL_FORMAT_ANY,
+                                        gdk_pixbuf_get_rowstride (pixbuf),
+                                        gdk_pixbuf_get_pixels (pixbuf));
+  if (texture == COGL_INVALID_HANDLE)
+    return COGL_INVALID_HANDLE;
+
+  /* What the texture is likely to take once uploaded */
+  size = gdk_pixbuf_get_width (pixbuf) * gdk_pixbuf_get_height (pixbuf) * 4;
+  if (size > texture_cache_max_size)
+    return texture;
+
+  if (G_UNLIKELY (texture_cache == NULL))
+    texture_cache =
+      g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+                             (GDestroyNotify) texture_cache_item_free);
+
+  key = texture_cache_key (uri, width, height);
+  item = g_hash_table_lookup (texture_cache, key);
+  if (item)
+    texture_cache_remove (item);
+
+  item = g_slice_new (TextureCacheItem);
+  item->key = key;
+  item->texture = cogl_handle_ref (texture);
+  item->size = size;
+
+  g_queue_push_head (&texture_cache_lru, item);
+  item->link = texture_cache_lru.head;
+  g_hash_table_insert (texture_cache, item->key, item);
+
+  texture_cache_size += size;
+
+  MEX_DEBUG ("texture cache (%" G_GSIZE_FORMAT "): added: %s",
+             texture_cache_size, key);
+
+  texture_cache_trim ();
+
+  return texture;
+}
+
+/**
+ * mex_texture_cache_set_max_size:
+ * @max_size: memory budget, in bytes
+ *
+ * Sets how much texture memory the cache may hold on to.
+ */
+void
+mex_texture_cache_set_max_size (gsize max_size)
+{
+  texture_cache_max_size = max_size;
+
+  if (texture_cache)
+    texture_cache_trim ();
+}
+
+gsize
+mex_texture_cache_get_max_size (void)
+{
+  return texture_cache_max_size;
+}
+
+/**
+ * mex_texture_cache_get_stats:
+ * @stats: (out): return location for the counters
+ *
+ * Fills @stats with the current state of the cache.
+ */
+void
+mex_texture_cache_get_stats (MexTextureCacheStats *stats)
+{
+  g_return_if_fail (stats != NULL);
+
+  stats->hits = texture_cache_hits;
+  stats->misses = texture_cache_misses;
+  stats->evictions = texture_cache_evictions;
+  stats->n_textures = g_queue_get_length (&texture_cache_lru);
+  stats->size = texture_cache_size;
+  stats->max_size = texture_cache_max_size;
+}
@@ -0,0 +1,65 @@
+/*
+ * Mex - a media explorer
+ *
+ * Copyright © 2010, 2011 Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses>
+ */
+
+#ifndef __MEX_TEXTURE_CACHE_H__
+#define __MEX_TEXTURE_CACHE_H__
+
+#include <clutter/clutter.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+G_BEGIN_DECLS
+
+typedef struct _MexTextureCacheStats MexTextureCacheStats;
+
+/**
+ * MexTextureCacheStats:
+ * @hits: lookups that found a texture
+ * @misses: lookups that didn't
+ * @evictions: textures dropped to stay within the budget
+ * @n_textures: number of textures currently cached
+ * @size: estimated size, in bytes, of the cached textures
+ * @max_size: memory budget, in bytes
+ *
+ * Counters of the decoded texture cache.
+ */
+struct _MexTextureCacheStats
+{
+  guint hits;
+  guint misses;
+  guint evictions;
+  guint n_textures;
+  gsize size;
+  gsize max_size;
+};
+
+CoglHandle mex_texture_cache_lookup (const gchar *uri,
+                                     gint         width,
+                                     gint         height);
+CoglHandle mex_texture_cache_add    (const gchar *uri,
+                                     gint         width,
+                                     gint         height,
+                                     GdkPixbuf   *pixbuf);
+
+void  mex_texture_cache_set_max_size (gsize max_size);
+gsize mex_texture_cache_get_max_size (void);
+
+void  mex_texture_cache_get_stats (MexTextureCacheStats *stats);
+
+G_END_DECLS
+
+#endif /* __MEX_TEXTURE_CACHE_H__ */
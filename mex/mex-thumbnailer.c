@@ -28,6 +28,12 @@
 #include "mex-marshal.h"
 
 #include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
 
 gchar *
 mex_get_thumbnail_path_for_uri (const gchar *uri)
@@ -57,153 +63,399 @@ mex_get_thumbnail_path_for_uri (const gchar *uri)
 
 static GThreadPool *thumbnail_thread_pool = NULL;
 
+/* Thumbnails are generated by long-lived mex-thumbnailer processes so that
+ * GStreamer and gdk-pixbuf only get initialised once per worker, while a
+ * crashing decoder still can't take the whole application down. Each
+ * thread of the pool borrows an idle worker for the duration of a request.
+ */
+#define THUMBNAIL_WORKER_TIMEOUT       (30 * 1000)
+#define THUMBNAIL_WORKER_MAX_REQUESTS  500
+
+typedef struct
+{
+  GPid  pid;
+  gint  fd;
+  guint n_requests;
+} ThumbnailWorker;
+
+static GAsyncQueue *thumbnail_idle_workers = NULL;
+
 static char * get_mime_type (const char *uri);
 
-/* thumbnail data */
+/* Requests for the same URI share a single job. Jobs wait in one queue per
+ * priority until a thread of the pool picks them up; the pool itself is
+ * only fed tokens, so that a job can still be re-prioritised or dropped
+ * after it has been queued. Apart from the pending queues and the running
+ * flag, which are protected by thumbnail_lock, jobs and requests are only
+ * touched from the main thread.
+ */
 typedef struct
 {
   gchar *uri;
   gchar *mime;
   gchar *thumbnail_path;
-  MexThumbnailCallback finished;
-  gpointer user_data;
-} ThumbnailData;
-
-static ThumbnailData*
-thumbnail_data_new (const gchar          *uri,
-                    MexThumbnailCallback  finished,
-                    gpointer              user_data)
+
+  MexThumbnailPriority priority;
+  GList *link;
+  guint  running : 1;
+
+  GList *requests;
+} ThumbnailJob;
+
+struct _MexThumbnailRequest
+{
+  ThumbnailJob         *job;
+  MexThumbnailPriority  priority;
+  MexThumbnailCallback  callback;
+  gpointer              user_data;
+};
+
+static GMutex thumbnail_lock;
+static GHashTable *thumbnail_jobs = NULL;
+static GQueue thumbnail_pending[MEX_THUMBNAIL_PRIORITY_HIGH + 1];
+
+static ThumbnailJob *
+thumbnail_job_new (const gchar *uri,
+                   const gchar *mime)
 {
-  ThumbnailData *data;
+  ThumbnailJob *job;
 
-  data = g_slice_new (ThumbnailData);
+  job = g_slice_new0 (ThumbnailJob);
 
-  data->uri = g_strdup (uri);
-  data->finished = finished;
-  data->user_data = user_data;
-  data->thumbnail_path = mex_get_thumbnail_path_for_uri (uri);
-  data->mime = get_mime_type (uri);
+  job->uri = g_strdup (uri);
+  job->mime = g_strdup (mime);
+  job->thumbnail_path = mex_get_thumbnail_path_for_uri (uri);
 
-  return data;
+  return job;
 }
 
 static void
-thumbnail_data_free (ThumbnailData *data)
+thumbnail_job_free (ThumbnailJob *job)
 {
-  g_free (data->uri);
-  g_free (data->mime);
-  g_free (data->thumbnail_path);
-  g_slice_free (ThumbnailData, data);
+  g_free (job->uri);
+  g_free (job->mime);
+  g_free (job->thumbnail_path);
+  g_slice_free (ThumbnailJob, job);
+}
+
+/* Must be called with thumbnail_lock held */
+static void
+thumbnail_job_update_priority (ThumbnailJob *job)
+{
+  MexThumbnailPriority priority = MEX_THUMBNAIL_PRIORITY_LOW;
+  GList *l;
+
+  for (l = job->requests; l; l = l->next)
+    {
+      MexThumbnailRequest *request = l->data;
+
+      priority = MAX (priority, request->priority);
+    }
+
+  if (job->link && priority != job->priority)
+    {
+      g_queue_unlink (&thumbnail_pending[job->priority], job->link);
+      g_queue_push_tail_link (&thumbnail_pending[priority], job->link);
+    }
+
+  job->priority = priority;
 }
 
 static gboolean
 mex_internal_thumbnail_finished (gpointer user_data)
 {
-  ThumbnailData *data = user_data;
+  ThumbnailJob *job = user_data;
+  MexThumbnailRequest *request;
+
+  g_hash_table_remove (thumbnail_jobs, job->uri);
+
+  /* Callbacks may cancel the requests that are still to be notified */
+  while ((request = job->requests ? job->requests->data : NULL))
+    {
+      job->requests = g_list_delete_link (job->requests, job->requests);
+
+      request->callback (job->uri, request->user_data);
 
-  data->finished (data->uri, data->user_data);
-  thumbnail_data_free (data);
+      g_slice_free (MexThumbnailRequest, request);
+    }
+
+  thumbnail_job_free (job);
 
   return FALSE;
 }
 
+static const gchar *
+get_thumbnailer_path (void)
+{
+  static gsize initialized = 0;
+  static gchar *thumbnailer_path = NULL;
+
+  if (g_once_init_enter (&initialized))
+    {
+      gchar *path = g_build_filename (LIBEXECDIR, "mex-thumbnailer", NULL);
+
+      /* if mex-thumbnailer is not in LIBEXECDIR, search the PATH */
+      if (!g_file_test (path, G_FILE_TEST_EXISTS))
+        {
+          g_free (path);
+          path = g_find_program_in_path ("mex-thumbnailer");
+        }
+
+      if (!path)
+        g_warning ("Could not locate mex-thumbnailer");
+
+      thumbnailer_path = path;
+      g_once_init_leave (&initialized, 1);
+    }
+
+  return thumbnailer_path;
+}
+
 static void
-mex_internal_thumbnail_start (ThumbnailData *data,
-                              gpointer       foo)
+thumbnail_worker_child_setup (gpointer user_data)
+{
+  gint fd = GPOINTER_TO_INT (user_data);
+
+  dup2 (fd, STDIN_FILENO);
+  dup2 (fd, STDOUT_FILENO);
+}
 
+static void
+thumbnail_worker_exited_cb (GPid     pid,
+                            gint     status,
+                            gpointer user_data)
 {
-  int status;
-  gchar *argv[5], *output;
+  g_spawn_close_pid (pid);
+}
+
+static ThumbnailWorker *
+thumbnail_worker_new (void)
+{
+  ThumbnailWorker *worker;
+  const gchar *path;
+  gchar *argv[3];
   GError *err = NULL;
+  gint fds[2];
+  GPid pid;
 
-  if (!data->mime)
-    return;
+  path = get_thumbnailer_path ();
+  if (!path)
+    return NULL;
 
-  if (g_str_has_prefix (data->mime, "image/")
-      || g_str_has_prefix (data->mime, "video/"))
+  /* A socket rather than pipes so that writing to a worker that died
+   * can't raise SIGPIPE in our process */
+  if (socketpair (AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) < 0)
     {
-      argv[0] = g_build_filename (LIBEXECDIR, "mex-thumbnailer", NULL);
+      g_warning (G_STRLOC ": %s", g_strerror (errno));
+      return NULL;
+    }
 
-      /* if mex-thumbnailer is not in LIBEXECDIR, search the PATH */
-      if (!g_file_test (argv[0], G_FILE_TEST_EXISTS))
-        {
-          gchar *path = g_strdup (getenv ("PATH"));
-          gchar **paths;
-          int i;
+  argv[0] = (gchar *) path;
+  argv[1] = "--server";
+  argv[2] = NULL;
+
+  if (!g_spawn_async (NULL, argv, NULL,
+                      G_SPAWN_DO_NOT_REAP_CHILD | G_SPAWN_CHILD_INHERITS_STDIN,
+                      thumbnail_worker_child_setup, GINT_TO_POINTER (fds[1]),
+                      &pid, &err))
+    {
+      g_warning ("Error: %s", err->message);
+      g_clear_error (&err);
+      close (fds[0]);
+      close (fds[1]);
+      return NULL;
+    }
 
-          g_free (argv[0]);
+  close (fds[1]);
+  g_child_watch_add (pid, thumbnail_worker_exited_cb, NULL);
 
-          paths = g_strsplit (path, G_SEARCHPATH_SEPARATOR_S, -1);
+  worker = g_slice_new0 (ThumbnailWorker);
+  worker->pid = pid;
+  worker->fd = fds[0];
 
-          for (i = 0; paths[i]; i++)
-            {
-              argv[0] = g_build_filename (paths[i], "mex-thumbnailer", NULL);
+  return worker;
+}
 
-              if (g_file_test (argv[0], G_FILE_TEST_EXISTS))
-                break;
+static void
+thumbnail_worker_free (ThumbnailWorker *worker,
+                       gboolean         kill_worker)
+{
+  /* Closing the socket makes an idle worker exit on its own */
+  if (kill_worker)
+    kill (worker->pid, SIGKILL);
 
-              g_free (argv[0]);
-              argv[0] = NULL;
-            }
+  close (worker->fd);
+  g_slice_free (ThumbnailWorker, worker);
+}
 
-          g_free (path);
-          g_strfreev (paths);
+/* Returns FALSE if the request could not even be sent, in which case the
+ * worker is dead and the request can be retried on a new one. */
+static gboolean
+thumbnail_worker_send (ThumbnailWorker *worker,
+                       ThumbnailJob    *job)
+{
+  gchar *request, *p;
+  gsize length;
+
+  request = g_strdup_printf ("%s\t%s\t%s\n",
+                             job->mime, job->uri, job->thumbnail_path);
+  length = strlen (request);
+
+  for (p = request; length; )
+    {
+      gssize sent = send (worker->fd, p, length, MSG_NOSIGNAL);
+
+      if (sent < 0)
+        {
+          if (errno == EINTR)
+            continue;
+
+          g_free (request);
+          return FALSE;
         }
 
-      if (!argv[0])
+      p += sent;
+      length -= sent;
+    }
+
+  g_free (request);
+
+  return TRUE;
+}
+
+/* Waits for the worker to answer the current request. Returns FALSE if
+ * it crashed or stopped responding, in which case it must be freed. */
+static gboolean
+thumbnail_worker_wait_reply (ThumbnailWorker *worker)
+{
+  struct pollfd pfd;
+  gchar reply[16];
+  gsize length = 0;
+
+  pfd.fd = worker->fd;
+  pfd.events = POLLIN;
+
+  while (length < sizeof (reply))
+    {
+      gssize received;
+      gint ready;
+
+      ready = poll (&pfd, 1, THUMBNAIL_WORKER_TIMEOUT);
+      if (ready < 0 && errno == EINTR)
+        continue;
+      if (ready <= 0)
         {
-          g_warning ("Could not locate mex-thumbnailer");
+          g_warning ("mex-thumbnailer did not respond, restarting it");
+          return FALSE;
         }
-      else
+
+      received = recv (worker->fd, reply + length, sizeof (reply) - length, 0);
+      if (received < 0 && errno == EINTR)
+        continue;
+      if (received <= 0)
         {
-          argv[1] = data->mime;
-          argv[2] = data->uri;
-          argv[3] = data->thumbnail_path;
-          argv[4] = NULL;
-
-          g_spawn_sync (NULL, argv, NULL, 0, NULL, NULL, NULL, &output, &status,
-                        &err);
-          if (err)
-            {
-              g_warning ("Error: %s", err->message);
-              g_clear_error (&err);
-            }
-
-          g_free (argv[0]);
+          g_warning ("mex-thumbnailer exited unexpectedly, restarting it");
+          return FALSE;
         }
+
+      length += received;
+      if (reply[length - 1] == '\n')
+        return TRUE;
     }
 
-  clutter_threads_add_timeout (0, mex_internal_thumbnail_finished, data);
+  return FALSE;
 }
 
 static void
-mex_internal_thumbnail (const gchar          *uri,
-                        MexThumbnailCallback  finished,
-                        gpointer              data)
+mex_internal_thumbnail_start (gpointer token,
+                              gpointer foo)
+
 {
-  GError *err = NULL;
+  ThumbnailWorker *worker;
+  ThumbnailJob *job = NULL;
+  gboolean retried = FALSE;
+  gint i;
+
+  g_mutex_lock (&thumbnail_lock);
+  for (i = MEX_THUMBNAIL_PRIORITY_HIGH; i >= 0 && !job; i--)
+    job = g_queue_pop_head (&thumbnail_pending[i]);
+  if (job)
+    {
+      job->link = NULL;
+      job->running = TRUE;
+    }
+  g_mutex_unlock (&thumbnail_lock);
 
-  if (!thumbnail_thread_pool)
-    thumbnail_thread_pool = g_thread_pool_new ((GFunc)mex_internal_thumbnail_start,
-                                               NULL,
-                                               mex_os_get_n_cores (),
-                                               FALSE, &err);
+  /* The job this token was pushed for has been cancelled */
+  if (!job)
+    return;
 
-  if (err)
+  if (!job->mime)
+    job->mime = get_mime_type (job->uri);
+
+  if (!job->mime ||
+      (!g_str_has_prefix (job->mime, "image/")
+       && !g_str_has_prefix (job->mime, "video/")))
+    goto finished;
+
+  worker = g_async_queue_try_pop (thumbnail_idle_workers);
+
+  while (TRUE)
     {
-      g_warning (G_STRLOC ": %s", err->message);
-      g_clear_error (&err);
-      return;
+      if (!worker && !(worker = thumbnail_worker_new ()))
+        break;
+
+      if (thumbnail_worker_send (worker, job))
+        break;
+
+      /* An idle worker died since its last request, start a new one */
+      thumbnail_worker_free (worker, FALSE);
+      worker = NULL;
+
+      if (retried)
+        break;
+      retried = TRUE;
     }
 
-  g_thread_pool_push (thumbnail_thread_pool,
-                      thumbnail_data_new (uri, finished, data), &err);
+  if (worker)
+    {
+      /* A worker that crashes or hangs on a file is not given that file
+       * again, the next request will simply spawn a new worker */
+      if (!thumbnail_worker_wait_reply (worker))
+        thumbnail_worker_free (worker, TRUE);
+      else if (++worker->n_requests >= THUMBNAIL_WORKER_MAX_REQUESTS)
+        thumbnail_worker_free (worker, FALSE);
+      else
+        g_async_queue_push (thumbnail_idle_workers, worker);
+    }
+
+finished:
+  clutter_threads_add_timeout (0, mex_internal_thumbnail_finished, job);
+}
+
+static gboolean
+mex_internal_thumbnail_init (void)
+{
+  GError *err = NULL;
+
+  if (thumbnail_thread_pool)
+    return TRUE;
+
+  thumbnail_thread_pool = g_thread_pool_new (mex_internal_thumbnail_start,
+                                             NULL,
+                                             mex_os_get_n_cores (),
+                                             FALSE, &err);
   if (err)
     {
       g_warning (G_STRLOC ": %s", err->message);
       g_clear_error (&err);
-      return;
+      return FALSE;
     }
+
+  thumbnail_idle_workers = g_async_queue_new ();
+  thumbnail_jobs = g_hash_table_new (g_str_hash, g_str_equal);
+
+  return TRUE;
 }
 
 static char *
@@ -242,9 +494,11 @@ get_mime_type (const char *uri)
  * @user_data: data to pass to @callback
  *
  * Attempt to generate a thumbnail for @url asynchronously.  When thumbnailing
- * is complete, @callback is called.  If thumbnailing isn't possible or fails no
- * callback will be made, so it is recommended to set a fallback image before
- * calling this function.
+ * is complete, @callback is called.  Thumbnailing may not be possible or may
+ * fail, so it is recommended to set a fallback image before calling this
+ * function and to check that the thumbnail exists in @callback.
+ *
+ * The request can't be cancelled, see mex_thumbnailer_request() for that.
  */
 void
 mex_thumbnailer_generate (const char           *url,
@@ -252,6 +506,139 @@ mex_thumbnailer_generate (const char           *url,
                           MexThumbnailCallback  callback,
                           gpointer              user_data)
 {
-  mex_internal_thumbnail (url, callback, user_data);
-  return;
+  mex_thumbnailer_request (url, mime_type, MEX_THUMBNAIL_PRIORITY_NORMAL,
+                           callback, user_data);
+}
+
+/**
+ * mex_thumbnailer_request: (skip)
+ * @url: the URL to thumbnail
+ * @mime_type: the MIME type of the URL (will be sniffed if %NULL)
+ * @priority: a #MexThumbnailPriority
+ * @callback: function to callback when thumbnailing is complete
+ * @user_data: data to pass to @callback
+ *
+ * Like mex_thumbnailer_generate(), but returns a handle that can be used to
+ * change the priority of the request or to cancel it. Unless cancelled,
+ * @callback is called exactly once. Requests for a URL that is already
+ * being thumbnailed share the same work.
+ *
+ * Returns: a handle for the request, valid until @callback is called or
+ *   the request is cancelled, or %NULL if the request could not be queued.
+ */
+MexThumbnailRequest *
+mex_thumbnailer_request (const char           *url,
+                         const char           *mime_type,
+                         MexThumbnailPriority  priority,
+                         MexThumbnailCallback  callback,
+                         gpointer              user_data)
+{
+  MexThumbnailRequest *request;
+  ThumbnailJob *job;
+  GError *err = NULL;
+
+  g_return_val_if_fail (url != NULL, NULL);
+  g_return_val_if_fail (callback != NULL, NULL);
+
+  if (!mex_internal_thumbnail_init ())
+    return NULL;
+
+  request = g_slice_new (MexThumbnailRequest);
+  request->priority = priority;
+  request->callback = callback;
+  request->user_data = user_data;
+
+  job = g_hash_table_lookup (thumbnail_jobs, url);
+  if (job)
+    {
+      request->job = job;
+      job->requests = g_list_prepend (job->requests, request);
+
+      g_mutex_lock (&thumbnail_lock);
+      thumbnail_job_update_priority (job);
+      g_mutex_unlock (&thumbnail_lock);
+
+      return request;
+    }
+
+  job = thumbnail_job_new (url, mime_type);
+  job->priority = priority;
+  job->requests = g_list_prepend (NULL, request);
+  request->job = job;
+
+  g_hash_table_insert (thumbnail_jobs, job->uri, job);
+
+  g_mutex_lock (&thumbnail_lock);
+  g_queue_push_tail (&thumbnail_pending[priority], job);
+  job->link = g_queue_peek_tail_link (&thumbnail_pending[priority]);
+  g_mutex_unlock (&thumbnail_lock);
+
+  /* Tokens carry no data, threads take the most urgent pending job */
+  g_thread_pool_push (thumbnail_thread_pool, GUINT_TO_POINTER (1), &err);
+  if (err)
+    {
+      g_warning (G_STRLOC ": %s", err->message);
+      g_clear_error (&err);
+    }
+
+  return request;
+}
+
+/**
+ * mex_thumbnailer_request_set_priority:
+ * @request: a #MexThumbnailRequest
+ * @priority: the new #MexThumbnailPriority
+ *
+ * Changes the priority of @request, for instance when the item it is for
+ * scrolls into view. This has no effect once thumbnailing has started.
+ */
+void
+mex_thumbnailer_request_set_priority (MexThumbnailRequest  *request,
+                                      MexThumbnailPriority  priority)
+{
+  g_return_if_fail (request != NULL);
+
+  request->priority = priority;
+
+  g_mutex_lock (&thumbnail_lock);
+  thumbnail_job_update_priority (request->job);
+  g_mutex_unlock (&thumbnail_lock);
+}
+
+/**
+ * mex_thumbnailer_cancel:
+ * @request: a #MexThumbnailRequest
+ *
+ * Cancels @request: its callback will not be called and @request is no
+ * longer valid. If no other request shares the same URL and thumbnailing
+ * hasn't started yet, no work is done for it at all.
+ */
+void
+mex_thumbnailer_cancel (MexThumbnailRequest *request)
+{
+  ThumbnailJob *job;
+  gboolean drop = FALSE;
+
+  g_return_if_fail (request != NULL);
+
+  job = request->job;
+  job->requests = g_list_remove (job->requests, request);
+  g_slice_free (MexThumbnailRequest, request);
+
+  g_mutex_lock (&thumbnail_lock);
+  if (job->requests)
+    thumbnail_job_update_priority (job);
+  else if (!job->running)
+    {
+      g_queue_delete_link (&thumbnail_pending[job->priority], job->link);
+      job->link = NULL;
+      drop = TRUE;
+    }
+  g_mutex_unlock (&thumbnail_lock);
+
+  if (drop)
+    {
+      g_hash_table_remove (thumbnail_jobs, job->uri);
+      thumbnail_job_free (job);
+    }
 }
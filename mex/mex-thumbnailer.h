@@ -27,11 +27,37 @@ G_BEGIN_DECLS
 
 typedef void (*MexThumbnailCallback) (const char *uri, gpointer user_data);
 
+typedef struct _MexThumbnailRequest MexThumbnailRequest;
+
+/**
+ * MexThumbnailPriority:
+ * @MEX_THUMBNAIL_PRIORITY_LOW: the thumbnail is not needed any time soon
+ * @MEX_THUMBNAIL_PRIORITY_NORMAL: default priority
+ * @MEX_THUMBNAIL_PRIORITY_HIGH: the thumbnail is for something on screen
+ *
+ * Order in which pending thumbnail requests are served.
+ */
+typedef enum
+{
+  MEX_THUMBNAIL_PRIORITY_LOW,
+  MEX_THUMBNAIL_PRIORITY_NORMAL,
+  MEX_THUMBNAIL_PRIORITY_HIGH
+} MexThumbnailPriority;
+
 void mex_thumbnailer_generate (const char *url,
                                const char *mime_type,
                                MexThumbnailCallback callback,
                                gpointer user_data);
 
+MexThumbnailRequest *mex_thumbnailer_request (const char           *url,
+                                              const char           *mime_type,
+                                              MexThumbnailPriority  priority,
+                                              MexThumbnailCallback  callback,
+                                              gpointer              user_data);
+void mex_thumbnailer_request_set_priority (MexThumbnailRequest  *request,
+                                           MexThumbnailPriority  priority);
+void mex_thumbnailer_cancel (MexThumbnailRequest *request);
+
 gchar * mex_get_thumbnail_path_for_uri (const gchar *uri);
 
 G_END_DECLS
@@ -0,0 +1,273 @@
+/*
+ * Mex - a media explorer
+ *
+ * Copyright © 2010, 2011 Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses>
+ */
+
+/*
+ * Records named spans and marks, timestamped with the monotonic clock, to
+ * see where the time goes during startup. Tracing is enabled by setting
+ * MEX_TRACE to the file the trace should be written to, or by calling
+ * mex_trace_enable(). The trace is written in the Trace Event format, it
+ * can be loaded in chrome://tracing.
+ *
+ * Spans can be recorded from any thread.
+ */
+
+#include <string.h>
+
+#include "mex-trace.h"
+
+typedef struct
+{
+  gchar    *name;
+  gint64    start;
+  gint64    duration;
+  gboolean  main_thread;
+} TraceEvent;
+
+G_LOCK_DEFINE_STATIC (trace);
+
+static gboolean  trace_enabled = FALSE;
+static gchar    *trace_filename = NULL;
+static gint64    trace_origin = 0;
+static GThread  *trace_thread = NULL;
+static GArray   *trace_events = NULL;
+
+static void
+mex_trace_init (void)
+{
+  static gsize initialised = 0;
+
+  if (g_once_init_enter (&initialised))
+    {
+      const gchar *filename = g_getenv ("MEX_TRACE");
+
+      if (filename && *filename && !trace_enabled)
+        mex_trace_enable (filename);
+
+      g_once_init_leave (&initialised, TRUE);
+    }
+}
+
+/**
+ * mex_trace_enable:
+ * @filename: (allow-none): where mex_trace_write() writes the trace, or
+ *   %NULL to only record it
+ *
+ * Starts recording spans, if it wasn't already. Timestamps are relative to
+ * the first call, which should be done from the main thread, as early as
+ * possible.
+ */
+void
+mex_trace_enable (const gchar *filename)
+{
+  G_LOCK (trace);
+
+  if (!trace_events)
+    {
+      trace_events = g_array_new (FALSE, FALSE, sizeof (TraceEvent));
+      trace_origin = g_get_monotonic_time ();
+      trace_thread = g_thread_self ();
+    }
+
+  g_free (trace_filename);
+  trace_filename = g_strdup (filename);
+  trace_enabled = TRUE;
+
+  G_UNLOCK (trace);
+}
+
+gboolean
+mex_trace_enabled (void)
+{
+  mex_trace_init ();
+
+  return trace_enabled;
+}
+
+static void
+mex_trace_record (gchar  *name,
+                  gint64  start,
+                  gint64  duration)
+{
+  TraceEvent event;
+
+  event.name = name;
+  event.duration = duration;
+  event.main_thread = (g_thread_self () == trace_thread);
+
+  G_LOCK (trace);
+  event.start = start - trace_origin;
+  g_array_append_val (trace_events, event);
+  G_UNLOCK (trace);
+}
+
+/**
+ * mex_trace_begin:
+ *
+ * Return value: the time to pass to mex_trace_end() once the span is over,
+ *   or 0 if tracing isn't enabled
+ */
+gint64
+mex_trace_begin (void)
+{
+  return mex_trace_enabled () ? g_get_monotonic_time () : 0;
+}
+
+/**
+ * mex_trace_end:
+ * @begin: the value returned by mex_trace_begin(), or any
+ *   g_get_monotonic_time() timestamp
+ * @format: printf-style name of the span
+ *
+ * Records a span going from @begin to now. Does nothing if @begin is 0.
+ */
+void
+mex_trace_end (gint64       begin,
+               const gchar *format,
+               ...)
+{
+  gint64 now;
+  va_list args;
+  gchar *name;
+
+  if (!mex_trace_enabled () || begin == 0)
+    return;
+
+  now = g_get_monotonic_time ();
+
+  va_start (args, format);
+  name = g_strdup_vprintf (format, args);
+  va_end (args);
+
+  mex_trace_record (name, begin, now - begin);
+}
+
+/**
+ * mex_trace_mark:
+ * @format: printf-style name of the mark
+ *
+ * Records that something happened, now.
+ */
+void
+mex_trace_mark (const gchar *format,
+                ...)
+{
+  gint64 now;
+  va_list args;
+  gchar *name;
+
+  if (!mex_trace_enabled ())
+    return;
+
+  now = g_get_monotonic_time ();
+
+  va_start (args, format);
+  name = g_strdup_vprintf (format, args);
+  va_end (args);
+
+  mex_trace_record (name, now, -1);
+}
+
+/**
+ * mex_trace_get_time:
+ *
+ * Return value: the time elapsed since tracing was enabled, in
+ *   microseconds, or 0 if it isn't
+ */
+gint64
+mex_trace_get_time (void)
+{
+  if (!mex_trace_enabled ())
+    return 0;
+
+  return g_get_monotonic_time () - trace_origin;
+}
+
+static void
+append_json_string (GString     *string,
+                    const gchar *value)
+{
+  const gchar *p;
+
+  g_string_append_c (string, '"');
+
+  for (p = value; *p; p++)
+    {
+      if (*p == '"' || *p == '\\')
+        g_string_append_printf (string, "\\%c", *p);
+      else if ((guchar) *p < 0x20)
+        g_string_append_printf (string, "\\u%04x", (guchar) *p);
+      else
+        g_string_append_c (string, *p);
+    }
+
+  g_string_append_c (string, '"');
+}
+
+/**
+ * mex_trace_write:
+ * @error: return location for a #GError, or %NULL
+ *
+ * Writes what has been recorded so far to the file given to
+ * mex_trace_enable(). Does nothing if tracing isn't enabled, or if there
+ * is no such file.
+ *
+ * Return value: %FALSE if the file couldn't be written
+ */
+gboolean
+mex_trace_write (GError **error)
+{
+  GString *json;
+  gboolean success;
+  guint i;
+
+  if (!mex_trace_enabled () || !trace_filename)
+    return TRUE;
+
+  json = g_string_new ("{\"traceEvents\":[\n");
+
+  G_LOCK (trace);
+
+  for (i = 0; i < trace_events->len; i++)
+    {
+      TraceEvent *event = &g_array_index (trace_events, TraceEvent, i);
+
+      g_string_append (json, "{\"name\":");
+      append_json_string (json, event->name);
+
+      if (event->duration < 0)
+        g_string_append_printf (json, ",\"ph\":\"i\",\"s\":\"g\""
+                                ",\"ts\":%" G_GINT64_FORMAT,
+                                event->start);
+      else
+        g_string_append_printf (json, ",\"ph\":\"X\",\"ts\":%" G_GINT64_FORMAT
+                                ",\"dur\":%" G_GINT64_FORMAT,
+                                event->start, event->duration);
+
+      g_string_append_printf (json, ",\"pid\":1,\"tid\":%d}%s\n",
+                              event->main_thread ? 1 : 2,
+                              i + 1 < trace_events->len ? "," : "");
+    }
+
+  success = g_file_set_contents (trace_filename, json->str, json->len, error);
+
+  G_UNLOCK (trace);
+
+  g_string_free (json, TRUE);
+
+  return success;
+}
@@ -0,0 +1,41 @@
+/*
+ * Mex - a media explorer
+ *
+ * Copyright © 2010, 2011 Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses>
+ */
+
+#ifndef __MEX_TRACE_H__
+#define __MEX_TRACE_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+void     mex_trace_enable   (const gchar *filename);
+gboolean mex_trace_enabled  (void);
+
+gint64   mex_trace_begin    (void);
+void     mex_trace_end      (gint64       begin,
+                             const gchar *format,
+                             ...) G_GNUC_PRINTF (2, 3);
+void     mex_trace_mark     (const gchar *format,
+                             ...) G_GNUC_PRINTF (1, 2);
+gint64   mex_trace_get_time (void);
+
+gboolean mex_trace_write    (GError **error);
+
+G_END_DECLS
+
+#endif /* __MEX_TRACE_H__ */
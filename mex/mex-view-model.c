@@ -72,6 +72,7 @@ struct _MexViewModelPrivate
   MexModel *model;
 
   MexContent *start_content;
+  gint        start_offset;
   guint       limit;
   guint       offset;
 
@@ -81,6 +82,10 @@ struct _MexViewModelPrivate
   GPtrArray *external_items;
   GPtrArray *internal_items;
 
+  /* external item -> index, valid for indices below positions_valid */
+  GHashTable *positions;
+  guint       positions_valid;
+
   GList *filter_by;
 
   MexContentMetadata order_by_key;
@@ -88,6 +93,17 @@ struct _MexViewModelPrivate
 
   MexContentMetadata group_by_key;
   GHashTable *group_items;
+  const MexModelCategoryInfo *category_info;
+
+  /* content -> collation key of the order-by value */
+  GHashTable *sort_keys;
+  /* content -> lower-cased group-by value */
+  GHashTable *group_keys;
+
+  /* internal item -> external item representing it */
+  GHashTable *item_map;
+  /* external item -> number of internal items it represents */
+  GHashTable *external_refs;
 
   GController *controller;
 
@@ -100,6 +116,7 @@ static void mex_view_model_controller_changed_cb (GController          *controll
                                                   MexViewModel         *self);
 
 static void mex_view_model_refresh_external_items (MexViewModel *model);
+static void mex_view_model_load_internal_items (MexViewModel *self);
 static void content_notify_cb (GObject *content, GParamSpec *pspec, MexViewModel *view);
 
 static void
@@ -116,12 +133,11 @@ mex_view_model_set_model (MexViewModel *self,
       g_object_unref (priv->start_content);
       priv->start_content = NULL;
     }
+  priv->start_offset = -1;
 
   if (model)
     {
-      MexContent *content;
       GController *controller;
-      gint i = 0;
 
       priv->model = g_object_ref_sink (model);
 
@@ -135,19 +151,10 @@ mex_view_model_set_model (MexViewModel *self,
 
       /* copy initial items across */
       g_ptr_array_set_size (priv->internal_items, 0);
+      g_hash_table_remove_all (priv->group_keys);
+      priv->category_info = NULL;
 
-      while ((content = mex_model_get_content (priv->model, i++)))
-        {
-          g_ptr_array_add (priv->internal_items, g_object_ref (content));
-
-          g_signal_connect (content, "notify", G_CALLBACK (content_notify_cb),
-                            self);
-
-          /* any MexProgram objects must have all their data resolved to be
-           * useful in the view model */
-          if (MEX_IS_PROGRAM (content))
-            _mex_program_complete (MEX_PROGRAM (content));
-        }
+      mex_view_model_load_internal_items (self);
     }
 
   if (priv->group_items)
@@ -321,6 +328,36 @@ mex_view_model_finalize (GObject *object)
       priv->group_items = NULL;
     }
 
+  if (priv->positions)
+    {
+      g_hash_table_destroy (priv->positions);
+      priv->positions = NULL;
+    }
+
+  if (priv->sort_keys)
+    {
+      g_hash_table_destroy (priv->sort_keys);
+      priv->sort_keys = NULL;
+    }
+
+  if (priv->group_keys)
+    {
+      g_hash_table_destroy (priv->group_keys);
+      priv->group_keys = NULL;
+    }
+
+  if (priv->item_map)
+    {
+      g_hash_table_destroy (priv->item_map);
+      priv->item_map = NULL;
+    }
+
+  if (priv->external_refs)
+    {
+      g_hash_table_destroy (priv->external_refs);
+      priv->external_refs = NULL;
+    }
+
   g_free (priv->title);
   priv->title = NULL;
 
@@ -339,6 +376,40 @@ mex_view_model_get_model (MexModel *model)
   return priv->model;
 }
 
+/* Looks up the index of @item in the external items, bringing the positions
+ * index up to date first if it has been invalidated by an insertion or
+ * removal before the item */
+static gint
+mex_view_model_external_index (MexViewModel *model,
+                               MexContent   *item)
+{
+  MexViewModelPrivate *priv = model->priv;
+  GPtrArray *array = priv->external_items;
+  gpointer value;
+  guint i;
+
+  if (g_hash_table_lookup_extended (priv->positions, item, NULL, &value))
+    {
+      i = GPOINTER_TO_UINT (value);
+
+      if (i < priv->positions_valid && array->pdata[i] == item)
+        return i;
+    }
+
+  if (priv->positions_valid >= array->len)
+    return -1;
+
+  for (i = priv->positions_valid; i < array->len; i++)
+    g_hash_table_insert (priv->positions, array->pdata[i],
+                         GUINT_TO_POINTER (i));
+  priv->positions_valid = array->len;
+
+  if (g_hash_table_lookup_extended (priv->positions, item, NULL, &value))
+    return GPOINTER_TO_UINT (value);
+
+  return -1;
+}
+
 static MexContent *
 mex_view_model_get_content (MexModel *model, guint idx)
 {
@@ -353,21 +424,14 @@ mex_view_model_get_content (MexModel *model, guint idx)
 
   if (priv->start_content)
     {
-      gboolean found = FALSE;
-
-      for (; start < priv->external_items->len; start++)
-        if (g_ptr_array_index (priv->external_items, start) == priv->start_content)
-          {
-            found = TRUE;
-            break;
-          }
-
       /* start at was not found */
-      if (!found)
+      if (priv->start_offset < 0)
         {
           g_critical (G_STRLOC ": start_at content is invalid in MexModelView");
           return NULL;
         }
+
+      start = priv->start_offset;
     }
 
   if (start + idx >= priv->external_items->len)
@@ -397,8 +461,7 @@ static gint
 mex_view_model_index (MexModel *model, MexContent *content)
 {
   MexViewModelPrivate *priv = MEX_VIEW_MODEL (model)->priv;
-  gint start = 0, idx = 0, position;
-  gboolean found;
+  gint start = 0, idx;
 
   if (!content)
     return -1;
@@ -406,50 +469,55 @@ mex_view_model_index (MexModel *model, MexContent *content)
   /* find the start content's index */
   if (priv->start_content)
     {
-      found = FALSE;
-
-      for (; start < priv->external_items->len; start++)
-        if (g_ptr_array_index (priv->external_items, start) == priv->start_content)
-          {
-            found = TRUE;
-            break;
-          }
-
-      if (!found)
+      if (priv->start_offset < 0)
         {
           g_critical (G_STRLOC ": start_at content is invalid in MexModelView");
           return -1;
         }
+
+      start = priv->start_offset;
     }
 
   /* find the search item's index */
-  found = FALSE;
-  idx = position = start;
-  while (idx < priv->external_items->len)
+  idx = mex_view_model_external_index (MEX_VIEW_MODEL (model), content);
+  if (idx < 0)
+    return -1;
+
+  /* items before the start content are only reachable if the model loops */
+  if (idx < start)
     {
-      if (g_ptr_array_index (priv->external_items, idx) == content)
-        {
-          found = TRUE;
-          break;
-        }
+      if (!priv->looped)
+        return -1;
+
+      idx += priv->external_items->len;
+    }
 
-      /* check if search has looped */
-      if (priv->looped && idx + 1 == start)
-        break;
+  return idx - start;
+}
 
-      /* loop if required */
-      if (priv->looped && idx + 1 == priv->external_items->len)
-        idx = -1;
+static void
+mex_view_model_set_visible_range (MexModel *model,
+                                  guint     first,
+                                  guint     last)
+{
+  MexViewModelPrivate *priv = MEX_VIEW_MODEL (model)->priv;
+  guint length, model_length;
 
-      idx++;
+  /* A limited view only ever shows the start of the model */
+  if (!priv->model || priv->limit)
+    return;
 
-      position++;
-    }
+  length = priv->external_items->len;
+  model_length = mex_model_get_length (priv->model);
+  if (!length || !model_length)
+    return;
 
-  if (!found)
-    return -1;
+  /* Filtering, grouping and sorting don't keep the order of the model,
+   * pass on how far into the view the range is */
+  first = (guint64) first * model_length / length;
+  last = (guint64) (last + 1) * model_length / length;
 
-  return position;
+  mex_model_set_visible_range (priv->model, first, MAX (first + 1, last) - 1);
 }
 
 static void
@@ -465,6 +533,7 @@ mex_model_iface_init (MexModelIface *iface)
   iface->get_controller = mex_view_model_get_controller;
   iface->get_length = mex_view_model_get_length;
   iface->index = mex_view_model_index;
+  iface->set_visible_range = mex_view_model_set_visible_range;
 
   /* TODO: this should not be part of the MexModel interface */
   iface->get_model = mex_view_model_get_model;
@@ -541,7 +610,18 @@ mex_view_model_init (MexViewModel *self)
 
   priv->controller = g_ptr_array_controller_new (priv->external_items);
 
+  priv->group_items = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                             g_free, g_object_unref);
+  priv->positions = g_hash_table_new (g_direct_hash, g_direct_equal);
+  priv->item_map = g_hash_table_new (g_direct_hash, g_direct_equal);
+  priv->sort_keys = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                           NULL, g_free);
+  priv->group_keys = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                            NULL, g_free);
+  priv->external_refs = g_hash_table_new (g_direct_hash, g_direct_equal);
+
   priv->order_by_key = MEX_CONTENT_METADATA_TITLE;
+  priv->start_offset = -1;
 }
 
 MexModel *
@@ -550,11 +630,45 @@ mex_view_model_new (MexModel *model)
   return g_object_new (MEX_TYPE_VIEW_MODEL, "model", model, NULL);
 }
 
-typedef struct
+static const gchar *
+mex_view_model_get_sort_key (MexViewModel *model,
+                             MexContent   *content)
 {
-  MexContentMetadata key;
-  gboolean descending;
-} SortFuncInfo;
+  MexViewModelPrivate *priv = model->priv;
+  gpointer key;
+
+  if (!g_hash_table_lookup_extended (priv->sort_keys, content, NULL, &key))
+    {
+      const gchar *value;
+
+      value = mex_content_get_metadata (content, priv->order_by_key);
+      key = (value) ? g_utf8_collate_key (value, -1) : NULL;
+
+      g_hash_table_insert (priv->sort_keys, content, key);
+    }
+
+  return key;
+}
+
+static const gchar *
+mex_view_model_get_group_key (MexViewModel *model,
+                              MexContent   *content)
+{
+  MexViewModelPrivate *priv = model->priv;
+  gpointer key;
+
+  if (!g_hash_table_lookup_extended (priv->group_keys, content, NULL, &key))
+    {
+      const gchar *value;
+
+      value = mex_content_get_metadata (content, priv->group_by_key);
+      key = (value) ? g_utf8_strdown (value, -1) : NULL;
+
+      g_hash_table_insert (priv->group_keys, content, key);
+    }
+
+  return key;
+}
 
 static gint
 order_by_func (gconstpointer a,
@@ -563,31 +677,38 @@ order_by_func (gconstpointer a,
 {
   MexContent **content_a = (MexContent **) a;
   MexContent **content_b = (MexContent **) b;
-  SortFuncInfo *info = user_data;
-  const gchar *value_a, *value_b;
+  MexViewModel *model = user_data;
+  const gchar *key_a, *key_b;
 
-  value_a = mex_content_get_metadata (*content_a, info->key);
-  value_b = mex_content_get_metadata (*content_b, info->key);
+  key_a = mex_view_model_get_sort_key (model, *content_a);
+  key_b = mex_view_model_get_sort_key (model, *content_b);
 
-  if (info->descending)
-    return g_strcmp0 (value_b, value_a);
+  if (model->priv->order_by_descending)
+    return g_strcmp0 (key_b, key_a);
   else
-    return g_strcmp0 (value_a, value_b);
-
+    return g_strcmp0 (key_a, key_b);
 }
 
-static gint
-_g_ptr_array_contains (GPtrArray *haystack, gpointer needle)
+/* returns the index after the last item that does not sort after @item */
+static guint
+_g_ptr_array_upper_bound (GPtrArray        *array,
+                          gpointer          item,
+                          GCompareDataFunc  compare_func,
+                          gpointer          user_data)
 {
-  gint i;
+  guint first = 0, last = array->len;
 
-  for (i = 0; i < haystack->len; i++)
+  while (first < last)
     {
-      if (haystack->pdata[i] == needle)
-        return i;
+      guint mid = first + (last - first) / 2;
+
+      if (compare_func (&item, &array->pdata[mid], user_data) < 0)
+        last = mid;
+      else
+        first = mid + 1;
     }
 
-  return -1;
+  return first;
 }
 
 static gint
@@ -596,14 +717,10 @@ _g_ptr_array_add_sorted_with_data (GPtrArray *array,
                                    GCompareDataFunc compare_func,
                                    gpointer user_data)
 {
-  gint i;
+  guint i;
 
   /* find the position to insert the item */
-  for (i = 0; i < array->len; i++)
-    {
-      if (compare_func (&item, &array->pdata[i], user_data) < 0)
-        break;
-    }
+  i = _g_ptr_array_upper_bound (array, item, compare_func, user_data);
 
   /* increase the size of the array */
   g_ptr_array_set_size (array, array->len + 1);
@@ -620,279 +737,541 @@ _g_ptr_array_add_sorted_with_data (GPtrArray *array,
   return i;
 }
 
-static void
-mex_view_model_refresh_external_items (MexViewModel *model)
+static gboolean
+mex_view_model_filter_content (MexViewModel *model,
+                               MexContent   *content)
 {
   MexViewModelPrivate *priv = model->priv;
-  gint i;
-  GHashTable *new_items, *external_items;
-  GHashTableIter iter;
-  GHashTable *groups = NULL;
-  GControllerReference *ref;
-  gpointer key;
-  SortFuncInfo info = { priv->order_by_key, priv->order_by_descending };
+  GList *list;
+
+  for (list = priv->filter_by; list; list = g_list_next (list))
+    {
+      FilterKeyValue *filter = list->data;
+      const gchar *v;
+      gboolean skip;
+
+      v = mex_content_get_metadata (content, filter->key);
+
+      /* skip this item if it does not match the filter */
+      skip = g_strcmp0 (v, filter->value);
+
+      if (filter->condition == MEX_FILTER_NOT)
+        skip = (skip == 0);
+
+      if (skip)
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+/*
+ * Works out which external item represents @content: the content itself,
+ * the group item it belongs to, or %NULL if it is filtered out.
+ */
+static MexContent *
+mex_view_model_resolve_content (MexViewModel *model,
+                                MexContent   *content)
+{
+  MexViewModelPrivate *priv = model->priv;
+  MexContent *group_item;
+  const gchar *g, *prop_name, *strlower;
+  const MexModelCategoryInfo *c_info;
+  FilterKeyValue *filter2;
+  gint group_key;
+
+  /* check the item matches the filter */
+  if (!mex_view_model_filter_content (model, content))
+    return NULL;
 
-  /* allocate the full array to start with */
-  new_items = g_hash_table_new_full (g_direct_hash, g_direct_equal, g_object_unref, NULL);
+  if (!priv->group_by_key)
+    return content;
 
-  if (priv->group_by_key)
+  strlower = mex_view_model_get_group_key (model, content);
+
+  if (!strlower)
+    return (priv->skip_ungrouped_items) ? NULL : content;
+
+  group_item = g_hash_table_lookup (priv->group_items, strlower);
+
+  if (group_item)
+    return group_item;
+
+  /* create a group item */
+  if (!priv->category_info)
     {
-      groups = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+      gchar *category = NULL;
 
-      if (!priv->group_items)
-        priv->group_items = g_hash_table_new_full (g_str_hash, g_str_equal,
-                                                   g_free, NULL);
+      g_object_get (G_OBJECT (model), "category", &category, NULL);
+      priv->category_info =
+        mex_model_manager_get_category_info (mex_model_manager_get_default (),
+                                             category);
+      g_free (category);
     }
+  c_info = priv->category_info;
 
-  /* add the items to the new list */
-  for (i = 0; i < priv->internal_items->len; i++)
+  g = mex_content_get_metadata (content, priv->group_by_key);
+
+  if (priv->filter_by
+      && ((FilterKeyValue*) priv->filter_by->data)->condition != MEX_FILTER_NOT)
+    filter2 = priv->filter_by->data;
+  else
+    filter2 = NULL;
+
+  if (c_info && c_info->primary_group_by_key == priv->group_by_key)
+    group_key = c_info->secondary_group_by_key;
+  else
+    group_key = 0;
+
+  group_item =
+    (MexContent*) mex_group_item_new (g,
+                                      priv->model,
+                                      /* filter key, value */
+                                      priv->group_by_key, g,
+                                      /* second filter key, value*/
+                                      (filter2) ? filter2->key : 0,
+                                      (filter2) ? filter2->value : NULL,
+                                      /* group key */
+                                      group_key);
+
+  prop_name = mex_content_get_property_name (MEX_CONTENT (content),
+                                             MEX_CONTENT_METADATA_STILL);
+  g_object_bind_property (content, prop_name, group_item, prop_name,
+                          G_BINDING_SYNC_CREATE);
+
+  prop_name = mex_content_get_property_name (MEX_CONTENT (content),
+                                             MEX_CONTENT_METADATA_ALBUM);
+  g_object_bind_property (content, prop_name, group_item, prop_name,
+                          G_BINDING_SYNC_CREATE);
+
+  prop_name = mex_content_get_property_name (MEX_CONTENT (content),
+                                             MEX_CONTENT_METADATA_ARTIST);
+  g_object_bind_property (content, prop_name, group_item, prop_name,
+                          G_BINDING_SYNC_CREATE);
+
+  /* add this item to the group items cache, which owns the reference */
+  g_hash_table_insert (priv->group_items, g_strdup (strlower),
+                       g_object_ref_sink (group_item));
+
+  return group_item;
+}
+
+/* keeps the positions index and the start offset up to date after @item has
+ * been inserted at @position */
+static void
+mex_view_model_item_inserted (MexViewModel *model,
+                              MexContent   *item,
+                              guint         position)
+{
+  MexViewModelPrivate *priv = model->priv;
+
+  priv->positions_valid = MIN (priv->positions_valid, position);
+
+  if (item == priv->start_content)
+    priv->start_offset = position;
+  else if (priv->start_offset >= 0 && (gint) position <= priv->start_offset)
+    priv->start_offset++;
+}
+
+/* keeps the positions index and the start offset up to date before @item is
+ * removed from @position */
+static void
+mex_view_model_item_removed (MexViewModel *model,
+                             MexContent   *item,
+                             guint         position)
+{
+  MexViewModelPrivate *priv = model->priv;
+
+  g_hash_table_remove (priv->positions, item);
+  g_hash_table_remove (priv->sort_keys, item);
+  priv->positions_valid = MIN (priv->positions_valid, position);
+
+  if (priv->start_offset == (gint) position)
+    priv->start_offset = -1;
+  else if (priv->start_offset > (gint) position)
+    priv->start_offset--;
+}
+
+static void
+mex_view_model_insert_external (MexViewModel *model,
+                                MexContent   *item)
+{
+  MexViewModelPrivate *priv = model->priv;
+  GControllerReference *ref;
+  gint position;
+
+  /* add the item */
+  if (priv->order_by_key)
     {
-      MexContent *content, *group_item;
+      position = _g_ptr_array_add_sorted_with_data (priv->external_items,
+                                                    g_object_ref (item),
+                                                    order_by_func, model);
+    }
+  else
+    {
+      g_ptr_array_add (priv->external_items, g_object_ref (item));
 
-      content = g_ptr_array_index (priv->internal_items, i);
+      position = priv->external_items->len - 1;
+    }
+
+  mex_view_model_item_inserted (model, item, position);
 
-      /* check the item matches the filter */
-      if (priv->filter_by)
+  /* emit the added signal, if there is no limit or the new index is
+   * less than the limit */
+  if (!priv->limit || position < priv->limit)
+    {
+      ref = g_controller_create_reference (priv->controller,
+                                           G_CONTROLLER_ADD,
+                                           G_TYPE_UINT, 1,
+                                           position);
+      g_controller_emit_changed (priv->controller, ref);
+      g_object_unref (ref);
+
+      if (priv->limit && position < priv->limit
+          && priv->external_items->len > priv->limit)
         {
-          GList *list;
-          const gchar *v;
-          FilterKeyValue *filter;
-          gboolean skip;
+          /* remove the item that is no longer visible */
+          ref = g_controller_create_reference (priv->controller,
+                                               G_CONTROLLER_REMOVE,
+                                               G_TYPE_UINT, 1,
+                                               priv->limit);
+          g_controller_emit_changed (priv->controller, ref);
+          g_object_unref (ref);
+        }
+    }
+}
 
-          for (list = priv->filter_by; list; list = g_list_next (list))
-            {
-              filter = list->data;
+/* Adds all of @items to the external items at once: the new items are sorted
+ * and merged into the existing (sorted) items, and a single reference is
+ * emitted for all of their indices. */
+static void
+mex_view_model_insert_external_batch (MexViewModel *model,
+                                      GPtrArray    *items)
+{
+  MexViewModelPrivate *priv = model->priv;
+  GPtrArray *array = priv->external_items;
+  GControllerReference *ref;
+  guint *insert_at;
+  guint old_len, limit, n_visible, i, j, k;
 
-              v = mex_content_get_metadata (content, filter->key);
+  if (items->len == 0)
+    return;
 
-              /* skip this item if it does not match the filter */
+  if (items->len == 1)
+    {
+      mex_view_model_insert_external (model, items->pdata[0]);
+      return;
+    }
 
-              skip = g_strcmp0 (v, filter->value);
+  old_len = array->len;
+  limit = VIEW_MODEL_LIMIT (priv);
 
-              if (filter->condition == MEX_FILTER_NOT)
-                skip = (skip == 0);
+  /* find where each of the new items goes in the current array */
+  insert_at = g_new (guint, items->len);
 
-              if (skip)
-                {
-                  break;
-                }
-            }
+  if (priv->order_by_key)
+    {
+      g_ptr_array_sort_with_data (items, order_by_func, model);
 
-          if (skip)
-            continue;
-        }
+      for (j = 0; j < items->len; j++)
+        insert_at[j] = _g_ptr_array_upper_bound (array, items->pdata[j],
+                                                 order_by_func, model);
+    }
+  else
+    {
+      for (j = 0; j < items->len; j++)
+        insert_at[j] = old_len;
+    }
 
-      /* create a group item if necessary */
-      if (priv->group_by_key)
+  /* visible items that are pushed past the limit have to be removed while
+   * they can still be looked up */
+  n_visible = MIN (old_len, limit);
+  if (old_len + items->len > limit)
+    {
+      ref = g_controller_create_reference (priv->controller,
+                                           G_CONTROLLER_REMOVE,
+                                           G_TYPE_UINT, 0);
+
+      for (i = n_visible, j = items->len; i-- > 0;)
         {
-          const gchar *g;
-          gchar *strlower;
-          gchar *category = NULL;
-          const MexModelCategoryInfo *c_info;
-
-          g_object_get (G_OBJECT (model), "category", &category, NULL);
-
-          c_info = mex_model_manager_get_category_info (mex_model_manager_get_default (),
-                                                        category);
-          g_free (category);
-
-
-          g = mex_content_get_metadata (content, priv->group_by_key);
-
-          if (!g && priv->skip_ungrouped_items)
-            continue;
-
-          if (g)
-            {
-              /* build up the group list */
-              strlower = g_utf8_strdown (g, -1);
-              if (!g_hash_table_lookup (groups, strlower))
-                {
-                  group_item = g_hash_table_lookup (priv->group_items, strlower);
-
-                  if (!group_item)
-                    {
-                      const gchar *prop_name;
-                      FilterKeyValue *filter2;
-                      gint group_key;
-
-                      if (priv->filter_by
-                          && ((FilterKeyValue*) priv->filter_by->data)->condition != MEX_FILTER_NOT)
-                        filter2 = priv->filter_by->data;
-                      else
-                        filter2 = NULL;
-
-
-                      if (c_info->primary_group_by_key == priv->group_by_key)
-                        group_key = c_info->secondary_group_by_key;
-                      else
-                        group_key = 0;
-
-                      group_item =
-                        (MexContent*) mex_group_item_new (g,
-                                                          priv->model,
-                                                          /* filter key, value */
-                                                          priv->group_by_key, g,
-                                                          /* second filter key, value*/
-                                                          (filter2) ? filter2->key : 0,
-                                                          (filter2) ? filter2->value : NULL,
-                                                          /* group key */
-                                                          group_key);
-
-                      prop_name = mex_content_get_property_name (MEX_CONTENT (content),
-                                                                 MEX_CONTENT_METADATA_STILL);
-                      g_object_bind_property (content, prop_name, group_item, prop_name,
-                                              G_BINDING_SYNC_CREATE);
-
-                      prop_name = mex_content_get_property_name (MEX_CONTENT (content),
-                                                                 MEX_CONTENT_METADATA_ALBUM);
-                      g_object_bind_property (content, prop_name, group_item, prop_name,
-                                              G_BINDING_SYNC_CREATE);
-
-                      prop_name = mex_content_get_property_name (MEX_CONTENT (content),
-                                                                 MEX_CONTENT_METADATA_ARTIST);
-                      g_object_bind_property (content, prop_name, group_item, prop_name,
-                                              G_BINDING_SYNC_CREATE);
-
-
-                      /* keep a list of the groups created during this refresh */
-                      g_hash_table_insert (groups, strlower, group_item);
-
-                      /* add this item to the group items cache */
-                      g_hash_table_insert (priv->group_items,
-                                           g_strdup (strlower), group_item);
-
-                      g_object_ref_sink (group_item);
-                    }
-                  content = group_item;
-                }
-              else
-                {
-                  g_free (strlower);
-                  continue;
-                }
-            }
+          while (j > 0 && insert_at[j - 1] > i)
+            j--;
+
+          if (i + j < limit)
+            break;
+
+          g_controller_reference_add_index (ref, i);
         }
 
-      /* add the item to the list */
-      g_hash_table_insert (new_items, g_object_ref (content), GINT_TO_POINTER (1));
+      if (g_controller_reference_get_n_indices (ref) > 0)
+        g_controller_emit_changed (priv->controller, ref);
+      g_object_unref (ref);
     }
 
-  if (groups)
+  /* merge the new items in, working from the end of the array */
+  g_ptr_array_set_size (array, old_len + items->len);
+
+  i = old_len;
+  k = array->len;
+  for (j = items->len; j-- > 0;)
     {
-      g_hash_table_destroy (groups);
-      groups = NULL;
+      while (i > insert_at[j])
+        array->pdata[--k] = array->pdata[--i];
+
+      array->pdata[--k] = g_object_ref (items->pdata[j]);
+      insert_at[j] = k;
     }
 
+  for (j = 0; j < items->len; j++)
+    mex_view_model_item_inserted (model, items->pdata[j], insert_at[j]);
 
-  /* compare new_items and external_items */
+  /* emit the added signal for all the new items below the limit */
+  ref = g_controller_create_reference (priv->controller,
+                                       G_CONTROLLER_ADD,
+                                       G_TYPE_UINT, 0);
 
-  /* add external_items to a hash table to improve lookup performance */
-  external_items = g_hash_table_new_full (g_direct_hash, g_direct_equal, g_object_unref, NULL);
-  for (i = 0; i < priv->external_items->len; i++)
-    g_hash_table_insert (external_items, g_object_ref (priv->external_items->pdata[i]), GINT_TO_POINTER (1));
+  for (j = 0; j < items->len && insert_at[j] < limit; j++)
+    g_controller_reference_add_index (ref, insert_at[j]);
 
-  /* Remove items first, so that the items added later can be added at the
-   * correct positions with respect to any limit value */
-  /* find items to remove from external_items */
-  g_hash_table_iter_init (&iter, external_items);
-  while (g_hash_table_iter_next (&iter, &key, NULL))
+  if (g_controller_reference_get_n_indices (ref) > 0)
+    g_controller_emit_changed (priv->controller, ref);
+  g_object_unref (ref);
+
+  g_free (insert_at);
+}
+
+static void
+mex_view_model_remove_external_index (MexViewModel *model,
+                                      gint          i)
+{
+  MexViewModelPrivate *priv = model->priv;
+  GControllerReference *ref;
+  gboolean new_item_visible;
+
+  /* emit the removed signal */
+  if (priv->limit == 0 || i < priv->limit)
     {
-      if (!g_hash_table_lookup (new_items, key))
-        {
-          gboolean new_item_visible;
-
-          i = _g_ptr_array_contains (priv->external_items, key);
-
-          /* emit the removed signal */
-          if (priv->limit == 0 || i < priv->limit)
-            {
-              ref = g_controller_create_reference (priv->controller,
-                                                   G_CONTROLLER_REMOVE,
-                                                   G_TYPE_UINT, 1, i);
-              g_controller_emit_changed (priv->controller, ref);
-            }
-
-
-          /* if the item to be removed is below the model's limit and the length
-           * of the items is greater than the limit, then a new item should
-           * become once the old item is removed */
-          if (i < priv->limit && priv->external_items->len > priv->limit)
-            new_item_visible = TRUE;
-          else
-            new_item_visible = FALSE;
-
-          /* remove the item */
-          g_ptr_array_remove_index (priv->external_items, i);
-
-          if (new_item_visible)
-            {
-              /* emit the added signal for the item that is now visible */
-              ref = g_controller_create_reference (priv->controller,
-                                                   G_CONTROLLER_ADD,
-                                                   G_TYPE_UINT, 1,
-                                                   priv->limit - 1);
-              g_controller_emit_changed (priv->controller, ref);
-            }
-
-          i--;
-        }
+      ref = g_controller_create_reference (priv->controller,
+                                           G_CONTROLLER_REMOVE,
+                                           G_TYPE_UINT, 1, i);
+      g_controller_emit_changed (priv->controller, ref);
+      g_object_unref (ref);
+    }
+
+  /* if the item to be removed is below the model's limit and the length
+   * of the items is greater than the limit, then a new item should
+   * become once the old item is removed */
+  if (i < priv->limit && priv->external_items->len > priv->limit)
+    new_item_visible = TRUE;
+  else
+    new_item_visible = FALSE;
+
+  /* remove the item */
+  mex_view_model_item_removed (model, priv->external_items->pdata[i], i);
+  g_ptr_array_remove_index (priv->external_items, i);
+
+  if (new_item_visible)
+    {
+      /* emit the added signal for the item that is now visible */
+      ref = g_controller_create_reference (priv->controller,
+                                           G_CONTROLLER_ADD,
+                                           G_TYPE_UINT, 1,
+                                           priv->limit - 1);
+      g_controller_emit_changed (priv->controller, ref);
+      g_object_unref (ref);
     }
+}
+
+static void
+mex_view_model_remove_external (MexViewModel *model,
+                                MexContent   *item)
+{
+  gint i;
+
+  i = mex_view_model_external_index (model, item);
+
+  if (i >= 0)
+    mex_view_model_remove_external_index (model, i);
+}
+
+/* Moves @item to its correct position if a change in its order-by key means
+ * it is no longer sorted with respect to its neighbours */
+static void
+mex_view_model_resort_external (MexViewModel *model,
+                                MexContent   *item)
+{
+  MexViewModelPrivate *priv = model->priv;
+  gpointer *pdata = priv->external_items->pdata;
+  gint i;
+
+  if (!priv->order_by_key)
+    return;
+
+  i = mex_view_model_external_index (model, item);
+  if (i < 0)
+    return;
+
+  if ((i == 0 || order_by_func (&pdata[i - 1], &pdata[i], model) <= 0)
+      && (i == priv->external_items->len - 1
+          || order_by_func (&pdata[i], &pdata[i + 1], model) <= 0))
+    return;
+
+  g_object_ref (item);
+  mex_view_model_remove_external_index (model, i);
+  mex_view_model_insert_external (model, item);
+  g_object_unref (item);
+}
 
+/* Records @external as the item representing @content, adding it to the
+ * external items if it is the first content it represents. If @pending is
+ * given, new external items are collected there to be added as a batch. */
+static void
+mex_view_model_map_item (MexViewModel *model,
+                         MexContent   *content,
+                         MexContent   *external,
+                         GPtrArray    *pending)
+{
+  MexViewModelPrivate *priv = model->priv;
+  guint n_refs;
 
+  if (!external)
+    return;
+
+  g_hash_table_insert (priv->item_map, content, external);
+
+  n_refs = GPOINTER_TO_UINT (g_hash_table_lookup (priv->external_refs,
+                                                  external));
+  g_hash_table_insert (priv->external_refs, external,
+                       GUINT_TO_POINTER (n_refs + 1));
+
+  if (n_refs == 0)
+    {
+      if (pending)
+        g_ptr_array_add (pending, external);
+      else
+        mex_view_model_insert_external (model, external);
+    }
+}
+
+/* Forgets the item representing @content, removing it from the external
+ * items if no other content is represented by it */
+static void
+mex_view_model_unmap_item (MexViewModel *model,
+                           MexContent   *content)
+{
+  MexViewModelPrivate *priv = model->priv;
+  MexContent *external;
+  guint n_refs;
+
+  external = g_hash_table_lookup (priv->item_map, content);
+  if (!external)
+    return;
+
+  g_hash_table_remove (priv->item_map, content);
+
+  n_refs = GPOINTER_TO_UINT (g_hash_table_lookup (priv->external_refs,
+                                                  external));
+  if (n_refs > 1)
+    {
+      g_hash_table_insert (priv->external_refs, external,
+                           GUINT_TO_POINTER (n_refs - 1));
+      return;
+    }
+
+  g_hash_table_remove (priv->external_refs, external);
+  mex_view_model_remove_external (model, external);
+}
+
+/* Routes a single changed item through the filter, group and order stages
+ * and emits only the controller references needed to reflect the change */
+static void
+mex_view_model_update_item (MexViewModel *model,
+                            MexContent   *content)
+{
+  MexViewModelPrivate *priv = model->priv;
+  MexContent *old_external, *new_external;
+
+  old_external = g_hash_table_lookup (priv->item_map, content);
+  new_external = mex_view_model_resolve_content (model, content);
+
+  if (old_external != new_external)
+    {
+      mex_view_model_unmap_item (model, content);
+      mex_view_model_map_item (model, content, new_external, NULL);
+    }
+  else if (new_external == content)
+    {
+      mex_view_model_resort_external (model, content);
+    }
+}
+
+static void
+mex_view_model_refresh_external_items (MexViewModel *model)
+{
+  MexViewModelPrivate *priv = model->priv;
+  GHashTable *present;
+  GPtrArray *pending;
+  gint i;
+
+  /* work out the external item for each of the internal items */
+  g_hash_table_remove_all (priv->item_map);
+  g_hash_table_remove_all (priv->external_refs);
+
+  for (i = 0; i < priv->internal_items->len; i++)
+    {
+      MexContent *content, *external;
+      guint n_refs;
+
+      content = g_ptr_array_index (priv->internal_items, i);
+      external = mex_view_model_resolve_content (model, content);
+
+      if (!external)
+        continue;
+
+      g_hash_table_insert (priv->item_map, content, external);
+
+      n_refs = GPOINTER_TO_UINT (g_hash_table_lookup (priv->external_refs,
+                                                      external));
+      g_hash_table_insert (priv->external_refs, external,
+                           GUINT_TO_POINTER (n_refs + 1));
+    }
+
+  /* Remove items first, so that the items added later can be added at the
+   * correct positions with respect to any limit value. Walking backwards
+   * keeps the indices of the items still to be checked valid. */
+  for (i = priv->external_items->len - 1; i >= 0; i--)
+    {
+      if (!g_hash_table_lookup (priv->external_refs,
+                                priv->external_items->pdata[i]))
+        mex_view_model_remove_external_index (model, i);
+    }
+
+  /* add a lookup table of external_items to improve lookup performance */
+  present = g_hash_table_new (g_direct_hash, g_direct_equal);
+  for (i = 0; i < priv->external_items->len; i++)
+    g_hash_table_insert (present, priv->external_items->pdata[i],
+                         GINT_TO_POINTER (1));
 
   /* find items to add to external_items */
-  g_hash_table_iter_init (&iter, new_items);
-  while (g_hash_table_iter_next (&iter, &key, NULL))
+  pending = g_ptr_array_new ();
+  for (i = 0; i < priv->internal_items->len; i++)
     {
-      if (!g_hash_table_lookup (external_items, key))
-        {
-          gint position;
-
-          /* add the item */
-          if (priv->order_by_key)
-            {
-              position = _g_ptr_array_add_sorted_with_data (priv->external_items,
-                                                            g_object_ref (key),
-                                                            order_by_func, &info);
-            }
-          else
-            {
-              g_ptr_array_add (priv->external_items,
-                               g_object_ref (key));
-
-              position = priv->external_items->len - 1;
-            }
-
-          /* emit the added signal, if there is no limit or the new index is
-           * less than the limit */
-          if (!priv->limit || position < priv->limit)
-            {
-              ref = g_controller_create_reference (priv->controller,
-                                                   G_CONTROLLER_ADD,
-                                                   G_TYPE_UINT, 1,
-                                                   position);
-              g_controller_emit_changed (priv->controller, ref);
-
-              if (priv->limit && position < priv->limit
-                  && priv->external_items->len > priv->limit)
-                {
-                  /* remove the item that is no longer visible */
-                  ref = g_controller_create_reference (priv->controller,
-                                                       G_CONTROLLER_REMOVE,
-                                                       G_TYPE_UINT, 1,
-                                                       priv->limit);
-                  g_controller_emit_changed (priv->controller, ref);
-                }
-            }
-        }
+      MexContent *external;
+
+      external = g_hash_table_lookup (priv->item_map,
+                                      priv->internal_items->pdata[i]);
+
+      if (!external || g_hash_table_lookup (present, external))
+        continue;
+
+      g_ptr_array_add (pending, external);
+      g_hash_table_insert (present, external, GINT_TO_POINTER (1));
     }
 
-  /* destroy the new_items list */
-  g_hash_table_destroy (new_items);
+  mex_view_model_insert_external_batch (model, pending);
 
-  /* destroy the external_items hash table */
-  g_hash_table_destroy (external_items);
+  g_ptr_array_free (pending, TRUE);
+  g_hash_table_destroy (present);
 }
 
 static void
@@ -908,12 +1287,18 @@ content_notify_cb (GObject      *content,
   group_key = mex_content_metadata_key_to_string (priv->group_by_key);
   order_by_key = mex_content_metadata_key_to_string (priv->order_by_key);
 
-  /* refresh the external list when one of the keys has changed */
+  /* update the item when one of the keys has changed, this is the only
+   * place where the cached keys of an item are invalidated */
   if (g_str_equal (pspec->name, group_key)
       || g_str_equal (pspec->name, order_by_key))
     {
-      /* TODO: update only the items which have changed */
-      mex_view_model_refresh_external_items (view);
+      if (g_str_equal (pspec->name, group_key))
+        g_hash_table_remove (priv->group_keys, content);
+
+      if (g_str_equal (pspec->name, order_by_key))
+        g_hash_table_remove (priv->sort_keys, content);
+
+      mex_view_model_update_item (view, MEX_CONTENT (content));
 
       return;
     }
@@ -926,13 +1311,92 @@ content_notify_cb (GObject      *content,
       if (g_str_equal (pspec->name,
                        mex_content_metadata_key_to_string (filter->key)))
         {
-          mex_view_model_refresh_external_items (view);
+          mex_view_model_update_item (view, MEX_CONTENT (content));
 
           return;
         }
     }
 }
 
+/* Copies the items of the model across, in the order of the model */
+static void
+mex_view_model_load_internal_items (MexViewModel *self)
+{
+  MexViewModelPrivate *priv = self->priv;
+  MexContent *content;
+  gint i = 0;
+
+  while ((content = mex_model_get_content (priv->model, i++)))
+    {
+      g_ptr_array_add (priv->internal_items, g_object_ref (content));
+
+      g_signal_connect (content, "notify", G_CALLBACK (content_notify_cb),
+                        self);
+
+      /* any MexProgram objects must have all their data resolved to be
+       * useful in the view model */
+      if (MEX_IS_PROGRAM (content))
+        _mex_program_complete (MEX_PROGRAM (content));
+    }
+}
+
+/* Empties the external items, which the views see as a single clear */
+static void
+mex_view_model_clear_external_items (MexViewModel *self)
+{
+  MexViewModelPrivate *priv = self->priv;
+  GControllerReference *ref;
+
+  priv->start_offset = -1;
+
+  g_hash_table_remove_all (priv->positions);
+  priv->positions_valid = 0;
+
+  if (priv->external_items->len > 0)
+    {
+      ref = g_controller_create_reference (priv->controller,
+                                           G_CONTROLLER_CLEAR,
+                                           G_TYPE_NONE, 0);
+      g_controller_emit_changed (priv->controller, ref);
+      g_object_unref (ref);
+
+      g_ptr_array_set_size (priv->external_items, 0);
+    }
+}
+
+static void
+mex_view_model_clear_internal_items (MexViewModel *self)
+{
+  MexViewModelPrivate *priv = self->priv;
+
+  while (priv->internal_items->len > 0)
+    {
+      GObject *o;
+
+      o = g_ptr_array_index (priv->internal_items,
+                             priv->internal_items->len - 1);
+
+      g_signal_handlers_disconnect_by_func (o,
+                                            G_CALLBACK (content_notify_cb),
+                                            self);
+      g_ptr_array_remove_index_fast (priv->internal_items,
+                                     priv->internal_items->len - 1);
+    }
+
+  g_hash_table_remove_all (priv->item_map);
+  g_hash_table_remove_all (priv->external_refs);
+  g_hash_table_remove_all (priv->group_keys);
+  g_hash_table_remove_all (priv->sort_keys);
+
+  if (priv->start_content)
+    g_object_unref (priv->start_content);
+  priv->start_content = NULL;
+
+  /* everything has gone, so there is no need to remove the external items
+   * one at a time */
+  mex_view_model_clear_external_items (self);
+}
+
 static void
 mex_view_model_controller_changed_cb (GController          *controller,
                                       GControllerAction     action,
@@ -949,13 +1413,17 @@ mex_view_model_controller_changed_cb (GController          *controller,
     {
     case G_CONTROLLER_ADD:
       {
+        GPtrArray *pending;
+        gint i;
+
         /* add the new items */
-        while (n_indices-- > 0)
+        pending = g_ptr_array_new ();
+        for (i = 0; i < n_indices; i++)
           {
             MexContent *content;
             guint idx;
 
-            idx = g_controller_reference_get_index_uint (ref, n_indices);
+            idx = g_controller_reference_get_index_uint (ref, i);
 
             content = mex_model_get_content (priv->model, idx);
 
@@ -963,7 +1431,15 @@ mex_view_model_controller_changed_cb (GController          *controller,
                               self);
 
             g_ptr_array_add (priv->internal_items, g_object_ref (content));
+
+            mex_view_model_map_item (self, content,
+                                     mex_view_model_resolve_content (self,
+                                                                     content),
+                                     pending);
           }
+
+        mex_view_model_insert_external_batch (self, pending);
+        g_ptr_array_free (pending, TRUE);
       }
       break;
 
@@ -982,13 +1458,17 @@ mex_view_model_controller_changed_cb (GController          *controller,
                                                   G_CALLBACK (content_notify_cb),
                                                   self);
 
-            g_ptr_array_remove_fast (priv->internal_items, content);
+            mex_view_model_unmap_item (self, content);
+            g_hash_table_remove (priv->group_keys, content);
 
             if (priv->start_content == content)
               {
                 g_object_unref (priv->start_content);
                 priv->start_content = NULL;
+                priv->start_offset = -1;
               }
+
+            g_ptr_array_remove_fast (priv->internal_items, content);
           }
       }
       break;
@@ -998,24 +1478,14 @@ mex_view_model_controller_changed_cb (GController          *controller,
       break;
 
     case G_CONTROLLER_CLEAR:
-      while (priv->internal_items->len > 0)
-        {
-          GObject *o;
-
-          o = g_ptr_array_index (priv->internal_items, 0);
-
-          g_signal_handlers_disconnect_by_func (o,
-                                                G_CALLBACK (content_notify_cb),
-                                                self);
-          g_ptr_array_remove_index_fast (priv->internal_items, 0);
-        }
-      if (priv->start_content)
-        g_object_unref (priv->start_content);
-      priv->start_content = NULL;
+      mex_view_model_clear_internal_items (self);
       break;
 
     case G_CONTROLLER_REPLACE:
-      g_warning (G_STRLOC ": G_CONTROLLER_REPLACE not implemented by MexViewModel");
+      /* all of the items may have changed, so start again from the model */
+      mex_view_model_clear_internal_items (self);
+      mex_view_model_load_internal_items (self);
+      mex_view_model_refresh_external_items (self);
       break;
 
     case G_CONTROLLER_INVALID_ACTION:
@@ -1026,8 +1496,6 @@ mex_view_model_controller_changed_cb (GController          *controller,
       g_warning (G_STRLOC ": Unhandled action");
       break;
     }
-
-  mex_view_model_refresh_external_items (self);
 }
 
 void
@@ -1064,9 +1532,15 @@ mex_view_model_set_start_content (MexViewModel *self, MexContent *content)
     }
 
   if (content)
-    priv->start_content = g_object_ref (content);
+    {
+      priv->start_content = g_object_ref (content);
+      priv->start_offset = mex_view_model_external_index (self, content);
+    }
   else
-    priv->start_content = NULL;
+    {
+      priv->start_content = NULL;
+      priv->start_offset = -1;
+    }
 
   mex_view_model_refresh_external_items (self);
 }
@@ -1172,6 +1646,7 @@ mex_view_model_set_group_by (MexViewModel       *model,
     return;
 
   priv->group_by_key = metadata_key;
+  g_hash_table_remove_all (priv->group_keys);
 
   if (priv->group_items)
     g_hash_table_remove_all (priv->group_items);
@@ -1184,6 +1659,7 @@ mex_view_model_set_order_by (MexViewModel       *model,
                              gboolean            descending)
 {
   MexViewModelPrivate *priv;
+  GControllerReference *ref;
 
   g_return_if_fail (MEX_IS_VIEW_MODEL (model));
 
@@ -1196,19 +1672,43 @@ mex_view_model_set_order_by (MexViewModel       *model,
   priv->order_by_key = metadata_key;
   priv->order_by_descending = descending;
 
-  /* remove the existing external items, so that it is fully re-sorted */
-  while (priv->external_items->len > 0)
+  g_hash_table_remove_all (priv->sort_keys);
+
+  /* without an order the items follow the model, which neither the last sort
+   * nor the internal items (see G_CONTROLLER_REMOVE) keep to, so lay them out
+   * again from the model */
+  if (!priv->order_by_key)
     {
-      GControllerReference *ref;
+      GPtrArray *old_items = priv->internal_items;
+      MexContent *content;
+      gint i = 0;
 
-      ref = g_controller_create_reference (priv->controller,
-                                           G_CONTROLLER_REMOVE,
-                                           G_TYPE_UINT, 1, 0);
-      g_controller_emit_changed (priv->controller, ref);
-      g_ptr_array_remove_index (priv->external_items, 0);
+      mex_view_model_clear_external_items (model);
+
+      priv->internal_items = g_ptr_array_new_with_free_func (g_object_unref);
+      if (priv->model)
+        while ((content = mex_model_get_content (priv->model, i++)))
+          g_ptr_array_add (priv->internal_items, g_object_ref (content));
+      g_ptr_array_unref (old_items);
+
+      mex_view_model_refresh_external_items (model);
+      return;
     }
 
-  mex_view_model_refresh_external_items (model);
+  /* the set of external items does not change, so re-sort them in one go and
+   * let the views refresh from the new order */
+  g_ptr_array_sort_with_data (priv->external_items, order_by_func, model);
+
+  priv->positions_valid = 0;
+  if (priv->start_content)
+    priv->start_offset = mex_view_model_external_index (model,
+                                                        priv->start_content);
+
+  ref = g_controller_create_reference (priv->controller,
+                                       G_CONTROLLER_REPLACE,
+                                       G_TYPE_NONE, 0);
+  g_controller_emit_changed (priv->controller, ref);
+  g_object_unref (ref);
 }
 
 /**
@@ -58,6 +58,7 @@
 #include <mex/mex-grilo-feed.h>
 #include <mex/mex-grilo-tracker-feed.h>
 #include <mex/mex-group-item.h>
+#include <mex/mex-image-loader.h>
 #include <mex/mex-info-bar.h>
 #include <mex/mex-info-panel.h>
 #include <mex/mex-lirc.h>
@@ -66,6 +67,7 @@
 #include <mex/mex-main.h>
 #include <mex/mex-media-controls.h>
 #include <mex/mex-menu.h>
+#include <mex/mex-metadata-journal.h>
 #include <mex/mex-mmkeys.h>
 #include <mex/mex-model.h>
 #include <mex/mex-model-manager.h>
@@ -86,8 +88,10 @@
 #include <mex/mex-settings.h>
 #include <mex/mex-shadow.h>
 #include <mex/mex-slide-show.h>
+#include <mex/mex-texture-cache.h>
 #include <mex/mex-tile.h>
 #include <mex/mex-tool-provider.h>
+#include <mex/mex-trace.h>
 #include <mex/mex-queue-button.h>
 #include <mex/mex-queue-model.h>
 #include <mex/mex-uri-channel-provider.h>
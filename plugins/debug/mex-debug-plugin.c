@@ -30,6 +30,9 @@
 
 #include <mex/mex-tool-provider.h>
 #include <mex/mex-main.h>
+#include <mex/mex-proxy.h>
+#include <mex/mex-texture-cache.h>
+#include <mex/mex-generic-content.h>
 
 #include "mex-debug-plugin.h"
 #include "mex-gobject-list.h"
@@ -364,6 +367,78 @@ do_fps (GObject             *instance,
   return TRUE;
 }
 
+/*
+ * Proxy scheduler statistics
+ */
+
+static gboolean
+do_proxy_stats (GObject             *instance,
+                const gchar         *action_name,
+                guint                key_val,
+                ClutterModifierType  modifiers,
+                gpointer             user_data)
+{
+  MexProxyStats stats;
+
+  mex_proxy_get_stats (&stats);
+
+  g_print ("Proxy scheduler:\n"
+           "  queued objects: %u\n"
+           "  created this frame: %u, last frame: %u\n"
+           "  budget: %.2f ms, average cost: %.2f ms\n"
+           "  frame interval: %.2f ms\n",
+           stats.queue_depth,
+           stats.created_this_frame, stats.created_last_frame,
+           stats.budget, stats.average_cost,
+           stats.frame_interval);
+
+  return TRUE;
+}
+
+static gboolean
+do_texture_cache_stats (GObject             *instance,
+                        const gchar         *action_name,
+                        guint                key_val,
+                        ClutterModifierType  modifiers,
+                        gpointer             user_data)
+{
+  MexTextureCacheStats stats;
+
+  mex_texture_cache_get_stats (&stats);
+
+  g_print ("Texture cache:\n"
+           "  textures: %u, size: %" G_GSIZE_FORMAT " / %" G_GSIZE_FORMAT
+           " KiB\n"
+           "  hits: %u, misses: %u, evictions: %u\n",
+           stats.n_textures, stats.size / 1024, stats.max_size / 1024,
+           stats.hits, stats.misses, stats.evictions);
+
+  return TRUE;
+}
+
+static gboolean
+do_content_stats (GObject             *instance,
+                  const gchar         *action_name,
+                  guint                key_val,
+                  ClutterModifierType  modifiers,
+                  gpointer             user_data)
+{
+  MexGenericContentStats stats;
+
+  mex_generic_content_get_stats (&stats);
+
+  g_print ("Content metadata:\n"
+           "  contents: %u, values: %u, distinct values: %u\n"
+           "  size: %" G_GSIZE_FORMAT " KiB, unshared: %" G_GSIZE_FORMAT
+           " KiB, saved: %" G_GSIZE_FORMAT " KiB\n",
+           stats.n_contents, stats.n_values, stats.n_strings,
+           stats.size / 1024, stats.unshared_size / 1024,
+           (stats.unshared_size - MIN (stats.size, stats.unshared_size))
+           / 1024);
+
+  return TRUE;
+}
+
 /*
  * Log handler
  */
@@ -492,6 +567,12 @@ mex_debug_plugin_init (MexDebugPlugin *self)
 
   append_binding (self, "debug-fps", CLUTTER_KEY_r,
                   G_CALLBACK (do_fps));
+  append_binding (self, "debug-proxy-stats", CLUTTER_KEY_p,
+                  G_CALLBACK (do_proxy_stats));
+  append_binding (self, "debug-texture-cache-stats", CLUTTER_KEY_t,
+                  G_CALLBACK (do_texture_cache_stats));
+  append_binding (self, "debug-content-stats", CLUTTER_KEY_m,
+                  G_CALLBACK (do_content_stats));
 
   if (have_gobject_list)
     {
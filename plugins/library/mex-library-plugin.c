@@ -32,14 +32,58 @@ G_DEFINE_TYPE_WITH_CODE (MexLibraryPlugin, mex_library_plugin,
                          G_IMPLEMENT_INTERFACE (MEX_TYPE_MODEL_PROVIDER,
                                                 mex_model_provider_iface_init))
 
+/* Items fetched at a time, more are fetched as the user scrolls */
+#define PAGE_SIZE 100
+
 #define LIBRARY_PLUGIN_PRIVATE(o) \
   (G_TYPE_INSTANCE_GET_PRIVATE ((o), MEX_TYPE_LIBRARY_PLUGIN, MexLibraryPluginPrivate))
 
+typedef enum
+{
+  CATEGORY_VIDEOS,
+  CATEGORY_PICTURES,
+  CATEGORY_MUSIC,
+
+  N_CATEGORIES
+} LibraryCategory;
+
+static const struct
+{
+  const gchar    *name;
+  const gchar    *placeholder;
+  const gchar    *paths_key;
+  GUserDirectory  directory;
+} categories[N_CATEGORIES] = {
+  { "videos", "No videos found", "video_paths", G_USER_DIRECTORY_VIDEOS },
+  { "pictures", "No pictures found", "pictures_paths",
+    G_USER_DIRECTORY_PICTURES },
+  { "music", "No Music found", "music_paths", G_USER_DIRECTORY_MUSIC }
+};
+
 struct _MexLibraryPluginPrivate
 {
+  /* Kept in the order of the categories, with n_models feeds for each */
   GList *models;
+  guint  n_models[N_CATEGORIES];
+
+  /* Root requests of each category, in the configured order */
+  GQueue roots[N_CATEGORIES];
+
+  GrlSource *source;
+  GList     *query_keys;
+  GList     *metadata_keys[N_CATEGORIES];
 };
 
+typedef struct
+{
+  MexLibraryPlugin *plugin;
+  LibraryCategory   category;
+  gchar            *uri;
+
+  gboolean          resolved;
+  MexFeed          *feed;
+} RootRequest;
+
 
 static void
 mex_library_plugin_dispose (GObject *object)
@@ -58,6 +102,13 @@ mex_library_plugin_dispose (GObject *object)
 static void
 mex_library_plugin_finalize (GObject *object)
 {
+  MexLibraryPluginPrivate *priv = MEX_LIBRARY_PLUGIN (object)->priv;
+  gint i;
+
+  g_list_free (priv->query_keys);
+  for (i = 0; i < N_CATEGORIES; i++)
+    g_list_free (priv->metadata_keys[i]);
+
   G_OBJECT_CLASS (mex_library_plugin_parent_class)->finalize (object);
 }
 
@@ -85,252 +136,198 @@ mex_model_provider_iface_init (MexModelProviderInterface *iface)
   iface->get_models = mex_library_plugin_get_models;
 }
 
-static GrlMedia *
-mex_library_plugin_get_box_for_path (GrlSource   *source,
-                                     const GList *keys,
-                                     const gchar *path)
+/* Feeds are published in the configured order, whatever order their roots
+ * resolve in. A slow root only holds back the ones after it in the same
+ * category. */
+static void
+mex_library_plugin_publish_roots (MexLibraryPlugin *self,
+                                  LibraryCategory   category)
 {
-  gchar *uri;
-  GrlMedia *box;
-  GrlOperationOptions *options;
+  MexLibraryPluginPrivate *priv = self->priv;
+  RootRequest *request;
 
-  GError *error = NULL;
+  while ((request = g_queue_peek_head (&priv->roots[category])) &&
+         request->resolved)
+    {
+      g_queue_pop_head (&priv->roots[category]);
+
+      if (request->feed)
+        {
+          gint c, position = 0;
+
+          for (c = 0; c <= category; c++)
+            position += priv->n_models[c];
+
+          priv->models = g_list_insert (priv->models, request->feed,
+                                        position);
+          priv->n_models[category]++;
+
+          mex_model_provider_model_added (MEX_MODEL_PROVIDER (self),
+                                          MEX_MODEL (request->feed));
+        }
+
+      g_free (request->uri);
+      g_slice_free (RootRequest, request);
+    }
+}
+
+static void
+mex_library_plugin_root_resolved_cb (GrlSource    *source,
+                                     guint         operation_id,
+                                     GrlMedia     *box,
+                                     gpointer      user_data,
+                                     const GError *error)
+{
+  RootRequest *request = user_data;
+  MexLibraryPlugin *self = request->plugin;
+  MexLibraryPluginPrivate *priv = self->priv;
+  MexFeed *feed;
+
+  request->resolved = TRUE;
+
+  if (!box)
+    {
+      g_warning ("Error getting media from uri %s: %s", request->uri,
+                 error ? error->message : "Not found");
+      goto done;
+    }
 
-  g_return_val_if_fail (path != NULL, NULL);
+  feed = mex_grilo_feed_new (source, priv->query_keys,
+                             priv->metadata_keys[request->category], box);
+  g_object_set (feed, "icon-name", "icon-library",
+                "placeholder-text", categories[request->category].placeholder,
+                "category", categories[request->category].name,
+                "page-size", PAGE_SIZE, NULL);
+
+  mex_grilo_feed_browse (MEX_GRILO_FEED (feed), 0, G_MAXINT);
+  request->feed = feed;
+
+  g_object_unref (box);
+
+done:
+  mex_library_plugin_publish_roots (self, request->category);
+  g_object_unref (self);
+}
+
+/* Roots are resolved asynchronously, and all at once, so that slow disks
+ * or network mounts don't hold up the startup. Each feed is published as
+ * soon as its root and the ones configured before it are known. */
+static void
+mex_library_plugin_resolve_root (MexLibraryPlugin *self,
+                                 LibraryCategory   category,
+                                 const gchar      *path)
+{
+  MexLibraryPluginPrivate *priv = self->priv;
+  GrlOperationOptions *options;
+  RootRequest *request;
+  GError *error = NULL;
+  gchar *uri;
 
   uri = g_filename_to_uri (path, NULL, &error);
   if (!uri)
     {
       g_warning ("Error converting path to uri: %s", error->message);
       g_error_free (error);
-      return NULL;
+      return;
     }
 
+  request = g_slice_new0 (RootRequest);
+  request->plugin = g_object_ref (self);
+  request->category = category;
+  request->uri = uri;
+  g_queue_push_tail (&priv->roots[category], request);
+
   options = grl_operation_options_new (NULL);
-  box = grl_source_get_media_from_uri_sync (source, uri, keys,
-                                            options,
-                                            &error);
-  g_free (uri);
+  grl_source_get_media_from_uri (priv->source, uri, priv->query_keys,
+                                 options,
+                                 mex_library_plugin_root_resolved_cb,
+                                 request);
   g_object_unref (options);
-
-  if (!box)
-    {
-      g_warning ("Error getting media from uri: %s", error->message);
-      g_error_free (error);
-      return NULL;
-    }
-
-  return box;
 }
 
 static void
 mex_library_plugin_init (MexLibraryPlugin *self)
 {
-  GrlSource *source;
   GrlRegistry *registry;
+  GKeyFile *mex_settings_key;
+  gint category;
 
   MexLibraryPluginPrivate *priv = self->priv =
     LIBRARY_PLUGIN_PRIVATE (self);
 
   registry = grl_registry_get_default ();
 
-  source = grl_registry_lookup_source (registry, "grl-filesystem");
-  if (source)
+  priv->source = grl_registry_lookup_source (registry, "grl-filesystem");
+  if (!priv->source)
     {
-      GList *query_keys;
-      MexFeed *feed;
-      GrlMedia *box;
-      gchar **paths;
-      GKeyFile *mex_settings_key;
-      gint i;
-      gsize paths_len;
-      GList *metadata_keys;
-
-      query_keys = grl_metadata_key_list_new (GRL_METADATA_KEY_ID,
-                                              GRL_METADATA_KEY_TITLE,
-                                              GRL_METADATA_KEY_MIME,
-                                              GRL_METADATA_KEY_URL,
-                                              GRL_METADATA_KEY_PUBLICATION_DATE,
-                                              NULL);
-
-      /* Add the videos model */
-
-      metadata_keys = grl_metadata_key_list_new (GRL_METADATA_KEY_ID,
-                                                 GRL_METADATA_KEY_DESCRIPTION,
-                                                 GRL_METADATA_KEY_DURATION,
-                                                 GRL_METADATA_KEY_THUMBNAIL,
-                                                 GRL_METADATA_KEY_WIDTH,
-                                                 GRL_METADATA_KEY_HEIGHT,
-                                                 NULL);
-
-      mex_settings_key = mex_get_settings_key_file ();
-      paths_len = 0;
-      paths = g_key_file_get_string_list (mex_settings_key,
-                                          "library-plugin",
-                                          "video_paths",
-                                          &paths_len,
-                                          NULL);
-
-      if (!paths)
-        paths = g_new (gchar*, 2);
-      else
-        paths = (gchar **)g_realloc ((gpointer)paths,
-                (paths_len + 2) * sizeof (gchar *));
-
-     paths[paths_len] =
-       g_strdup (g_get_user_special_dir (G_USER_DIRECTORY_VIDEOS));
-
-     paths_len++;
-     paths[paths_len] = NULL;
-
-      if (paths)
-        {
-          for (i = 0; i < paths_len; i++)
-            {
-              box =
-                mex_library_plugin_get_box_for_path (source,
-                                                     query_keys, paths[i]);
-              if (box)
-                {
-                  feed = mex_grilo_feed_new (source,
-                                             query_keys, metadata_keys, box);
-
-                  g_object_set (feed, "icon-name", "icon-library",
-                                "placeholder-text", "No videos found",
-                                "category", "videos", NULL);
-
-                  mex_grilo_feed_browse (MEX_GRILO_FEED (feed), 0, G_MAXINT);
-
-                  priv->models = g_list_append (priv->models, feed);
-                }
-            }
-        }
-
-      if (metadata_keys)
-        g_list_free (metadata_keys);
-      if (paths)
-        g_strfreev (paths);
-
-      /* Add the photos model */
-
-      metadata_keys = grl_metadata_key_list_new (GRL_METADATA_KEY_ID,
-                                                 GRL_METADATA_KEY_DESCRIPTION,
-                                                 GRL_METADATA_KEY_THUMBNAIL,
-                                                 GRL_METADATA_KEY_WIDTH,
-                                                 GRL_METADATA_KEY_HEIGHT,
-                                                 NULL);
-
-      paths_len = 0;
-      paths = g_key_file_get_string_list (mex_settings_key,
-                                          "library-plugin",
-                                          "pictures_paths",
-                                          &paths_len,
-                                          NULL);
-
-      paths = (gchar **)g_realloc ((gpointer)paths,
-                                   (paths_len + 2) * sizeof (gchar *));
-
-      if (!paths)
-        paths = g_new (gchar*, 2);
-      else
-        paths[paths_len] =
-          g_strdup (g_get_user_special_dir (G_USER_DIRECTORY_PICTURES));
-
-      paths_len++;
-      paths[paths_len] = NULL;
+      g_warning ("Filesystem plugin not found");
+      return;
+    }
 
-      if (paths)
-        {
-          for (i = 0; i < paths_len; i++)
-            {
-              box =
-                mex_library_plugin_get_box_for_path (source,
-                                                     query_keys, paths[i]);
-              if (box)
-                {
-                  feed = mex_grilo_feed_new (source,
-                                             query_keys, metadata_keys, box);
-                  g_object_set (feed, "icon-name", "icon-library",
-                                "placeholder-text", "No pictures found",
-                                "category", "pictures", NULL);
-
-                  mex_grilo_feed_browse (MEX_GRILO_FEED (feed), 0, G_MAXINT);
-
-                  priv->models = g_list_append (priv->models, feed);
-                }
-            }
-        }
+  priv->query_keys =
+    grl_metadata_key_list_new (GRL_METADATA_KEY_ID,
+                               GRL_METADATA_KEY_TITLE,
+                               GRL_METADATA_KEY_MIME,
+                               GRL_METADATA_KEY_URL,
+                               GRL_METADATA_KEY_PUBLICATION_DATE,
+                               NULL);
+
+  priv->metadata_keys[CATEGORY_VIDEOS] =
+    grl_metadata_key_list_new (GRL_METADATA_KEY_ID,
+                               GRL_METADATA_KEY_DESCRIPTION,
+                               GRL_METADATA_KEY_DURATION,
+                               GRL_METADATA_KEY_THUMBNAIL,
+                               GRL_METADATA_KEY_WIDTH,
+                               GRL_METADATA_KEY_HEIGHT,
+                               NULL);
+
+  priv->metadata_keys[CATEGORY_PICTURES] =
+    grl_metadata_key_list_new (GRL_METADATA_KEY_ID,
+                               GRL_METADATA_KEY_DESCRIPTION,
+                               GRL_METADATA_KEY_THUMBNAIL,
+                               GRL_METADATA_KEY_WIDTH,
+                               GRL_METADATA_KEY_HEIGHT,
+                               NULL);
+
+  priv->metadata_keys[CATEGORY_MUSIC] =
+    grl_metadata_key_list_new (GRL_METADATA_KEY_ID,
+                               GRL_METADATA_KEY_DESCRIPTION,
+                               GRL_METADATA_KEY_THUMBNAIL,
+                               GRL_METADATA_KEY_WIDTH,
+                               GRL_METADATA_KEY_HEIGHT,
+                               GRL_METADATA_KEY_ARTIST,
+                               GRL_METADATA_KEY_ALBUM,
+                               NULL);
+
+  mex_settings_key = mex_get_settings_key_file ();
+
+  for (category = 0; category < N_CATEGORIES; category++)
+    {
+      const gchar *special_dir;
+      gchar **paths = NULL;
+      gint i;
 
-      if (metadata_keys)
-        g_list_free (metadata_keys);
-      if (paths)
-        g_strfreev (paths);
-
-      /* Add the music model */
-      metadata_keys = grl_metadata_key_list_new (GRL_METADATA_KEY_ID,
-                                                 GRL_METADATA_KEY_DESCRIPTION,
-                                                 GRL_METADATA_KEY_THUMBNAIL,
-                                                 GRL_METADATA_KEY_WIDTH,
-                                                 GRL_METADATA_KEY_HEIGHT,
-                                                 GRL_METADATA_KEY_ARTIST,
-                                                 GRL_METADATA_KEY_ALBUM,
-                                                 NULL);
-
-      paths_len = 0;
-      paths = g_key_file_get_string_list (mex_settings_key,
-                                          "library-plugin",
-                                          "music_paths",
-                                          &paths_len,
-                                          NULL);
-
-      if (!paths)
-        paths = g_new (gchar*, 2);
-      else
-        paths = (gchar **)g_realloc ((gpointer)paths,
-            (paths_len + 2) * sizeof (gchar *));
-
-      paths[paths_len] =
-        g_strdup (g_get_user_special_dir (G_USER_DIRECTORY_MUSIC));
-
-      paths_len++;
-      paths[paths_len] = NULL;
-
-      if (paths)
-        {
-          for (i = 0; i < paths_len; i++)
-            {
-              box =
-                mex_library_plugin_get_box_for_path (source,
-                                                     query_keys, paths[i]);
-              if (box)
-                {
-                  feed = mex_grilo_feed_new (source,
-                                             query_keys, metadata_keys, box);
-                  g_object_set (feed, "icon-name", "icon-library",
-                                "placeholder-text", "No Music found",
-                                "category", "music", NULL);
-
-                  mex_grilo_feed_browse (MEX_GRILO_FEED (feed), 0, G_MAXINT);
-
-                  priv->models = g_list_append (priv->models, feed);
-                }
-            }
-        }
+      g_queue_init (&priv->roots[category]);
 
-      /* clean up */
+      /* The configured paths, followed by the XDG directory */
+      if (mex_settings_key)
+        paths = g_key_file_get_string_list (mex_settings_key,
+                                            "library-plugin",
+                                            categories[category].paths_key,
+                                            NULL, NULL);
 
-      if (metadata_keys)
-        g_list_free (metadata_keys);
-      if (paths)
-        g_strfreev (paths);
+      for (i = 0; paths && paths[i]; i++)
+        mex_library_plugin_resolve_root (self, category, paths[i]);
 
-      if (mex_settings_key)
-        g_key_file_free (mex_settings_key);
+      special_dir = g_get_user_special_dir (categories[category].directory);
+      if (special_dir)
+        mex_library_plugin_resolve_root (self, category, special_dir);
 
-      g_list_free (query_keys);
+      g_strfreev (paths);
     }
-  else
-    g_warning ("Filesystem plugin not found");
+
+  if (mex_settings_key)
+    g_key_file_free (mex_settings_key);
 }
 
 static GType
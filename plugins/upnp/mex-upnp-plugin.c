@@ -26,6 +26,9 @@
 
 G_DEFINE_TYPE (MexUpnpPlugin, mex_upnp_plugin, G_TYPE_OBJECT)
 
+/* Items fetched at a time, more are fetched as the user scrolls */
+#define PAGE_SIZE 100
+
 #define GET_PRIVATE(o) \
   (G_TYPE_INSTANCE_GET_PRIVATE ((o), MEX_TYPE_UPNP_PLUGIN, MexUpnpPluginPrivate))
 
@@ -145,6 +148,7 @@ add_model (MexUpnpPlugin *self,
   g_object_set (feed, "icon-name", "icon-panelheader-computer",
                 "placeholder-text", placeholder,
                 "category", cat_name,
+                "page-size", PAGE_SIZE,
                 NULL);
   mex_grilo_feed_query (MEX_GRILO_FEED (feed), query, 0, G_MAXINT);
 
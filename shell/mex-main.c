@@ -27,6 +27,7 @@
 #include <stdlib.h>
 #include <libgen.h>
 #include <signal.h>
+#include <glib-unix.h>
 
 #include <locale.h>
 
@@ -102,6 +103,12 @@ typedef struct
   gint busy_count;
 
   guint cursor_timeout_source;
+
+  MxApplication *app;
+  gboolean       first_frame;
+  gboolean       home_screen_shown;
+  gboolean       interactive;
+  gboolean       action_providers_loaded;
 } MexData;
 
 void mex_toggle_pip (MexData *data);
@@ -112,13 +119,19 @@ static void mex_hide_actor (MexData *data, ClutterActor *actor);
 static void mex_push_busy (MexData *data);
 static void mex_pop_busy (MexData *data);
 
+static void cleanup_before_exit (void);
+
 static gboolean opt_fullscreen   = FALSE;
 static gboolean opt_version      = FALSE;
 static gboolean opt_show_version = FALSE;
 static gboolean opt_ignore_res   = FALSE;
 static gboolean opt_touch        = FALSE;
+static gboolean opt_benchmark    = FALSE;
+static gchar *opt_trace = NULL;
 static gchar **opt_file = NULL;
 
+#define BENCHMARK_TIMEOUT 120
+
 static void
 mex_header_activated_cb (MexExplorer *explorer,
                          MexModel    *model,
@@ -793,6 +806,72 @@ mex_finish_home_screen (MexData *data)
   mex_explorer_set_focused_model (MEX_EXPLORER (data->explorer),
                                   mex_model_manager_get_model_for_category (mmanager,
                                                                             "videos"));
+
+  data->home_screen_shown = TRUE;
+  mex_trace_mark ("home screen");
+
+  return FALSE;
+}
+
+static void
+mex_quit (MexData *data)
+{
+  /* While the main loop can still complete asynchronous writes */
+  cleanup_before_exit ();
+
+#if MX_CHECK_VERSION(1,99,3)
+  g_application_release (G_APPLICATION (data->app));
+#else
+  mx_application_quit (data->app);
+#endif
+}
+
+/* The UI is considered usable once a frame has been painted with the home
+ * screen showing the videos column populated */
+static void
+mex_stage_paint_cb (ClutterActor *stage,
+                    MexData      *data)
+{
+  MexModelManager *mmanager;
+  MexModel *model;
+
+  if (!data->first_frame)
+    {
+      mex_trace_mark ("first frame");
+      data->first_frame = TRUE;
+    }
+
+  if (!data->home_screen_shown)
+    return;
+
+  mmanager = mex_model_manager_get_default ();
+  model = mex_model_manager_get_model_for_category (mmanager, "videos");
+  if (!model || mex_model_get_length (model) == 0)
+    return;
+
+  mex_trace_mark ("interactive");
+  data->interactive = TRUE;
+
+  g_signal_handlers_disconnect_by_func (stage, mex_stage_paint_cb, data);
+
+  if (opt_benchmark)
+    {
+      g_print ("time-to-interactive: %.1f ms\n",
+               mex_trace_get_time () / 1000.0);
+      mex_quit (data);
+    }
+}
+
+static gboolean
+mex_benchmark_timeout_cb (MexData *data)
+{
+  if (!data->interactive)
+    {
+      g_printerr ("time-to-interactive: not reached after %d s\n",
+                  BENCHMARK_TIMEOUT);
+      mex_quit (data);
+    }
+
   return FALSE;
 }
 
@@ -1010,6 +1089,18 @@ mex_captured_event_cb (ClutterActor *actor,
   gboolean handled;
   ClutterKeyEvent *key_event;
 
+  /* Content boxes list their actions when they are opened, which only
+   * happens on input. The plugins providing actions may have been deferred,
+   * so load them before the first key or button press reaches a box. */
+  if (!data->action_providers_loaded &&
+      (event->type == CLUTTER_KEY_PRESS ||
+       event->type == CLUTTER_BUTTON_PRESS))
+    {
+      mex_plugin_manager_require (mex_plugin_manager_get_default (),
+                                  MEX_TYPE_ACTION_PROVIDER);
+      data->action_providers_loaded = TRUE;
+    }
+
   /* Motion events are used to show/hide the cursor when the application is
    * full-screened */
   if (event->type == CLUTTER_MOTION)
@@ -1269,6 +1360,30 @@ mex_remove_model_provider_cb (MexData *data,
   g_hash_table_remove (data->model_to_provider, old_object);
 }
 
+static void
+mex_add_provider_model (MexData          *data,
+                        MexModelProvider *provider,
+                        MexModel         *model)
+{
+  MexModelManager *manager = mex_model_manager_get_default ();
+
+  mex_model_manager_add_model (manager, model);
+
+  /* Add a mapping from the model back to the provider */
+  g_hash_table_insert (data->model_to_provider, model, provider);
+  g_object_weak_ref (G_OBJECT (model),
+                     (GWeakNotify)mex_remove_model_provider_cb,
+                     data);
+}
+
+static void
+mex_plugin_model_added_cb (MexModelProvider *provider,
+                           MexModel         *model,
+                           MexData          *data)
+{
+  mex_add_provider_model (data, provider, model);
+}
+
 static void
 mex_plugin_present_model_cb (GObject      *plugin,
                              MexModel     *model,
@@ -1614,24 +1729,16 @@ mex_plugin_loaded_cb (MexPluginManager *plugin_manager,
   if (MEX_IS_MODEL_PROVIDER (plugin))
     {
       GList *m;
-      MexModelManager *manager = mex_model_manager_get_default ();
       const GList *models =
         mex_model_provider_get_models (MEX_MODEL_PROVIDER (plugin));
 
       for (m = (GList *)models; m; m = m->next)
-        {
-          MexModel *model = m->data;
-          mex_model_manager_add_model (manager, model);
-
-          /* Add a mapping from the model back to the provider */
-          g_hash_table_insert (data->model_to_provider, model, plugin);
-          g_object_weak_ref (G_OBJECT (model),
-                             (GWeakNotify)mex_remove_model_provider_cb,
-                             data);
-        }
+        mex_add_provider_model (data, MEX_MODEL_PROVIDER (plugin), m->data);
 
       g_signal_connect (plugin, "present-model",
                         G_CALLBACK (mex_plugin_present_model_cb), data);
+      g_signal_connect (plugin, "model-added",
+                        G_CALLBACK (mex_plugin_model_added_cb), data);
     }
 
   if (MEX_IS_TOOL_PROVIDER (plugin))
@@ -2035,14 +2142,34 @@ mex_open_group_cb (MxAction *action,
 static void
 cleanup_before_exit (void)
 {
+  static gboolean cleaned_up = FALSE;
+  GError *error = NULL;
+
+  /* Called when asked to quit, and once more when the main loop returns */
+  if (cleaned_up)
+    return;
+  cleaned_up = TRUE;
+
 #ifdef HAVE_WEBREMOTE
   webremote_quit ();
 #endif
+
+  /* Save the play counts and positions still in the journal */
+  mex_metadata_journal_flush ();
+
+  if (!mex_trace_write (&error))
+    {
+      g_warning ("Failed to write the trace: %s", error->message);
+      g_clear_error (&error);
+    }
 }
 
 static MxApplication *application_for_signal;
-static void
-on_int_term_signaled (int sig)
+
+/* Dispatched from the main loop by g_unix_signal_add(), not from the
+ * signal handler itself */
+static gboolean
+on_int_term_signaled (gpointer user_data)
 {
   cleanup_before_exit ();
 #if MX_CHECK_VERSION(1,99,3)
@@ -2058,6 +2185,8 @@ on_int_term_signaled (int sig)
 #else
   mx_application_quit (application_for_signal);
 #endif
+
+  return TRUE;
 }
 
 static GOptionEntry entries[] =
@@ -2072,6 +2201,10 @@ static GOptionEntry entries[] =
     "Don't warn if the screen size isn't sufficient", NULL },
   { "touch-mode", 't', 0, G_OPTION_ARG_NONE, &opt_touch,
     "Enable touch-screen mode", NULL },
+  { "trace", 0, 0, G_OPTION_ARG_FILENAME, &opt_trace,
+    "Write a trace of the startup to FILE when quitting", "FILE" },
+  { "benchmark", 0, 0, G_OPTION_ARG_NONE, &opt_benchmark,
+    "Print the time it took to become usable and quit", NULL },
   { G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &opt_file,
     "File to play", NULL },
   { NULL }
@@ -2274,6 +2407,7 @@ mex_startup (MxApplication *app,
   MexModelManager *mmanager;
   gchar *tmp;
   gchar *web_settings_loc;
+  gint64 startup, span;
 #ifdef HAVE_CLUTTER_CEX100
   const ClutterColor background_color = { 0x00, 0x00, 0x00, 0x00 };
 #else
@@ -2281,10 +2415,17 @@ mex_startup (MxApplication *app,
 #endif /* HAVE_CLUTTER_CEX100 */
 
 
+  startup = span = mex_trace_begin ();
+
+  data->app = app;
+
   clutter_set_font_flags (clutter_get_font_flags () & ~CLUTTER_FONT_MIPMAPPING);
 
   mex_style_load_default ();
 
+  mex_trace_end (span, "startup: style");
+  span = mex_trace_begin ();
+
 #ifdef HAVE_CLUTTER_CEX100
   /* If we're on CEX100, use the default stage and make it semi-transparent */
   data->stage = CLUTTER_STAGE (clutter_stage_get_default ());
@@ -2304,6 +2445,8 @@ mex_startup (MxApplication *app,
 
   mex_set_main_window (data->window);
 
+  mex_trace_end (span, "startup: stage");
+
   g_signal_connect (data->stage, "activate",
                     G_CALLBACK (on_stage_actived), &data);
   g_signal_connect (data->stage, "deactivate",
@@ -2318,13 +2461,8 @@ mex_startup (MxApplication *app,
   data->info_bar = mex_info_bar_get_default ();
 
   if (getenv ("MEX_DISABLE_QUIT") == NULL)
-#if MX_CHECK_VERSION(1,99,3)
-    g_signal_connect_swapped (data->info_bar, "close-request",
-                              G_CALLBACK (g_application_release), app);
-#else
     g_signal_connect_swapped (data->info_bar, "close-request",
-                              G_CALLBACK (mx_application_quit), app);
-#endif
+                              G_CALLBACK (mex_quit), data);
   else
     g_signal_connect_swapped (data->info_bar, "close-request",
                               G_CALLBACK (mex_go_back), data);
@@ -2334,6 +2472,7 @@ mex_startup (MxApplication *app,
 
 
   /* Create base widgets */
+  span = mex_trace_begin ();
   data->layout = mx_box_layout_new ();
   clutter_actor_set_name (data->layout, "main-layout");
   data->tool_area = mx_box_layout_new ();
@@ -2349,6 +2488,8 @@ mex_startup (MxApplication *app,
   mx_spinner_set_animating (MX_SPINNER (data->spinner), FALSE);
   clutter_actor_set_opacity (data->spinner, 0x00);
 
+  mex_trace_end (span, "startup: explorer");
+
   /* Hook onto the download-queue length property notification to
    * indicate we're busy
    */
@@ -2376,6 +2517,7 @@ mex_startup (MxApplication *app,
   /* It's possible that MexPlayer does not provide an actor that will display
    * the video. This happens on STB hardware when the video is displayed in
    * another frame buffer. */
+  span = mex_trace_begin ();
   data->video_player = (ClutterActor *) mex_player_get_default ();
   g_signal_connect_swapped (data->video_player, "close-request",
                             G_CALLBACK (mex_go_back), data);
@@ -2408,6 +2550,8 @@ mex_startup (MxApplication *app,
                        G_CALLBACK (mex_music_player_content_set_externally_cb),
                             data);
 
+  mex_trace_end (span, "startup: players");
+
 
   /* Pack spinner into stack */
   clutter_actor_add_child (data->stack, data->spinner);
@@ -2418,6 +2562,7 @@ mex_startup (MxApplication *app,
   mx_stack_child_set_y_align (MX_STACK (data->stack), data->spinner,
                               MX_ALIGN_START);
 
+  span = mex_trace_begin ();
   data->volume_control = mex_volume_control_new ();
   clutter_actor_set_opacity (data->volume_control, 0x00);
 
@@ -2435,13 +2580,18 @@ mex_startup (MxApplication *app,
   g_signal_connect (data->volume_control, "notify::volume",
                     G_CALLBACK (on_volume_changed), data);
 
+  mex_trace_end (span, "startup: volume control");
 
+
+  span = mex_trace_begin ();
   data->slide_show = mex_slide_show_new ();
   g_signal_connect_swapped (data->slide_show, "close-request",
                             G_CALLBACK (mex_go_back), data);
   clutter_actor_add_child (data->stack, data->slide_show);
   clutter_actor_hide (data->slide_show);
 
+  mex_trace_end (span, "startup: slide show");
+
   if (opt_show_version == TRUE)
     {
       /* Pack the version in the stack and align it to the bottom left */
@@ -2462,7 +2612,10 @@ mex_startup (MxApplication *app,
   /* Resize and display window */
   mx_window_set_has_toolbar (data->window, FALSE);
   mx_window_set_window_size (data->window, 1280, 720);
+
+  span = mex_trace_begin ();
   mx_window_show (data->window);
+  mex_trace_end (span, "startup: show window");
 
   if (opt_fullscreen)
     mx_window_set_fullscreen (data->window, TRUE);
@@ -2474,6 +2627,13 @@ mex_startup (MxApplication *app,
   g_signal_connect (data->stage, "event",
                     G_CALLBACK (mex_event_cb), data);
 
+  if (mex_trace_enabled ())
+    g_signal_connect_after (data->stage, "paint",
+                            G_CALLBACK (mex_stage_paint_cb), data);
+  if (opt_benchmark)
+    g_timeout_add_seconds (BENCHMARK_TIMEOUT,
+                           (GSourceFunc) mex_benchmark_timeout_cb, data);
+
 
   /* Create model->provider mapping hash-table */
   data->model_to_provider = g_hash_table_new (NULL, NULL);
@@ -2500,7 +2660,10 @@ mex_startup (MxApplication *app,
   g_signal_connect (pmanager, "plugin-loaded",
                     G_CALLBACK (mex_plugin_loaded_cb), data);
   mex_info_bar_set_plugin_manager (MEX_INFO_BAR (data->info_bar), pmanager);
+
+  span = mex_trace_begin ();
   mex_plugin_manager_refresh (pmanager);
+  mex_trace_end (span, "startup: plugins");
 
 
   /* set the root model on the explorer */
@@ -2559,8 +2722,8 @@ mex_startup (MxApplication *app,
 #endif
 
   application_for_signal = app;
-  signal (SIGINT, on_int_term_signaled);
-  signal (SIGTERM, on_int_term_signaled);
+  g_unix_signal_add (SIGINT, on_int_term_signaled, NULL);
+  g_unix_signal_add (SIGTERM, on_int_term_signaled, NULL);
 
   /* Out of the box experience */
   out_of_box (data);
@@ -2594,6 +2757,8 @@ mex_startup (MxApplication *app,
     }
 #endif
 
+  mex_trace_end (startup, "startup");
+
   mex_vt_manager_activate ();
 }
 
@@ -2657,6 +2822,7 @@ main (int argc, char **argv)
 
   GError *error = NULL;
   MexData data = { 0, };
+  gint64 span;
 
   /* initialise translations */
   setlocale (LC_ALL, "");
@@ -2692,12 +2858,17 @@ main (int argc, char **argv)
       exit (EXIT_SUCCESS);
     }
 
+  if (opt_trace || opt_benchmark)
+    mex_trace_enable (opt_trace);
+
 
   /* log domain */
   MEX_LOG_DOMAIN_INIT (main_log_domain, "main");
 
   /* initialise mex */
+  span = mex_trace_begin ();
   mex_init (&argc, &argv);
+  mex_trace_end (span, "mex_init");
   mex_init_default_actions (&data);
 
   mex_lirc_init ();
@@ -2773,6 +2944,9 @@ main (int argc, char **argv)
   mex_deinit ();
 #endif
 
+  if (opt_benchmark && !data.interactive)
+    return EXIT_FAILURE;
+
   return 0;
 }
 
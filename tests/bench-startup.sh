@@ -0,0 +1,78 @@
+#!/bin/sh
+#
+# Cold-start benchmark: boots the shell against a generated library, twice,
+# and reports how long it took to become usable. The first run starts with
+# empty caches, the second one with the caches written by the first run.
+# The traces of both runs are left in the current directory.
+#
+# An X server is started with xvfb-run when there is no DISPLAY, and a
+# session bus with dbus-launch when there is none either. Plugins are the
+# installed ones, or the ones in MEX_PLUGIN_PATH.
+#
+# Usage: bench-startup.sh [path/to/media-explorer]
+#
+# MEX_BENCH_ITEMS is the number of videos in the library (default: 1000).
+
+set -e
+
+shell=${1:-media-explorer}
+n_items=${MEX_BENCH_ITEMS:-1000}
+
+fixture=`mktemp -d`
+cleanup ()
+{
+  if [ -n "$bus_pid" ]; then
+    kill $bus_pid
+  fi
+  rm -rf "$fixture"
+}
+trap cleanup EXIT
+
+mkdir -p "$fixture/library/videos" "$fixture/library/music" \
+         "$fixture/library/pictures" "$fixture/config/mex" "$fixture/cache"
+
+# Just enough of an AVI header for the files to be typed as videos
+i=0
+while [ $i -lt $n_items ]; do
+  printf 'RIFF\0\0\0\0AVI LIST' > "$fixture/library/videos/clip-$i.avi"
+  i=`expr $i + 1`
+done
+
+cat > "$fixture/config/mex/mex.conf" << END
+[library-plugin]
+video_paths=$fixture/library/videos;
+music_paths=$fixture/library/music;
+pictures_paths=$fixture/library/pictures;
+END
+
+XDG_CONFIG_HOME="$fixture/config"
+XDG_CACHE_HOME="$fixture/cache"
+export XDG_CONFIG_HOME XDG_CACHE_HOME
+
+if [ -z "$DBUS_SESSION_BUS_ADDRESS" ]; then
+  eval `dbus-launch --sh-syntax`
+  bus_pid=$DBUS_SESSION_BUS_PID
+fi
+
+run_shell ()
+{
+  if [ -n "$DISPLAY" ]; then
+    "$shell" --benchmark --ignore-resolution --trace="$1"
+  else
+    xvfb-run -a -s "-screen 0 1280x720x24" \
+      "$shell" --benchmark --ignore-resolution --trace="$1"
+  fi
+}
+
+for run in cold warm; do
+  trace="$PWD/mex-startup-$run.trace"
+  result=`run_shell "$trace" | grep '^time-to-interactive:'` || true
+
+  if [ -z "$result" ]; then
+    echo "$run start: failed" >&2
+    exit 1
+  fi
+
+  echo "$run start, $n_items videos: ${result#time-to-interactive: }" \
+       "(trace in $trace)"
+done
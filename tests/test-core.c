@@ -18,7 +18,9 @@
 
 #include <string.h>
 #include <stdarg.h>
+#include <unistd.h>
 
+#include <glib/gstdio.h>
 #include <mex.h>
 
 /*
@@ -121,6 +123,570 @@ test_model_sorted (void)
   g_object_unref (model);
 }
 
+static void
+test_model_sorted_batch (void)
+{
+  const gchar *names[] = { "D", "B", "C", "E", "G", "A", "C", "F" };
+  MexModel *model;
+  GList *list = NULL;
+  gint i;
+
+  model = mex_generic_model_new ("Test", "test-icon");
+  mex_model_set_sort_func (model, model_sort_a_z, NULL);
+  fill_model (model, 2, "C", "H");
+
+  for (i = 0; i < G_N_ELEMENTS (names); i++)
+    list = g_list_prepend (list, g_object_new (MEX_TYPE_APPLICATION,
+                                               "name", names[i], NULL));
+  mex_model_add (model, list);
+  g_list_free (list);
+
+  check_model (model, 10, "A", "B", "C", "C", "C", "D", "E", "F", "G", "H");
+  g_object_unref (model);
+}
+
+/*
+ * MexViewModel
+ */
+
+static MexContent *
+add_titled_content (MexModel    *model,
+                    const gchar *title)
+{
+  MexContent *content;
+
+  content = g_object_new (MEX_TYPE_GENERIC_CONTENT, NULL);
+  mex_content_set_metadata (content, MEX_CONTENT_METADATA_TITLE, title);
+  mex_content_set_metadata (content, MEX_CONTENT_METADATA_MIMETYPE,
+                            "video/ogg");
+  mex_model_add_content (model, content);
+
+  return content;
+}
+
+static void
+check_titles (MexModel *model,
+              gint      n_items,
+              ...)
+{
+  va_list va_args;
+  gint i;
+
+  g_assert_cmpint (mex_model_get_length (model), ==, n_items);
+
+  va_start (va_args, n_items);
+
+  for (i = 0; i < n_items; i++)
+    {
+      MexContent *content;
+
+      content = mex_model_get_content (model, i);
+
+      g_assert_cmpstr (mex_content_get_metadata (content,
+                                                 MEX_CONTENT_METADATA_TITLE),
+                       ==, va_arg (va_args, gchar *));
+    }
+
+  va_end (va_args);
+}
+
+static void
+test_view_model_incremental (void)
+{
+  MexModel *model, *view;
+  MexContent *b, *c;
+
+  model = mex_generic_model_new ("Test", "test-icon");
+  view = mex_view_model_new (model);
+
+  add_titled_content (model, "C");
+  b = add_titled_content (model, "B");
+  add_titled_content (model, "D");
+  c = add_titled_content (model, "A");
+  check_titles (view, 4, "A", "B", "C", "D");
+
+  /* changing the order-by key moves only the changed item */
+  mex_content_set_metadata (c, MEX_CONTENT_METADATA_TITLE, "E");
+  check_titles (view, 4, "B", "C", "D", "E");
+
+  /* items failing the filter drop out, and come back when they match */
+  mex_view_model_set_filter_by (MEX_VIEW_MODEL (view),
+                                MEX_CONTENT_METADATA_MIMETYPE, MEX_FILTER_EQUAL,
+                                "video/ogg",
+                                MEX_CONTENT_METADATA_NONE);
+  mex_content_set_metadata (b, MEX_CONTENT_METADATA_MIMETYPE, "audio/ogg");
+  check_titles (view, 3, "C", "D", "E");
+  mex_content_set_metadata (b, MEX_CONTENT_METADATA_MIMETYPE, "video/ogg");
+  check_titles (view, 4, "B", "C", "D", "E");
+
+  /* removals from the source model are forwarded */
+  mex_model_remove_content (model, b);
+  check_titles (view, 3, "C", "D", "E");
+
+  mex_model_clear (model);
+  check_titles (view, 0);
+
+  g_object_unref (view);
+  g_object_unref (model);
+}
+
+static void
+test_view_model_batch (void)
+{
+  const gchar *titles[] = { "E", "A", "C" };
+  MexModel *model, *view;
+  GList *list = NULL;
+  gint i;
+
+  model = mex_generic_model_new ("Test", "test-icon");
+  view = mex_view_model_new (model);
+  mex_view_model_set_limit (MEX_VIEW_MODEL (view), 3);
+
+  add_titled_content (model, "D");
+  add_titled_content (model, "B");
+  check_titles (view, 2, "B", "D");
+
+  for (i = 0; i < G_N_ELEMENTS (titles); i++)
+    {
+      MexContent *content = g_object_new (MEX_TYPE_GENERIC_CONTENT, NULL);
+
+      mex_content_set_metadata (content, MEX_CONTENT_METADATA_TITLE,
+                                titles[i]);
+      list = g_list_prepend (list, content);
+    }
+  mex_model_add (model, list);
+  g_list_free (list);
+
+  check_titles (view, 3, "A", "B", "C");
+
+  mex_view_model_set_order_by (MEX_VIEW_MODEL (view),
+                               MEX_CONTENT_METADATA_TITLE, TRUE);
+  check_titles (view, 3, "E", "D", "C");
+
+  /* without an order, the items are back in the order of the model */
+  mex_view_model_set_order_by (MEX_VIEW_MODEL (view),
+                               MEX_CONTENT_METADATA_NONE, FALSE);
+  check_titles (view, 3, "D", "B", "C");
+
+  g_object_unref (view);
+  g_object_unref (model);
+}
+
+static void
+test_view_model_start_content (void)
+{
+  MexModel *model, *view;
+  MexContent *a, *c, *d;
+
+  model = mex_generic_model_new ("Test", "test-icon");
+  view = mex_view_model_new (model);
+
+  a = add_titled_content (model, "A");
+  c = add_titled_content (model, "C");
+  d = add_titled_content (model, "D");
+
+  mex_view_model_set_loop (MEX_VIEW_MODEL (view), TRUE);
+  mex_view_model_set_start_content (MEX_VIEW_MODEL (view), c);
+  check_titles (view, 3, "C", "D", "A");
+  g_assert_cmpint (mex_model_index (view, c), ==, 0);
+  g_assert_cmpint (mex_model_index (view, a), ==, 2);
+
+  /* the start offset follows insertions and removals before it */
+  add_titled_content (model, "B");
+  check_titles (view, 4, "C", "D", "A", "B");
+  g_assert_cmpint (mex_model_index (view, d), ==, 1);
+
+  g_object_ref (a);
+  mex_model_remove_content (model, a);
+  check_titles (view, 3, "C", "D", "B");
+  g_assert_cmpint (mex_model_index (view, a), ==, -1);
+  g_object_unref (a);
+
+  g_object_unref (view);
+  g_object_unref (model);
+}
+
+/*
+ * MexFeed
+ */
+
+static MexContent *
+add_program (MexFeed     *feed,
+             const gchar *title)
+{
+  MexContent *program;
+
+  program = g_object_new (MEX_TYPE_PROGRAM, NULL);
+  mex_content_set_metadata (program, MEX_CONTENT_METADATA_TITLE, title);
+  mex_model_add_content (MEX_MODEL (feed), program);
+  g_object_unref (program);
+
+  return program;
+}
+
+static guint
+search_feed (MexFeed           *feed,
+             MexFeedSearchMode  mode,
+             const gchar       *search)
+{
+  MexModel *results;
+  gchar **terms;
+  guint length;
+
+  /* programs are indexed in a thread */
+  while (mex_feed_is_indexing (feed))
+    g_main_context_iteration (NULL, TRUE);
+
+  results = mex_generic_model_new ("Results", "test-icon");
+  terms = g_strsplit (search, " ", -1);
+
+  mex_feed_search (feed, (const gchar **) terms, mode, results);
+  length = mex_model_get_length (results);
+
+  g_strfreev (terms);
+  g_object_unref (results);
+
+  return length;
+}
+
+static void
+test_feed_search (void)
+{
+  MexFeed *feed;
+  MexContent *amelie, *fish;
+
+  feed = mex_feed_new ("Test", "test");
+  add_program (feed, "The Big Sleep");
+  fish = add_program (feed, "Big Fish");
+  amelie = add_program (feed, "Le Fabuleux Destin d'Amélie Poulain");
+
+  /* substrings, case and accents don't matter */
+  g_assert_cmpuint (search_feed (feed, MEX_FEED_SEARCH_MODE_OR, "big"), ==, 2);
+  g_assert_cmpuint (search_feed (feed, MEX_FEED_SEARCH_MODE_OR, "ee"), ==, 1);
+  g_assert_cmpuint (search_feed (feed, MEX_FEED_SEARCH_MODE_OR, "AMELIE"),
+                    ==, 1);
+  g_assert_cmpuint (search_feed (feed, MEX_FEED_SEARCH_MODE_OR, "abul"),
+                    ==, 1);
+  g_assert_cmpuint (search_feed (feed, MEX_FEED_SEARCH_MODE_OR, "bigs"),
+                    ==, 0);
+
+  g_assert_cmpuint (search_feed (feed, MEX_FEED_SEARCH_MODE_AND, "big fi"),
+                    ==, 1);
+  g_assert_cmpuint (search_feed (feed, MEX_FEED_SEARCH_MODE_OR, "fish le"),
+                    ==, 3);
+
+  /* only the field that changed is indexed again */
+  mex_content_set_metadata (fish, MEX_CONTENT_METADATA_SYNOPSIS, "A tall tale");
+  g_assert_cmpuint (search_feed (feed, MEX_FEED_SEARCH_MODE_AND, "fish tall"),
+                    ==, 1);
+  mex_content_set_metadata (fish, MEX_CONTENT_METADATA_TITLE, "Big Eyes");
+  g_assert_cmpuint (search_feed (feed, MEX_FEED_SEARCH_MODE_OR, "fish"), ==, 0);
+  g_assert_cmpuint (search_feed (feed, MEX_FEED_SEARCH_MODE_AND, "eyes tale"),
+                    ==, 1);
+
+  mex_model_remove_content (MEX_MODEL (feed), amelie);
+  g_assert_cmpuint (search_feed (feed, MEX_FEED_SEARCH_MODE_OR, "amelie"),
+                    ==, 0);
+  g_assert_cmpuint (search_feed (feed, MEX_FEED_SEARCH_MODE_OR, "e"), ==, 2);
+
+  g_object_unref (feed);
+}
+
+/*
+ * MexTextureCache
+ */
+
+static void
+test_texture_cache_lru (void)
+{
+  MexTextureCacheStats before, after;
+  CoglHandle texture;
+  GdkPixbuf *pixbuf;
+  gsize max_size;
+
+  /* Room for two 16x16 textures */
+  max_size = mex_texture_cache_get_max_size ();
+  mex_texture_cache_set_max_size (2 * 16 * 16 * 4);
+  mex_texture_cache_get_stats (&before);
+
+  pixbuf = gdk_pixbuf_new (GDK_COLORSPACE_RGB, TRUE, 8, 16, 16);
+  gdk_pixbuf_fill (pixbuf, 0xff0000ff);
+
+  cogl_handle_unref (mex_texture_cache_add ("test://a", 16, 16, pixbuf));
+  cogl_handle_unref (mex_texture_cache_add ("test://b", 16, 16, pixbuf));
+
+  /* a is now the most recently used, so b gets evicted */
+  texture = mex_texture_cache_lookup ("test://a", 16, 16);
+  g_assert (texture != COGL_INVALID_HANDLE);
+  cogl_handle_unref (texture);
+
+  cogl_handle_unref (mex_texture_cache_add ("test://c", 16, 16, pixbuf));
+
+  g_assert (mex_texture_cache_lookup ("test://b", 16, 16) ==
+            COGL_INVALID_HANDLE);
+  /* the size is part of the key */
+  g_assert (mex_texture_cache_lookup ("test://a", 8, 8) ==
+            COGL_INVALID_HANDLE);
+
+  texture = mex_texture_cache_lookup ("test://a", 16, 16);
+  g_assert (texture != COGL_INVALID_HANDLE);
+  cogl_handle_unref (texture);
+
+  mex_texture_cache_get_stats (&after);
+  g_assert_cmpuint (after.hits - before.hits, ==, 2);
+  g_assert_cmpuint (after.misses - before.misses, ==, 2);
+  g_assert_cmpuint (after.evictions - before.evictions, >=, 1);
+  g_assert_cmpuint (after.n_textures, ==, 2);
+
+  g_object_unref (pixbuf);
+  mex_texture_cache_set_max_size (max_size);
+}
+
+/*
+ * MexGenericContent
+ */
+
+static void
+test_generic_content_compact (void)
+{
+  MexGenericContentStats before, stats;
+  MexModel *model;
+  MexContent *content;
+  gchar *value;
+  gint i;
+
+  mex_generic_content_get_stats (&before);
+
+  /* 20k tracks of 500 albums, titles and URLs are unique */
+  model = mex_generic_model_new ("Music", "Music");
+  for (i = 0; i < 20000; i++)
+    {
+      content = g_object_new (MEX_TYPE_GENERIC_CONTENT, NULL);
+
+      value = g_strdup_printf ("Track %d", i);
+      mex_content_set_metadata (content, MEX_CONTENT_METADATA_TITLE, value);
+      g_free (value);
+      value = g_strdup_printf ("file:///music/%d/%d.ogg", i / 40, i);
+      mex_content_set_metadata (content, MEX_CONTENT_METADATA_URL, value);
+      g_free (value);
+      value = g_strdup_printf ("Album %d", i / 40);
+      mex_content_set_metadata (content, MEX_CONTENT_METADATA_ALBUM, value);
+      g_free (value);
+      value = g_strdup_printf ("Artist %d", i / 400);
+      mex_content_set_metadata (content, MEX_CONTENT_METADATA_ARTIST, value);
+      g_free (value);
+      mex_content_set_metadata (content, MEX_CONTENT_METADATA_MIMETYPE,
+                                "audio/ogg");
+
+      mex_model_add_content (model, content);
+    }
+
+  /* values are found whatever order they were set in */
+  g_assert_cmpstr (mex_content_get_metadata (content,
+                                             MEX_CONTENT_METADATA_MIMETYPE),
+                   ==, "audio/ogg");
+  g_assert_cmpstr (mex_content_get_metadata (content,
+                                             MEX_CONTENT_METADATA_TITLE),
+                   ==, "Track 19999");
+  mex_content_set_metadata (content, MEX_CONTENT_METADATA_ALBUM, NULL);
+  g_assert (mex_content_get_metadata (content,
+                                      MEX_CONTENT_METADATA_ALBUM) == NULL);
+  g_assert_cmpstr (mex_content_get_metadata (content,
+                                             MEX_CONTENT_METADATA_ARTIST),
+                   ==, "Artist 49");
+
+  mex_generic_content_get_stats (&stats);
+  g_assert_cmpuint (stats.n_contents - before.n_contents, ==, 20000);
+  g_assert_cmpuint (stats.n_values - before.n_values, ==, 99999);
+  g_assert_cmpuint (stats.size, <, stats.unshared_size / 2);
+
+  g_test_message ("metadata of 20000 contents: %" G_GSIZE_FORMAT " KiB, "
+                  "%" G_GSIZE_FORMAT " KiB unshared",
+                  (stats.size - before.size) / 1024,
+                  (stats.unshared_size - before.unshared_size) / 1024);
+
+  g_object_unref (model);
+
+  mex_generic_content_get_stats (&stats);
+  g_assert_cmpuint (stats.n_contents, ==, before.n_contents);
+  g_assert_cmpuint (stats.n_values, ==, before.n_values);
+  g_assert_cmpuint (stats.size, ==, before.size);
+}
+
+/*
+ * MexMetadataJournal
+ */
+
+static void
+test_metadata_journal_coalesce (void)
+{
+  MexContent *content;
+  guint n_pending;
+
+  n_pending = mex_metadata_journal_get_n_pending ();
+  content = g_object_new (MEX_TYPE_GENERIC_CONTENT, NULL);
+
+  /* the content is only saved once, and kept alive until then */
+  mex_metadata_journal_add (content);
+  mex_content_set_metadata (content, MEX_CONTENT_METADATA_PLAY_COUNT, "1");
+  mex_metadata_journal_add (content);
+  g_assert_cmpuint (mex_metadata_journal_get_n_pending (), ==, n_pending + 1);
+
+  g_object_add_weak_pointer (G_OBJECT (content), (gpointer *) &content);
+  g_object_unref (content);
+  g_assert (content != NULL);
+
+  mex_metadata_journal_flush ();
+  g_assert_cmpuint (mex_metadata_journal_get_n_pending (), ==, 0);
+  g_assert (content == NULL);
+}
+
+/*
+ * MexGrid
+ */
+
+static void
+test_grid_virtualized (void)
+{
+  ClutterActor *grid;
+  MexContent *first;
+  MexModel *model;
+  gint i;
+
+  model = mex_generic_model_new ("Test", "test-icon");
+  for (i = 0; i < 1000; i++)
+    add_titled_content (model, "A");
+  first = mex_model_get_content (model, 0);
+
+  grid = mex_grid_new ();
+  g_object_ref_sink (grid);
+  mex_grid_set_stride (MEX_GRID (grid), 3);
+  mex_grid_set_virtualized (MEX_GRID (grid), TRUE);
+  mex_grid_set_model (MEX_GRID (grid), model);
+
+  /* only the first few rows get a tile until the grid is laid out */
+  g_assert_cmpint (clutter_actor_get_n_children (grid), <, 100);
+  g_assert (mex_content_view_get_content (MEX_CONTENT_VIEW (
+            clutter_actor_get_first_child (grid))) == first);
+
+  /* insertions and removals don't create tiles either */
+  add_titled_content (model, "B");
+  mex_model_remove_content (model, first);
+  g_assert_cmpint (clutter_actor_get_n_children (grid), <, 100);
+
+  /* but every item has one when not virtualized */
+  mex_grid_set_virtualized (MEX_GRID (grid), FALSE);
+  g_assert_cmpint (clutter_actor_get_n_children (grid), ==, 1000);
+
+  mex_grid_set_model (MEX_GRID (grid), NULL);
+  g_assert_cmpint (clutter_actor_get_n_children (grid), ==, 0);
+
+  clutter_actor_destroy (grid);
+  g_object_unref (grid);
+  g_object_unref (model);
+}
+
+/*
+ * MexColumn
+ */
+
+static void
+test_column_virtualized (void)
+{
+  MxAdjustment *adjustment;
+  ClutterActor *column;
+  MexModel *model;
+  gint i;
+
+  model = mex_generic_model_new ("Test", "test-icon");
+  for (i = 0; i < 1000; i++)
+    add_titled_content (model, "A");
+
+  column = mex_column_new ();
+  g_object_ref_sink (column);
+
+  /* only scrolling columns are virtualized */
+  adjustment = mx_adjustment_new ();
+  mx_scrollable_set_adjustments (MX_SCROLLABLE (column), NULL, adjustment);
+  g_object_unref (adjustment);
+
+  mex_column_set_virtualized (MEX_COLUMN (column), TRUE);
+  mex_column_set_model (MEX_COLUMN (column), model);
+  g_assert_cmpint (clutter_actor_get_n_children (column), <, 100);
+  g_assert (!mex_column_is_empty (MEX_COLUMN (column)));
+
+  mex_model_remove_content (model, mex_model_get_content (model, 0));
+  g_assert_cmpint (clutter_actor_get_n_children (column), <, 100);
+
+  mex_column_set_virtualized (MEX_COLUMN (column), FALSE);
+  g_assert_cmpint (clutter_actor_get_n_children (column), ==, 999);
+
+  mex_model_clear (model);
+  g_assert (mex_column_is_empty (MEX_COLUMN (column)));
+
+  clutter_actor_destroy (column);
+  g_object_unref (column);
+  g_object_unref (model);
+}
+
+static void
+test_column_virtualized_unscrolled (void)
+{
+  ClutterActor *column;
+  MexModel *model;
+  gint i;
+
+  model = mex_generic_model_new ("Test", "test-icon");
+  for (i = 0; i < 20; i++)
+    add_titled_content (model, "A");
+
+  column = mex_column_new ();
+  g_object_ref_sink (column);
+
+  /* without an adjustment, every row is laid out and needs a box */
+  mex_column_set_virtualized (MEX_COLUMN (column), TRUE);
+  mex_column_set_model (MEX_COLUMN (column), model);
+  g_assert_cmpint (clutter_actor_get_n_children (column), ==, 20);
+
+  clutter_actor_destroy (column);
+  g_object_unref (column);
+  g_object_unref (model);
+}
+
+/*
+ * Tracing
+ */
+
+static void
+test_trace_write (void)
+{
+  gchar *filename, *contents;
+  gint64 begin;
+  gint fd;
+
+  fd = g_file_open_tmp ("mex-trace-XXXXXX", &filename, NULL);
+  g_assert_cmpint (fd, >=, 0);
+  close (fd);
+
+  mex_trace_enable (filename);
+  g_assert (mex_trace_enabled ());
+
+  begin = mex_trace_begin ();
+  g_assert_cmpint (begin, >, 0);
+  mex_trace_end (begin, "span \"%d\"", 1);
+  mex_trace_mark ("mark");
+  g_assert_cmpint (mex_trace_get_time (), >, 0);
+
+  g_assert (mex_trace_write (NULL));
+  g_assert (g_file_get_contents (filename, &contents, NULL, NULL));
+  g_assert (strstr (contents, "{\"name\":\"span \\\"1\\\"\",\"ph\":\"X\""));
+  g_assert (strstr (contents, "{\"name\":\"mark\",\"ph\":\"i\""));
+
+  g_unlink (filename);
+  g_free (contents);
+  g_free (filename);
+}
+
 int
 main(int   argc,
      char *argv[])
@@ -130,6 +696,23 @@ main(int   argc,
     mex_init (&argc, &argv);
 
     g_test_add_func ("/core/model/sorted-insertion", test_model_sorted);
+    g_test_add_func ("/core/model/sorted-batch", test_model_sorted_batch);
+    g_test_add_func ("/core/view-model/incremental",
+                     test_view_model_incremental);
+    g_test_add_func ("/core/view-model/batch", test_view_model_batch);
+    g_test_add_func ("/core/view-model/start-content",
+                     test_view_model_start_content);
+    g_test_add_func ("/core/feed/search", test_feed_search);
+    g_test_add_func ("/core/texture-cache/lru", test_texture_cache_lru);
+    g_test_add_func ("/core/generic-content/compact",
+                     test_generic_content_compact);
+    g_test_add_func ("/core/metadata-journal/coalesce",
+                     test_metadata_journal_coalesce);
+    g_test_add_func ("/core/grid/virtualized", test_grid_virtualized);
+    g_test_add_func ("/core/column/virtualized", test_column_virtualized);
+    g_test_add_func ("/core/column/virtualized-unscrolled",
+                     test_column_virtualized_unscrolled);
+    g_test_add_func ("/core/trace/write", test_trace_write);
 
     return g_test_run ();
 }
@@ -16,28 +16,225 @@
  * along with this program; if not, see <http://www.gnu.org/licenses>
  */
 
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
 #include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
 #include <gdk-pixbuf/gdk-pixbuf.h>
 #include <gst/gst.h>
 #include <string.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <unistd.h>
+
+#ifdef HAVE_LIBJPEG
+#include <setjmp.h>
+#include <jpeglib.h>
+#endif
 
 #include <mex/mex-settings.h>
 #include <mex/mex-utils.h>
 
 #define THUMBNAIL_SIZE 512
 
-static void mex_internal_thumbnail_image (const gchar *uri, const gchar *path);
-static void mex_internal_thumbnail_video (const gchar *uri, const gchar *path);
+static gboolean mex_internal_thumbnail_image (const gchar *uri,
+                                              const gchar *path);
+#ifdef HAVE_LIBJPEG
+static gboolean mex_internal_thumbnail_jpeg (const gchar *uri,
+                                             const gchar *path);
+#endif
+static gboolean mex_internal_thumbnail_video (const gchar *uri,
+                                              const gchar *path);
+
+static gboolean
+mex_internal_thumbnail (const gchar *mime,
+                        const gchar *uri,
+                        const gchar *thumbnail_path)
+{
+  if (g_str_has_prefix (mime, "image/"))
+    {
+#ifdef HAVE_LIBJPEG
+      if (g_str_equal (mime, "image/jpeg") &&
+          mex_internal_thumbnail_jpeg (uri, thumbnail_path))
+        return TRUE;
+#endif
+
+      return mex_internal_thumbnail_image (uri, thumbnail_path);
+    }
+  else if (g_str_has_prefix (mime, "video/"))
+    return mex_internal_thumbnail_video (uri, thumbnail_path);
+
+  return FALSE;
+}
+
+static gboolean
+write_all (gint         fd,
+           const gchar *buffer,
+           gsize        length)
+{
+  while (length)
+    {
+      gssize written = write (fd, buffer, length);
+
+      if (written < 0)
+        return FALSE;
+
+      buffer += written;
+      length -= written;
+    }
+
+  return TRUE;
+}
+
+/* Server mode: requests are read from stdin, one per line, as
+ * "mime\turi\tthumbnail-path". Each one is answered on stdout with a
+ * line reading either "ok" or "error". The process exits when stdin is
+ * closed. */
+static int
+mex_internal_thumbnail_serve (void)
+{
+  GIOChannel *channel;
+  gchar *line;
+  gsize terminator;
+  gint reply_fd;
+
+  /* Keep the real stdout for replies and send anything else that gets
+   * printed there (by GStreamer plugins for instance) to stderr instead */
+  reply_fd = dup (STDOUT_FILENO);
+  dup2 (STDERR_FILENO, STDOUT_FILENO);
+
+  channel = g_io_channel_unix_new (STDIN_FILENO);
+  g_io_channel_set_encoding (channel, NULL, NULL);
+
+  while (g_io_channel_read_line (channel, &line, NULL, &terminator,
+                                 NULL) == G_IO_STATUS_NORMAL)
+    {
+      gboolean success = FALSE;
+      gchar **request;
+      const gchar *reply;
+
+      line[terminator] = '\0';
+      request = g_strsplit (line, "\t", 3);
+
+      if (g_strv_length (request) == 3)
+        success = mex_internal_thumbnail (request[0], request[1], request[2]);
+
+      g_strfreev (request);
+      g_free (line);
+
+      reply = success ? "ok\n" : "error\n";
+      if (!write_all (reply_fd, reply, strlen (reply)))
+        break;
+    }
+
+  g_io_channel_unref (channel);
+  close (reply_fd);
+
+  return 0;
+}
+
+/* Benchmark mode: thumbnails every image and video found in a directory
+ * (typically a fixed corpus of test media) into a temporary directory and
+ * reports the throughput for each kind of media. */
+static int
+mex_internal_thumbnail_benchmark (const gchar *corpus)
+{
+  const gchar *kinds[] = { "image/", "video/" };
+  GError *err = NULL;
+  gchar *output_dir;
+  gint i;
+
+  output_dir = g_dir_make_tmp ("mex-thumbnailer-XXXXXX", &err);
+  if (!output_dir)
+    {
+      g_warning (G_STRLOC ": %s", err->message);
+      g_clear_error (&err);
+      return 1;
+    }
+
+  for (i = 0; i < G_N_ELEMENTS (kinds); i++)
+    {
+      guint n_files = 0, n_thumbnails = 0;
+      const gchar *name;
+      GTimer *timer;
+      GDir *dir;
+
+      dir = g_dir_open (corpus, 0, &err);
+      if (!dir)
+        {
+          g_warning (G_STRLOC ": %s", err->message);
+          g_clear_error (&err);
+          break;
+        }
+
+      timer = g_timer_new ();
+      g_timer_stop (timer);
+
+      while ((name = g_dir_read_name (dir)))
+        {
+          gchar *path, *uri, *content_type, *mime, *thumbnail_path;
+          gboolean uncertain;
+
+          path = g_build_filename (corpus, name, NULL);
+          content_type = g_content_type_guess (path, NULL, 0, &uncertain);
+          mime = g_content_type_get_mime_type (content_type);
+          g_free (content_type);
+
+          if (!mime || !g_str_has_prefix (mime, kinds[i]))
+            {
+              g_free (mime);
+              g_free (path);
+              continue;
+            }
+
+          uri = g_filename_to_uri (path, NULL, NULL);
+          thumbnail_path = g_strdup_printf ("%s/%u.jpg", output_dir, n_files);
+
+          g_timer_continue (timer);
+          if (mex_internal_thumbnail (mime, uri, thumbnail_path))
+            n_thumbnails++;
+          g_timer_stop (timer);
+
+          n_files++;
+          g_unlink (thumbnail_path);
+
+          g_free (thumbnail_path);
+          g_free (uri);
+          g_free (mime);
+          g_free (path);
+        }
+
+      if (n_files)
+        g_print ("%s: %u/%u thumbnails in %.2f s, %.1f thumbnails/s\n",
+                 i == 0 ? "images" : "videos",
+                 n_thumbnails, n_files, g_timer_elapsed (timer, NULL),
+                 n_thumbnails / g_timer_elapsed (timer, NULL));
+
+      g_timer_destroy (timer);
+      g_dir_close (dir);
+    }
+
+  g_rmdir (output_dir);
+  g_free (output_dir);
+
+  return 0;
+}
 
 int
 main (int argc, char **argv)
 {
-  gchar *mime, *settings;
+  gchar *settings;
   GstRegistry *registry;
   GKeyFile *key_file;
+  gboolean server, benchmark;
+
+  server = (argc == 2 && g_str_equal (argv[1], "--server"));
+  benchmark = (argc == 3 && g_str_equal (argv[1], "--benchmark"));
 
-  if (argc != 4)
+  if (argc != 4 && !server && !benchmark)
     return 1;
 
   g_type_init ();
@@ -70,29 +267,169 @@ main (int argc, char **argv)
               if (plugin)
                 gst_registry_remove_plugin (registry, plugin);
             }
+
+          g_strfreev (denied_plugins);
         }
       g_key_file_free (key_file);
       g_free (settings);
     }
 
-  mime = argv[1];
+  if (server)
+    return mex_internal_thumbnail_serve ();
 
-  if (g_str_has_prefix (mime, "image/"))
-    mex_internal_thumbnail_image (argv[2], argv[3]);
-  else if (g_str_has_prefix (mime, "video/"))
-    {
-      gst_init (&argc, &argv);
+  if (benchmark)
+    return mex_internal_thumbnail_benchmark (argv[2]);
+
+  return mex_internal_thumbnail (argv[1], argv[2], argv[3]) ? 0 : 1;
+}
 
-      mex_internal_thumbnail_video (argv[2], argv[3]);
+/* Size of the thumbnail of a width x height picture, the longest side is
+ * THUMBNAIL_SIZE pixels */
+static void
+get_thumbnail_size (gint  width,
+                    gint  height,
+                    gint *dw,
+                    gint *dh)
+{
+  if (width > height)
+    {
+      *dw = THUMBNAIL_SIZE;
+      *dh = MAX (height * THUMBNAIL_SIZE / width, 1);
     }
   else
-    return 1;
+    {
+      *dh = THUMBNAIL_SIZE;
+      *dw = MAX (width * THUMBNAIL_SIZE / height, 1);
+    }
+}
 
-  return 0;
+#ifdef HAVE_LIBJPEG
+/* JPEG thumbnailer */
+typedef struct
+{
+  struct jpeg_error_mgr pub;
+  jmp_buf               setjmp_buffer;
+} JpegErrorMgr;
+
+static void
+jpeg_error_exit_cb (j_common_ptr cinfo)
+{
+  JpegErrorMgr *jerr = (JpegErrorMgr *) cinfo->err;
+
+  longjmp (jerr->setjmp_buffer, 1);
 }
 
-/* image thumbnailer */
 static void
+jpeg_output_message_cb (j_common_ptr cinfo)
+{
+  /* Warnings about slightly corrupt files are common and harmless */
+}
+
+/* Decodes the file straight at the largest 1/2, 1/4 or 1/8 reduction that
+ * is still bigger than the thumbnail, so that most of the pixels of large
+ * photos are never decoded. The fast integer IDCT and plain chroma
+ * upsampling are good enough for something that gets scaled down anyway.
+ * Returns FALSE for anything libjpeg can't handle on its own (CMYK files
+ * for instance), those go through gdk-pixbuf.
+ */
+static gboolean
+mex_internal_thumbnail_jpeg (const gchar *uri,
+                             const gchar *thumbnail_path)
+{
+  struct jpeg_decompress_struct cinfo;
+  GdkPixbuf *volatile pixbuf = NULL;
+  GdkPixbuf *output;
+  JpegErrorMgr jerr;
+  GError *err = NULL;
+  gchar *filename;
+  guchar *pixels;
+  guint max_side, denom;
+  gint rowstride, dw, dh;
+  FILE *file;
+
+  filename = g_filename_from_uri (uri, NULL, NULL);
+  if (!filename)
+    return FALSE;
+
+  file = fopen (filename, "rb");
+  g_free (filename);
+
+  if (!file)
+    return FALSE;
+
+  cinfo.err = jpeg_std_error (&jerr.pub);
+  jerr.pub.error_exit = jpeg_error_exit_cb;
+  jerr.pub.output_message = jpeg_output_message_cb;
+
+  if (setjmp (jerr.setjmp_buffer))
+    {
+      jpeg_destroy_decompress (&cinfo);
+      fclose (file);
+
+      if (pixbuf)
+        g_object_unref (pixbuf);
+
+      return FALSE;
+    }
+
+  jpeg_create_decompress (&cinfo);
+  jpeg_stdio_src (&cinfo, file);
+  jpeg_read_header (&cinfo, TRUE);
+
+  max_side = MAX (cinfo.image_width, cinfo.image_height);
+  denom = 8;
+  while (denom > 1 && max_side / denom < THUMBNAIL_SIZE)
+    denom /= 2;
+
+  cinfo.scale_num = 1;
+  cinfo.scale_denom = denom;
+  cinfo.out_color_space = JCS_RGB;
+  cinfo.dct_method = JDCT_IFAST;
+  cinfo.do_fancy_upsampling = FALSE;
+
+  jpeg_start_decompress (&cinfo);
+
+  pixbuf = gdk_pixbuf_new (GDK_COLORSPACE_RGB, FALSE, 8,
+                           cinfo.output_width, cinfo.output_height);
+  if (!pixbuf)
+    longjmp (jerr.setjmp_buffer, 1);
+
+  pixels = gdk_pixbuf_get_pixels (pixbuf);
+  rowstride = gdk_pixbuf_get_rowstride (pixbuf);
+
+  while (cinfo.output_scanline < cinfo.output_height)
+    {
+      JSAMPROW row = pixels + cinfo.output_scanline * rowstride;
+
+      jpeg_read_scanlines (&cinfo, &row, 1);
+    }
+
+  jpeg_finish_decompress (&cinfo);
+  jpeg_destroy_decompress (&cinfo);
+  fclose (file);
+
+  get_thumbnail_size (gdk_pixbuf_get_width (pixbuf),
+                      gdk_pixbuf_get_height (pixbuf),
+                      &dw, &dh);
+  output = gdk_pixbuf_scale_simple (pixbuf, dw, dh, GDK_INTERP_BILINEAR);
+  g_object_unref (pixbuf);
+
+  gdk_pixbuf_save (output, thumbnail_path, "jpeg", &err, NULL);
+  g_object_unref (output);
+
+  if (err)
+    {
+      g_warning (G_STRLOC ": %s", err->message);
+      g_clear_error (&err);
+      return FALSE;
+    }
+
+  return TRUE;
+}
+#endif
+
+/* image thumbnailer */
+static gboolean
 mex_internal_thumbnail_image (const gchar *uri,
                               const gchar *thumbnail_path)
 {
@@ -109,17 +446,20 @@ mex_internal_thumbnail_image (const gchar *uri,
     {
       g_warning (G_STRLOC ": %s", err->message);
       g_clear_error (&err);
+      return FALSE;
     }
-  else
-    {
-      gdk_pixbuf_save (pixbuf, thumbnail_path, "jpeg", &err, NULL);
 
-      if (err)
-        {
-          g_warning (G_STRLOC ": %s", err->message);
-          g_clear_error (&err);
-        }
+  gdk_pixbuf_save (pixbuf, thumbnail_path, "jpeg", &err, NULL);
+  g_object_unref (pixbuf);
+
+  if (err)
+    {
+      g_warning (G_STRLOC ": %s", err->message);
+      g_clear_error (&err);
+      return FALSE;
     }
+
+  return TRUE;
 }
 
 /* video thumbnailer */
@@ -221,10 +561,7 @@ get_shot (const char *uri)
           g_object_get (video_sink, "last-pixbuf", &shot, NULL);
 
           if (shot == NULL)
-            {
-              g_warning ("No frame for %s", uri);
-              return NULL;
-            }
+            g_warning ("No frame for %s", uri);
         }
 
     }
@@ -235,86 +572,69 @@ get_shot (const char *uri)
   return shot;
 }
 
+/* A grid of about HISTOGRAM_SAMPLES x HISTOGRAM_SAMPLES pixels is plenty
+ * to tell a blank or black frame from an actual picture */
+#define HISTOGRAM_SAMPLES 128
+
 static gboolean
 is_interesting (GdkPixbuf *pixbuf)
 {
-  int width, height, r, rowstride;
-  gboolean has_alpha;
-  guint32 histogram[4][4][4] = {{{0,},},};
+  int width, height, r, rowstride, n_channels, x_step, y_step;
+  guint32 histogram[64] = { 0, };
   guchar *pixels;
   int pxl_count = 0, count, i;
 
   width = gdk_pixbuf_get_width (pixbuf);
   height = gdk_pixbuf_get_height (pixbuf);
   rowstride = gdk_pixbuf_get_rowstride (pixbuf);
-  has_alpha = gdk_pixbuf_get_has_alpha (pixbuf);
+  n_channels = gdk_pixbuf_get_n_channels (pixbuf);
+
+  x_step = MAX (width / HISTOGRAM_SAMPLES, 1) * n_channels;
+  y_step = MAX (height / HISTOGRAM_SAMPLES, 1);
 
   pixels = gdk_pixbuf_get_pixels (pixbuf);
-  for (r = 0; r < height; r++)
+  for (r = 0; r < height; r += y_step)
     {
-      guchar *row = pixels + (r * rowstride);
-      int c;
+      const guchar *p = pixels + (r * rowstride);
+      const guchar *end = p + width * n_channels;
 
-      for (c = 0; c < width; c++)
+      /* 4 levels per channel, bins are indexed as 0brrggbb */
+      for (; p < end; p += x_step)
         {
-          guchar red, green, blue;
-
-          red = row[0];
-          green = row[1];
-          blue = row[2];
-
-          histogram[red / 64][green / 64][blue / 64]++;
-
-          if (has_alpha)
-            {
-              row += 4;
-            }
-          else
-            {
-              row += 3;
-            }
-
+          histogram[((p[0] >> 6) << 4) | ((p[1] >> 6) << 2) | (p[2] >> 6)]++;
           pxl_count++;
         }
     }
 
+  /* Count how many bins have more than 1% of the pixels in the histogram */
   count = 0;
-  for (i = 0; i < 4; i++)
+  for (i = 0; i < G_N_ELEMENTS (histogram); i++)
     {
-      int j;
-      for (j = 0; j < 4; j++)
-        {
-          int k;
-
-          for (k = 0; k < 4; k++)
-            {
-              /* Count how many bins have more than
-                 1% of the pixels in the histogram */
-              if (histogram[i][j][k] > pxl_count / 100)
-                {
-                  count++;
-                }
-            }
-        }
+      if (histogram[i] > pxl_count / 100)
+        count++;
     }
 
   /* Image is boring if there is only 1 bin with > 1% of pixels */
   return count > 1;
 }
 
-void
+static gboolean
 mex_internal_thumbnail_video (const gchar *uri,
                               const gchar *thumbnail_path)
 {
+  gboolean success = FALSE;
   GdkPixbuf *shot = NULL;
   gboolean interesting = FALSE;
   int count = 0;
 
   while (interesting == FALSE && count < 5)
     {
+      if (shot)
+        g_object_unref (shot);
+
       shot = get_shot (uri);
       if (shot == NULL)
-        return;
+        return FALSE;
 
       count++;
       interesting = is_interesting (shot);
@@ -323,32 +643,20 @@ mex_internal_thumbnail_video (const gchar *uri,
   if (shot)
     {
       GdkPixbuf *output;
-      int dw, dh, width, height;
+      int dw, dh;
       GError *error = NULL;
 
-      width = gdk_pixbuf_get_width (shot);
-      height = gdk_pixbuf_get_height (shot);
+      get_thumbnail_size (gdk_pixbuf_get_width (shot),
+                          gdk_pixbuf_get_height (shot),
+                          &dw, &dh);
 
-      if (width > height)
-        {
-          double ratio;
+      /* When reducing, bilinear filtering averages all the source pixels
+       * covered by each destination pixel, which looks as good as
+       * GDK_INTERP_HYPER at a fraction of the cost. */
+      output = gdk_pixbuf_scale_simple (shot, dw, dh, GDK_INTERP_BILINEAR);
 
-          ratio = (double) THUMBNAIL_SIZE / (double) width;
-          dw = THUMBNAIL_SIZE;
-          dh = height * ratio;
-        }
-      else
-        {
-          double ratio;
-
-          ratio = (double) THUMBNAIL_SIZE / (double) height;
-          dh = THUMBNAIL_SIZE;
-          dw = width * ratio;
-        }
-
-      output = gdk_pixbuf_scale_simple (shot, dw, dh, GDK_INTERP_HYPER);
-
-      if (gdk_pixbuf_save (output, thumbnail_path, "jpeg", &error, NULL) == FALSE)
+      success = gdk_pixbuf_save (output, thumbnail_path, "jpeg", &error, NULL);
+      if (!success)
         {
           g_warning ("Error writing file %s for %s: %s", thumbnail_path, uri,
                      error->message);
@@ -358,5 +666,7 @@ mex_internal_thumbnail_video (const gchar *uri,
       g_object_unref (output);
       g_object_unref (shot);
     }
+
+  return success;
 }
 